@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""Code generation throughput.
+
+Generates a large program with gen_large.py, then runs `sig --emit-c` on it
+several times and reports the codegen stage's time, the C it produced per
+second, and source lines per second. Every run must print byte-identical C:
+code generation is deterministic, so a differing run is reported as an error.
+
+Normally invoked through the CMake `bench-codegen` target:
+
+    cmake --build build --target bench-codegen
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import subprocess
+import sys
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+def run(sig, source):
+    """One `sig --emit-c`: the codegen stage's stats and a hash of the C."""
+    proc = subprocess.run([sig, "--emit-c", "--stats-json", source],
+                          check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    stats = json.loads(proc.stderr)
+    codegen = next(p for p in stats["passes"] if p["name"] == "codegen")
+    return {
+        "cpu_ms": codegen["cpu_ms"],
+        "c_bytes": stats["counts"]["c_bytes"],
+        "ir_instrs": stats["counts"]["ir_instrs"],
+        "sha1": hashlib.sha1(proc.stdout).hexdigest(),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--sig", required=True, help="path to the sig compiler")
+    parser.add_argument("--work-dir", default="bench-work")
+    parser.add_argument("--lines", type=int, default=100000)
+    parser.add_argument("--repeat", type=int, default=5)
+    args = parser.parse_args()
+
+    os.makedirs(args.work_dir, exist_ok=True)
+    source = os.path.join(args.work_dir, "codegen_%d.sgm" % args.lines)
+    subprocess.run([sys.executable, os.path.join(BENCH_DIR, "gen_large.py"), source,
+                    "--lines", str(args.lines)], check=True)
+
+    runs = [run(args.sig, source) for _ in range(args.repeat)]
+    best = min(r["cpu_ms"] for r in runs)
+    c_bytes = runs[0]["c_bytes"]
+    print("%d lines, %d IR instructions -> %.2f MB of C" % (args.lines, runs[0]["ir_instrs"], c_bytes / 1e6))
+    print("codegen: %.1f ms (best of %d)  %.0f MB/s  %.2fM lines/s" % (
+        best, args.repeat, c_bytes / 1e6 / (best / 1e3), args.lines / 1e6 / (best / 1e3)))
+
+    hashes = sorted(set(r["sha1"] for r in runs))
+    if len(hashes) != 1:
+        print("error: %d runs produced %d different outputs" % (len(runs), len(hashes)), file=sys.stderr)
+        return 1
+    print("output: identical across %d runs (sha1 %s)" % (len(runs), hashes[0][:12]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
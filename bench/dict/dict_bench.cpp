@@ -0,0 +1,122 @@
+// sigma_dict_bench: the runtime's dict against std::unordered_map.
+//
+//   sigma_dict_bench [keys]
+//
+// Runs the same operations on both, with the same keys: the runtime calls
+// sig generates (sigma_side.c) on one side, operator[] and find on the
+// other.
+//
+//   insert       `keys` distinct random ints into an empty table
+//   hit, miss    look each of them up again, then as many absent ones
+//   word count   counts[word]++ over `keys` words drawn from 20011
+//                distinct strings, as in bench/workloads/word_count.sgm
+//
+// The word count runs twice: growing from empty, and sized up front with
+// dict(n) / reserve(n).
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+int64_t sigma_side_insert(const int64_t* keys, size_t n);
+int64_t sigma_side_lookup(const int64_t* keys, size_t n);
+void sigma_side_words(const int* ids, size_t n, int distinct);
+void sigma_side_count(size_t n, int capacity);
+int64_t sigma_side_counted(const char* word);
+}
+
+static const int DISTINCT = 20011;
+
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t splitmix(uint64_t& x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static void row(const char* name, size_t n, double sigma, double stl, int64_t check) {
+    printf("%-22s %8.1f ns/op %8.1f ns/op  %5.2fx   (%" PRId64 ")\n", name, sigma * 1e9 / n, stl * 1e9 / n,
+           stl / sigma, check);
+}
+
+// The fastest of ROUNDS runs of `f`, in seconds.
+static const int ROUNDS = 5;
+
+template <typename F>
+static double best(F f) {
+    double min = 1e30;
+    for (int r = 0; r < ROUNDS; r++) {
+        double t = now();
+        f();
+        t = now() - t;
+        if (t < min) min = t;
+    }
+    return min;
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    std::vector<int64_t> present, absent;
+    std::vector<int> ids;
+    std::vector<std::string> words;
+    uint64_t seed = 42;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t r = splitmix(seed);
+        present.push_back((int64_t)(r >> 1));
+        absent.push_back(-(int64_t)(r >> 1) - 1);
+        ids.push_back((int)(splitmix(seed) % DISTINCT));
+        words.push_back("w" + std::to_string(ids.back()));
+    }
+    sigma_side_words(ids.data(), n, DISTINCT);
+    printf("%zu keys, best of %d\n%-22s %14s %14s %8s\n", n, ROUNDS, "", "sigma dict", "unordered_map", "speedup");
+
+    std::unordered_map<int64_t, int64_t> m;
+    int64_t size = 0;
+    double sigma = best([&] { size = sigma_side_insert(present.data(), n); });
+    double stl = best([&] {
+        m = {};
+        for (size_t i = 0; i < n; i++) m[present[i]] = (int64_t)i;
+    });
+    row("insert int", n, sigma, stl, size - (int64_t)m.size());
+
+    int64_t sum = 0, sumStl = 0;
+    sigma = best([&] { sum = sigma_side_lookup(present.data(), n); });
+    stl = best([&] {
+        sumStl = 0;
+        for (size_t i = 0; i < n; i++) sumStl += m.find(present[i])->second;
+    });
+    row("lookup int, hit", n, sigma, stl, sum - sumStl);
+
+    sigma = best([&] { sum = sigma_side_lookup(absent.data(), n); });
+    stl = best([&] {
+        sumStl = 0;
+        for (size_t i = 0; i < n; i++) {
+            auto it = m.find(absent[i]);
+            if (it != m.end()) sumStl += it->second;
+        }
+    });
+    row("lookup int, miss", n, sigma, stl, sum - sumStl);
+
+    for (int sized = 0; sized < 2; sized++) {
+        std::unordered_map<std::string, int64_t> counts;
+        sigma = best([&] { sigma_side_count(n, sized ? DISTINCT : 0); });
+        stl = best([&] {
+            counts = {};
+            if (sized) counts.reserve(DISTINCT);
+            for (size_t i = 0; i < n; i++) counts[words[i]]++;
+        });
+        int64_t diff = 0;
+        for (auto& e : counts) diff += e.second - sigma_side_counted(e.first.c_str());
+        row(sized ? "word count, dict(n)" : "word count", n, sigma, stl, diff);
+    }
+    return 0;
+}
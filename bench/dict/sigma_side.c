@@ -0,0 +1,44 @@
+// The Sigma half of sigma_dict_bench, in C because sigma_rt.h is: the same
+// runtime calls sig generates for d[k]: v, d[k] and counts[word]++.
+#include "sigma_rt.h"
+
+static SigmaValue ints;
+static SigmaValue counts;
+static SigmaValue* words;
+
+int64_t sigma_side_insert(const int64_t* keys, size_t n) {
+  ints = sigma_make_dict();
+  for (size_t i = 0; i < n; i++) sigma_dict_set(ints, sigma_make_int(keys[i]), sigma_make_int((int64_t)i));
+  return sigma_len(ints);
+}
+
+int64_t sigma_side_lookup(const int64_t* keys, size_t n) {
+  int64_t sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    SigmaValue v = sigma_dict_get(ints, sigma_make_int(keys[i]));
+    if (v.type == TYPE_INT) sum += v.as.integer;
+  }
+  return sum;
+}
+
+// Sigma strings for words "w<id>", one per distinct id.
+void sigma_side_words(const int* ids, size_t n, int distinct) {
+  SigmaValue* table = malloc(sizeof(SigmaValue) * distinct);
+  for (int i = 0; i < distinct; i++) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "w%d", i);
+    table[i] = sigma_make_string(buf);
+  }
+  words = malloc(sizeof(SigmaValue) * n);
+  for (size_t i = 0; i < n; i++) words[i] = table[ids[i]];
+}
+
+void sigma_side_count(size_t n, int capacity) {
+  counts = capacity ? sigma_make_dict_sized(sigma_make_int(capacity)) : sigma_make_dict();
+  for (size_t i = 0; i < n; i++) sigma_index_increment(counts, words[i]);
+}
+
+int64_t sigma_side_counted(const char* word) {
+  SigmaValue v = sigma_dict_get(counts, sigma_make_string(word));
+  return v.type == TYPE_INT ? v.as.integer : 0;
+}
@@ -0,0 +1,67 @@
+// sigma_call_bench: the per-call cost of calling Sigma through libsigma.
+//
+//   sigma_call_bench [rules.sgm] [calls]
+//
+// Compiles the module once, then times the same calls made four ways: a
+// plain C++ function with the same value ABI (the floor), sigma_invoke on a
+// function handle, sigma_call by name, and sigma::Module::call, which also
+// converts its C++ arguments.
+#include "sigma.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+// What score() computes, in C++.
+__attribute__((noinline)) static sigma_value nativeScore(sigma_value base, sigma_value mult) {
+    if (base.as.i > 100) return sigma_int(base.as.i * mult.as.i);
+    return sigma_int(base.as.i + mult.as.i);
+}
+
+template <class F>
+static void report(const char* name, long calls, F&& call) {
+    int64_t sink = 0;
+    for (long i = 0; i < calls / 10; i++) sink += call(i).as.i;
+    auto start = Clock::now();
+    for (long i = 0; i < calls; i++) sink += call(i).as.i;
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    printf("%-34s %8.1f ns/call   (checksum %lld)\n", name, ns / calls, (long long)sink);
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "bench/embed/rules.sgm";
+    long calls = argc > 2 ? atol(argv[2]) : 10000000;
+
+    auto start = Clock::now();
+    sigma::Module rules = sigma::Module::compile(path);
+    double compileMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    printf("compile + load %s: %.1f ms (once)\n\n", path.c_str(), compileMs);
+
+    const sigma_function* nothing = rules.function("nothing");
+    const sigma_function* score = rules.function("score");
+    sigma_value gold = sigma_string(rules.get(), "gold");
+
+    report("C++ function, same ABI", calls, [&](long i) {
+        return nativeScore(sigma_int(i & 255), sigma_int(3));
+    });
+    report("sigma_invoke nothing()", calls, [&](long) {
+        return sigma_invoke(nothing, nullptr, 0);
+    });
+    report("sigma_invoke score(i, 3)", calls, [&](long i) {
+        sigma_value args[] = {sigma_int(i & 255), sigma_int(3)};
+        return sigma_invoke(score, args, 2);
+    });
+    report("sigma_call \"score\" by name", calls, [&](long i) {
+        sigma_value args[] = {sigma_int(i & 255), sigma_int(3)};
+        return sigma_call(rules.get(), "score", args, 2);
+    });
+    report("Module::call(score, i, 3)", calls, [&](long i) {
+        return rules.call(score, i & 255, 3);
+    });
+    report("Module::call(\"tier\", string)", calls, [&](long) {
+        return rules.call("tier", gold);
+    });
+    return 0;
+}
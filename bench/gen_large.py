@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+"""Generate a large, syntactically varied Sigma program for front-end benchmarks.
+
+Usage: gen_large.py <output.sgm> [--lines N]
+"""
+
+import argparse
+
+
+def function_block(k):
+    return [
+        "fn step_%d: (a, b) {" % k,
+        "    t: a + b * %d" % (k % 7 + 1),
+        "    $if t > %d :: {" % (k * 3),
+        "        t: t - b",
+        "    }",
+        "    $el :: t: t + 1",
+        "    cfg: { id:: %d, name:: \"step_%d\", weight:: %d.5 }" % (k, k, k % 10),
+        "    return t + cfg.id",
+        "}",
+        "",
+    ]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("output")
+    parser.add_argument("--lines", type=int, default=5000)
+    args = parser.parse_args()
+
+    lines = ["-- Generated by bench/gen_large.py; do not edit.", ""]
+    k = 0
+    while len(lines) < args.lines:
+        lines.extend(function_block(k))
+        k += 1
+
+    lines.append("acc: 0")
+    for i in range(k):
+        lines.append("acc: step_%d.run(acc, %d)" % (i, i))
+    lines.append("yap(acc)")
+
+    with open(args.output, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,138 @@
+// bench_run: run one command and report its cost as a single JSON object.
+//
+//   bench_run [--stdout <file>] -- <command> [args...]
+//
+// Reports wall time, user/system CPU time and peak RSS (from wait4) and the
+// number of instructions retired by the command and everything it spawns,
+// counted with perf_event_open when the kernel allows it (null otherwise).
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int open_instruction_counter(pid_t pid) {
+#ifdef __linux__
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.disabled = 1;
+  attr.enable_on_exec = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+#else
+  (void)pid;
+  return -1;
+#endif
+}
+
+int main(int argc, char** argv) {
+  const char* stdout_path = NULL;
+  int i = 1;
+  for (; i < argc; i++) {
+    if (strcmp(argv[i], "--stdout") == 0 && i + 1 < argc) {
+      stdout_path = argv[++i];
+    } else if (strcmp(argv[i], "--") == 0) {
+      i++;
+      break;
+    } else {
+      break;
+    }
+  }
+  if (i >= argc) {
+    fprintf(stderr, "Usage: bench_run [--stdout <file>] -- <command> [args...]\n");
+    return 2;
+  }
+
+  // The child blocks on this pipe until the counter is attached, so that
+  // enable_on_exec starts counting exactly at exec().
+  int go[2];
+  if (pipe(go) != 0) {
+    perror("pipe");
+    return 2;
+  }
+
+  double start = now_seconds();
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return 2;
+  }
+  if (pid == 0) {
+    char c;
+    close(go[1]);
+    if (read(go[0], &c, 1) != 1) _exit(127);
+    close(go[0]);
+    if (stdout_path) {
+      int fd = open(stdout_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0) _exit(127);
+      close(fd);
+    }
+    execvp(argv[i], &argv[i]);
+    perror(argv[i]);
+    _exit(127);
+  }
+
+  close(go[0]);
+  int counter = open_instruction_counter(pid);
+  if (write(go[1], "x", 1) != 1) {
+    perror("write");
+    return 2;
+  }
+  close(go[1]);
+
+  int status = 0;
+  struct rusage usage;
+  while (wait4(pid, &status, 0, &usage) < 0) {
+    if (errno != EINTR) {
+      perror("wait4");
+      return 2;
+    }
+  }
+  double wall = now_seconds() - start;
+
+  long long instructions = -1;
+  if (counter >= 0) {
+    uint64_t count = 0;
+    if (read(counter, &count, sizeof(count)) == sizeof(count)) instructions = (long long)count;
+    close(counter);
+  }
+
+  int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  printf("{\"wall_s\": %.6f, \"user_s\": %.6f, \"sys_s\": %.6f, \"max_rss_kb\": %ld, ",
+         wall,
+         usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6,
+         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6,
+         usage.ru_maxrss);
+  if (instructions >= 0) {
+    printf("\"instructions\": %lld, ", instructions);
+  } else {
+    printf("\"instructions\": null, ");
+  }
+  printf("\"exit_code\": %d}\n", exit_code);
+  return 0;
+}
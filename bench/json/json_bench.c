@@ -0,0 +1,248 @@
+// sigma_json_bench: json_parse and json_stringify throughput.
+//
+//   sigma_json_bench [file.json ...]
+//
+// Without arguments it generates three documents shaped like the usual
+// JSON corpora, deterministically, so that runs compare:
+//
+//   twitter   search results: nested objects with the same keys over and
+//             over, text with non-ASCII characters and \u escapes, 64-bit
+//             ids, many nulls and bools (like twitter.json, 0.6 MB)
+//   canada    one GeoJSON polygon: arrays of [longitude, latitude] pairs,
+//             decs with 15 to 17 digits (like canada.json, 2.2 MB)
+//   citm      a catalog: objects keyed by id, short arrays of ints
+//             (like citm_catalog.json, 1.7 MB)
+//
+// Given files, it measures those instead (the real corpora, say). Each
+// figure is the best of several runs, in GB/s of JSON text: the input for
+// parsing, the output for stringifying (which writes compact JSON, so the
+// two sizes differ when the input is indented).
+#include "sigma_rt.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// --- documents ---
+
+typedef struct {
+  char* data;
+  size_t len, capacity;
+} Buf;
+
+static void put(Buf* b, const char* s) {
+  size_t n = strlen(s);
+  if (b->len + n + 1 > b->capacity) {
+    b->capacity = (b->len + n + 1) * 2;
+    b->data = realloc(b->data, b->capacity);
+  }
+  memcpy(b->data + b->len, s, n + 1);
+  b->len += n;
+}
+
+static void putf(Buf* b, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+static void putf(Buf* b, const char* fmt, ...) {
+  char tmp[1024];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(tmp, sizeof(tmp), fmt, args);
+  va_end(args);
+  put(b, tmp);
+}
+
+static uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next(void) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+static const char* const words[] = {
+  "the", "of", "sigma", "json", "fast", "parse", "index", "bytes", "value", "array",
+  "caf\xc3\xa9", "na\xc3\xafve", "\xe6\x9d\xb1\xe4\xba\xac", "\xe5\x90\x8d\xe5\x89\x8d", "\\u00e9t\\u00e9",
+  "line\\nbreak", "\\\"quoted\\\"", "tab\\there", "http:\\/\\/t.co\\/x", "\xf0\x9f\x98\x80"
+};
+
+static void put_text(Buf* b, int n) {
+  put(b, "\"");
+  for (int i = 0; i < n; i++) {
+    if (i) put(b, " ");
+    put(b, words[next() % (sizeof(words) / sizeof(words[0]))]);
+  }
+  put(b, "\"");
+}
+
+static void put_user(Buf* b, int id) {
+  putf(b, "{\"id\":%d,\"id_str\":\"%d\",\"name\":", id, id);
+  put_text(b, 2);
+  putf(b, ",\"screen_name\":\"user%d\",\"location\":", id);
+  put_text(b, 1);
+  put(b, ",\"description\":");
+  put_text(b, 12);
+  putf(b, ",\"url\":null,\"protected\":false,\"followers_count\":%d,\"friends_count\":%d,"
+       "\"listed_count\":%d,\"created_at\":\"Sat Jul 19 05:33:%02d +0000 2014\",\"favourites_count\":%d,"
+       "\"utc_offset\":null,\"time_zone\":null,\"geo_enabled\":%s,\"verified\":false,\"statuses_count\":%d,"
+       "\"lang\":\"ja\",\"profile_background_color\":\"C0DEED\",\"profile_image_url\":"
+       "\"http:\\/\\/pbs.twimg.com\\/profile_images\\/%d\\/normal.jpeg\",\"following\":false}",
+       (int)(next() % 5000), (int)(next() % 1000), (int)(next() % 50), (int)(next() % 60),
+       (int)(next() % 9000), next() % 2 ? "true" : "false", (int)(next() % 100000), id);
+}
+
+static char* twitter(size_t* len) {
+  Buf b = {0};
+  put(&b, "{\"statuses\":[");
+  for (int i = 0; i < 400; i++) {
+    if (i) put(&b, ",");
+    uint64_t id = 505874924095815681ULL + next() % 1000000;
+    putf(&b, "{\"metadata\":{\"result_type\":\"recent\",\"iso_language_code\":\"ja\"},"
+         "\"created_at\":\"Sun Aug 31 00:29:%02d +0000 2014\",\"id\":%llu,\"id_str\":\"%llu\",\"text\":",
+         i % 60, (unsigned long long)id, (unsigned long long)id);
+    put_text(&b, 14);
+    put(&b, ",\"source\":\"<a href=\\\"http:\\/\\/twitter.com\\/download\\/iphone\\\" rel=\\\"nofollow\\\">"
+        "Twitter for iPhone<\\/a>\",\"truncated\":false,\"in_reply_to_status_id\":null,"
+        "\"in_reply_to_user_id\":null,\"user\":");
+    put_user(&b, 1186275104 + i);
+    putf(&b, ",\"geo\":null,\"coordinates\":null,\"place\":null,\"retweet_count\":%d,\"favorite_count\":%d,"
+         "\"entities\":{\"hashtags\":[],\"symbols\":[],\"urls\":[],\"user_mentions\":[{\"screen_name\":"
+         "\"aym0566x\",\"name\":", (int)(next() % 100), (int)(next() % 100));
+    put_text(&b, 2);
+    putf(&b, ",\"id\":%d,\"id_str\":\"%d\",\"indices\":[0,9]}]},\"favorited\":false,\"retweeted\":false,"
+         "\"lang\":\"ja\"}", 586671909 + i, 586671909 + i);
+  }
+  put(&b, "],\"search_metadata\":{\"completed_in\":0.087,\"max_id\":505874924095815681,\"count\":400}}");
+  *len = b.len;
+  return b.data;
+}
+
+static char* canada(size_t* len) {
+  Buf b = {0};
+  put(&b, "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"properties\":{\"name\":\"Canada\"},"
+      "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[");
+  double lon = -65.613616999999977, lat = 43.420273000000009;
+  for (int ring = 0; ring < 480; ring++) {
+    put(&b, ring ? ",[" : "[");
+    for (int i = 0; i < 115; i++) {
+      lon += ((double)(next() % 2001) - 1000) * 1.3e-5;
+      lat += ((double)(next() % 2001) - 1000) * 1.1e-5;
+      putf(&b, "%s[%.15f,%.15f]", i ? "," : "", lon, lat);
+    }
+    put(&b, "]");
+  }
+  put(&b, "]}}]}");
+  *len = b.len;
+  return b.data;
+}
+
+static char* citm(size_t* len) {
+  Buf b = {0};
+  put(&b, "{\"areaNames\":{");
+  for (int i = 0; i < 300; i++) putf(&b, "%s\"%d\":\"Area %d\"", i ? "," : "", 205705993 + i, i);
+  put(&b, "},\"events\":{");
+  for (int i = 0; i < 1800; i++) {
+    int id = 138586341 + i;
+    putf(&b, "%s\"%d\":{\"description\":null,\"id\":%d,\"logo\":%s,\"name\":", i ? "," : "", id, id,
+         next() % 3 ? "null" : "\"\\/images\\/UE0AAAAACEKo6QAAAAVDSVRN\"");
+    put_text(&b, 3);
+    put(&b, ",\"subTopicIds\":[");
+    for (int k = 0, n = 2 + next() % 4; k < n; k++) putf(&b, "%s%d", k ? "," : "", 337184262 + (int)(next() % 500));
+    putf(&b, "],\"subjectCode\":null,\"subtitle\":null,\"topicIds\":[%d,%d]}", 324846099 + (int)(next() % 40),
+         107888604 + (int)(next() % 40));
+  }
+  put(&b, "},\"performances\":[");
+  for (int i = 0; i < 2400; i++) {
+    putf(&b, "%s{\"eventId\":%d,\"id\":%d,\"logo\":null,\"name\":null,\"prices\":[", i ? "," : "",
+         138586341 + (int)(next() % 1800), 339887544 + i);
+    for (int k = 0, n = 1 + next() % 3; k < n; k++) {
+      putf(&b, "%s{\"amount\":%d,\"audienceSubCategoryId\":337100890,\"seatCategoryId\":%d}", k ? "," : "",
+           (int)(next() % 200) * 500, 338937295 + (int)(next() % 8));
+    }
+    putf(&b, "],\"seatCategories\":[{\"areas\":[{\"areaId\":%d,\"blockIds\":[]}],\"seatCategoryId\":%d}],"
+         "\"seatMapImage\":null,\"start\":%lld,\"venueCode\":\"PLEYEL_PLEYEL\"}",
+         205705993 + (int)(next() % 300), 338937295 + (int)(next() % 8), 1372701600000LL + (long long)(next() % 1000000) * 1000);
+  }
+  put(&b, "]}");
+  *len = b.len;
+  return b.data;
+}
+
+static char* read_file(const char* path, size_t* len) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return NULL;
+  fseek(f, 0, SEEK_END);
+  *len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char* data = malloc(*len + 1);
+  if (fread(data, 1, *len, f) != *len) *len = 0;
+  data[*len] = '\0';
+  fclose(f);
+  return data;
+}
+
+// --- measurement ---
+
+// Parsed values are never freed (the runtime has no collector), so the
+// number of runs is kept small.
+#define RUNS 10
+
+static void bench(const char* name, const char* text, size_t len) {
+  SigmaValue input = sigma_make_string_n(text, len);
+  double parse = 1e30, stringify = 1e30;
+  SigmaValue doc = sigma_make_nil(), out = sigma_make_nil();
+  for (int i = 0; i < RUNS; i++) {
+    double t = now();
+    doc = sigma_json_parse(input);
+    t = now() - t;
+    if (t < parse) parse = t;
+    if (sigma_failed) {
+      char buf[256];
+      sigma_error_report(buf, sizeof(buf));
+      printf("%-10s %s\n", name, buf);
+      return;
+    }
+  }
+  for (int i = 0; i < RUNS; i++) {
+    double t = now();
+    out = sigma_json_stringify(doc);
+    t = now() - t;
+    if (t < stringify) stringify = t;
+  }
+  size_t out_len = sigma_str_len(out.as.string);
+  // The output must parse back to something that stringifies the same.
+  SigmaValue again = sigma_json_stringify(sigma_json_parse(out));
+  if (strcmp(again.as.string, out.as.string) != 0) printf("%s: output does not round-trip\n", name);
+  printf("%-10s %8.2f MB %10.2f GB/s %10.2f GB/s %10.2f MB\n", name, len / 1e6, len / parse / 1e9,
+         out_len / stringify / 1e9, out_len / 1e6);
+}
+
+int main(int argc, char** argv) {
+  printf("%-10s %11s %15s %15s %13s\n", "", "input", "json_parse", "json_stringify", "output");
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+      size_t len;
+      char* text = read_file(argv[i], &len);
+      if (!text) {
+        fprintf(stderr, "cannot read %s\n", argv[i]);
+        return 1;
+      }
+      const char* base = strrchr(argv[i], '/');
+      bench(base ? base + 1 : argv[i], text, len);
+    }
+    return 0;
+  }
+  size_t len;
+  char* text = twitter(&len);
+  bench("twitter", text, len);
+  text = canada(&len);
+  bench("canada", text, len);
+  text = citm(&len);
+  bench("citm", text, len);
+  return 0;
+}
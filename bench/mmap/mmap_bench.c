@@ -0,0 +1,157 @@
+// sigma_mmap_bench: opening saved data with mmap_array and mmap_dict,
+// against rebuilding it from text.
+//
+//   sigma_mmap_bench [keys] [decs]
+//
+// A dict of `keys` string keys ("user1234567", 5 million by default) to
+// ints is written once as text, one "key value" line each, and once with
+// save. The text is read back the way a program without mmap_dict would:
+// lines(), then a dict insert per line. The image is opened with mmap_dict.
+// Lookups of random keys are then timed in both, and right after opening
+// the image, while its pages are still being mapped in.
+//
+// Likewise `decs` decs (50 million, 400 MB, by default) are saved, and
+// summed after mmap_array and after reading the file into an f64_array.
+// Everything is read from the page cache; the files are written just
+// before.
+#include "sigma_rt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next(void) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+static void check(const char* what) {
+  if (!sigma_failed) return;
+  char buf[256];
+  sigma_error_report(buf, sizeof(buf));
+  fprintf(stderr, "%s: %s\n", what, buf);
+  exit(1);
+}
+
+static SigmaValue key(int64_t i) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "user%07lld", (long long)i);
+  return sigma_make_string(buf);
+}
+
+#define LOOKUPS 1000000
+
+// ns per lookup of LOOKUPS random keys, all of them present.
+static double lookups(SigmaValue d, const SigmaValue* keys) {
+  double t = now();
+  int64_t sum = 0;
+  for (int i = 0; i < LOOKUPS; i++) sum += sigma_dict_get(d, keys[i]).as.integer;
+  t = now() - t;
+  if (sum < 0) printf("(%lld)\n", (long long)sum);     // keeps the loop
+  return t * 1e9 / LOOKUPS;
+}
+
+static void bench_dict(int64_t n) {
+  char text_path[] = "/tmp/sigma_mmap_bench_XXXXXX";
+  int fd = mkstemp(text_path);
+  FILE* f = fdopen(fd, "w");
+  SigmaValue d = sigma_make_dict_sized(sigma_make_int(n));
+  for (int64_t i = 0; i < n; i++) {
+    SigmaValue k = key(i);
+    sigma_dict_set(d, k, sigma_make_int(i));
+    fprintf(f, "%s %lld\n", k.as.string, (long long)i);
+  }
+  fclose(f);
+  char image_path[64];
+  snprintf(image_path, sizeof(image_path), "%s.dict", text_path);
+  double t = now();
+  sigma_save(d, sigma_make_string(image_path));
+  t = now() - t;
+  check("save");
+  printf("dict of %lld keys\n", (long long)n);
+  printf("  %-34s %10.1f ms\n", "save", t * 1e3);
+
+  t = now();
+  SigmaValue lines = sigma_read_lines(sigma_make_string(text_path));
+  check("lines");
+  SigmaValue parsed = sigma_make_dict_sized(sigma_make_int(n));
+  for (int i = 0; i < lines.as.array->size; i++) {
+    const char* line = ((SigmaValue*)lines.as.array->items[i])->as.string;
+    const char* space = strchr(line, ' ');
+    sigma_dict_set(parsed, sigma_make_string_n(line, space - line), sigma_make_int(atoll(space + 1)));
+  }
+  t = now() - t;
+  printf("  %-34s %10.1f ms\n", "lines() and a dict insert per line", t * 1e3);
+
+  SigmaValue* keys = malloc(sizeof(SigmaValue) * LOOKUPS);
+  for (int i = 0; i < LOOKUPS; i++) keys[i] = key((int64_t)(next() % (uint64_t)n));
+  t = now();
+  SigmaValue mapped = sigma_mmap_dict(sigma_make_string(image_path));
+  t = now() - t;
+  check("mmap_dict");
+  printf("  %-34s %10.3f ms\n", "mmap_dict", t * 1e3);
+  printf("  %-34s %10.1f ns\n", "lookup, just opened", lookups(mapped, keys));
+  printf("  %-34s %10.1f ns\n", "lookup, mapped", lookups(mapped, keys));
+  printf("  %-34s %10.1f ns\n", "lookup, in memory", lookups(parsed, keys));
+  unlink(text_path);
+  unlink(image_path);
+}
+
+static double sum(SigmaValue a) {
+  const double* x = a.as.typed->data;
+  double s = 0;
+  for (int64_t i = 0; i < a.as.typed->size; i++) s += x[i];
+  return s;
+}
+
+static void bench_array(int64_t n) {
+  char path[] = "/tmp/sigma_mmap_bench_XXXXXX";
+  close(mkstemp(path));
+  SigmaValue a = sigma_make_f64_array(sigma_make_int(n));
+  double* x = a.as.typed->data;
+  for (int64_t i = 0; i < n; i++) x[i] = (double)(next() % 1000) / 8;
+  double t = now();
+  sigma_save(a, sigma_make_string(path));
+  t = now() - t;
+  check("save");
+  double expect = sum(a);
+  printf("\n%lld decs, %.0f MB\n", (long long)n, n * 8 / 1e6);
+  printf("  %-34s %10.1f ms\n", "save", t * 1e3);
+
+  t = now();
+  FILE* f = fopen(path, "rb");
+  SigmaValue read = sigma_make_f64_array(sigma_make_int(n));
+  if (fread(read.as.typed->data, 8, n, f) != (size_t)n) printf("short read\n");
+  fclose(f);
+  double s = sum(read);
+  t = now() - t;
+  printf("  %-34s %10.1f ms%s\n", "read into an f64_array, sum", t * 1e3, s == expect ? "" : " (wrong sum)");
+
+  t = now();
+  SigmaValue mapped = sigma_mmap_array(sigma_make_string(path), sigma_make_string("f64"));
+  double open = now() - t;
+  check("mmap_array");
+  s = sum(mapped);
+  t = now() - t;
+  printf("  %-34s %10.3f ms\n", "mmap_array", open * 1e3);
+  printf("  %-34s %10.1f ms%s\n", "mmap_array, sum", t * 1e3, s == expect ? "" : " (wrong sum)");
+  unlink(path);
+}
+
+int main(int argc, char** argv) {
+  int64_t keys = argc > 1 ? atoll(argv[1]) : 5000000;
+  int64_t decs = argc > 2 ? atoll(argv[2]) : 50000000;
+  bench_dict(keys);
+  bench_array(decs);
+  return 0;
+}
@@ -0,0 +1,35 @@
+#include <stdio.h>
+
+#define N 600
+
+static void bubble_sort(double* a, int n, int ascending) {
+  for (int i = 0; i < n - 1; i++) {
+    for (int j = 0; j < n - i - 1; j++) {
+      if (ascending ? a[j] > a[j + 1] : a[j] < a[j + 1]) {
+        double t = a[j];
+        a[j] = a[j + 1];
+        a[j + 1] = t;
+      }
+    }
+  }
+}
+
+int main(void) {
+  double numbers[N];
+  unsigned long long seed = 12345;
+  for (int i = 0; i < N; i++) {
+    seed = (seed * 1103515245ULL + 12345ULL) % 2147483648ULL;
+    numbers[i] = (double)(seed % 10000);
+  }
+  for (int round = 0; round < 10; round++) {
+    bubble_sort(numbers, N, 1);
+    bubble_sort(numbers, N, 0);
+  }
+  printf("[");
+  for (int i = 0; i < N; i++) {
+    printf("%g", numbers[i]);
+    if (i < N - 1) printf(", ");
+  }
+  printf("]\n");
+  return 0;
+}
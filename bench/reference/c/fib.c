@@ -0,0 +1,11 @@
+#include <stdio.h>
+
+static double fib(double n) {
+  if (n < 2) return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+int main(void) {
+  printf("%g\n", fib(30));
+  return 0;
+}
@@ -0,0 +1,13 @@
+#include <stdint.h>
+#include <stdio.h>
+
+int main(void) {
+  int64_t total = 0;
+  for (int64_t i = 0; i < 1500; i++) {
+    for (int64_t j = 0; j < 1500; j++) {
+      total = total + i * j;
+    }
+  }
+  printf("%lld\n", (long long)total);
+  return 0;
+}
@@ -0,0 +1,37 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N 1000000
+
+static double a[N], b[N];
+static uint8_t bs[N];
+
+int main(void) {
+  int64_t x = 42;
+  for (int i = 0; i < N; i++) {
+    x = (x * 1103515245 + 12345) % 2147483648;
+    a[i] = x / 2147483648.0;
+    b[i] = i % 100;
+  }
+  for (int pass = 0; pass < 10; pass++) {
+    for (int i = 0; i < N; i++) a[i] = a[i] * 0.5 + b[i];
+  }
+  double dot = 0;
+  for (int i = 0; i < N; i++) dot += a[i] * b[i];
+  printf("%lld\n", (long long)dot);
+
+  for (int i = 0; i < N; i++) {
+    x = (x * 1103515245 + 12345) % 2147483648;
+    bs[i] = x % 256;
+  }
+  int64_t hist[256] = {0};
+  for (int i = 0; i < N; i++) hist[bs[i]]++;
+  // Counting sort, as the runtime sorts bytes.
+  int64_t at = 0;
+  for (int v = 0; v < 256; v++) {
+    for (int64_t k = 0; k < hist[v]; k++) bs[at++] = (uint8_t)v;
+  }
+  printf("%lld\n%lld\n%d\n%d\n", (long long)hist[0], (long long)hist[255], bs[0], bs[N - 1]);
+  return 0;
+}
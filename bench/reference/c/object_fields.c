@@ -0,0 +1,16 @@
+#include <stdint.h>
+#include <stdio.h>
+
+struct point {
+  int64_t x, y, vx, vy;
+};
+
+int main(void) {
+  volatile struct point p = {0, 0, 1, 2};
+  for (int i = 0; i < 1000000; i++) {
+    p.x = p.x + p.vx;
+    p.y = p.y + p.vy;
+  }
+  printf("%lld\n%lld\n", (long long)p.x, (long long)p.y);
+  return 0;
+}
@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(void) {
+  size_t len = 0, cap = 64;
+  char* line = malloc(cap);
+  line[0] = '\0';
+  for (int i = 0; i < 6000; i++) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%g,", (double)i);
+    if (len + n + 1 > cap) {
+      while (len + n + 1 > cap) cap *= 2;
+      line = realloc(line, cap);
+    }
+    memcpy(line + len, buf, n + 1);
+    len += n;
+  }
+  printf("%s\n", line);
+  free(line);
+  return 0;
+}
@@ -0,0 +1,80 @@
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t count(const char* s, size_t n, const char* sub) {
+  size_t m = strlen(sub), c = 0;
+  for (const char* at = s; (at = memmem(at, n - (at - s), sub, m)); at += m) c++;
+  return c;
+}
+
+static long find(const char* s, size_t n, const char* sub) {
+  const char* at = memmem(s, n, sub, strlen(sub));
+  return at ? at - s : -1;
+}
+
+static char* mapcase(const char* s, size_t n, int (*f)(int)) {
+  char* out = malloc(n + 1);
+  for (size_t i = 0; i < n; i++) out[i] = f((unsigned char)s[i]);
+  out[n] = '\0';
+  return out;
+}
+
+int main(void) {
+  const char* line = "  The quick brown fox jumps over the lazy dog, again and again  \n";
+  size_t n = strlen(line);
+  char* text = malloc(n << 17);
+  memcpy(text, line, n);
+  for (int i = 0; i < 17; i++, n *= 2) memcpy(text + n, text, n);
+  printf("%zu\n", n);
+  printf("%zu\n", count(text, n, "\n"));
+  printf("%zu\n", count(text, n, "fox"));
+  printf("%ld\n", find(text, n, "lazy cat"));
+
+  char* up = mapcase(text, n, toupper);
+  printf("%zu\n", count(up, n, "FOX"));
+  char* low = mapcase(up, n, tolower);
+  printf("%ld\n", find(low, n, "again"));
+  size_t foxes = count(text, n, "fox");
+  char* wolves = malloc(n + foxes + 1);
+  size_t len = 0;
+  for (const char* at = text, *next; at < text + n; at = next + 3) {
+    next = memmem(at, n - (at - text), "fox", 3);
+    if (!next) {
+      memcpy(wolves + len, at, text + n - at);
+      len += text + n - at;
+      break;
+    }
+    memcpy(wolves + len, at, next - at);
+    memcpy(wolves + len + (next - at), "wolf", 4);
+    len += next - at + 4;
+  }
+  printf("%zu\n", len);
+
+  size_t lines = 0, words = 0, chars = 0;
+  for (const char* at = text; at <= text + n; lines++) {
+    const char* end = memchr(at, '\n', text + n - at);
+    if (!end) end = text + n;
+    const char* a = at;
+    const char* b = end;
+    while (a < b && isspace((unsigned char)*a)) a++;
+    while (b > a && isspace((unsigned char)b[-1])) b--;
+    chars += b - a;
+    for (const char* p = a; p < b;) {
+      while (p < b && isspace((unsigned char)*p)) p++;
+      if (p < b) words++;
+      while (p < b && !isspace((unsigned char)*p)) p++;
+    }
+    at = end + 1;
+  }
+  printf("%zu\n", lines);
+  printf("%zu\n", words);
+  printf("%zu\n", chars);
+  free(text);
+  free(up);
+  free(low);
+  free(wolves);
+  return 0;
+}
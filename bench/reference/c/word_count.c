@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Open addressing with linear probing over a power-of-two table, FNV-1a.
+#define SLOTS (1 << 16)
+
+struct entry {
+  char* word;
+  int64_t count;
+};
+
+static struct entry table[SLOTS];
+
+static uint64_t hash(const char* s) {
+  uint64_t h = 1469598103934665603ULL;
+  for (; *s; s++) h = (h ^ (unsigned char)*s) * 1099511628211ULL;
+  return h;
+}
+
+static struct entry* lookup(const char* word) {
+  size_t i = hash(word) & (SLOTS - 1);
+  while (table[i].word && strcmp(table[i].word, word) != 0) i = (i + 1) & (SLOTS - 1);
+  return &table[i];
+}
+
+int main(void) {
+  int64_t x = 42;
+  size_t n = 0;
+  for (int i = 0; i < 1000000; i++) {
+    x = (x * 1103515245 + 12345) % 2147483648;
+    char word[32];
+    snprintf(word, sizeof(word), "w%d", (int)(x % 20011));
+    struct entry* e = lookup(word);
+    if (!e->word) {
+      e->word = strdup(word);
+      n++;
+    }
+    e->count++;
+  }
+
+  int64_t total = 0, most = 0;
+  for (size_t i = 0; i < SLOTS; i++) {
+    if (!table[i].word) continue;
+    total += table[i].count;
+    if (table[i].count > most) most = table[i].count;
+  }
+  printf("%zu\n%lld\n%lld\n%lld\n", n, (long long)total, (long long)most, (long long)lookup("w7")->count);
+  return 0;
+}
@@ -0,0 +1,22 @@
+N = 600
+
+
+def bubble_sort(a, ascending):
+    n = len(a)
+    for i in range(n - 1):
+        for j in range(n - i - 1):
+            if (a[j] > a[j + 1]) if ascending else (a[j] < a[j + 1]):
+                a[j], a[j + 1] = a[j + 1], a[j]
+
+
+numbers = []
+seed = 12345
+for _ in range(N):
+    seed = (seed * 1103515245 + 12345) % 2147483648
+    numbers.append(seed % 10000)
+
+for _ in range(10):
+    bubble_sort(numbers, True)
+    bubble_sort(numbers, False)
+
+print("[" + ", ".join("%g" % v for v in numbers) + "]")
@@ -0,0 +1,30 @@
+from array import array
+
+n = 1000000
+a = array("d", bytes(8 * n))
+b = array("d", bytes(8 * n))
+x = 42
+for i in range(n):
+    x = (x * 1103515245 + 12345) % 2147483648
+    a[i] = x / 2147483648.0
+    b[i] = i % 100
+for _ in range(10):
+    for i in range(n):
+        a[i] = a[i] * 0.5 + b[i]
+dot = 0.0
+for i in range(n):
+    dot = dot + a[i] * b[i]
+print(int(dot))
+
+bs = bytearray(n)
+for i in range(n):
+    x = (x * 1103515245 + 12345) % 2147483648
+    bs[i] = x % 256
+hist = array("q", bytes(8 * 256))
+for i in range(n):
+    hist[bs[i]] += 1
+bs = bytearray(sorted(bs))
+print(hist[0])
+print(hist[255])
+print(bs[0])
+print(bs[n - 1])
@@ -0,0 +1,6 @@
+p = {"x": 0, "y": 0, "vx": 1, "vy": 2}
+for i in range(1000000):
+    p["x"] = p["x"] + p["vx"]
+    p["y"] = p["y"] + p["vy"]
+print(p["x"])
+print(p["y"])
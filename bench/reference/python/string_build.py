@@ -0,0 +1,4 @@
+line = ""
+for i in range(6000):
+    line = line + "%g" % i + ","
+print(line)
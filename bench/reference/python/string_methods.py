@@ -0,0 +1,26 @@
+line = "  The quick brown fox jumps over the lazy dog, again and again  \n"
+text = line
+for i in range(17):
+    text = text + text
+print(len(text))
+print(text.count("\n"))
+print(text.count("fox"))
+print(text.find("lazy cat"))
+
+up = text.upper()
+print(up.count("FOX"))
+low = up.lower()
+print(low.find("again"))
+wolves = text.replace("fox", "wolf")
+print(len(wolves))
+
+lines = text.split("\n")
+words = 0
+chars = 0
+for l in lines:
+    l = l.strip()
+    words += len(l.split())
+    chars += len(l)
+print(len(lines))
+print(words)
+print(chars)
@@ -0,0 +1,18 @@
+counts = {}
+x = 42
+for i in range(1000000):
+    x = (x * 1103515245 + 12345) % 2147483648
+    word = "w%d" % (x % 20011)
+    counts[word] = counts.get(word, 0) + 1
+
+total = 0
+most = 0
+for word in counts:
+    c = counts[word]
+    total += c
+    if c > most:
+        most = c
+print(len(counts))
+print(total)
+print(most)
+print(counts["w7"])
@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+"""Sigma benchmark driver.
+
+Compiles and runs every workload in bench/workloads with `sig`, runs the C and
+Python reference implementations of the same programs, and reports compile
+time, run time, peak RSS and instructions retired for each. Results can be
+compared against (or saved as) a baseline JSON file.
+
+Normally invoked through the CMake `bench` target:
+
+    cmake --build build --target bench
+"""
+
+import argparse
+import datetime
+import hashlib
+import json
+import os
+import platform
+import shutil
+import subprocess
+import sys
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+WORKLOADS = ["fib", "nested_loops", "string_build", "array_sort", "object_fields", "word_count", "numeric_arrays", "string_methods", "large_file"]
+
+# Workloads whose source is generated at bench time rather than checked in.
+GENERATED = {"large_file"}
+
+
+def measure(runner, cmd, stdout=None):
+    argv = [runner]
+    if stdout:
+        argv += ["--stdout", stdout]
+    argv += ["--"] + cmd
+    out = subprocess.run(argv, check=True, stdout=subprocess.PIPE, text=True).stdout
+    result = json.loads(out)
+    if result["exit_code"] != 0:
+        raise RuntimeError("command failed (%d): %s" % (result["exit_code"], " ".join(cmd)))
+    return result
+
+
+def best_of(runner, cmd, repeat, stdout=None):
+    """Run a command `repeat` times and keep the fastest wall time and
+    the lowest instruction count; peak RSS is the maximum seen."""
+    runs = [measure(runner, cmd, stdout) for _ in range(repeat)]
+    instructions = [r["instructions"] for r in runs if r["instructions"] is not None]
+    return {
+        "wall_s": min(r["wall_s"] for r in runs),
+        "cpu_s": min(r["user_s"] + r["sys_s"] for r in runs),
+        "max_rss_kb": max(r["max_rss_kb"] for r in runs),
+        "instructions": min(instructions) if instructions else None,
+    }
+
+
+def digest(path):
+    with open(path, "rb") as f:
+        return hashlib.sha1(f.read()).hexdigest()
+
+
+def workload_source(name, args):
+    if name == "large_file":
+        path = os.path.join(args.work_dir, "large_file.sgm")
+        subprocess.run([sys.executable, os.path.join(BENCH_DIR, "gen_large.py"), path,
+                        "--lines", str(args.large_lines)], check=True)
+        return path
+    return os.path.join(BENCH_DIR, "workloads", name + ".sgm")
+
+
+def bench_sigma(name, args):
+    src = workload_source(name, args)
+    exe = os.path.join(args.work_dir, name + ".sigma")
+    out = os.path.join(args.work_dir, name + ".sigma.out")
+    stats = os.path.join(args.work_dir, name + ".stats.json")
+    compile_repeat = 1 if name in GENERATED else args.repeat
+    compiled = best_of(args.runner, [args.sig, "--stats-json=" + stats, "-o", exe, src], compile_repeat)
+    with open(stats) as f:
+        passes = {p["name"]: p["wall_ms"] for p in json.load(f)["passes"]}
+    compiled["frontend_ms"] = sum(passes.get(p, 0.0) for p in ("lex", "parse", "escape", "lower", "optimize", "codegen"))
+    compiled["passes_ms"] = passes
+    ran = best_of(args.runner, [exe], args.repeat, stdout=out)
+    return {"compile": compiled, "run": ran, "output": digest(out)}
+
+
+def bench_c(name, args):
+    src = os.path.join(BENCH_DIR, "reference", "c", name + ".c")
+    if not os.path.exists(src) or not shutil.which(args.cc):
+        return None
+    exe = os.path.join(args.work_dir, name + ".c.exe")
+    out = os.path.join(args.work_dir, name + ".c.out")
+    compiled = best_of(args.runner, [args.cc, "-O2", src, "-o", exe, "-lm"], 1)
+    ran = best_of(args.runner, [exe], args.repeat, stdout=out)
+    return {"compile": compiled, "run": ran, "output": digest(out)}
+
+
+def bench_python(name, args):
+    src = os.path.join(BENCH_DIR, "reference", "python", name + ".py")
+    if not os.path.exists(src):
+        return None
+    out = os.path.join(args.work_dir, name + ".py.out")
+    ran = best_of(args.runner, [args.python, src], args.repeat, stdout=out)
+    return {"compile": None, "run": ran, "output": digest(out)}
+
+
+def fmt_seconds(value):
+    return "-" if value is None else "%.4f" % value
+
+
+def fmt_count(value):
+    if value is None:
+        return "-"
+    for unit, scale in (("G", 1e9), ("M", 1e6), ("K", 1e3)):
+        if value >= scale:
+            return "%.2f%s" % (value / scale, unit)
+    return str(value)
+
+
+def compare(current, baseline, threshold):
+    """Compare sigma results against the baseline. Instructions retired are
+    preferred when both sides have them, since they are far less noisy than
+    wall time."""
+    rows = []
+    regressions = []
+    for name, impls in current.items():
+        base = baseline.get("results", {}).get(name, {}).get("sigma")
+        cur = impls.get("sigma")
+        if not base or not cur:
+            continue
+        for phase in ("compile", "run"):
+            b, c = base.get(phase), cur.get(phase)
+            if not b or not c:
+                continue
+            if b.get("instructions") and c.get("instructions"):
+                metric = "instructions"
+            else:
+                metric = "wall_s"
+            ratio = c[metric] / b[metric] if b[metric] else 1.0
+            rows.append((name, phase, metric, ratio))
+            if ratio > 1.0 + threshold:
+                regressions.append((name, phase, metric, ratio))
+    return rows, regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--sig", required=True, help="path to the sig compiler")
+    parser.add_argument("--runner", required=True, help="path to the bench_run measurement helper")
+    parser.add_argument("--work-dir", default=os.path.join(os.getcwd(), "bench-work"))
+    parser.add_argument("--baseline", default=os.path.join(BENCH_DIR, "baseline.json"))
+    parser.add_argument("--update-baseline", action="store_true",
+                        help="overwrite the baseline with this run's results")
+    parser.add_argument("--json", help="also write this run's results to a JSON file")
+    parser.add_argument("--only", help="comma-separated list of workloads to run")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative slowdown reported as a regression (default 0.10)")
+    parser.add_argument("--fail-on-regression", action="store_true")
+    parser.add_argument("--no-reference", action="store_true", help="skip the C and Python runs")
+    parser.add_argument("--large-lines", type=int, default=5000)
+    parser.add_argument("--cc", default=os.environ.get("CC", "gcc"))
+    parser.add_argument("--python", default=sys.executable)
+    args = parser.parse_args()
+
+    os.makedirs(args.work_dir, exist_ok=True)
+    names = args.only.split(",") if args.only else WORKLOADS
+
+    results = {}
+    for name in names:
+        if name not in WORKLOADS:
+            parser.error("unknown workload: " + name)
+        print("running %s..." % name, file=sys.stderr)
+        impls = {"sigma": bench_sigma(name, args)}
+        if not args.no_reference:
+            for impl, fn in (("c", bench_c), ("python", bench_python)):
+                r = fn(name, args)
+                if r:
+                    impls[impl] = r
+        results[name] = impls
+
+    header = "%-14s %-7s %10s %10s %10s %12s %10s  %s" % (
+        "workload", "impl", "compile_s", "front_ms", "run_s", "max_rss_kb", "instr", "output")
+    print(header)
+    print("-" * len(header))
+    mismatches = []
+    for name, impls in results.items():
+        expected = impls["sigma"]["output"]
+        for impl, r in impls.items():
+            check = "ok" if r["output"] == expected else "MISMATCH"
+            if check != "ok":
+                mismatches.append("%s/%s" % (name, impl))
+            front = r["compile"].get("frontend_ms") if r["compile"] else None
+            print("%-14s %-7s %10s %10s %10s %12d %10s  %s" % (
+                name, impl,
+                fmt_seconds(r["compile"]["wall_s"] if r["compile"] else None),
+                "-" if front is None else "%.2f" % front,
+                fmt_seconds(r["run"]["wall_s"]),
+                r["run"]["max_rss_kb"],
+                fmt_count(r["run"]["instructions"]),
+                check))
+
+    document = {
+        "date": datetime.datetime.now().isoformat(timespec="seconds"),
+        "machine": "%s %s" % (platform.system(), platform.machine()),
+        "results": results,
+    }
+
+    regressions = []
+    if os.path.exists(args.baseline) and not args.update_baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        rows, regressions = compare(results, baseline, args.threshold)
+        if rows:
+            print("\nsigma vs baseline (%s, %s):" % (baseline.get("date", "?"), baseline.get("machine", "?")))
+            for name, phase, metric, ratio in rows:
+                flag = "  REGRESSION" if ratio > 1.0 + args.threshold else ""
+                print("  %-14s %-8s %-13s %+7.1f%%%s" % (name, phase, metric, (ratio - 1.0) * 100, flag))
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(document, f, indent=2)
+    if args.update_baseline:
+        with open(args.baseline, "w") as f:
+            json.dump(document, f, indent=2)
+            f.write("\n")
+        print("\nbaseline written to " + args.baseline)
+
+    # A reference that prints something else no longer checks anything.
+    if mismatches:
+        print("\noutput differs from sigma's: " + ", ".join(mismatches), file=sys.stderr)
+        return 1
+    if regressions and args.fail_on_regression:
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,180 @@
+// sigma_string_bench: the string methods against their nearest glibc
+// equivalents.
+//
+//   sigma_string_bench [megabytes]
+//
+// Generates `megabytes` of text (64 by default): lines of 4 to 16 words
+// drawn from a list of 64, deterministically. Each operation runs on the
+// whole text, and each figure is the best of several runs, in GB/s of
+// input. find looks for a needle that does not occur, so that it reads
+// everything.
+#define _GNU_SOURCE
+#include "sigma_rt.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next(void) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+static const char* const words[] = {
+  "the", "of", "and", "to", "in", "is", "was", "that", "for", "on", "with", "as", "by", "at", "from", "this",
+  "Sigma", "runtime", "string", "vector", "search", "needle", "haystack", "memory", "cache", "line", "byte",
+  "split", "find", "count", "replace", "trim", "Upper", "Lower", "ASCII", "UTF-8", "caf\xc3\xa9", "na\xc3\xafve",
+  "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "again", "table", "column", "value", "index",
+  "hash", "dict", "array", "object", "channel", "task", "worker", "queue", "file", "path", "lexer", "parser",
+  "codegen", "linker"
+};
+
+static char* text(size_t bytes, size_t* len) {
+  char* buf = malloc(bytes + 64);
+  size_t n = 0;
+  while (n < bytes) {
+    int k = 4 + (int)(next() % 13);
+    if (next() % 4 == 0) buf[n++] = ' ';
+    for (int i = 0; i < k && n < bytes; i++) {
+      const char* w = words[next() % (sizeof(words) / sizeof(words[0]))];
+      size_t wl = strlen(w);
+      if (i) buf[n++] = ' ';
+      memcpy(buf + n, w, wl);
+      n += wl;
+    }
+    buf[n++] = '\n';
+  }
+  buf[n] = '\0';
+  *len = n;
+  return buf;
+}
+
+// Results are never freed (the runtime has no collector), so the number
+// of runs is kept small.
+#define RUNS 5
+
+static SigmaValue input;
+static const char* raw;
+static size_t raw_len;
+static size_t sink;
+
+static void report(const char* name, double best) {
+  printf("%-34s %8.2f GB/s\n", name, raw_len / best / 1e9);
+}
+
+static void bench(const char* name, void (*op)(void)) {
+  double best = 1e30;
+  for (int i = 0; i < RUNS; i++) {
+    double t = now();
+    op();
+    t = now() - t;
+    if (sigma_failed) {
+      char buf[256];
+      sigma_error_report(buf, sizeof(buf));
+      printf("%s: %s\n", name, buf);
+      exit(1);
+    }
+    if (t < best) best = t;
+  }
+  report(name, best);
+}
+
+static SigmaValue str(const char* s) {
+  return sigma_make_string(s);
+}
+
+static void find(void) { sink += sigma_str_find(input, str("lazy cat")).as.integer; }
+static void find_memmem(void) { sink += memmem(raw, raw_len, "lazy cat", 8) != NULL; }
+static void find_strstr(void) { sink += strstr(raw, "lazy cat") != NULL; }
+static void count_lines(void) { sink += sigma_str_count(input, str("\n")).as.integer; }
+
+static void count_lines_memchr(void) {
+  for (const char* p = raw; (p = memchr(p, '\n', raw + raw_len - p)); p++) sink++;
+}
+
+static void count_word(void) { sink += sigma_str_count(input, str("fox")).as.integer; }
+
+static void count_word_memmem(void) {
+  for (const char* p = raw; (p = memmem(p, raw + raw_len - p, "fox", 3)); p += 3) sink++;
+}
+
+static void replace(void) { sink += sigma_str_len(sigma_str_replace(input, str("fox"), str("wolf")).as.string); }
+
+// What replace does, with memmem and one buffer sized up front.
+static void replace_memmem(void) {
+  size_t hits = 0;
+  for (const char* p = raw; (p = memmem(p, raw + raw_len - p, "fox", 3)); p += 3) hits++;
+  char* out = malloc(raw_len + hits + 1);
+  char* o = out;
+  const char* p = raw;
+  for (const char* at; (at = memmem(p, raw + raw_len - p, "fox", 3)); p = at + 3) {
+    memcpy(o, p, at - p);
+    o += at - p;
+    memcpy(o, "wolf", 4);
+    o += 4;
+  }
+  memcpy(o, p, raw + raw_len - p);
+  sink += o - out;
+  free(out);
+}
+
+static void upper(void) { sink += sigma_str_upper(input).as.string[0]; }
+
+static void upper_toupper(void) {
+  char* out = malloc(raw_len + 1);
+  for (size_t i = 0; i < raw_len; i++) out[i] = toupper((unsigned char)raw[i]);
+  sink += out[0];
+  free(out);
+}
+
+static void lower(void) { sink += sigma_str_lower(input).as.string[0]; }
+// Frees what split returned: the item pointers, the boxes and the strings
+// are one block each. (The runtime has no collector; without this, the runs
+// of split() would not fit in memory at 64 MB.)
+static void drop_split(SigmaValue arr) {
+  SigmaArray* a = arr.as.array;
+  sink += a->size;
+  if (a->size) {
+    SigmaValue* boxes = a->items[0];
+    free(sigma_str_header(boxes[0].as.string));
+    free(boxes);
+  }
+  free(a->items);
+  free(a);
+}
+
+static void split_lines(void) { drop_split(sigma_str_split(input, str("\n"))); }
+static void split_words(void) { drop_split(sigma_str_split_space(input)); }
+
+int main(int argc, char** argv) {
+  size_t mb = argc > 1 ? (size_t)atol(argv[1]) : 64;
+  raw = text(mb << 20, &raw_len);
+  input = sigma_make_string_n(raw, raw_len);
+  printf("%.0f MB of text\n\n", raw_len / 1e6);
+
+  bench("find", find);
+  bench("  memmem", find_memmem);
+  bench("  strstr", find_strstr);
+  bench("count(\"\\n\")", count_lines);
+  bench("  memchr loop", count_lines_memchr);
+  bench("count(\"fox\")", count_word);
+  bench("  memmem loop", count_word_memmem);
+  bench("replace(\"fox\", \"wolf\")", replace);
+  bench("  memmem and memcpy", replace_memmem);
+  bench("upper()", upper);
+  bench("  toupper loop", upper_toupper);
+  bench("lower()", lower);
+  bench("split(\"\\n\")", split_lines);
+  bench("split()", split_words);
+  return sink == 42;
+}
@@ -0,0 +1,234 @@
+// sigma_table_bench: the table operations on a generated sales log.
+//
+//   sigma_table_bench [rows]
+//
+// Writes a CSV of `rows` sales (10 million by default, about 450 MB) to a
+// temporary file, deterministically:
+//
+//   id       1, 2, 3, ...
+//   region   one of 8 names
+//   product  one of 1000 codes ("p0042")
+//   qty      1 to 20
+//   price    0.50 to 99.99, two decimals
+//   day      1 to 365
+//
+// then reads it with read_csv and times each operation on the table, as
+// the best of a few runs, in milliseconds and nanoseconds per input row.
+// Filtering and summing by group are also timed on the same data laid out
+// as a Sigma program without tables would hold it: one object per row,
+// grouped into a dict. Objects take several times the memory, so that
+// layout only gets the first million rows; per row, the figures compare.
+#include "sigma_rt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next(void) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+static const char* const regions[] = {"north", "south", "east", "west", "central", "coast", "valley", "islands"};
+
+static void write_csv(FILE* f, int64_t rows) {
+  static char buf[1 << 20];
+  setvbuf(f, buf, _IOFBF, sizeof(buf));
+  fputs("id,region,product,qty,price,day\n", f);
+  for (int64_t i = 1; i <= rows; i++) {
+    uint64_t r = next();
+    int cents = 50 + (int)(r % 9950);
+    fprintf(f, "%lld,%s,p%04d,%d,%d.%02d,%d\n", (long long)i, regions[(r >> 16) % 8], (int)((r >> 24) % 1000),
+            1 + (int)((r >> 36) % 20), cents / 100, cents % 100, 1 + (int)((r >> 44) % 365));
+  }
+}
+
+static void check(const char* what) {
+  if (!sigma_failed) return;
+  char buf[256];
+  sigma_error_report(buf, sizeof(buf));
+  fprintf(stderr, "%s: %s\n", what, buf);
+  exit(1);
+}
+
+static SigmaValue str(const char* s) {
+  return sigma_make_string(s);
+}
+
+// Frees the columns a result did not share with the table it came from.
+// (The runtime has no collector; without this, the runs would not fit in
+// memory at 10 million rows.)
+static void drop(SigmaValue result, const SigmaTable* from) {
+  if (result.type != TYPE_TABLE) return;
+  SigmaTable* t = result.as.table;
+  for (int c = 0; c < t->ncols; c++) {
+    int shared = 0;
+    for (int k = 0; k < from->ncols; k++) shared |= t->columns[c].data == from->columns[k].data;
+    if (!shared) free(t->columns[c].data);
+  }
+  free(t->columns);
+  free(t);
+}
+
+#define RUNS 3
+
+static void report(const char* name, double best, int64_t rows) {
+  printf("%-36s %10.1f ms %8.2f ns/row\n", name, best * 1e3, best * 1e9 / rows);
+}
+
+typedef SigmaValue (*TableOp)(SigmaValue t);
+
+static void bench(const char* name, SigmaValue table, TableOp op) {
+  double best = 1e30;
+  for (int i = 0; i < RUNS; i++) {
+    double t = now();
+    SigmaValue result = op(table);
+    t = now() - t;
+    check(name);
+    if (t < best) best = t;
+    drop(result, table.as.table);
+  }
+  report(name, best, table.as.table->rows);
+}
+
+static SigmaValue filter_qty(SigmaValue t) {
+  return sigma_table_filter(t, str("qty"), str(">"), sigma_make_int(10));
+}
+
+static SigmaValue filter_region(SigmaValue t) {
+  return sigma_table_filter(t, str("region"), str("=="), str("north"));
+}
+
+static SigmaValue filter_price(SigmaValue t) {
+  return sigma_table_filter(t, str("price"), str("<"), sigma_make_number(25.0));
+}
+
+static SigmaValue select_two(SigmaValue t) {
+  SigmaValue names[] = {str("region"), str("price")};
+  return sigma_table_select(t, sigma_make_array_of(2, names));
+}
+
+static SigmaValue sum_by_region(SigmaValue t) {
+  return sigma_table_sum(sigma_table_group_by(t, str("region")), str("price"));
+}
+
+static SigmaValue mean_by_product(SigmaValue t) {
+  return sigma_table_mean(sigma_table_group_by(t, str("product")), str("price"));
+}
+
+static SigmaValue count_by_region_day(SigmaValue t) {
+  SigmaValue keys[] = {str("region"), str("day")};
+  return sigma_table_count(sigma_table_group_by(t, sigma_make_array_of(2, keys)));
+}
+
+static SigmaValue sum_by_day(SigmaValue t) {
+  return sigma_table_sum(sigma_table_group_by(t, str("day")), str("qty"));
+}
+
+static SigmaValue sort_by_price(SigmaValue t) {
+  return sigma_table_sort_by(t, str("price"));
+}
+
+static SigmaValue sort_by_product(SigmaValue t) {
+  return sigma_table_sort_by_order(t, str("product"), str("desc"));
+}
+
+// --- one object per row ---
+
+static SigmaValue objects_of(SigmaValue table, int64_t rows) {
+  static const char* const keys[] = {"id", "region", "product", "qty", "price", "day"};
+  SigmaValue columns[6];
+  for (int c = 0; c < 6; c++) columns[c] = sigma_table_column(table, str(keys[c]));
+  SigmaValue arr = sigma_make_array();
+  for (int64_t i = 0; i < rows; i++) {
+    SigmaValue vals[6];
+    for (int c = 0; c < 6; c++) vals[c] = sigma_array_get(columns[c], sigma_make_int(i));
+    sigma_array_push(arr, sigma_make_object_of(6, keys, vals));
+  }
+  return arr;
+}
+
+static double objects_filter(SigmaValue rows) {
+  double t = now();
+  SigmaValue kept = sigma_make_array();
+  for (int i = 0; i < rows.as.array->size; i++) {
+    SigmaValue row = *(SigmaValue*)rows.as.array->items[i];
+    if (sigma_is_truthy(sigma_greater_than(sigma_object_get(row, "qty"), sigma_make_int(10)))) {
+      sigma_array_push(kept, row);
+    }
+  }
+  return now() - t;
+}
+
+static double objects_sum_by_region(SigmaValue rows) {
+  double t = now();
+  SigmaValue sums = sigma_make_dict();
+  for (int i = 0; i < rows.as.array->size; i++) {
+    SigmaValue row = *(SigmaValue*)rows.as.array->items[i];
+    SigmaValue region = sigma_object_get(row, "region");
+    SigmaValue sum = sigma_dict_get(sums, region);
+    if (sum.type == TYPE_NIL) sum = sigma_make_int(0);
+    sigma_dict_set(sums, region, sigma_add(sum, sigma_object_get(row, "price")));
+  }
+  return now() - t;
+}
+
+static void bench_objects(const char* name, SigmaValue rows, double (*op)(SigmaValue)) {
+  double best = 1e30;
+  for (int i = 0; i < RUNS; i++) {
+    double t = op(rows);
+    if (t < best) best = t;
+  }
+  report(name, best, rows.as.array->size);
+}
+
+int main(int argc, char** argv) {
+  int64_t rows = argc > 1 ? atoll(argv[1]) : 10000000;
+  char path[] = "/tmp/sigma_table_bench_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  FILE* f = fdopen(fd, "w");
+  write_csv(f, rows);
+  long size = ftell(f);
+  fclose(f);
+
+  double t = now();
+  SigmaValue table = sigma_read_csv(str(path));
+  t = now() - t;
+  check("read_csv");
+  unlink(path);
+  printf("%" PRId64 " rows, %.0f MB of CSV\n\n", rows, size / 1e6);
+  report("read_csv", t, rows);
+  printf("%-36s %10.2f GB/s\n", "", size / t / 1e9);
+
+  bench("filter(\"qty\", \">\", 10)", table, filter_qty);
+  bench("filter(\"region\", \"==\", \"north\")", table, filter_region);
+  bench("filter(\"price\", \"<\", 25.0)", table, filter_price);
+  bench("select([\"region\", \"price\"])", table, select_two);
+  bench("group_by(\"region\").sum(\"price\")", table, sum_by_region);
+  bench("group_by(\"product\").mean(\"price\")", table, mean_by_product);
+  bench("group_by(\"day\").sum(\"qty\")", table, sum_by_day);
+  bench("group_by([\"region\", \"day\"]).count()", table, count_by_region_day);
+  bench("sort_by(\"price\")", table, sort_by_price);
+  bench("sort_by(\"product\", \"desc\")", table, sort_by_product);
+
+  int64_t object_rows = rows < 1000000 ? rows : 1000000;
+  printf("\none object per row, %" PRId64 " rows:\n", object_rows);
+  SigmaValue objects = objects_of(table, object_rows);
+  bench_objects("filter qty > 10", objects, objects_filter);
+  bench_objects("sum price by region", objects, objects_sum_by_region);
+  return 0;
+}
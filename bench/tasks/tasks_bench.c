@@ -0,0 +1,148 @@
+// sigma_task_bench: what $spawn and channels cost, against plain threads.
+//
+//   SIGMA_WORKERS=n sigma_task_bench [tasks] [round trips]
+//
+// Calls the runtime the way generated code does: task bodies are C
+// functions with the SigmaValue ABI, and values go through sigma_chan_send
+// and sigma_chan_recv.
+//
+//   spawn        start `tasks` tasks that each send one value on a buffered
+//                channel and finish; the main thread receives them all.
+//                Against pthread_create and pthread_join of a thread each
+//                (a tenth as many; threads are slow to start).
+//   spawn, held  the same, but on an unbuffered channel, so that every task
+//                is alive, parked in send, until main gets to it.
+//   ping-pong    two tasks pass an int back and forth over two unbuffered
+//                channels; time per round trip. Against two threads doing
+//                the same with a mutex and two condition variables.
+//
+// With one worker a round trip is two context switches; with more, the
+// two tasks may sit on different workers and the time includes a wakeup.
+#include "sigma_rt.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void row(const char* name, long n, double sigma, double threads) {
+  printf("%-14s %10.0f ns %12.0f ns %8.1fx\n", name, sigma * 1e9 / n, threads * 1e9 / n, threads / sigma);
+}
+
+// --- spawn ---
+
+static SigmaValue send_one(SigmaValue c, SigmaValue i) {
+  return sigma_chan_send(c, i);
+}
+
+static double spawn_tasks(long n, int64_t capacity) {
+  SigmaValue c = sigma_make_chan_sized(sigma_make_int(capacity));
+  double t = now();
+  for (long i = 0; i < n; i++) {
+    SigmaValue args[2] = {c, sigma_make_int(i)};
+    sigma_spawn((void*)send_one, 2, args);
+  }
+  int64_t sum = 0;
+  for (long i = 0; i < n; i++) sum += sigma_chan_recv(c).as.integer;
+  t = now() - t;
+  if (sum != (int64_t)n * (n - 1) / 2) fprintf(stderr, "spawn: wrong sum %lld\n", (long long)sum);
+  return t;
+}
+
+static void* thread_noop(void* arg) {
+  return arg;
+}
+
+static double spawn_threads(long n) {
+  double t = now();
+  for (long i = 0; i < n; i++) {
+    pthread_t thread;
+    pthread_create(&thread, NULL, thread_noop, NULL);
+    pthread_join(thread, NULL);
+  }
+  return now() - t;
+}
+
+// --- ping-pong ---
+
+static SigmaValue pinger(SigmaValue ping, SigmaValue pong, SigmaValue rounds, SigmaValue done) {
+  SigmaValue v = sigma_make_int(0);
+  for (int64_t i = 0; i < rounds.as.integer; i++) {
+    sigma_chan_send(ping, v);
+    v = sigma_chan_recv(pong);
+  }
+  return sigma_chan_send(done, v);
+}
+
+static SigmaValue ponger(SigmaValue ping, SigmaValue pong, SigmaValue rounds) {
+  for (int64_t i = 0; i < rounds.as.integer; i++) {
+    SigmaValue v = sigma_chan_recv(ping);
+    sigma_chan_send(pong, sigma_make_int(v.as.integer + 1));
+  }
+  return sigma_make_nil();
+}
+
+static double ping_pong_tasks(long n) {
+  SigmaValue args[4] = {sigma_make_chan(), sigma_make_chan(), sigma_make_int(n), sigma_make_chan()};
+  double t = now();
+  sigma_spawn((void*)ponger, 3, args);
+  sigma_spawn((void*)pinger, 4, args);
+  SigmaValue v = sigma_chan_recv(args[3]);
+  t = now() - t;
+  if (v.as.integer != n) fprintf(stderr, "ping-pong: wrong count %lld\n", (long long)v.as.integer);
+  return t;
+}
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake[2];
+  int turn;
+  long rounds;
+} Table;
+
+static void* thread_player(void* arg) {
+  Table* table = arg;
+  pthread_mutex_lock(&table->lock);
+  for (long i = 0; i < table->rounds; i++) {
+    while (table->turn != 1) pthread_cond_wait(&table->wake[1], &table->lock);
+    table->turn = 0;
+    pthread_cond_signal(&table->wake[0]);
+  }
+  pthread_mutex_unlock(&table->lock);
+  return NULL;
+}
+
+static double ping_pong_threads(long n) {
+  Table table = {PTHREAD_MUTEX_INITIALIZER, {PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER}, 0, n};
+  pthread_t other;
+  double t = now();
+  pthread_create(&other, NULL, thread_player, &table);
+  pthread_mutex_lock(&table.lock);
+  for (long i = 0; i < n; i++) {
+    table.turn = 1;
+    pthread_cond_signal(&table.wake[1]);
+    while (table.turn != 0) pthread_cond_wait(&table.wake[0], &table.lock);
+  }
+  pthread_mutex_unlock(&table.lock);
+  pthread_join(other, NULL);
+  return now() - t;
+}
+
+int main(int argc, char** argv) {
+  long tasks = argc > 1 ? atol(argv[1]) : 100000;
+  long rounds = argc > 2 ? atol(argv[2]) : 100000;
+  const char* workers = getenv("SIGMA_WORKERS");
+  printf("%ld tasks, %ld round trips, SIGMA_WORKERS=%s\n%-14s %13s %15s %9s\n", tasks, rounds,
+         workers ? workers : "(cores)", "", "tasks", "threads", "speedup");
+  spawn_tasks(1000, 1000);    // starts the workers and fills the stack cache
+  double threads = spawn_threads(tasks / 10) * 10;
+  row("spawn", tasks, spawn_tasks(tasks, tasks), threads);
+  row("spawn, held", tasks, spawn_tasks(tasks, 0), threads);
+  row("ping-pong", rounds, ping_pong_tasks(rounds), ping_pong_threads(rounds));
+  return 0;
+}
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""What $try and the error checks cost the code sig generates.
+
+Takes the C that `sig --emit-c` generates for bench/try/hot_loop.sgm, a loop
+that never fails, and builds three programs from it with the same compiler
+and flags:
+
+    try        the C as generated: the loop inside a $try
+    no-try     the same program without the $try around the loop
+    unchecked  the first, with every `sigma_check` after a call that can
+               fail replaced by 0, as if nothing could fail
+
+It runs them in turn, `--repeat` times each, and reports the median and the
+fastest run. `try` against `no-try` is the cost of the $try itself;
+`try` against `unchecked` is the cost of testing the error flag after each
+call. Normally invoked through the CMake `bench-try` target:
+
+    cmake --build build --target bench-try
+"""
+
+import argparse
+import os
+import re
+import statistics
+import subprocess
+import sys
+import time
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(os.path.dirname(BENCH_DIR))
+
+
+def emit_c(sig, source, out_dir):
+    """Writes the modules `sig --emit-c` prints to out_dir; returns the .c files."""
+    text = subprocess.run([sig, "--emit-c", source], check=True, stdout=subprocess.PIPE, text=True).stdout
+    files = []
+    name = None
+    parts = {}
+    for line in text.splitlines(keepends=True):
+        m = re.match(r"// (\S+\.[ch])(?: \(.*\))?$", line)
+        if m:
+            name = m.group(1)
+            parts[name] = []
+            continue
+        parts[name].append(line)
+    os.makedirs(out_dir, exist_ok=True)
+    for name, lines in parts.items():
+        with open(os.path.join(out_dir, name), "w") as f:
+            f.writelines(lines)
+        if name.endswith(".c"):
+            files.append(os.path.join(out_dir, name))
+    return files
+
+
+def build(cc, c_files, exe):
+    runtime = os.path.join(ROOT, "runtime")
+    subprocess.run([cc, "-O3", "-I", runtime, "-o", exe] + c_files +
+                   [os.path.join(runtime, "sigma_rt.c"), "-lm", "-lpthread"], check=True)
+
+
+def without_try(source):
+    """hot_loop.sgm with its $try and catch block taken out."""
+    with open(source) as f:
+        text = f.read()
+    body = re.search(r"\$try :: \{\n(.*?)\n\} catch\(e\) :: \{\n.*?\n\}\n", text, re.S)
+    if not body:
+        sys.exit("try_bench: no $try ... catch block in " + source)
+    lines = [l[4:] if l.startswith("    ") else l for l in body.group(1).splitlines()]
+    return text[:body.start()] + "\n".join(lines) + "\n" + text[body.end():]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--sig", required=True, help="path to the sig compiler")
+    parser.add_argument("--work-dir", default=os.path.join(os.getcwd(), "bench-work"))
+    parser.add_argument("--repeat", type=int, default=11)
+    parser.add_argument("--cc", default=os.environ.get("CC", "gcc"))
+    args = parser.parse_args()
+
+    source = os.path.join(BENCH_DIR, "hot_loop.sgm")
+    work = os.path.join(args.work_dir, "try")
+    os.makedirs(work, exist_ok=True)
+    plain = os.path.join(work, "hot_loop_no_try.sgm")
+    with open(plain, "w") as f:
+        f.write(without_try(source))
+
+    exes = {}
+    files = emit_c(args.sig, source, os.path.join(work, "try"))
+    exes["try"] = os.path.join(work, "try.exe")
+    build(args.cc, files, exes["try"])
+
+    files = emit_c(args.sig, plain, os.path.join(work, "no-try"))
+    exes["no-try"] = os.path.join(work, "no-try.exe")
+    build(args.cc, files, exes["no-try"])
+
+    files = emit_c(args.sig, source, os.path.join(work, "unchecked"))
+    checks = 0
+    for path in files:
+        with open(path) as f:
+            c = f.read()
+        c, n = re.subn(r"sigma_check\([^()]*\)", "0", c)
+        checks += n
+        with open(path, "w") as f:
+            f.write(c)
+    exes["unchecked"] = os.path.join(work, "unchecked.exe")
+    build(args.cc, files, exes["unchecked"])
+
+    outputs = {}
+    times = {name: [] for name in exes}
+    for _ in range(args.repeat):
+        for name, exe in exes.items():
+            start = time.perf_counter()
+            out = subprocess.run([exe], check=True, stdout=subprocess.PIPE).stdout
+            times[name].append(time.perf_counter() - start)
+            outputs[name] = out
+    if len(set(outputs.values())) != 1:
+        sys.exit("try_bench: the three programs printed different output")
+
+    base = statistics.median(times["unchecked"])
+    print("%d runs each; %d sigma_check calls removed for unchecked\n" % (args.repeat, checks))
+    print("%-10s %10s %10s %10s" % ("", "median_s", "best_s", "vs unchecked"))
+    for name in exes:
+        median = statistics.median(times[name])
+        print("%-10s %10.4f %10.4f %+11.1f%%" % (name, median, min(times[name]), (median / base - 1) * 100))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
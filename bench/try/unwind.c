@@ -0,0 +1,154 @@
+// sigma_try_bench: what error handling costs code that never fails.
+//
+//   sigma_try_bench [iterations]
+//
+// Models the code sig generates for a hot loop that calls a Sigma function,
+// which reads an array element (a call that can fail), under the two
+// schemes considered for $try/catch:
+//
+//   slot    the runtime sets a thread-local flag on failure; every fallible
+//           call is followed by a __builtin_expect test of it, which jumps
+//           to the handler or returns to the caller (what sig emits)
+//   setjmp  a $try calls setjmp on entry and the runtime longjmps to the
+//           innermost one; fallible calls are not followed by anything
+//
+// Each is timed with the $try around the loop and inside the loop body,
+// against the same loop with no error handling at all. Nothing fails.
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define TABLE 8
+
+static _Thread_local int failed;
+static _Thread_local jmp_buf* handler;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The runtime's array read, three ways.
+__attribute__((noinline)) static int64_t get_none(const int64_t* a, int64_t n, int64_t i) {
+  if (i < 0 || i >= n) return 0;
+  return a[i];
+}
+
+__attribute__((noinline)) static int64_t get_slot(const int64_t* a, int64_t n, int64_t i) {
+  if (i < 0 || i >= n) {
+    failed = 1;
+    return 0;
+  }
+  return a[i];
+}
+
+__attribute__((noinline)) static int64_t get_jmp(const int64_t* a, int64_t n, int64_t i) {
+  if (i < 0 || i >= n) longjmp(*handler, 1);
+  return a[i];
+}
+
+// A Sigma function that reads table[i % 8] and adds one.
+__attribute__((noinline)) static int64_t lookup_none(const int64_t* a, int64_t i) {
+  return get_none(a, TABLE, i % TABLE) + 1;
+}
+
+__attribute__((noinline)) static int64_t lookup_slot(const int64_t* a, int64_t i) {
+  int64_t v = get_slot(a, TABLE, i % TABLE);
+  if (__builtin_expect(failed, 0)) return 0;
+  return v + 1;
+}
+
+__attribute__((noinline)) static int64_t lookup_jmp(const int64_t* a, int64_t i) {
+  return get_jmp(a, TABLE, i % TABLE) + 1;
+}
+
+static int64_t loop_none(const int64_t* a, int64_t n) {
+  int64_t sum = 0;
+  for (int64_t i = 0; i < n; i++) sum += lookup_none(a, i);
+  return sum;
+}
+
+static int64_t slot_outside(const int64_t* a, int64_t n) {
+  int64_t sum = 0;
+  for (int64_t i = 0; i < n; i++) {
+    int64_t v = lookup_slot(a, i);
+    if (__builtin_expect(failed, 0)) goto caught;
+    sum += v;
+  }
+  return sum;
+caught:
+  failed = 0;
+  return -sum;
+}
+
+static int64_t slot_inside(const int64_t* a, int64_t n) {
+  int64_t sum = 0;
+  for (int64_t i = 0; i < n; i++) {
+    int64_t v = lookup_slot(a, i);
+    if (__builtin_expect(failed, 0)) {
+      failed = 0;
+      sum -= 1;
+      continue;
+    }
+    sum += v;
+  }
+  return sum;
+}
+
+// Locals written in the $try and read by the handler must be volatile
+// across longjmp, which keeps them out of registers.
+static int64_t jmp_outside(const int64_t* a, int64_t n) {
+  volatile int64_t sum = 0;
+  jmp_buf buf;
+  jmp_buf* outer = handler;
+  handler = &buf;
+  if (setjmp(buf)) {
+    handler = outer;
+    return -sum;
+  }
+  for (int64_t i = 0; i < n; i++) sum += lookup_jmp(a, i);
+  handler = outer;
+  return sum;
+}
+
+static int64_t jmp_inside(const int64_t* a, int64_t n) {
+  volatile int64_t sum = 0;
+  jmp_buf* outer = handler;
+  for (int64_t i = 0; i < n; i++) {
+    jmp_buf buf;
+    handler = &buf;
+    if (setjmp(buf)) {
+      sum -= 1;
+      continue;
+    }
+    sum += lookup_jmp(a, i);
+  }
+  handler = outer;
+  return sum;
+}
+
+static double report(const char* name, int64_t (*loop)(const int64_t*, int64_t), const int64_t* a, int64_t n, double base) {
+  loop(a, n / 10);
+  double start = now();
+  int64_t sum = loop(a, n);
+  double ns = (now() - start) * 1e9 / n;
+  printf("%-30s %6.2f ns/iter", name, ns);
+  if (base > 0) printf("  %+6.1f%%", 100 * (ns / base - 1));
+  else printf("         ");
+  printf("   (sum %lld)\n", (long long)sum);
+  return ns;
+}
+
+int main(int argc, char** argv) {
+  int64_t n = argc > 1 ? atoll(argv[1]) : 200000000;
+  int64_t table[TABLE] = {3, 1, 4, 1, 5, 9, 2, 6};
+  double base = report("no error handling", loop_none, table, n, 0);
+  report("slot, $try around the loop", slot_outside, table, n, base);
+  report("slot, $try in the loop body", slot_inside, table, n, base);
+  report("setjmp, $try around the loop", jmp_outside, table, n, base);
+  report("setjmp, $try in the loop body", jmp_inside, table, n, base);
+  return 0;
+}
@@ -0,0 +1,19 @@
+# Embeds the runtime sources into a C++ header so that sig is a single
+# self-contained binary.
+#
+#   cmake -DOUTPUT=<header> -DINPUTS="<file>;<file>" -P embed_runtime.cmake
+#
+# Each input becomes `static const char <name>_src[]`, e.g. sigma_rt_c_src.
+# The header is written next to OUTPUT and renamed over it, so a build never
+# sees it half written.
+
+set(tmp ${OUTPUT}.tmp)
+file(WRITE ${tmp} "// Generated by cmake/embed_runtime.cmake from runtime/; do not edit.\n#pragma once\n\n")
+foreach(input ${INPUTS})
+    get_filename_component(name ${input} NAME)
+    string(MAKE_C_IDENTIFIER ${name} ident)
+    file(READ ${input} content)
+    file(APPEND ${tmp} "static const char ${ident}_src[] = R\"SIGMA_RT(${content})SIGMA_RT\";\n\n")
+endforeach()
+
+file(RENAME ${tmp} ${OUTPUT})
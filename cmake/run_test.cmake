@@ -0,0 +1,43 @@
+# Runs one language test: compiles and runs a .sgm file with sig and checks
+# that it prints exactly what the .out file next to it holds. The test runs
+# in WORK_DIR, emptied first and given a copy of tests/data/, so it can name
+# those files relatively and write its own without touching the source tree.
+# A test with a .err file must fail, printing exactly that on stderr, with
+# the paths of files in the tests directory relative to it; any other test
+# must print nothing there.
+#
+#   cmake -DSIG=<sig> -DSOURCE=<test.sgm> -DWORK_DIR=<dir> -P run_test.cmake
+
+string(REGEX REPLACE "\\.sgm$" ".out" expected_file ${SOURCE})
+file(READ ${expected_file} expected)
+get_filename_component(directory ${SOURCE} DIRECTORY)
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+if (EXISTS ${directory}/data)
+    file(COPY ${directory}/data DESTINATION ${WORK_DIR})
+endif()
+execute_process(
+    COMMAND ${SIG} ${SOURCE}
+    WORKING_DIRECTORY ${WORK_DIR}
+    OUTPUT_VARIABLE actual
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE status
+)
+string(REPLACE "${directory}/" "" errors "${errors}")
+string(REGEX REPLACE "\\.sgm$" ".err" error_file ${SOURCE})
+if (EXISTS ${error_file})
+    file(READ ${error_file} expected_errors)
+    if (status EQUAL 0)
+        message(FATAL_ERROR "${SOURCE} exited with 0, expected:\n${expected_errors}")
+    endif()
+    if (NOT errors STREQUAL expected_errors)
+        message(FATAL_ERROR "${SOURCE} printed on stderr:\n${errors}\nexpected:\n${expected_errors}")
+    endif()
+elseif (NOT status EQUAL 0)
+    message(FATAL_ERROR "${SOURCE} exited with ${status}:\n${errors}")
+elseif (NOT errors STREQUAL "")
+    message(FATAL_ERROR "${SOURCE} printed on stderr:\n${errors}")
+endif()
+if (NOT actual STREQUAL expected)
+    message(FATAL_ERROR "${SOURCE} printed:\n${actual}\nexpected:\n${expected}")
+endif()
@@ -1,801 +1,1122 @@
 #include "../include/ast.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <string>
-#include <sstream>
 #include <set>
 #include <map>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <stdexcept>
 
+// The C being generated: a single buffer, reserved up front, that every
+// piece of output is appended to in order. Numbers are formatted in place,
+// so emitting an instruction builds no intermediate strings.
+class CodeBuffer {
+    std::string buf;
+    
+public:
+    void reserve(size_t bytes) { buf.reserve(bytes); }
+    size_t size() const { return buf.size(); }
+    std::string take() { return std::move(buf); }
+    
+    CodeBuffer& operator<<(const char* s) {
+        buf.append(s);
+        return *this;
+    }
+    
+    CodeBuffer& operator<<(const std::string& s) {
+        buf.append(s);
+        return *this;
+    }
+    
+    CodeBuffer& operator<<(char c) {
+        buf.push_back(c);
+        return *this;
+    }
+    
+    template <class T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, char> && !std::is_same_v<T, bool>, int> = 0>
+    CodeBuffer& operator<<(T n) {
+        char tmp[24];
+        buf.append(tmp, std::to_chars(tmp, tmp + sizeof(tmp), n).ptr);
+        return *this;
+    }
+};
+
+// Prints C for one module from its optimized IR.
+//
+// Each function becomes straight-line C with gotos between blocks laid out in
+// reverse postorder, so most edges fall through. Every SSA value is a local:
+// a double or int when its type is a number or a boolean, a SigmaValue
+// otherwise. Phis become locals assigned on the incoming edges.
+//
+// Every call that can fail is followed by a test of the runtime's error
+// flag (see sigma_check): an IR_CHECK branches to its $try handler, and
+// anywhere else the function returns, leaving the error to its caller.
+//
+// Output is streamed into one CodeBuffer, and every name in it comes from
+// the IR (v<id> for values, b<id> for blocks, t<n> for phi temporaries), so
+// the same source always produces the same C.
 class CodeGen {
-    std::stringstream code;
-    int indent = 0;
-    std::set<std::string> constants;
-    
-    void emit(std::string s) {
-        for (int i = 0; i < indent; i++) code << "  ";
-        code << s << "\n";
-    }
-    
-    std::string genExpr(ASTNode* node) {
-        if (node->type == NODE_LITERAL) {
-            if (node->value[0] == '"') {
-                std::string escaped = node->value;
-                std::string result;
-                for (char c : escaped) {
-                    if (c == '"') result += "\\\"";
-                    else result += c;
+    const ModuleInfo* mod = nullptr;
+    CodeBuffer out;
+    const IRFunction* fn = nullptr;
+    // String literals, interned once at startup; IR_STR indexes this table.
+    std::map<std::string, size_t> strings;
+    // Literals of top-level $fixed declarations emitted as static data, the
+    // static strings they contain, and the string values only they use.
+    std::set<const IRInstr*> fixedData;
+    std::map<std::string, size_t> fixedStrings;
+    std::set<const IRInstr*> fixedOnly;
+    // --mem-stats: the Sigma line the runtime currently attributes
+    // allocations to, or -1 if a call or a jump may have changed it.
+    int line = -1;
+    // sig watch: the table source lines are read from, and the lines it
+    // holds (see generateShard).
+    std::string linesTable;
+    std::map<int, size_t> lineIndex;
+    std::vector<int> lines;
+    
+    // How an operand is printed.
+    enum Form {
+        VAR,        // the local holding it
+        RAW,        // in its own representation
+        BOXED,      // as a SigmaValue
+        DEC,        // as a C double, for dec arithmetic
+        AS,         // in the representation of `type`, unboxing if needed
+        TRUTH       // as a C truth value
+    };
+    
+    struct Operand {
+        const IRInstr* v;
+        Form form;
+        IRType type = TY_UNKNOWN;
+    };
+    
+    static Operand var(const IRInstr* v) { return {v, VAR}; }
+    static Operand raw(const IRInstr* v) { return {v, RAW}; }
+    static Operand boxed(const IRInstr* v) { return {v, BOXED}; }
+    static Operand dec(const IRInstr* v) { return {v, DEC}; }
+    static Operand as(const IRInstr* v, IRType type) { return {v, AS, type}; }
+    static Operand truth(const IRInstr* v) { return {v, TRUTH}; }
+    
+    // String literal contents as a C string literal body.
+    struct Escaped {
+        const std::string& text;
+    };
+    
+    // A Sigma source line, for error locations and --mem-stats.
+    struct SourceLine {
+        int n;
+    };
+    
+    static const char* cType(IRType type) {
+        switch (type) {
+            case TY_INT: return "int64_t";
+            case TY_DEC: return "double";
+            case TY_BOOL: return "int";
+            case TY_VOID: return nullptr;
+            default: return "SigmaValue";
+        }
+    }
+    
+    // --- output ---
+    
+    void put(const char* s) { out << s; }
+    void put(const std::string& s) { out << s; }
+    void put(char c) { out << c; }
+    void put(int n) { out << n; }
+    void put(size_t n) { out << n; }
+    
+    void put(const Escaped& e) {
+        for (char c : e.text) {
+            if (c == '"' || c == '\\') out << '\\' << c;
+            else if (c == '\n') out << "\\n";
+            else if (c == '\t') out << "\\t";
+            else if ((unsigned char)c < 0x20) out << '\\' << (char)('0' + ((c >> 6) & 3)) << (char)('0' + ((c >> 3) & 7)) << (char)('0' + (c & 7));
+            else out << c;
+        }
+    }
+    
+    void put(const SourceLine& l) {
+        if (linesTable.empty()) {
+            out << l.n;
+            return;
+        }
+        auto it = lineIndex.emplace(l.n, lines.size());
+        if (it.second) lines.push_back(l.n);
+        out << linesTable << '[' << it.first->second << ']';
+    }
+    
+    void put(const Operand& o) {
+        const IRInstr* v = o.v;
+        switch (o.form) {
+            case VAR:
+                out << 'v' << v->id;
+                break;
+            case RAW:
+                if (v->op == IR_PARAM) out << 'a' << (int)v->num;
+                else if (v->op != IR_CONST) out << 'v' << v->id;
+                else if (v->type == TY_INT) putInt(v->inum);
+                else if (v->type == TY_DEC) putNum(v->num);
+                else if (v->type == TY_BOOL) out << (v->num ? "1" : "0");
+                else out << "sigma_make_nil()";
+                break;
+            case BOXED:
+                if (v->type == TY_INT) put("sigma_make_int(", raw(v), ")");
+                else if (v->type == TY_DEC) put("sigma_make_number(", raw(v), ")");
+                else if (v->type == TY_BOOL) put("sigma_make_bool(", raw(v), ")");
+                else put(raw(v));
+                break;
+            case DEC:
+                if (v->type == TY_DEC) put(raw(v));
+                else if (v->type == TY_INT) put("(double)", raw(v));
+                else put("sigma_num(", boxed(v), ")");
+                break;
+            case AS:
+                if (o.type == TY_INT) {
+                    if (v->type == TY_INT) put(raw(v));
+                    else put(boxed(v), ".as.integer");
+                } else if (o.type == TY_DEC) {
+                    put(dec(v));
+                } else if (o.type == TY_BOOL) {
+                    if (v->type == TY_BOOL) put(raw(v));
+                    else put(boxed(v), ".as.boolean");
+                } else {
+                    put(boxed(v));
                 }
-                return "sigma_make_literal(\"" + result + "\")";
-            } else {
-                return "sigma_make_literal(\"" + node->value + "\")";
-            }
+                break;
+            case TRUTH:
+                if (v->type == TY_BOOL) put(raw(v));
+                else if (v->type == TY_INT || v->type == TY_DEC) put("(", raw(v), " != 0)");
+                else if (v->type == TY_NIL) put("0");
+                else put("sigma_is_truthy(", raw(v), ")");
+                break;
         }
-        
-        if (node->type == NODE_IDENT) {
-            return node->value;
+    }
+    
+    template <class A, class B, class... Rest>
+    void put(const A& a, const B& b, const Rest&... rest) {
+        put(a);
+        put(b);
+        (put(rest), ...);
+    }
+    
+    // One indented line of a function body.
+    template <class... Parts>
+    void emit(const Parts&... parts) {
+        out << "  ";
+        (put(parts), ...);
+        out << '\n';
+    }
+    
+    void putNum(double x) {
+        if (std::isinf(x)) {
+            out << (x > 0 ? "HUGE_VAL" : "-HUGE_VAL");
+            return;
         }
-        
-        if (node->type == NODE_BINARY_OP) {
-            std::string left = genExpr(node->children[0].get());
-            std::string right = genExpr(node->children[1].get());
-            
-            if (node->value == "+") {
-                return "sigma_add(" + left + ", " + right + ")";
-            } else if (node->value == "-") {
-                return "sigma_subtract(" + left + ", " + right + ")";
-            } else if (node->value == "*") {
-                return "sigma_multiply(" + left + ", " + right + ")";
-            } else if (node->value == "/") {
-                return "sigma_divide(" + left + ", " + right + ")";
-            } else if (node->value == "%") {
-                return "sigma_modulo(" + left + ", " + right + ")";
-            } else if (node->value == "==") {
-                return "sigma_equals(" + left + ", " + right + ")";
-            } else if (node->value == "===") {
-                return "sigma_strict_equals(" + left + ", " + right + ")";
-            } else if (node->value == "!=") {
-                return "sigma_not_equals(" + left + ", " + right + ")";
-            } else if (node->value == "<") {
-                return "sigma_less_than(" + left + ", " + right + ")";
-            } else if (node->value == ">") {
-                return "sigma_greater_than(" + left + ", " + right + ")";
-            } else if (node->value == "<=") {
-                return "sigma_less_equal(" + left + ", " + right + ")";
-            } else if (node->value == ">=") {
-                return "sigma_greater_equal(" + left + ", " + right + ")";
-            } else if (node->value == "&&") {
-                return "sigma_logical_and(" + left + ", " + right + ")";
-            } else if (node->value == "||") {
-                return "sigma_logical_or(" + left + ", " + right + ")";
-            }
-            
-            return "sigma_make_nil()";
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.17g", x);
+        out << buf;
+        if (!strpbrk(buf, ".en")) out << ".0";
+    }
+    
+    void putInt(int64_t x) {
+        if (x == INT64_MIN) out << "INT64_MIN";
+        else out << x;
+    }
+    
+    // f(args...), every argument boxed.
+    void putCall(const char* f, const IRInstr* in) {
+        put(f, "(");
+        for (size_t i = 0; i < in->args.size(); i++) {
+            if (i) put(", ");
+            put(boxed(in->args[i]));
         }
-        
-        if (node->type == NODE_FUNC_CALL) {
-            // Check for check_type() function
-            if (node->value == "check_type" && node->children.size() == 1) {
-                return "sigma_type_of(" + genExpr(node->children[0].get()) + ")";
+        put(")");
+    }
+    
+    void putCall(const std::string& f, const IRInstr* in) {
+        putCall(f.c_str(), in);
+    }
+    
+    static bool both(const IRInstr* in, IRType type) {
+        return in->args[0]->type == type && in->args[1]->type == type;
+    }
+    
+    // Both operands unboxed numbers, so C can compare them directly.
+    static bool unboxedNumbers(const IRInstr* in) {
+        for (const IRInstr* arg : in->args) {
+            if (arg->type != TY_INT && arg->type != TY_DEC) return false;
+        }
+        return true;
+    }
+    
+    // The suffix that unboxes a runtime call's result of type `type`.
+    static const char* unbox(IRType type) {
+        if (type == TY_INT) return ".as.integer";
+        if (type == TY_DEC) return ".as.number";
+        if (type == TY_BOOL) return ".as.boolean";
+        return "";
+    }
+    
+    // The prefix of the runtime's accessors for a typed array type
+    // (sigma_f64_get, sigma_u8_data, ...), or null for any other type.
+    static const char* typedAccessor(IRType type) {
+        if (type == TY_F64ARR) return "sigma_f64";
+        if (type == TY_I64ARR) return "sigma_i64";
+        if (type == TY_U8ARR) return "sigma_u8";
+        return nullptr;
+    }
+    
+    // Whether a value of type `v` goes into a typed array of type `arr`
+    // unboxed: any number into an f64 array, an int into the others.
+    static bool storesUnboxed(IRType arr, IRType v) {
+        return arr == TY_F64ARR ? irIsNumeric(v) : v == TY_INT;
+    }
+    
+    // The stored value, as the typed array `arr` holds it.
+    static Operand elemValue(const IRInstr* arr, const IRInstr* v) {
+        return arr->type == TY_F64ARR ? dec(v) : raw(v);
+    }
+    
+    // Int, dec and num arithmetic. Ints stay in C int64_t arithmetic when
+    // the optimizer proved the result fits (the result is an int), and go
+    // through the overflow-checking sigma_int_* helpers otherwise.
+    void putArith(const IRInstr* in) {
+        static const std::map<IROp, std::tuple<const char*, const char*, const char*>> ops = {
+            {IR_ADD, {"+", "sigma_int_add", "sigma_num_add"}},
+            {IR_SUB, {"-", "sigma_int_subtract", "sigma_subtract"}},
+            {IR_MUL, {"*", "sigma_int_multiply", "sigma_multiply"}},
+            {IR_DIV, {"/", "sigma_int_divide", "sigma_divide"}},
+            {IR_MOD, {"%", "sigma_int_modulo", "sigma_modulo"}},
+        };
+        auto& op = ops.at(in->op);
+        const IRInstr* a = in->args[0];
+        const IRInstr* b = in->args[1];
+        if (both(in, TY_INT)) {
+            if (in->type == TY_INT) put("(", raw(a), " ", std::get<0>(op), " ", raw(b), ")");
+            else put(std::get<1>(op), "(", raw(a), ", ", raw(b), ")");
+        } else if (in->type == TY_DEC) {
+            if (in->op == IR_MOD) put("fmod(", dec(a), ", ", dec(b), ")");
+            else put(dec(a), " ", std::get<0>(op), " ", dec(b));
+        } else if (in->type == TY_NUM) {
+            putCall(std::get<2>(op), in);
+        } else {
+            putCall("sigma_add", in);
+        }
+    }
+    
+    // Right-hand side for an instruction that produces a value.
+    void putExpr(const IRInstr* in) {
+        static const std::map<IROp, std::pair<const char*, const char*>> compare = {
+            {IR_LT, {"<", "sigma_less_than"}}, {IR_GT, {">", "sigma_greater_than"}},
+            {IR_LE, {"<=", "sigma_less_equal"}}, {IR_GE, {">=", "sigma_greater_equal"}},
+        };
+        const IRInstr* a = in->args.size() > 0 ? in->args[0] : nullptr;
+        const IRInstr* b = in->args.size() > 1 ? in->args[1] : nullptr;
+        switch (in->op) {
+            case IR_STR:
+                put("sigma_strings[", strings.at(in->name), "]");
+                break;
+            case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+                putArith(in);
+                break;
+            case IR_LT: case IR_GT: case IR_LE: case IR_GE: {
+                auto& op = compare.at(in->op);
+                if (both(in, TY_INT)) put("(", raw(a), " ", op.first, " ", raw(b), ")");
+                else if (unboxedNumbers(in)) put("(", dec(a), " ", op.first, " ", dec(b), ")");
+                else {
+                    putCall(op.second, in);
+                    put(".as.boolean");
+                }
+                break;
             }
-            // Check for to_int() function
-            if (node->value == "to_int" && node->children.size() == 1) {
-                return "sigma_to_int(" + genExpr(node->children[0].get()) + ")";
+            case IR_EQ: case IR_STRICT_EQ: case IR_NE: {
+                const char* op = in->op == IR_NE ? " != " : " == ";
+                if (both(in, TY_INT) || both(in, TY_DEC) || both(in, TY_BOOL)) {
+                    put("(", raw(a), op, raw(b), ")");
+                } else if (in->op != IR_STRICT_EQ && unboxedNumbers(in)) {
+                    put("(", dec(a), op, dec(b), ")");
+                } else if (both(in, TY_STR)) {
+                    if (in->op == IR_NE) put("!");
+                    put("sigma_str_equals(", raw(a), ".as.string, ", raw(b), ".as.string)");
+                } else {
+                    if (in->op == IR_NE) put("!");
+                    putCall(in->op == IR_STRICT_EQ ? "sigma_strict_equals" : "sigma_equals", in);
+                    put(".as.boolean");
+                }
+                break;
             }
-            // Check for to_dec() function
-            if (node->value == "to_dec" && node->children.size() == 1) {
-                return "sigma_to_dec(" + genExpr(node->children[0].get()) + ")";
+            case IR_AND:
+                put("(", truth(a), " && ", truth(b), ")");
+                break;
+            case IR_OR:
+                put("(", truth(a), " || ", truth(b), ")");
+                break;
+            case IR_BUILTIN:
+                putCall(in->name, in);
+                put(unbox(in->type));
+                break;
+            case IR_CALL: {
+                const IRFunction* f = in->callee;
+                if (f && f->origin) {
+                    // A specialization: numbers and booleans go in and out unboxed.
+                    put(in->name, "(");
+                    for (size_t i = 0; i < in->args.size(); i++) {
+                        if (i) put(", ");
+                        put(as(in->args[i], f->paramValues[i]->type));
+                    }
+                    put(")");
+                } else {
+                    putCall(in->name, in);
+                    put(unbox(in->type));
+                }
+                break;
             }
-            // Check for to_str() function
-            if (node->value == "to_str" && node->children.size() == 1) {
-                return "sigma_to_str(" + genExpr(node->children[0].get()) + ")";
+            case IR_GET:
+                put("sigma_object_get(", boxed(a), ", \"", in->name, "\")");
+                break;
+            case IR_INDEX: {
+                const char* typed = typedAccessor(a->type);
+                if (typed && b->type == TY_INT) {
+                    put(typed, "_get(", boxed(a), ", ", raw(b), ")");
+                    break;
+                }
+                putCall(a->type == TY_DICT ? "sigma_dict_get" : "sigma_array_get", in);
+                put(unbox(in->type));
+                break;
             }
-            // Check for random() function
-            if (node->value == "random" && node->children.size() == 1) {
-                return "sigma_random(" + genExpr(node->children[0].get()) + ")";
+            case IR_ELEM:
+                if (const char* typed = typedAccessor(a->type)) {
+                    put(typed, "_data(", boxed(a), ")[", raw(b), "]");
+                } else if (in->args.size() < 3) {
+                    put("sigma_array_at(", boxed(a), ", ", raw(b), ")");
+                } else {
+                    // Not an array: sigma_array_get raises.
+                    put("(", raw(in->args[2]), " ? sigma_array_at(", boxed(a), ", ", raw(b), ")");
+                    put(" : sigma_array_get(", boxed(a), ", ", boxed(b), "))");
+                }
+                break;
+            case IR_ITEM:
+                put("sigma_iter_at(", boxed(a), ", ", as(b, TY_INT), ")", unbox(in->type));
+                break;
+            case IR_CATCH:
+                put("sigma_error_catch()");
+                break;
+            case IR_LEN:
+                put("sigma_len(", boxed(a), ")");
+                break;
+            case IR_IS_ARRAY:
+                put("(", boxed(a), ".type == TYPE_ARRAY)");
+                break;
+            case IR_SORT:
+                putCall("sigma_array_sort", in);
+                break;
+            case IR_INPUT:
+                put("sigma_input(\"", Escaped{in->name}, "\")");
+                break;
+            default:
+                throw std::runtime_error("CodeGen: unexpected IR instruction");
+        }
+    }
+    
+    // Literals are sized exactly. Elements go into a local array first;
+    // literals that do not escape keep their boxes and header in the frame.
+    void emitLiteral(const IRInstr* in) {
+        Operand v = var(in);
+        size_t n = in->args.size();
+        if (fixedData.count(in)) {
+            emit(v, in->op == IR_ARRAY ? " = sigma_static_array(&" : " = sigma_static_object(&", v, "_hdr);");
+            return;
+        }
+        if (in->args.empty()) {
+            emit(v, in->op == IR_ARRAY ? " = sigma_make_array_of(0, NULL);" : " = sigma_make_object_of(0, NULL, NULL);");
+            return;
+        }
+        for (size_t i = 0; i < n; i++) emit(v, "_vals[", i, "] = ", boxed(in->args[i]), ";");
+        if (in->op == IR_ARRAY) {
+            if (in->noEscape) emit(v, " = sigma_stack_array(&", v, "_hdr, ", v, "_items, ", v, "_vals, ", n, ");");
+            else emit(v, " = sigma_make_array_of(", n, ", ", v, "_vals);");
+        } else {
+            if (in->noEscape) emit(v, " = sigma_stack_object(&", v, "_hdr, ", v, "_keys, ", v, "_slots, ", v, "_vals, ", n, ");");
+            else emit(v, " = sigma_make_object_of(", n, ", ", v, "_keys, ", v, "_vals);");
+        }
+    }
+    
+    void declareLiteral(const IRInstr* in) {
+        if (in->args.empty() || fixedData.count(in)) return;
+        Operand v = var(in);
+        size_t n = in->args.size();
+        emit("SigmaValue ", v, "_vals[", n, "];");
+        if (in->op == IR_OBJECT) {
+            // Stack objects copy their keys before adding one, so the key
+            // table can be shared by every call.
+            out << "  " << (in->noEscape ? "static char* " : "static const char* const ");
+            put(v, "_keys[] = {");
+            for (size_t i = 0; i < in->keys.size(); i++) put(i ? ", \"" : "\"", in->keys[i], "\"");
+            out << "};\n";
+        }
+        if (!in->noEscape) return;
+        if (in->op == IR_ARRAY) {
+            emit("void* ", v, "_items[", n, "];");
+            emit("SigmaArray ", v, "_hdr;");
+        } else {
+            emit("void* ", v, "_slots[", n, "];");
+            emit("SigmaObject ", v, "_hdr;");
+        }
+    }
+    
+    // --- $fixed data ---
+
+    // sigma_hash_bytes in sigma_rt.c, which static strings must agree with.
+    static uint64_t wymix(uint64_t a, uint64_t b) {
+        unsigned __int128 r = (unsigned __int128)a * b;
+        return (uint64_t)r ^ (uint64_t)(r >> 64);
+    }
+    
+    static uint64_t hashBytes(const std::string& s) {
+        static const uint64_t wyp[4] = {
+            0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+        };
+        auto r8 = [](const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; };
+        auto r4 = [](const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return (uint64_t)v; };
+        const uint8_t* p = (const uint8_t*)s.data();
+        size_t len = s.size();
+        uint64_t seed = wymix(wyp[0], wyp[1]);
+        uint64_t a = 0, b = 0;
+        if (len <= 16) {
+            if (len >= 4) {
+                a = (r4(p) << 32) | r4(p + ((len >> 3) << 2));
+                b = (r4(p + len - 4) << 32) | r4(p + len - 4 - ((len >> 3) << 2));
+            } else if (len > 0) {
+                a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
             }
-            // Check for random_range() function
-            if (node->value == "random_range" && node->children.size() == 2) {
-                return "sigma_random_range(" + genExpr(node->children[0].get()) + ", " + genExpr(node->children[1].get()) + ")";
+        } else {
+            size_t i = len;
+            if (i > 48) {
+                uint64_t see1 = seed, see2 = seed;
+                do {
+                    seed = wymix(r8(p) ^ wyp[1], r8(p + 8) ^ seed);
+                    see1 = wymix(r8(p + 16) ^ wyp[2], r8(p + 24) ^ see1);
+                    see2 = wymix(r8(p + 32) ^ wyp[3], r8(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
             }
-            
-            std::string call = node->value + "(";
-            for (size_t i = 0; i < node->children.size(); i++) {
-                call += genExpr(node->children[i].get());
-                if (i < node->children.size() - 1) call += ", ";
+            for (; i > 16; i -= 16, p += 16) seed = wymix(r8(p) ^ wyp[1], r8(p + 8) ^ seed);
+            a = r8(p + i - 16);
+            b = r8(p + i - 8);
+        }
+        unsigned __int128 r = (unsigned __int128)(a ^ wyp[1]) * (b ^ seed);
+        return wymix((uint64_t)r ^ wyp[0] ^ len, (uint64_t)(r >> 64) ^ wyp[1]);
+    }
+    
+    // Whether `v` can be an element of static data. Strings with escape
+    // sequences are left to the C compiler, which knows their bytes.
+    bool isFixedValue(const IRInstr* v) const {
+        if (v->op == IR_STR) return v->name.find('\\') == std::string::npos;
+        if (v->op == IR_CONST) return !(v->type == TY_DEC && std::isnan(v->num));
+        return fixedData.count(v) > 0;
+    }
+
+    // A SigmaValue initializer for an element of static data.
+    void putFixedValue(const IRInstr* v) {
+        if (v->op == IR_STR) {
+            put("{TYPE_STRING, {.string = (char*)sigma_fixed_str", fixedStrings.at(v->name), ".chars}}");
+        } else if (v->op == IR_ARRAY) {
+            put("{TYPE_ARRAY, {.array = &", var(v), "_hdr}}");
+        } else if (v->op == IR_OBJECT) {
+            put("{TYPE_OBJECT, {.object = &", var(v), "_hdr}}");
+        } else if (v->type == TY_INT) {
+            put("{TYPE_INT, {.integer = ", raw(v), "}}");
+        } else if (v->type == TY_DEC) {
+            put("{TYPE_NUMBER, {.number = ", raw(v), "}}");
+        } else if (v->type == TY_BOOL) {
+            put("{TYPE_BOOL, {.boolean = ", raw(v), "}}");
+        } else {
+            put("{TYPE_NIL}");
+        }
+    }
+
+    // A top-level $fixed array or object of constants, nested literals and
+    // strings, as static C data: nothing is allocated or initialized at
+    // startup. The element boxes, item pointers and strings are const; only
+    // the header is writable, for the copy made on the first write (see
+    // SIGMA_STATIC_STORAGE).
+    void emitFixed(const IRInstr* in) {
+        std::vector<const IRInstr*> vals(in->args.begin(), in->args.end());
+        std::vector<std::string> keys;
+        if (in->op == IR_OBJECT) {
+            // Later duplicates of a key overwrite earlier ones.
+            vals.clear();
+            for (size_t i = 0; i < in->keys.size(); i++) {
+                size_t j = 0;
+                while (j < keys.size() && keys[j] != in->keys[i]) j++;
+                if (j == keys.size()) {
+                    keys.push_back(in->keys[i]);
+                    vals.push_back(in->args[i]);
+                } else {
+                    vals[j] = in->args[i];
+                }
             }
-            call += ")";
-            return call;
         }
-        
-        if (node->type == NODE_ARRAY) {
-            std::string arrCode = "sigma_make_array()";
-            std::string tempArr = "temp_arr_" + std::to_string(rand());
-            emit("SigmaValue " + tempArr + " = " + arrCode + ";");
-            for (auto& child : node->children) {
-                emit("sigma_array_push(" + tempArr + ", " + genExpr(child.get()) + ");");
+        for (const IRInstr* v : vals) {
+            if (v->op != IR_STR || !fixedStrings.emplace(v->name, fixedStrings.size()).second) continue;
+            put("SIGMA_STATIC_STRING(sigma_fixed_str", fixedStrings.size() - 1, ", ", hashBytes(v->name), "ULL, ");
+            put(v->name.size(), ", \"", Escaped{v->name}, "\");\n");
+        }
+        Operand v = var(in);
+        size_t n = vals.size();
+        if (n > 0) {
+            put("static const SigmaValue ", v, "_vals[", n, "] = {");
+            for (size_t i = 0; i < n; i++) {
+                put(i ? ", " : "");
+                putFixedValue(vals[i]);
             }
-            return tempArr;
+            put("};\n");
+            put("static void* const ", v, in->op == IR_ARRAY ? "_items[" : "_slots[", n, "] = {");
+            for (size_t i = 0; i < n; i++) put(i ? ", " : "", "(void*)&", v, "_vals[", i, "]");
+            put("};\n");
         }
-        
-        if (node->type == NODE_OBJECT) {
-            std::string objCode = "sigma_make_object()";
-            std::string tempObj = "temp_obj_" + std::to_string(rand());
-            emit("SigmaValue " + tempObj + " = " + objCode + ";");
-            for (auto& child : node->children) {
-                std::string key = child->value;
-                std::string val = genExpr(child->children[0].get());
-                emit("sigma_object_set(" + tempObj + ", \"" + key + "\", " + val + ");");
+        if (in->op == IR_ARRAY) {
+            if (n > 0) put("static SigmaArray ", v, "_hdr = {(void**)", v, "_items, ", n, ", ", n, ", SIGMA_STATIC_STORAGE};\n");
+            else put("static SigmaArray ", v, "_hdr = {NULL, 0, 0, SIGMA_STATIC_STORAGE};\n");
+        } else {
+            if (n > 0) {
+                put("static char* const ", v, "_keys[", n, "] = {");
+                for (size_t i = 0; i < n; i++) put(i ? ", \"" : "\"", keys[i], "\"");
+                put("};\n");
+                put("static SigmaObject ", v, "_hdr = {(char**)", v, "_keys, (void**)", v, "_slots, ", n, ", ", n, ", SIGMA_STATIC_STORAGE};\n");
+            } else {
+                put("static SigmaObject ", v, "_hdr = {NULL, NULL, 0, 0, SIGMA_STATIC_STORAGE};\n");
             }
-            return tempObj;
         }
-        
-        if (node->type == NODE_MEMBER_ACCESS) {
-            std::string obj = genExpr(node->children[0].get());
-            std::string member = node->children[1]->value;
-            
-            if (member == "sort" && node->children.size() > 2) {
-                std::string order = genExpr(node->children[2].get());
-                return "sigma_array_sort(" + obj + ", " + order + ")";
+    }
+
+    // Picks the $fixed literals that become static data. Nested literals
+    // come first in instruction order, so they are decided before their
+    // parents.
+    void collectFixed(const std::vector<const IRFunction*>& fns) {
+        std::set<const IRInstr*> used;
+        for (const IRFunction* f : fns) {
+            for (auto& block : f->blocks) {
+                for (IRInstr* in : block->instrs) {
+                    bool fixed = (in->op == IR_ARRAY || in->op == IR_OBJECT) && in->fixed;
+                    for (const IRInstr* arg : in->args) fixed = fixed && isFixedValue(arg);
+                    if (fixed) fixedData.insert(in);
+                    else used.insert(in->args.begin(), in->args.end());
+                }
             }
-            
-            return "sigma_object_get(" + obj + ", \"" + member + "\")";
         }
-        
-        if (node->type == NODE_INDEX_ACCESS) {
-            std::string arr = genExpr(node->children[0].get());
-            std::string idx = genExpr(node->children[1].get());
-            return "sigma_array_get(" + arr + ", " + idx + ")";
+        for (const IRInstr* data : fixedData) {
+            for (const IRInstr* arg : data->args) {
+                if (arg->op == IR_STR && !used.count(arg)) fixedOnly.insert(arg);
+            }
         }
-        
-        return "sigma_make_nil()";
-    }
-    
-    void genStmt(ASTNode* node) {
-        if (node->type == NODE_INPUT) {
-            std::string varName = node->value;
-            std::string prompt = "";
-            
-            if (!node->children.empty()) {
-                std::string literal = node->children[0]->value;
-                if (literal.length() >= 2 && literal[0] == '"' && literal[literal.length()-1] == '"') {
-                    prompt = literal.substr(1, literal.length() - 2);
+    }
+
+    // Phi assignments for the edge from -> to, as parallel copies.
+    struct Copies {
+        std::vector<std::pair<const IRInstr*, const IRInstr*>> moves;   // phi, value
+        bool overlap = false;
+        bool empty() const { return moves.empty(); }
+    };
+    
+    static Copies edgeCopies(const IRBlock* from, const IRBlock* to) {
+        size_t idx = 0;
+        while (to->preds[idx] != from) idx++;
+        Copies c;
+        for (IRInstr* in : to->instrs) {
+            if (in->op != IR_PHI) break;
+            const IRInstr* arg = in->args[idx];
+            if (arg == in) continue;
+            if (arg->op == IR_PHI && arg->block == to) c.overlap = true;
+            c.moves.push_back({in, arg});
+        }
+        return c;
+    }
+    
+    static Operand phiValue(const IRInstr* phi, const IRInstr* arg) {
+        return cType(phi->type) == std::string("SigmaValue") ? boxed(arg) : raw(arg);
+    }
+    
+    void emitCopies(const Copies& c) {
+        if (!c.overlap) {
+            for (auto& m : c.moves) emit(var(m.first), " = ", phiValue(m.first, m.second), ";");
+            return;
+        }
+        // A phi of the target feeds another: read them all before writing.
+        emit("{");
+        for (size_t i = 0; i < c.moves.size(); i++) {
+            emit(cType(c.moves[i].first->type), " t", i, " = ", phiValue(c.moves[i].first, c.moves[i].second), ";");
+        }
+        for (size_t i = 0; i < c.moves.size(); i++) emit(var(c.moves[i].first), " = t", i, ";");
+        emit("}");
+    }
+    
+    void emitGoto(const Copies& copies, const IRBlock* to, const IRBlock* next) {
+        emitCopies(copies);
+        if (to != next) emit("goto b", to->id, ";");
+    }
+    
+    // Leaves the function with the pending error: the caller checks for it.
+    const char* unwind() const {
+        if (fn->kind == FN_MAIN) return "sigma_error_uncaught();";
+        if (fn->kind == FN_INIT) return "return;";
+        if (!fn->origin) return "return sigma_make_nil();";
+        switch (fn->returnType) {
+            case TY_INT: case TY_BOOL: return "return 0;";
+            case TY_DEC: return "return 0.0;";
+            default: return "return sigma_make_nil();";
+        }
+    }
+    
+    void putCheck(const IRInstr* in) {
+        put("sigma_check(sigma_source, ", SourceLine{in->line}, ")");
+    }
+    
+    // --- $match ---
+
+    // A perfect hash of string cases, over the hash every string carries:
+    // bucket b = h & (seeds.size() - 1) and slot
+    // ((h ^ seeds[b]) * SWITCH_MULTIPLIER) >> (64 - bits), distinct for
+    // distinct hashes. The seeds are found bucket by bucket, largest first
+    // ("hash, displace and compress"). Strings whose hashes are equal share
+    // a slot and are told apart by comparing them.
+    static constexpr uint64_t SWITCH_MULTIPLIER = 0x9e3779b97f4a7c15ULL;
+
+    struct StringSwitch {
+        int bits = 0;
+        std::vector<uint32_t> seeds;
+        std::map<uint64_t, std::vector<const IRCase*>> slots;
+    };
+
+    static uint64_t switchSlot(uint64_t h, uint32_t seed, int bits) {
+        return bits ? ((h ^ seed) * SWITCH_MULTIPLIER) >> (64 - bits) : 0;
+    }
+
+    static StringSwitch stringSwitch(const std::vector<const IRCase*>& cases) {
+        std::map<uint64_t, std::vector<const IRCase*>> byHash;
+        for (const IRCase* c : cases) byHash[hashBytes(c->str)].push_back(c);
+        size_t n = byHash.size();
+        StringSwitch s;
+        while (((size_t)1 << s.bits) < n) s.bits++;
+        size_t buckets = 1;
+        while (buckets * 4 < n) buckets *= 2;
+        for (;; s.bits++) {
+            std::vector<std::vector<uint64_t>> members(buckets);
+            for (auto& entry : byHash) members[entry.first & (buckets - 1)].push_back(entry.first);
+            std::vector<size_t> order(buckets);
+            for (size_t b = 0; b < buckets; b++) order[b] = b;
+            std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return members[x].size() > members[y].size(); });
+            std::vector<bool> taken((size_t)1 << s.bits);
+            s.seeds.assign(buckets, 0);
+            bool placed = true;
+            for (size_t b : order) {
+                placed = false;
+                for (uint32_t seed = 0; seed < 65536 && !placed; seed++) {
+                    std::vector<uint64_t> slots;
+                    for (uint64_t h : members[b]) {
+                        uint64_t slot = switchSlot(h, seed, s.bits);
+                        if (taken[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end()) break;
+                        slots.push_back(slot);
+                    }
+                    if (slots.size() < members[b].size()) continue;
+                    for (uint64_t slot : slots) taken[slot] = true;
+                    s.seeds[b] = seed;
+                    placed = true;
                 }
+                if (!placed) break;
             }
-            
-            emit("SigmaValue " + varName + " = sigma_input(\"" + prompt + "\");");
+            if (!placed) continue;
+            for (auto& entry : byHash) {
+                uint64_t h = entry.first;
+                s.slots[switchSlot(h, s.seeds[h & (buckets - 1)], s.bits)] = entry.second;
+            }
+            return s;
         }
-        
-        if (node->type == NODE_VAR_DECL) {
-            bool isConstant = node->value.find("$fixed_") == 0;
-            std::string varName = node->value;
-            
-            if (isConstant) {
-                constants.insert(varName);
+    }
+
+    // Cases, grouped by the arm they lead to: `case 1: case 2: goto b4;`.
+    void emitCases(const IRInstr* sw, bool strings, const std::vector<Copies>& copies) {
+        for (size_t a = 0; a + 1 < sw->arms.size(); a++) {
+            bool any = false;
+            for (const IRCase& c : sw->cases) {
+                if (c.arm != a || (c.type == TY_STR) != strings) continue;
+                out << "  case ";
+                putInt(c.num);
+                out << ":\n";
+                any = true;
             }
-            
-            std::string value = genExpr(node->children[0].get());
-            emit("SigmaValue " + varName + " = " + value + ";");
+            if (any) emitGoto(copies[a], sw->arms[a], nullptr);
         }
-        
-        if (node->type == NODE_ASSIGNMENT) {
-            std::string varName = node->children[0]->value;
-            
-            if (constants.count(varName) > 0) {
-                emit("sigma_error(\"Cannot reassign constant variable: " + varName + "\");");
-                emit("exit(1);");
-                return;
+    }
+
+    // IR_SWITCH. Ints are a C switch, which the C compiler turns into a
+    // jump table when they are dense. Strings are a switch on their
+    // perfect-hash slot followed by one comparison. A dec with an integer
+    // value matches the int cases, as it would compare equal to them.
+    void emitSwitch(const IRInstr* in, const IRBlock* next) {
+        const IRInstr* v = in->args[0];
+        std::vector<Copies> copies;
+        for (const IRBlock* arm : in->arms) copies.push_back(edgeCopies(in->block, arm));
+        std::vector<const IRCase*> ints, strs;
+        for (const IRCase& c : in->cases) (c.type == TY_INT ? ints : strs).push_back(&c);
+        bool number = v->type == TY_INT || v->type == TY_DEC || v->type == TY_NUM || v->type == TY_ANY;
+        bool string = v->type == TY_STR || v->type == TY_ANY;
+
+        if (!ints.empty() && number) {
+            if (v->type == TY_INT) {
+                emit("switch (", raw(v), ") {");
+            } else {
+                emit("int64_t ", var(in), "_int;");
+                emit("if (sigma_match_int(", boxed(v), ", &", var(in), "_int)) switch (", var(in), "_int) {");
             }
-            
-            if (node->children[0]->type == NODE_MEMBER_ACCESS) {
-                std::string obj = genExpr(node->children[0]->children[0].get());
-                std::string member = node->children[0]->children[1]->value;
-                std::string value = genExpr(node->children[1].get());
-                emit("sigma_object_set(" + obj + ", \"" + member + "\", " + value + ");");
-            } else if (node->children[0]->type == NODE_INDEX_ACCESS) {
-                std::string arr = genExpr(node->children[0]->children[0].get());
-                std::string idx = genExpr(node->children[0]->children[1].get());
-                std::string value = genExpr(node->children[1].get());
-                emit("sigma_array_set(" + arr + ", " + idx + ", " + value + ");");
+            emitCases(in, false, copies);
+            emit("}");
+        }
+        if (!strs.empty() && string) {
+            StringSwitch s = stringSwitch(strs);
+            Operand h = var(in);
+            if (v->type != TY_STR) emit("if (", boxed(v), ".type == TYPE_STRING) {");
+            else emit("{");
+            emit("const SigmaString* ", h, "_str = sigma_str_header(", raw(v), ".as.string);");
+            if (s.bits == 0) {
+                emit("{");
+            } else if (s.seeds.size() == 1) {
+                emit("switch (((", h, "_str->hash ^ ", (size_t)s.seeds[0], "u) * ", SWITCH_MULTIPLIER, "ULL) >> ", 64 - s.bits, ") {");
             } else {
-                std::string value = genExpr(node->children[1].get());
-                emit(varName + " = " + value + ";");
+                out << "  static const uint32_t " << 'v' << in->id << "_seeds[" << s.seeds.size() << "] = {";
+                for (size_t i = 0; i < s.seeds.size(); i++) out << (i ? ", " : "") << s.seeds[i];
+                out << "};\n";
+                emit("switch (((", h, "_str->hash ^ ", h, "_seeds[", h, "_str->hash & ", s.seeds.size() - 1, "]) * ",
+                     SWITCH_MULTIPLIER, "ULL) >> ", 64 - s.bits, ") {");
+            }
+            for (auto& [slot, cases] : s.slots) {
+                if (s.bits) emit("case ", (size_t)slot, ":");
+                for (const IRCase* c : cases) {
+                    emit("if (", h, "_str->hash == ", hashBytes(c->str), "ULL && ", h, "_str->len == ", c->str.size(),
+                         " && memcmp(", h, "_str->chars, \"", Escaped{c->str}, "\", ", c->str.size(), ") == 0) {");
+                    emitGoto(copies[c->arm], in->arms[c->arm], nullptr);
+                    emit("}");
+                }
+                if (s.bits) emit("break;");
             }
+            emit("}");
+            emit("}");
         }
-        
-        if (node->type == NODE_YAP) {
-            std::string expr = genExpr(node->children[0].get());
-            emit("sigma_print(" + expr + ");");
+        emitGoto(copies.back(), in->arms.back(), next);
+    }
+
+    void emitTerminator(const IRInstr* in, const IRBlock* next) {
+        const IRBlock* block = in->block;
+        if (in->op == IR_RETURN) {
+            if (fn->kind == FN_SIGMA && fn->origin) emit("return ", as(in->args[0], fn->returnType), ";");
+            else if (fn->kind == FN_SIGMA) emit("return ", boxed(in->args[0]), ";");
+            else if (fn->kind == FN_MAIN) emit("return 0;");
+            else emit("return;");
+            return;
         }
-        
-        if (node->type == NODE_RETURN) {
-            emit("return " + genExpr(node->children[0].get()) + ";");
+        if (in->op == IR_JUMP) {
+            emitGoto(edgeCopies(block, in->targets[0]), in->targets[0], next);
+            return;
         }
-        
-        if (node->type == NODE_IF) {
-            emit("if (sigma_is_truthy(" + genExpr(node->children[0].get()) + ")) {");
-            indent++;
-            if (node->children[1]->type == NODE_BLOCK) {
-                for (auto& child : node->children[1]->children) genStmt(child.get());
-            } else {
-                genStmt(node->children[1].get());
+        if (in->op == IR_SWITCH) {
+            emitSwitch(in, next);
+            return;
+        }
+        // IR_CHECK: "true" is an error, into the handler.
+        bool isCheck = in->op == IR_CHECK;
+        const IRBlock* t = in->targets[isCheck ? 1 : 0];
+        const IRBlock* f = in->targets[isCheck ? 0 : 1];
+        Copies tCopies = edgeCopies(block, t);
+        Copies fCopies = edgeCopies(block, f);
+        bool negate = t == next && tCopies.empty();
+        out << (negate ? "  if (!" : "  if (");
+        if (isCheck) putCheck(in);
+        else put(truth(in->args[0]));
+        out << ") {\n";
+        if (negate) {
+            emitGoto(fCopies, f, nullptr);
+            emit("}");
+            return;
+        }
+        emitGoto(tCopies, t, nullptr);
+        emit("}");
+        emitGoto(fCopies, f, next);
+    }
+    
+    void emitInstr(const IRInstr* in) {
+        if (fixedOnly.count(in)) return;
+        if (memStats && in->line && in->line != line) {
+            emit("sigma_mem_at(sigma_source, ", SourceLine{in->line}, ");");
+            line = in->line;
+        }
+        switch (in->op) {
+            case IR_PHI:
+                break;
+            case IR_ARRAY:
+            case IR_OBJECT:
+                emitLiteral(in);
+                break;
+            case IR_SET:
+                emit("sigma_object_set(", boxed(in->args[0]), ", \"", in->name, "\", ", boxed(in->args[1]), ");");
+                break;
+            case IR_SET_INDEX: {
+                const IRInstr* arr = in->args[0];
+                const char* typed = typedAccessor(arr->type);
+                if (typed && in->args[1]->type == TY_INT && storesUnboxed(arr->type, in->args[2]->type)) {
+                    emit(typed, "_set(", boxed(arr), ", ", raw(in->args[1]), ", ", elemValue(arr, in->args[2]), ");");
+                    break;
+                }
+                out << "  ";
+                putCall(arr->type == TY_DICT ? "sigma_dict_set" : "sigma_array_set", in);
+                out << ";\n";
+                break;
             }
-            indent--;
-            
-            for (size_t i = 2; i < node->children.size(); i++) {
-                emit("} else {");
-                indent++;
-                if (node->children[i]->type == NODE_BLOCK) {
-                    for (auto& child : node->children[i]->children) genStmt(child.get());
-                } else {
-                    genStmt(node->children[i].get());
+            case IR_SET_ELEM: {
+                const IRInstr* arr = in->args[0];
+                if (const char* typed = typedAccessor(arr->type)) {
+                    if (!storesUnboxed(arr->type, in->args[2]->type)) {
+                        emit("sigma_array_set(", boxed(arr), ", ", boxed(in->args[1]), ", ", boxed(in->args[2]), ");");
+                    } else if (arr->type == TY_U8ARR) {
+                        emit("sigma_u8_put(", boxed(arr), ", ", raw(in->args[1]), ", ", raw(in->args[2]), ");");
+                    } else {
+                        emit(typed, "_data(", boxed(arr), ")[", raw(in->args[1]), "] = ", elemValue(arr, in->args[2]), ";");
+                    }
+                    break;
+                }
+                if (in->args.size() < 4) {
+                    emit("sigma_array_put(", boxed(arr), ", ", raw(in->args[1]), ", ", boxed(in->args[2]), ");");
+                    break;
                 }
-                indent--;
+                emit("if (", raw(in->args[3]), ") sigma_array_put(", boxed(arr), ", ", raw(in->args[1]), ", ", boxed(in->args[2]), ");");
+                emit("else sigma_array_set(", boxed(arr), ", ", boxed(in->args[1]), ", ", boxed(in->args[2]), ");");
+                break;
             }
-            emit("}");
+            case IR_PRINT:
+                out << "  ";
+                putCall("sigma_print", in);
+                out << ";\n";
+                break;
+            case IR_SPAWN: {
+                Operand v = var(in);
+                size_t n = in->args.size();
+                for (size_t i = 0; i < n; i++) emit(v, "_vals[", i, "] = ", boxed(in->args[i]), ";");
+                if (n) emit("sigma_spawn((void*)", in->name, ", ", n, ", ", v, "_vals);");
+                else emit("sigma_spawn((void*)", in->name, ", 0, NULL);");
+                break;
+            }
+            default:
+                out << "  ";
+                put(var(in), " = ");
+                putExpr(in);
+                out << ";\n";
+                break;
+        }
+        if (in->op == IR_CALL) line = -1;
+        if (irMayFail(in) && !irChecked(in)) {
+            out << "  if (";
+            putCheck(in);
+            put(") ", unwind(), "\n");
+        }
+    }
+    
+    // Generic functions keep the SigmaValue ABI of the module header;
+    // specializations are static and use C types for their typed values.
+    void putSignature(const IRFunction& f) {
+        if (f.origin) put("static ", cType(f.returnType), " ");
+        else put("SigmaValue ");
+        put(f.name, "(");
+        if (f.params.empty()) put("void");
+        for (size_t i = 0; i < f.params.size(); i++) {
+            if (i) put(", ");
+            put(f.origin ? cType(f.paramValues[i]->type) : "SigmaValue", " a", i);
+        }
+        put(")");
+    }
+    
+    void emitFunction(const IRFunction& f) {
+        fn = &f;
+        if (f.kind == FN_MAIN) {
+            out << "int main() {\n";
+        } else if (f.kind == FN_INIT) {
+            out << "void " << f.name << "(void) {\n";
+        } else {
+            putSignature(f);
+            out << " {\n";
         }
         
-        if (node->type == NODE_FOR) {
-            std::string initVar = node->children[0]->value;
-            std::string initVal = genExpr(node->children[0]->children[0].get());
-            std::string cond = genExpr(node->children[1].get());
-            std::string incVar = node->children[2]->children[0]->value;
-            
-            emit("for (SigmaValue " + initVar + " = " + initVal + "; " + 
-                 "sigma_is_truthy(" + cond + "); " + incVar + " = sigma_add(" + incVar + ", sigma_make_number(1))) {");
-            indent++;
-            if (node->children[3]->type == NODE_BLOCK) {
-                for (auto& child : node->children[3]->children) genStmt(child.get());
-            } else {
-                genStmt(node->children[3].get());
+        std::set<const IRBlock*> targets;
+        for (size_t i = 0; i < f.blocks.size(); i++) {
+            const IRBlock* next = i + 1 < f.blocks.size() ? f.blocks[i + 1].get() : nullptr;
+            for (IRBlock* s : f.blocks[i]->succs()) {
+                if (s != next || f.blocks[i]->terminator()->op != IR_JUMP) targets.insert(s);
+            }
+            for (IRInstr* in : f.blocks[i]->instrs) {
+                if (fixedOnly.count(in)) continue;
+                if (const char* type = cType(in->type)) emit(type, " ", var(in), ";");
+                if (in->op == IR_ARRAY || in->op == IR_OBJECT) declareLiteral(in);
+                if (in->op == IR_SPAWN && !in->args.empty()) emit("SigmaValue ", var(in), "_vals[", in->args.size(), "];");
             }
-            indent--;
-            emit("}");
         }
-        
-        if (node->type == NODE_WHILE) {
-            emit("while (sigma_is_truthy(" + genExpr(node->children[0].get()) + ")) {");
-            indent++;
-            if (node->children[1]->type == NODE_BLOCK) {
-                for (auto& child : node->children[1]->children) genStmt(child.get());
-            } else {
-                genStmt(node->children[1].get());
+        if (f.kind == FN_MAIN) {
+            for (auto& dep : mod->initOrder) {
+                emit("sigma_init_", dep, "();");
+                emit("if (sigma_failed) sigma_error_uncaught();");
             }
-            indent--;
-            emit("}");
         }
         
-        if (node->type == NODE_TRY_CATCH) {
-            emit("if (1) {");
-            indent++;
-            for (auto& stmt : node->children[0]->children) {
-                genStmt(stmt.get());
+        for (size_t i = 0; i < f.blocks.size(); i++) {
+            const IRBlock* block = f.blocks[i].get();
+            const IRBlock* next = i + 1 < f.blocks.size() ? f.blocks[i + 1].get() : nullptr;
+            if (targets.count(block)) out << 'b' << block->id << ":;\n";
+            line = -1;
+            for (IRInstr* in : block->instrs) {
+                if (irIsTerminator(in->op)) emitTerminator(in, next);
+                else emitInstr(in);
             }
-            indent--;
-            emit("}");
-            
-            if (node->children.size() > 1) {
-                std::string errorVar = node->children[1]->value;
-                emit("if (0) {");
-                indent++;
-                emit("SigmaValue " + errorVar + " = sigma_make_string(\"Error\");");
-                for (auto& stmt : node->children[1]->children) {
-                    genStmt(stmt.get());
+        }
+        out << "}\n";
+    }
+    
+    // About how much C a unit produces, so the buffer is allocated once.
+    static size_t estimate(const std::vector<const IRFunction*>& fns) {
+        size_t instrs = 0;
+        for (const IRFunction* f : fns) {
+            for (auto& block : f->blocks) instrs += block->instrs.size();
+        }
+        return 4096 + instrs * 96;
+    }
+    
+    // Shards declare just the functions they call rather than include the
+    // module headers, which change whenever a function is added.
+    void declareCallees(const std::vector<const IRFunction*>& fns) {
+        std::map<std::string, size_t> callees;
+        for (const IRFunction* f : fns) {
+            for (auto& block : f->blocks) {
+                for (IRInstr* in : block->instrs) {
+                    if ((in->op == IR_CALL && !(in->callee && in->callee->origin)) || in->op == IR_SPAWN) {
+                        callees[in->name] = in->args.size();
+                    }
                 }
-                indent--;
-                emit("}");
             }
         }
-        
-        if (node->type == NODE_FUNC_DECL) {
-            emit("SigmaValue " + node->value + "(");
-            
-            size_t paramCount = node->children.size() - 1;
-            for (size_t i = 0; i < paramCount; i++) {
-                code << "SigmaValue " << node->children[i]->value;
-                if (i < paramCount - 1) code << ", ";
-            }
-            code << ") {\n";
-            indent++;
-            for (auto& stmt : node->children.back()->children) {
-                genStmt(stmt.get());
+        bool main = fns.back()->kind == FN_MAIN && !mod->initOrder.empty();
+        if (callees.empty() && !main) return;
+        out << "\n";
+        for (auto& [name, arity] : callees) {
+            out << "SigmaValue " << name << "(";
+            for (size_t i = 0; i < arity; i++) out << (i ? ", SigmaValue" : "SigmaValue");
+            out << (arity ? ");\n" : "void);\n");
+        }
+        if (main) {
+            for (auto& dep : mod->initOrder) out << "void sigma_init_" << dep << "(void);\n";
+        }
+    }
+    
+    // A translation unit holding `fns`, with the string table and static
+    // data they use.
+    void emitUnit(const std::vector<const IRFunction*>& fns, const ModuleInfo& info) {
+        mod = &info;
+        out.reserve(estimate(fns));
+        out << "#include \"sigma_rt.h\"\n";
+        if (linesTable.empty()) {
+            out << "#include \"" << info.id << ".h\"\n";
+            for (auto& dep : info.imports) out << "#include \"" << dep << ".h\"\n";
+            // main also runs the modules it only reaches through others.
+            for (auto& dep : info.initOrder) {
+                if (std::find(info.imports.begin(), info.imports.end(), dep) == info.imports.end()) {
+                    out << "void sigma_init_" << dep << "(void);\n";
+                }
             }
-            emit("return sigma_make_nil();");
-            indent--;
-            emit("}");
+        } else {
+            declareCallees(fns);
         }
-        
-        if (node->type == NODE_UNARY_OP) {
-            if (node->value == "++") {
-                emit(node->children[0]->value + " = sigma_add(" + node->children[0]->value + ", sigma_make_number(1));");
-            } else if (node->value == "--") {
-                emit(node->children[0]->value + " = sigma_subtract(" + node->children[0]->value + ", sigma_make_number(1));");
+        out << "\n";
+        // For error locations and --mem-stats.
+        put("static const char sigma_source[] __attribute__((unused)) = \"", Escaped{info.file}, "\";\n");
+        if (!linesTable.empty()) put("extern const int ", linesTable, "[];\n");
+        out << "\n";
+        collectFixed(fns);
+        std::vector<const std::string*> literals;
+        for (const IRFunction* f : fns) {
+            for (auto& block : f->blocks) {
+                for (IRInstr* in : block->instrs) {
+                    if (in->op == IR_STR && !fixedOnly.count(in) && strings.emplace(in->name, literals.size()).second) literals.push_back(&in->name);
+                }
             }
         }
-        
-        if (node->type == NODE_FUNC_CALL) {
-            std::string call = node->value + "(";
-            for (size_t i = 0; i < node->children.size(); i++) {
-                call += genExpr(node->children[i].get());
-                if (i < node->children.size() - 1) call += ", ";
+        if (!literals.empty()) {
+            out << "static SigmaValue sigma_strings[" << literals.size() << "];\n";
+            out << "__attribute__((constructor)) static void sigma_intern_strings(void) {\n";
+            for (size_t i = 0; i < literals.size(); i++) emit("sigma_strings[", i, "] = sigma_intern(\"", Escaped{*literals[i]}, "\");");
+            out << "}\n\n";
+        }
+        for (const IRFunction* f : fns) {
+            for (auto& block : f->blocks) {
+                for (IRInstr* in : block->instrs) {
+                    if (fixedData.count(in)) emitFixed(in);
+                }
             }
-            call += ");";
-            emit(call);
         }
+        if (!fixedData.empty()) out << "\n";
+        for (const IRFunction* f : fns) {
+            if (!f->origin) continue;
+            putSignature(*f);
+            out << ";\n";
+        }
+        for (const IRFunction* f : fns) emitFunction(*f);
     }
     
 public:
-    std::string generate(ASTNode* root) {
-        code << "#include <stdio.h>\n";
-        code << "#include <stdlib.h>\n";
-        code << "#include <string.h>\n";
-        code << "#include <math.h>\n";
-        code << "#include <time.h>\n\n";
-        
-        // Type definitions
-        code << "typedef enum {\n";
-        code << "  TYPE_NIL,\n";
-        code << "  TYPE_NUMBER,\n";
-        code << "  TYPE_STRING,\n";
-        code << "  TYPE_BOOL,\n";
-        code << "  TYPE_ARRAY,\n";
-        code << "  TYPE_OBJECT\n";
-        code << "} SigmaType;\n\n";
-        
-        code << "typedef struct {\n";
-        code << "  void** items;\n";
-        code << "  int size;\n";
-        code << "  int capacity;\n";
-        code << "} SigmaArray;\n\n";
-        
-        code << "typedef struct {\n";
-        code << "  char** keys;\n";
-        code << "  void** values;\n";
-        code << "  int size;\n";
-        code << "  int capacity;\n";
-        code << "} SigmaObject;\n\n";
-        
-        code << "typedef struct SigmaValue {\n";
-        code << "  SigmaType type;\n";
-        code << "  union {\n";
-        code << "    double number;\n";
-        code << "    char* string;\n";
-        code << "    int boolean;\n";
-        code << "    SigmaArray* array;\n";
-        code << "    SigmaObject* object;\n";
-        code << "  } as;\n";
-        code << "} SigmaValue;\n\n";
-        
-        // Forward declarations
-        code << "SigmaValue sigma_make_nil();\n";
-        code << "SigmaValue sigma_make_number(double n);\n";
-        code << "SigmaValue sigma_make_bool(int b);\n";
-        code << "SigmaValue sigma_make_string(const char* s);\n";
-        code << "SigmaValue sigma_make_literal(const char* literal);\n";
-        code << "int sigma_is_truthy(SigmaValue v);\n";
-        code << "void sigma_print(SigmaValue v);\n";
-        code << "void sigma_error(const char* msg);\n";
-        code << "SigmaValue sigma_input(const char* prompt);\n";
-        code << "SigmaValue sigma_type_of(SigmaValue v);\n";
-        code << "SigmaValue sigma_to_int(SigmaValue v);\n";
-        code << "SigmaValue sigma_to_dec(SigmaValue v);\n";
-        code << "SigmaValue sigma_to_str(SigmaValue v);\n";
-        code << "SigmaValue sigma_random(SigmaValue digits);\n";
-        code << "SigmaValue sigma_random_range(SigmaValue min, SigmaValue max);\n\n";
-        
-        // Basic functions
-        code << "void sigma_error(const char* msg) {\n";
-        code << "  fprintf(stderr, \"Error: %s\\n\", msg);\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_make_nil() {\n";
-        code << "  SigmaValue v; v.type = TYPE_NIL; return v;\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_make_number(double n) {\n";
-        code << "  SigmaValue v; v.type = TYPE_NUMBER; v.as.number = n; return v;\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_make_bool(int b) {\n";
-        code << "  SigmaValue v; v.type = TYPE_BOOL; v.as.boolean = b; return v;\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_make_string(const char* s) {\n";
-        code << "  SigmaValue v; v.type = TYPE_STRING;\n";
-        code << "  v.as.string = malloc(strlen(s) + 1);\n";
-        code << "  strcpy(v.as.string, s);\n";
-        code << "  return v;\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_make_literal(const char* literal) {\n";
-        code << "  if (literal[0] == '\"') {\n";
-        code << "    char* str = malloc(strlen(literal) - 1);\n";
-        code << "    strncpy(str, literal + 1, strlen(literal) - 2);\n";
-        code << "    str[strlen(literal) - 2] = '\\0';\n";
-        code << "    return sigma_make_string(str);\n";
-        code << "  } else if (strcmp(literal, \"true\") == 0) {\n";
-        code << "    return sigma_make_bool(1);\n";
-        code << "  } else if (strcmp(literal, \"false\") == 0) {\n";
-        code << "    return sigma_make_bool(0);\n";
-        code << "  } else {\n";
-        code << "    return sigma_make_number(atof(literal));\n";
-        code << "  }\n";
-        code << "}\n\n";
-        
-        // Input function
-        code << "SigmaValue sigma_input(const char* prompt) {\n";
-        code << "  if (prompt && strlen(prompt) > 0) {\n";
-        code << "    printf(\"%s\", prompt);\n";
-        code << "    fflush(stdout);\n";
-        code << "  }\n";
-        code << "  char buffer[1024];\n";
-        code << "  if (fgets(buffer, sizeof(buffer), stdin) == NULL) {\n";
-        code << "    return sigma_make_string(\"\");\n";
-        code << "  }\n";
-        code << "  size_t len = strlen(buffer);\n";
-        code << "  if (len > 0 && buffer[len-1] == '\\n') {\n";
-        code << "    buffer[len-1] = '\\0';\n";
-        code << "  }\n";
-        code << "  return sigma_make_string(buffer);\n";
-        code << "}\n\n";
-        
-        // Type function
-        code << "SigmaValue sigma_type_of(SigmaValue v) {\n";
-        code << "  switch (v.type) {\n";
-        code << "    case TYPE_NIL: return sigma_make_string(\"nil\");\n";
-        code << "    case TYPE_NUMBER: {\n";
-        code << "      if (v.as.number == floor(v.as.number)) {\n";
-        code << "        return sigma_make_string(\"int\");\n";
-        code << "      } else {\n";
-        code << "        return sigma_make_string(\"dec\");\n";
-        code << "      }\n";
-        code << "    }\n";
-        code << "    case TYPE_STRING: return sigma_make_string(\"str\");\n";
-        code << "    case TYPE_BOOL: return sigma_make_string(\"bool\");\n";
-        code << "    case TYPE_ARRAY: return sigma_make_string(\"arr\");\n";
-        code << "    case TYPE_OBJECT: return sigma_make_string(\"obj\");\n";
-        code << "    default: return sigma_make_string(\"unknown\");\n";
-        code << "  }\n";
-        code << "}\n\n";
-        
-        // Type conversion functions
-        code << "SigmaValue sigma_to_int(SigmaValue v) {\n";
-        code << "  switch (v.type) {\n";
-        code << "    case TYPE_NUMBER:\n";
-        code << "      return sigma_make_number(floor(v.as.number));\n";
-        code << "    case TYPE_STRING: {\n";
-        code << "      double num = atof(v.as.string);\n";
-        code << "      return sigma_make_number(floor(num));\n";
-        code << "    }\n";
-        code << "    case TYPE_BOOL:\n";
-        code << "      return sigma_make_number(v.as.boolean ? 1.0 : 0.0);\n";
-        code << "    default:\n";
-        code << "      return sigma_make_number(0.0);\n";
-        code << "  }\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_to_dec(SigmaValue v) {\n";
-        code << "  switch (v.type) {\n";
-        code << "    case TYPE_NUMBER:\n";
-        code << "      return v;\n";
-        code << "    case TYPE_STRING:\n";
-        code << "      return sigma_make_number(atof(v.as.string));\n";
-        code << "    case TYPE_BOOL:\n";
-        code << "      return sigma_make_number(v.as.boolean ? 1.0 : 0.0);\n";
-        code << "    default:\n";
-        code << "      return sigma_make_number(0.0);\n";
-        code << "  }\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_to_str(SigmaValue v) {\n";
-        code << "  char buffer[64];\n";
-        code << "  switch (v.type) {\n";
-        code << "    case TYPE_NIL:\n";
-        code << "      return sigma_make_string(\"nil\");\n";
-        code << "    case TYPE_NUMBER:\n";
-        code << "      if (v.as.number == floor(v.as.number)) {\n";
-        code << "        sprintf(buffer, \"%.0f\", v.as.number);\n";
-        code << "      } else {\n";
-        code << "        sprintf(buffer, \"%g\", v.as.number);\n";
-        code << "      }\n";
-        code << "      return sigma_make_string(buffer);\n";
-        code << "    case TYPE_STRING:\n";
-        code << "      return v;\n";
-        code << "    case TYPE_BOOL:\n";
-        code << "      return sigma_make_string(v.as.boolean ? \"true\" : \"false\");\n";
-        code << "    case TYPE_ARRAY:\n";
-        code << "      return sigma_make_string(\"[array]\");\n";
-        code << "    case TYPE_OBJECT:\n";
-        code << "      return sigma_make_string(\"[object]\");\n";
-        code << "    default:\n";
-        code << "      return sigma_make_string(\"unknown\");\n";
-        code << "  }\n";
-        code << "}\n\n";
-        
-        // Random number functions
-        code << "SigmaValue sigma_random(SigmaValue digits) {\n";
-        code << "  static int seeded = 0;\n";
-        code << "  if (!seeded) {\n";
-        code << "    srand(time(NULL));\n";
-        code << "    seeded = 1;\n";
-        code << "  }\n";
-        code << "  int d = (int)digits.as.number;\n";
-        code << "  if (d <= 0) d = 1;\n";
-        code << "  if (d > 9) d = 9;\n";
-        code << "  int min = 1;\n";
-        code << "  int max = 9;\n";
-        code << "  for (int i = 1; i < d; i++) {\n";
-        code << "    min *= 10;\n";
-        code << "    max = max * 10 + 9;\n";
-        code << "  }\n";
-        code << "  int result = min + rand() % (max - min + 1);\n";
-        code << "  return sigma_make_number((double)result);\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_random_range(SigmaValue min_val, SigmaValue max_val) {\n";
-        code << "  static int seeded = 0;\n";
-        code << "  if (!seeded) {\n";
-        code << "    srand(time(NULL));\n";
-        code << "    seeded = 1;\n";
-        code << "  }\n";
-        code << "  int min = (int)min_val.as.number;\n";
-        code << "  int max = (int)max_val.as.number;\n";
-        code << "  if (min > max) {\n";
-        code << "    int temp = min;\n";
-        code << "    min = max;\n";
-        code << "    max = temp;\n";
-        code << "  }\n";
-        code << "  int result = min + rand() % (max - min + 1);\n";
-        code << "  return sigma_make_number((double)result);\n";
-        code << "}\n\n";
-        
-        // Array functions
-        code << "SigmaValue sigma_make_array() {\n";
-        code << "  SigmaValue v;\n";
-        code << "  v.type = TYPE_ARRAY;\n";
-        code << "  v.as.array = malloc(sizeof(SigmaArray));\n";
-        code << "  v.as.array->items = malloc(sizeof(void*) * 10);\n";
-        code << "  v.as.array->size = 0;\n";
-        code << "  v.as.array->capacity = 10;\n";
-        code << "  return v;\n";
-        code << "}\n\n";
-        
-        code << "void sigma_array_push(SigmaValue arr, SigmaValue val) {\n";
-        code << "  if (arr.type != TYPE_ARRAY) return;\n";
-        code << "  if (arr.as.array->size >= arr.as.array->capacity) {\n";
-        code << "    arr.as.array->capacity *= 2;\n";
-        code << "    arr.as.array->items = realloc(arr.as.array->items, sizeof(void*) * arr.as.array->capacity);\n";
-        code << "  }\n";
-        code << "  SigmaValue* newVal = malloc(sizeof(SigmaValue));\n";
-        code << "  *newVal = val;\n";
-        code << "  arr.as.array->items[arr.as.array->size++] = newVal;\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_array_get(SigmaValue arr, SigmaValue idx) {\n";
-        code << "  if (arr.type != TYPE_ARRAY || idx.type != TYPE_NUMBER) return sigma_make_nil();\n";
-        code << "  int i = (int)idx.as.number;\n";
-        code << "  if (i < 0 || i >= arr.as.array->size) return sigma_make_nil();\n";
-        code << "  return *(SigmaValue*)arr.as.array->items[i];\n";
-        code << "}\n\n";
-        
-        code << "void sigma_array_set(SigmaValue arr, SigmaValue idx, SigmaValue val) {\n";
-        code << "  if (arr.type != TYPE_ARRAY || idx.type != TYPE_NUMBER) return;\n";
-        code << "  int i = (int)idx.as.number;\n";
-        code << "  if (i < 0 || i >= arr.as.array->size) return;\n";
-        code << "  *(SigmaValue*)arr.as.array->items[i] = val;\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_array_sort(SigmaValue arr, SigmaValue order) {\n";
-        code << "  if (arr.type != TYPE_ARRAY) return arr;\n";
-        code << "  int ascending = 1;\n";
-        code << "  if (order.type == TYPE_STRING && strcmp(order.as.string, \"desc\") == 0) {\n";
-        code << "    ascending = 0;\n";
-        code << "  }\n";
-        code << "  for (int i = 0; i < arr.as.array->size - 1; i++) {\n";
-        code << "    for (int j = 0; j < arr.as.array->size - i - 1; j++) {\n";
-        code << "      SigmaValue* a = (SigmaValue*)arr.as.array->items[j];\n";
-        code << "      SigmaValue* b = (SigmaValue*)arr.as.array->items[j + 1];\n";
-        code << "      int shouldSwap = 0;\n";
-        code << "      if (ascending && a->type == TYPE_NUMBER && b->type == TYPE_NUMBER && a->as.number > b->as.number) shouldSwap = 1;\n";
-        code << "      if (!ascending && a->type == TYPE_NUMBER && b->type == TYPE_NUMBER && a->as.number < b->as.number) shouldSwap = 1;\n";
-        code << "      if (shouldSwap) {\n";
-        code << "        void* temp = arr.as.array->items[j];\n";
-        code << "        arr.as.array->items[j] = arr.as.array->items[j + 1];\n";
-        code << "        arr.as.array->items[j + 1] = temp;\n";
-        code << "      }\n";
-        code << "    }\n";
-        code << "  }\n";
-        code << "  return arr;\n";
-        code << "}\n\n";
-        
-        // Object functions
-        code << "SigmaValue sigma_make_object() {\n";
-        code << "  SigmaValue v;\n";
-        code << "  v.type = TYPE_OBJECT;\n";
-        code << "  v.as.object = malloc(sizeof(SigmaObject));\n";
-        code << "  v.as.object->keys = malloc(sizeof(char*) * 10);\n";
-        code << "  v.as.object->values = malloc(sizeof(void*) * 10);\n";
-        code << "  v.as.object->size = 0;\n";
-        code << "  v.as.object->capacity = 10;\n";
-        code << "  return v;\n";
-        code << "}\n\n";
-        
-        code << "void sigma_object_set(SigmaValue obj, const char* key, SigmaValue val) {\n";
-        code << "  if (obj.type != TYPE_OBJECT) return;\n";
-        code << "  for (int i = 0; i < obj.as.object->size; i++) {\n";
-        code << "    if (strcmp(obj.as.object->keys[i], key) == 0) {\n";
-        code << "      *(SigmaValue*)obj.as.object->values[i] = val;\n";
-        code << "      return;\n";
-        code << "    }\n";
-        code << "  }\n";
-        code << "  if (obj.as.object->size >= obj.as.object->capacity) {\n";
-        code << "    obj.as.object->capacity *= 2;\n";
-        code << "    obj.as.object->keys = realloc(obj.as.object->keys, sizeof(char*) * obj.as.object->capacity);\n";
-        code << "    obj.as.object->values = realloc(obj.as.object->values, sizeof(void*) * obj.as.object->capacity);\n";
-        code << "  }\n";
-        code << "  obj.as.object->keys[obj.as.object->size] = malloc(strlen(key) + 1);\n";
-        code << "  strcpy(obj.as.object->keys[obj.as.object->size], key);\n";
-        code << "  SigmaValue* newVal = malloc(sizeof(SigmaValue));\n";
-        code << "  *newVal = val;\n";
-        code << "  obj.as.object->values[obj.as.object->size++] = newVal;\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_object_get(SigmaValue obj, const char* key) {\n";
-        code << "  if (obj.type != TYPE_OBJECT) return sigma_make_nil();\n";
-        code << "  for (int i = 0; i < obj.as.object->size; i++) {\n";
-        code << "    if (strcmp(obj.as.object->keys[i], key) == 0) {\n";
-        code << "      return *(SigmaValue*)obj.as.object->values[i];\n";
-        code << "    }\n";
-        code << "  }\n";
-        code << "  return sigma_make_nil();\n";
-        code << "}\n\n";
-        
-        // Arithmetic operations
-        code << "SigmaValue sigma_add(SigmaValue a, SigmaValue b) {\n";
-        code << "  if (a.type == TYPE_STRING || b.type == TYPE_STRING) {\n";
-        code << "    char a_buf[64], b_buf[64];\n";
-        code << "    char* a_str = a_buf;\n";
-        code << "    char* b_str = b_buf;\n";
-        code << "    if (a.type == TYPE_STRING) {\n";
-        code << "      a_str = a.as.string;\n";
-        code << "    } else if (a.type == TYPE_NUMBER) {\n";
-        code << "      sprintf(a_buf, \"%g\", a.as.number);\n";
-        code << "    } else if (a.type == TYPE_BOOL) {\n";
-        code << "      strcpy(a_buf, a.as.boolean ? \"true\" : \"false\");\n";
-        code << "    } else {\n";
-        code << "      strcpy(a_buf, \"nil\");\n";
-        code << "    }\n";
-        code << "    if (b.type == TYPE_STRING) {\n";
-        code << "      b_str = b.as.string;\n";
-        code << "    } else if (b.type == TYPE_NUMBER) {\n";
-        code << "      sprintf(b_buf, \"%g\", b.as.number);\n";
-        code << "    } else if (b.type == TYPE_BOOL) {\n";
-        code << "      strcpy(b_buf, b.as.boolean ? \"true\" : \"false\");\n";
-        code << "    } else {\n";
-        code << "      strcpy(b_buf, \"nil\");\n";
-        code << "    }\n";
-        code << "    char* result = malloc(strlen(a_str) + strlen(b_str) + 1);\n";
-        code << "    strcpy(result, a_str);\n";
-        code << "    strcat(result, b_str);\n";
-        code << "    return sigma_make_string(result);\n";
-        code << "  }\n";
-        code << "  return sigma_make_number(a.as.number + b.as.number);\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_subtract(SigmaValue a, SigmaValue b) {\n";
-        code << "  return sigma_make_number(a.as.number - b.as.number);\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_multiply(SigmaValue a, SigmaValue b) {\n";
-        code << "  return sigma_make_number(a.as.number * b.as.number);\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_divide(SigmaValue a, SigmaValue b) {\n";
-        code << "  return sigma_make_number(a.as.number / b.as.number);\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_modulo(SigmaValue a, SigmaValue b) {\n";
-        code << "  return sigma_make_number(fmod(a.as.number, b.as.number));\n";
-        code << "}\n\n";
-        
-        // Comparison and logical operations
-        code << "SigmaValue sigma_equals(SigmaValue a, SigmaValue b) {\n";
-        code << "  if (a.type != b.type) return sigma_make_bool(0);\n";
-        code << "  if (a.type == TYPE_NUMBER) return sigma_make_bool(a.as.number == b.as.number);\n";
-        code << "  if (a.type == TYPE_STRING) return sigma_make_bool(strcmp(a.as.string, b.as.string) == 0);\n";
-        code << "  if (a.type == TYPE_BOOL) return sigma_make_bool(a.as.boolean == b.as.boolean);\n";
-        code << "  return sigma_make_bool(0);\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_strict_equals(SigmaValue a, SigmaValue b) {\n";
-        code << "  if (a.type != b.type) return sigma_make_bool(0);\n";
-        code << "  if (a.type == TYPE_NUMBER) return sigma_make_bool(a.as.number == b.as.number);\n";
-        code << "  if (a.type == TYPE_STRING) return sigma_make_bool(strcmp(a.as.string, b.as.string) == 0);\n";
-        code << "  if (a.type == TYPE_BOOL) return sigma_make_bool(a.as.boolean == b.as.boolean);\n";
-        code << "  return sigma_make_bool(0);\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_not_equals(SigmaValue a, SigmaValue b) {\n";
-        code << "  return sigma_make_bool(!sigma_is_truthy(sigma_equals(a, b)));\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_less_than(SigmaValue a, SigmaValue b) {\n";
-        code << "  return sigma_make_bool(a.as.number < b.as.number);\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_greater_than(SigmaValue a, SigmaValue b) {\n";
-        code << "  return sigma_make_bool(a.as.number > b.as.number);\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_less_equal(SigmaValue a, SigmaValue b) {\n";
-        code << "  return sigma_make_bool(a.as.number <= b.as.number);\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_greater_equal(SigmaValue a, SigmaValue b) {\n";
-        code << "  return sigma_make_bool(a.as.number >= b.as.number);\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_logical_and(SigmaValue a, SigmaValue b) {\n";
-        code << "  return sigma_make_bool(sigma_is_truthy(a) && sigma_is_truthy(b));\n";
-        code << "}\n\n";
-        
-        code << "SigmaValue sigma_logical_or(SigmaValue a, SigmaValue b) {\n";
-        code << "  return sigma_make_bool(sigma_is_truthy(a) || sigma_is_truthy(b));\n";
-        code << "}\n\n";
-        
-        // Truthiness and printing
-        code << "int sigma_is_truthy(SigmaValue v) {\n";
-        code << "  switch (v.type) {\n";
-        code << "    case TYPE_NIL: return 0;\n";
-        code << "    case TYPE_BOOL: return v.as.boolean;\n";
-        code << "    case TYPE_NUMBER: return v.as.number != 0;\n";
-        code << "    case TYPE_STRING: return strlen(v.as.string) > 0;\n";
-        code << "    default: return 1;\n";
-        code << "  }\n";
-        code << "}\n\n";
-        
-        code << "void sigma_print(SigmaValue v) {\n";
-        code << "  switch (v.type) {\n";
-        code << "    case TYPE_NIL: printf(\"nil\\n\"); break;\n";
-        code << "    case TYPE_NUMBER: {\n";
-        code << "      double num = v.as.number;\n";
-        code << "      if (num == floor(num)) {\n";
-        code << "        printf(\"%g\\n\", num);\n";
-        code << "      } else {\n";
-        code << "        printf(\"%.2f\\n\", num);\n";
-        code << "      }\n";
-        code << "      break;\n";
-        code << "    }\n";
-        code << "    case TYPE_STRING: printf(\"%s\\n\", v.as.string); break;\n";
-        code << "    case TYPE_BOOL: printf(\"%s\\n\", v.as.boolean ? \"true\" : \"false\"); break;\n";
-        code << "    case TYPE_ARRAY: {\n";
-        code << "      printf(\"[\");\n";
-        code << "      for (int i = 0; i < v.as.array->size; i++) {\n";
-        code << "        SigmaValue elem = *(SigmaValue*)v.as.array->items[i];\n";
-        code << "        if (elem.type == TYPE_NUMBER) printf(\"%g\", elem.as.number);\n";
-        code << "        else if (elem.type == TYPE_STRING) printf(\"\\\"%s\\\"\", elem.as.string);\n";
-        code << "        if (i < v.as.array->size - 1) printf(\", \");\n";
-        code << "      }\n";
-        code << "      printf(\"]\\n\");\n";
-        code << "      break;\n";
-        code << "    }\n";
-        code << "    case TYPE_OBJECT: printf(\"<object>\\n\"); break;\n";
-        code << "    default: printf(\"<unknown>\\n\"); break;\n";
-        code << "  }\n";
-        code << "}\n\n";
-        
-        // Generate functions
-        for (auto& child : root->children) {
-            if (child->type == NODE_FUNC_DECL) genStmt(child.get());
-        }
-        
-        // Main function
-        code << "int main() {\n";
-        indent++;
+    bool memStats = false;      // attribute runtime allocations to source lines
+    
+    // C source for one module: its functions plus either an init function
+    // (imported modules) or main() (the entry module).
+    std::string generate(const IRModule& ir, const ModuleInfo& info) {
+        std::vector<const IRFunction*> fns;
+        for (auto& f : ir.functions) fns.push_back(f.get());
+        emitUnit(fns, info);
+        return out.take();
+    }
+    
+    // sig watch: one of the small units a module is split into, so that an
+    // edit recompiles only the unit it touched. Specializations are static,
+    // so `fns` must include every function that calls one. Source lines are
+    // read from the array `table`, which another unit defines with the
+    // values left in `tableLines`: code that only moved keeps its C.
+    std::string generateShard(const std::vector<const IRFunction*>& fns, const ModuleInfo& info,
+                              const std::string& table, std::vector<int>& tableLines) {
+        linesTable = table;
+        emitUnit(fns, info);
+        tableLines = lines;
+        return out.take();
+    }
+    
+    // Prototypes for the module's functions and its init function.
+    static std::string generateHeader(ASTNode* root, const ModuleInfo& info) {
+        CodeBuffer h;
+        h << "#pragma once\n";
+        h << "#include \"sigma_rt.h\"\n\n";
         for (auto& child : root->children) {
-            if (child->type != NODE_FUNC_DECL) genStmt(child.get());
+            if (child->type != NODE_FUNC_DECL) continue;
+            h << "SigmaValue " << info.functions.at(child->value) << "(";
+            size_t paramCount = child->children.size() - 1;
+            if (paramCount == 0) h << "void";
+            for (size_t i = 0; i < paramCount; i++) {
+                h << "SigmaValue " << child->children[i]->value;
+                if (i < paramCount - 1) h << ", ";
+            }
+            h << ");\n";
         }
-        emit("return 0;");
-        indent--;
-        code << "}\n";
-        
-        return code.str();
+        if (!info.isMain) h << "void sigma_init_" << info.id << "(void);\n";
+        return h.take();
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,186 @@
+#include "../include/ast.h"
+#include <set>
+#include <string>
+#include <vector>
+
+// Escape analysis for array and object literals.
+//
+// A literal does not escape when nothing can refer to it after the C block it
+// is created in has ended: the end of its function, or of the current loop
+// iteration. Such literals are marked noEscape, and CodeGen places their
+// header and buffers in that block's stack frame instead of on the heap.
+//
+// Two shapes qualify:
+//   x: [..]            declares a new variable, and every later use of x in
+//                      its scope only reads or writes through it: x[i], x.f,
+//                      x[i]: v, x.f: v, yap(x), len(x), $for e $in x
+//   yap([..]), [..][i], {..}.f, $for e $in [..]
+//                      a literal used as a temporary inside a statement
+//
+// Any other mention of x counts as an escape, including returning it, passing
+// it to a function, storing it in another array or object, copying it into
+// another variable, and .sort() (which returns its receiver).
+class EscapeAnalysis {
+    // Larger literals stay on the heap so a big table in main() cannot
+    // overflow the stack.
+    static constexpr size_t MAX_STACK_ELEMENTS = 256;
+
+    std::vector<std::set<std::string>> scopes;
+
+    bool isDeclared(const std::string& name) {
+        for (auto& scope : scopes) {
+            if (scope.count(name)) return true;
+        }
+        return false;
+    }
+
+    static bool isLiteral(const ASTNode* node) {
+        return node->type == NODE_ARRAY || node->type == NODE_OBJECT;
+    }
+
+    static bool fitsOnStack(const ASTNode* node) {
+        if (node->children.empty() || node->children.size() > MAX_STACK_ELEMENTS) return false;
+        if (node->type == NODE_OBJECT) {
+            std::set<std::string> keys;
+            for (auto& pair : node->children) {
+                if (!keys.insert(pair->value).second) return false;
+            }
+        }
+        return true;
+    }
+
+    static bool isSortAccess(const ASTNode* node) {
+        return node->type == NODE_MEMBER_ACCESS && node->children[1]->value == "sort";
+    }
+
+    static bool isLenCall(const ASTNode* node) {
+        return node->type == NODE_FUNC_CALL && node->value == "len" && node->children.size() == 1;
+    }
+
+    // The collection of a $for ... $in, which only hands out its items.
+    static bool isIterated(const ASTNode* node, const ASTNode* parent) {
+        return parent->type == NODE_FOR_IN && parent->children[0].get() == node;
+    }
+
+    // Whether every mention of `name` under `node` only goes through it.
+    static bool usesAreSafe(const ASTNode* node, const ASTNode* parent, const std::string& name) {
+        if (node->type == NODE_IDENT && node->value == name) {
+            if (!parent) return false;
+            if (parent->type == NODE_INDEX_ACCESS && parent->children[0].get() == node) return true;
+            if (parent->type == NODE_MEMBER_ACCESS && parent->children[0].get() == node) return !isSortAccess(parent);
+            return parent->type == NODE_YAP || isLenCall(parent) || isIterated(node, parent);
+        }
+        for (auto& child : node->children) {
+            if (!usesAreSafe(child.get(), node, name)) return false;
+        }
+        return true;
+    }
+
+    // Literals that are only read through within a single statement.
+    void markTemporaries(ASTNode* node, ASTNode* parent) {
+        if (isLiteral(node) && parent && fitsOnStack(node)) {
+            bool receiver = (parent->type == NODE_INDEX_ACCESS || parent->type == NODE_MEMBER_ACCESS) &&
+                            parent->children[0].get() == node && !isSortAccess(parent);
+            if (receiver || parent->type == NODE_YAP || isLenCall(parent) || isIterated(node, parent)) node->noEscape = true;
+        }
+        for (auto& child : node->children) markTemporaries(child.get(), node);
+    }
+
+    void visitBlock(std::vector<std::unique_ptr<ASTNode>>& stmts, size_t begin = 0) {
+        for (size_t i = begin; i < stmts.size(); i++) visitStmt(stmts, i);
+    }
+
+    void visitBody(ASTNode* node) {
+        scopes.emplace_back();
+        if (node->type == NODE_BLOCK) {
+            visitBlock(node->children);
+        } else {
+            std::vector<std::unique_ptr<ASTNode>> single;
+            single.push_back(std::unique_ptr<ASTNode>(node));
+            visitBlock(single);
+            single[0].release();
+        }
+        scopes.pop_back();
+    }
+
+    void visitStmt(std::vector<std::unique_ptr<ASTNode>>& stmts, size_t i) {
+        ASTNode* node = stmts[i].get();
+        switch (node->type) {
+            case NODE_VAR_DECL: {
+                ASTNode* init = node->children[0].get();
+                bool fresh = !isDeclared(node->value);
+                if (fresh) scopes.back().insert(node->value);
+                if (fresh && isLiteral(init) && fitsOnStack(init)) {
+                    bool safe = true;
+                    for (size_t j = i + 1; j < stmts.size() && safe; j++) {
+                        safe = usesAreSafe(stmts[j].get(), nullptr, node->value);
+                    }
+                    init->noEscape = safe;
+                }
+                for (auto& child : init->children) markTemporaries(child.get(), init);
+                break;
+            }
+            case NODE_ASSIGNMENT:
+            case NODE_YAP:
+            case NODE_RETURN:
+            case NODE_FUNC_CALL:
+                for (auto& child : node->children) markTemporaries(child.get(), node);
+                break;
+            case NODE_INPUT:
+                scopes.back().insert(node->value);
+                break;
+            case NODE_IF:
+                markTemporaries(node->children[0].get(), node);
+                for (size_t b = 1; b < node->children.size(); b++) visitBody(node->children[b].get());
+                break;
+            case NODE_FOR:
+                // The header is re-evaluated every iteration, so only the
+                // body is analysed.
+                scopes.push_back({node->children[0]->value});
+                visitBody(node->children[3].get());
+                scopes.pop_back();
+                break;
+            case NODE_WHILE:
+                visitBody(node->children[1].get());
+                break;
+            case NODE_FOR_IN:
+                markTemporaries(node->children[0].get(), node);
+                scopes.push_back({node->value});
+                visitBody(node->children[1].get());
+                scopes.pop_back();
+                break;
+            case NODE_MATCH:
+                markTemporaries(node->children[0].get(), node);
+                for (size_t a = 1; a < node->children.size(); a++) visitBody(node->children[a]->children.back().get());
+                break;
+            case NODE_TRY_CATCH:
+                visitBody(node->children[0].get());
+                if (node->children.size() > 1) {
+                    scopes.push_back({node->children[1]->value});
+                    visitBody(node->children[1].get());
+                    scopes.pop_back();
+                }
+                break;
+            case NODE_FUNC_DECL: {
+                auto outer = std::move(scopes);
+                scopes.clear();
+                scopes.emplace_back();
+                for (size_t p = 0; p + 1 < node->children.size(); p++) {
+                    scopes.back().insert(node->children[p]->value);
+                }
+                visitBody(node->children.back().get());
+                scopes = std::move(outer);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+public:
+    void run(ASTNode* root) {
+        scopes.clear();
+        scopes.emplace_back();
+        visitBlock(root->children);
+    }
+};
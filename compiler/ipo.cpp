@@ -0,0 +1,448 @@
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// Copies the blocks of `src` to the end of `dst` with fresh instructions;
+// src's parameters become `args`. Returns the copies in src's block order,
+// so the first one is the copy of src's entry.
+std::vector<IRBlock*> irCopyBody(IRFunction& dst, const IRFunction& src, const std::vector<IRInstr*>& args) {
+    std::map<const IRInstr*, IRInstr*> values;
+    std::map<const IRBlock*, IRBlock*> blocks;
+    std::vector<IRBlock*> copies;
+    for (size_t i = 0; i < src.paramValues.size(); i++) values[src.paramValues[i]] = args[i];
+    for (auto& block : src.blocks) {
+        IRBlock* copy = dst.newBlock();
+        copy->sealed = true;
+        blocks[block.get()] = copy;
+        copies.push_back(copy);
+        for (IRInstr* in : block->instrs) {
+            IRInstr* c = dst.make(in->op);
+            c->type = in->type;
+            c->num = in->num;
+            c->name = in->name;
+            c->keys = in->keys;
+            c->cases = in->cases;
+            c->builtin = in->builtin;
+            c->callee = in->callee;
+            c->noEscape = in->noEscape;
+            c->fixed = in->fixed;
+            c->line = in->line;
+            c->block = copy;
+            copy->instrs.push_back(c);
+            values[in] = c;
+        }
+    }
+    for (auto& block : src.blocks) {
+        IRBlock* copy = blocks[block.get()];
+        for (IRBlock* p : block->preds) copy->preds.push_back(blocks.at(p));
+        for (size_t i = 0; i < block->instrs.size(); i++) {
+            IRInstr* in = block->instrs[i];
+            IRInstr* c = copy->instrs[i];
+            for (IRInstr* arg : in->args) {
+                arg = irResolve(arg);
+                auto it = values.find(arg);
+                if (it != values.end()) {
+                    c->args.push_back(it->second);
+                    continue;
+                }
+                IRInstr* k = dst.constant(arg->type, arg->num);
+                k->inum = arg->inum;
+                c->args.push_back(k);
+            }
+            for (int t = 0; t < 2; t++) {
+                if (in->targets[t]) c->targets[t] = blocks.at(in->targets[t]);
+            }
+            for (IRBlock* arm : in->arms) c->arms.push_back(blocks.at(arm));
+        }
+    }
+    return copies;
+}
+
+// Interprocedural optimizations over one module, around the per-function
+// Optimizer:
+//
+//   inline      copy small non-recursive functions into their callers, so
+//               the caller's optimizations see through the call
+//   types       infer every function's return type together with the
+//               types inside all function bodies
+//   specialize  for each argument type signature a call site is known to
+//               use (all numbers, say), clone the callee with those
+//               parameter types and call the clone, whose parameters and
+//               result stay unboxed; calls with unknown arguments keep
+//               using the generic function
+//   errors      find the functions that may return with an error pending,
+//               and drop the checks after calls to the others
+//
+// Only calls between functions of the same module are touched: other
+// modules see a function through its header, and each module's object file
+// is cached on its own source.
+class ModuleOptimizer {
+    IRModule& module;
+    std::map<std::pair<IRFunction*, std::string>, IRFunction*> clones;
+    std::map<IRFunction*, int> cloneCount;
+
+    static const size_t INLINE_MAX_INSTRS = 40;      // callee size limit
+    static const size_t CALLER_MAX_INSTRS = 4000;    // stop growing a caller past this
+    static const int MAX_SPECIALIZATIONS = 8;        // per function
+    static const int MAX_SPECIALIZE_ROUNDS = 4;
+    static constexpr char TYPE_LETTERS[] = "?idnbsaohfluzxv";  // by IRType, for clone names
+    static_assert(sizeof(TYPE_LETTERS) == TY_VOID + 2, "one letter per IRType");
+
+public:
+    int inlined = 0;
+    int specialized = 0;
+    int checksRemoved = 0;
+    int cseRemoved = 0;
+    int hoisted = 0;
+    int dceRemoved = 0;
+
+private:
+    static size_t size(const IRFunction& fn) {
+        size_t n = 0;
+        for (auto& block : fn.blocks) n += block->instrs.size();
+        return n;
+    }
+
+    static std::vector<IRInstr*> calls(const IRFunction& fn) {
+        std::vector<IRInstr*> out;
+        for (auto& block : fn.blocks) {
+            for (IRInstr* in : block->instrs) {
+                if (in->op == IR_CALL && in->callee) out.push_back(in);
+            }
+        }
+        return out;
+    }
+
+    void resolveCallees() {
+        std::map<std::string, IRFunction*> bySymbol;
+        for (auto& fn : module.functions) {
+            if (fn->kind == FN_SIGMA) bySymbol[fn->name] = fn.get();
+        }
+        for (auto& fn : module.functions) {
+            for (auto& block : fn->blocks) {
+                for (IRInstr* in : block->instrs) {
+                    if (in->op != IR_CALL) continue;
+                    auto it = bySymbol.find(in->name);
+                    if (it != bySymbol.end()) in->callee = it->second;
+                }
+            }
+        }
+    }
+
+    // --- inline ---
+
+    bool recursive(IRFunction* fn) {
+        std::set<IRFunction*> seen;
+        std::vector<IRFunction*> work = {fn};
+        while (!work.empty()) {
+            IRFunction* f = work.back();
+            work.pop_back();
+            for (IRInstr* call : calls(*f)) {
+                if (call->callee == fn) return true;
+                if (seen.insert(call->callee).second) work.push_back(call->callee);
+            }
+        }
+        return false;
+    }
+
+    // Ends `in`'s block after it with an IR_CHECK into `handler`, moving the
+    // rest of the block to a new one. The handler's phis take the values
+    // they take on the edge from `like`.
+    static void checkInto(IRFunction& fn, IRInstr* in, IRBlock* handler, IRBlock* like) {
+        IRBlock* block = in->block;
+        IRBlock* rest = fn.newBlock();
+        rest->sealed = true;
+        auto pos = std::find(block->instrs.begin(), block->instrs.end(), in);
+        rest->instrs.assign(pos + 1, block->instrs.end());
+        block->instrs.erase(pos + 1, block->instrs.end());
+        for (IRInstr* r : rest->instrs) r->block = rest;
+        for (IRBlock* succ : rest->succs()) {
+            std::replace(succ->preds.begin(), succ->preds.end(), block, rest);
+        }
+        IRInstr* check = fn.make(IR_CHECK);
+        check->type = TY_VOID;
+        check->line = in->line;
+        check->targets[0] = rest;
+        check->targets[1] = handler;
+        check->block = block;
+        block->instrs.push_back(check);
+        rest->preds.push_back(block);
+        size_t from = std::find(handler->preds.begin(), handler->preds.end(), like) - handler->preds.begin();
+        handler->preds.push_back(block);
+        for (IRInstr* phi : handler->instrs) {
+            if (phi->op == IR_PHI) phi->args.push_back(phi->args[from]);
+        }
+    }
+
+    // Splits the call's block after the call, copies the callee between
+    // the halves and turns its returns into jumps to the second half. In a
+    // $try, whatever in the copy can fail gets a check into the handler.
+    void inlineCall(IRFunction& caller, IRInstr* call) {
+        IRInstr* callCheck = irChecked(call) ? call->block->instrs.back() : nullptr;
+        IRBlock* block = call->block;
+        IRBlock* rest = caller.newBlock();
+        rest->sealed = true;
+        auto pos = std::find(block->instrs.begin(), block->instrs.end(), call);
+        rest->instrs.assign(pos + 1, block->instrs.end());
+        block->instrs.erase(pos, block->instrs.end());
+        for (IRInstr* in : rest->instrs) in->block = rest;
+        for (IRBlock* succ : rest->succs()) {
+            std::replace(succ->preds.begin(), succ->preds.end(), block, rest);
+        }
+
+        std::vector<IRBlock*> body = irCopyBody(caller, *call->callee, call->args);
+        IRInstr* jump = caller.make(IR_JUMP);
+        jump->type = TY_VOID;
+        jump->targets[0] = body[0];
+        jump->block = block;
+        block->instrs.push_back(jump);
+        body[0]->preds.push_back(block);
+
+        std::vector<IRInstr*> results;
+        for (IRBlock* b : body) {
+            IRInstr* ret = b->terminator();
+            if (!ret || ret->op != IR_RETURN) continue;
+            results.push_back(ret->args[0]);
+            ret->op = IR_JUMP;
+            ret->args.clear();
+            ret->targets[0] = rest;
+            rest->preds.push_back(b);
+        }
+        if (results.size() == 1) {
+            call->forward = results[0];
+        } else {
+            IRInstr* phi = caller.make(IR_PHI);
+            phi->args = results;
+            phi->block = rest;
+            rest->instrs.insert(rest->instrs.begin(), phi);
+            call->forward = phi;
+        }
+        if (callCheck) {
+            std::vector<IRInstr*> fallible;
+            for (IRBlock* b : body) {
+                for (IRInstr* in : b->instrs) {
+                    if (irMayFail(in) && !irChecked(in)) fallible.push_back(in);
+                }
+            }
+            for (IRInstr* in : fallible) checkInto(caller, in, callCheck->targets[1], rest);
+        }
+        inlined++;
+    }
+
+    static bool inLoop(IRBlock* block) {
+        std::set<IRBlock*> seen;
+        std::vector<IRBlock*> work = block->succs();
+        while (!work.empty()) {
+            IRBlock* b = work.back();
+            work.pop_back();
+            if (b == block) return true;
+            if (!seen.insert(b).second) continue;
+            for (IRBlock* succ : b->succs()) work.push_back(succ);
+        }
+        return false;
+    }
+
+    // A module body runs once, so only its loops are worth growing.
+    void inlineInto(IRFunction& fn) {
+        for (IRInstr* call : calls(fn)) {
+            IRFunction* callee = call->callee;
+            if (callee == &fn || recursive(callee)) continue;
+            if (fn.kind != FN_SIGMA && !inLoop(call->block)) continue;
+            if (size(*callee) > INLINE_MAX_INSTRS || size(fn) + size(*callee) > CALLER_MAX_INSTRS) continue;
+            inlineCall(fn, call);
+        }
+        Optimizer(fn).cleanup();
+    }
+
+    // Callees before callers, so that what gets copied is already inlined.
+    void inlineAll() {
+        std::set<IRFunction*> done;
+        std::vector<IRFunction*> order;
+        std::vector<std::pair<IRFunction*, size_t>> stack;
+        for (auto& root : module.functions) {
+            if (!done.insert(root.get()).second) continue;
+            stack.push_back({root.get(), 0});
+            while (!stack.empty()) {
+                auto& top = stack.back();
+                std::vector<IRInstr*> out = calls(*top.first);
+                if (top.second < out.size()) {
+                    IRFunction* next = out[top.second++]->callee;
+                    if (done.insert(next).second) stack.push_back({next, 0});
+                } else {
+                    order.push_back(top.first);
+                    stack.pop_back();
+                }
+            }
+        }
+        for (IRFunction* fn : order) inlineInto(*fn);
+    }
+
+    // --- types ---
+
+    static IRType returned(const IRFunction& fn, bool settle) {
+        IRType t = TY_UNKNOWN;
+        for (auto& block : fn.blocks) {
+            IRInstr* ret = block->terminator();
+            if (ret && ret->op == IR_RETURN) t = irJoin(t, ret->args[0]->type);
+        }
+        return settle && t == TY_UNKNOWN ? TY_ANY : t;
+    }
+
+    // Return types start unknown, so a recursive function's result type is
+    // whatever its base cases return, as long as the recursive cases agree.
+    void inferTypes() {
+        for (auto& fn : module.functions) fn->returnType = TY_UNKNOWN;
+        for (bool settle : {false, true}) {
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (auto& fn : module.functions) {
+                    Optimizer(*fn).inferTypes(settle);
+                    if (fn->kind != FN_SIGMA) continue;
+                    IRType t = returned(*fn, settle);
+                    if (t != fn->returnType) {
+                        fn->returnType = t;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // --- errors ---
+
+    // An error escapes a function through any call that can fail and is not
+    // followed by a check into a handler. Starts from "none can fail", so
+    // mutually recursive functions that never raise are found too.
+    void inferFailures() {
+        for (auto& fn : module.functions) fn->mayFail = false;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto& fn : module.functions) {
+                if (fn->mayFail) continue;
+                for (auto& block : fn->blocks) {
+                    for (IRInstr* in : block->instrs) {
+                        if (irMayFail(in) && !irChecked(in)) fn->mayFail = true;
+                    }
+                }
+                changed |= fn->mayFail;
+            }
+        }
+    }
+
+    // --- specialize ---
+
+    // Empty unless every argument type is known: a clone that still takes
+    // boxed arguments saves little and doubles the code gcc has to compile.
+    static std::string signature(const IRInstr* call) {
+        std::string sig;
+        for (IRInstr* arg : call->args) {
+            if (arg->type == TY_ANY) return "";
+            sig += TYPE_LETTERS[arg->type];
+        }
+        return sig;
+    }
+
+    IRFunction* specialization(IRFunction* origin, const std::string& sig) {
+        auto key = std::make_pair(origin, sig);
+        auto it = clones.find(key);
+        if (it != clones.end()) return it->second;
+        if (cloneCount[origin] >= MAX_SPECIALIZATIONS) return origin;
+        cloneCount[origin]++;
+
+        auto clone = std::make_unique<IRFunction>();
+        clone->name = origin->name + "__" + sig;
+        clone->params = origin->params;
+        clone->origin = origin;
+        for (size_t i = 0; i < sig.size(); i++) {
+            IRInstr* param = clone->make(IR_PARAM);
+            param->num = i;
+            param->type = (IRType)(std::string(TYPE_LETTERS).find(sig[i]));
+            clone->paramValues.push_back(param);
+        }
+        irCopyBody(*clone, *origin, clone->paramValues);
+        IRFunction* fn = clone.get();
+        // Keep the module body last.
+        module.functions.insert(module.functions.end() - 1, std::move(clone));
+        clones[key] = fn;
+        specialized++;
+        return fn;
+    }
+
+    // Points every call at the specialization for its argument types.
+    bool retarget() {
+        bool changed = false;
+        std::vector<IRFunction*> fns;
+        for (auto& fn : module.functions) fns.push_back(fn.get());
+        for (IRFunction* fn : fns) {
+            for (IRInstr* call : calls(*fn)) {
+                IRFunction* origin = call->callee->origin ? call->callee->origin : call->callee;
+                std::string sig = signature(call);
+                IRFunction* target = sig.empty() ? origin : specialization(origin, sig);
+                if (target == call->callee) continue;
+                call->callee = target;
+                call->name = target->name;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    void dropUnusedClones() {
+        std::set<IRFunction*> used;
+        std::vector<IRFunction*> work;
+        for (auto& fn : module.functions) {
+            if (!fn->origin && used.insert(fn.get()).second) work.push_back(fn.get());
+        }
+        while (!work.empty()) {
+            IRFunction* fn = work.back();
+            work.pop_back();
+            for (IRInstr* call : calls(*fn)) {
+                if (used.insert(call->callee).second) work.push_back(call->callee);
+            }
+        }
+        std::vector<std::unique_ptr<IRFunction>> kept;
+        for (auto& fn : module.functions) {
+            if (used.count(fn.get())) kept.push_back(std::move(fn));
+            else specialized--;
+        }
+        module.functions = std::move(kept);
+    }
+
+public:
+    ModuleOptimizer(IRModule& m) : module(m) {}
+
+    // With `enabled` false, only what CodeGen needs: a clean CFG and types.
+    void run(bool enabled) {
+        for (auto& fn : module.functions) Optimizer(*fn).cleanup();
+        resolveCallees();
+        if (enabled) inlineAll();
+        inferTypes();
+        for (int round = 0; enabled && round < MAX_SPECIALIZE_ROUNDS; round++) {
+            if (!retarget()) break;
+            inferTypes();
+        }
+        dropUnusedClones();
+        for (auto& fn : module.functions) {
+            if (enabled) {
+                Optimizer opt(*fn);
+                opt.optimize();
+                checksRemoved += opt.checksRemoved;
+                cseRemoved += opt.cseRemoved;
+                hoisted += opt.hoisted;
+                dceRemoved += opt.dceRemoved;
+            }
+        }
+        inferFailures();
+        for (auto& fn : module.functions) {
+            Optimizer opt(*fn);
+            opt.simplifyChecks();
+            opt.cleanup();
+            irFinish(*fn);
+        }
+    }
+};
@@ -0,0 +1,1233 @@
+#include "../include/ast.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// What lowering and code generation need to know about the module.
+struct ModuleInfo {
+    std::string id;                               // C identifier for the module
+    std::string file;                             // .sgm file name, for reports
+    bool isMain = false;
+    std::vector<std::string> imports;             // ids of directly imported modules
+    std::vector<std::string> initOrder;           // entry module only: every imported module, dependencies first
+    std::map<std::string, std::string> functions; // callable Sigma function name -> C symbol
+    std::map<std::string, size_t> arities;        // and its number of parameters
+};
+
+// Sigma's mid-level IR.
+//
+// Every Sigma function, and the module body, is lowered to a control-flow
+// graph of basic blocks holding instructions in SSA form: each instruction
+// is its own value, variables only exist during lowering, and join points
+// merge values with phis. The optimizer (opt.cpp) works on this form and
+// CodeGen prints C from it.
+//
+// Operations are generic (IR_ADD adds any two Sigma values). Type inference
+// gives every value a static type, and values known to be integers, decs or
+// booleans are kept unboxed as C int64_ts, doubles and ints.
+enum IROp {
+    IR_CONST,       // number, bool or nil constant; printed inline, never in a block
+    IR_PARAM,       // function parameter `num`; printed inline, never in a block
+    IR_STR,         // string literal `name`
+    IR_PHI,
+    IR_ADD, IR_SUB, IR_MUL, IR_DIV, IR_MOD,
+    IR_EQ, IR_STRICT_EQ, IR_NE, IR_LT, IR_GT, IR_LE, IR_GE,
+    IR_AND, IR_OR,
+    IR_BUILTIN,     // runtime builtin `builtin`
+    IR_CALL,        // Sigma function; C symbol in `name`
+    IR_SPAWN,       // $spawn: starts the Sigma function `name` as a task
+    IR_ARRAY,       // array literal
+    IR_OBJECT,      // object literal with keys `keys`
+    IR_GET,         // obj.name
+    IR_INDEX,       // arr[i]
+    IR_SET,         // obj.name: v
+    IR_SET_INDEX,   // arr[i]: v
+    IR_SORT,        // arr.sort(order)
+    IR_LEN,         // len(v); pure for arrays, typed arrays and strings, whose length never changes
+    IR_IS_ARRAY,    // v is an array: the hoisted type check of IR_ELEM and IR_SET_ELEM
+    IR_ELEM,        // arr[i] with i known to be in bounds; args[2], if any, is an IR_IS_ARRAY guard
+    IR_SET_ELEM,    // arr[i]: v likewise; args[3], if any, is the guard
+    IR_ITEM,        // item i, known to be in bounds, of a $for ... $in collection: element, dict key or character
+    IR_PRINT,
+    IR_INPUT,       // $in, prompt in `name`
+    IR_CATCH,       // the pending error, which it clears; first in a $try's handler block
+    IR_JUMP,        // terminators
+    IR_BRANCH,
+    IR_SWITCH,      // $match on args[0]: to arms[c.arm] for the case c it equals, else to arms.back()
+    IR_CHECK,       // after a call that can fail: on to targets[0], or to the handler targets[1]
+    IR_RETURN
+};
+
+enum IRType {
+    TY_UNKNOWN,     // not inferred yet
+    TY_INT,         // C int64_t
+    TY_DEC,         // C double
+    TY_NUM,         // int or dec: a SigmaValue (e.g. an int sum that may overflow)
+    TY_BOOL,        // C int
+    TY_STR,
+    TY_ARR,
+    TY_OBJ,
+    TY_DICT,
+    TY_F64ARR,      // typed arrays: f64_array(n), i64_array(n), bytes(n)
+    TY_I64ARR,
+    TY_U8ARR,
+    TY_NIL,
+    TY_ANY,         // any SigmaValue
+    TY_VOID         // produces no value
+};
+
+// What an instruction may do besides computing its result. The optimizer
+// only moves, merges or deletes instructions whose effects allow it.
+enum IREffect {
+    EFF_PURE,       // depends only on its operands
+    EFF_LOAD,       // also reads array or object contents
+    EFF_ALLOC,      // returns a fresh array or object
+    EFF_STORE,      // may write array or object contents
+    EFF_IO,         // observable, but leaves arrays and objects alone
+    EFF_CONTROL     // terminator
+};
+
+struct IRBuiltin {
+    const char* name;       // Sigma name
+    const char* symbol;     // runtime function
+    size_t arity;
+    IRType result;
+    IREffect effect;
+    bool fails = false;     // may raise an error
+};
+
+static const IRBuiltin IR_BUILTINS[] = {
+    {"check_type", "sigma_type_of", 1, TY_STR, EFF_PURE},
+    {"to_int", "sigma_to_int", 1, TY_NUM, EFF_PURE},
+    {"to_dec", "sigma_to_dec", 1, TY_DEC, EFF_PURE},
+    {"to_str", "sigma_to_str", 1, TY_STR, EFF_PURE},
+    {"random", "sigma_random", 1, TY_INT, EFF_IO},
+    {"random_range", "sigma_random_range", 2, TY_INT, EFF_IO},
+    {"random_dec", "sigma_random_dec", 0, TY_DEC, EFF_IO},
+    {"random_array", "sigma_random_array", 3, TY_ARR, EFF_IO},
+    {"seed", "sigma_seed", 1, TY_NIL, EFF_IO},
+    {"error", "sigma_error_raise", 1, TY_NIL, EFF_IO, true},
+    {"dict", "sigma_make_dict", 0, TY_DICT, EFF_ALLOC},
+    {"dict", "sigma_make_dict_sized", 1, TY_DICT, EFF_ALLOC},
+    {"f64_array", "sigma_make_f64_array", 1, TY_F64ARR, EFF_ALLOC, true},
+    {"i64_array", "sigma_make_i64_array", 1, TY_I64ARR, EFF_ALLOC, true},
+    {"bytes", "sigma_make_bytes", 1, TY_U8ARR, EFF_ALLOC, true},
+    {"lines", "sigma_read_lines", 1, TY_ARR, EFF_IO, true},
+    {"json_parse", "sigma_json_parse", 1, TY_ANY, EFF_ALLOC, true},
+    {"json_stringify", "sigma_json_stringify", 1, TY_STR, EFF_LOAD, true},
+    {"chan", "sigma_make_chan", 0, TY_ANY, EFF_ALLOC},
+    {"chan", "sigma_make_chan_sized", 1, TY_ANY, EFF_ALLOC},
+    {"read_csv", "sigma_read_csv", 1, TY_ANY, EFF_IO, true},
+    {"table", "sigma_make_table", 1, TY_ANY, EFF_ALLOC, true},
+    {"mmap_array", "sigma_mmap_array", 2, TY_ANY, EFF_IO, true},
+    {"mmap_array", "sigma_mmap_array_mode", 3, TY_ANY, EFF_IO, true},
+    {"mmap_dict", "sigma_mmap_dict", 1, TY_DICT, EFF_IO, true},
+};
+
+// Methods, v.name(args), called with the receiver as their first argument;
+// `arity` does not count it.
+static const IRBuiltin IR_METHODS[] = {
+    {"has", "sigma_dict_has", 1, TY_BOOL, EFF_LOAD, true},
+    {"keys", "sigma_dict_keys", 0, TY_ARR, EFF_ALLOC, true},
+    {"values", "sigma_dict_values", 0, TY_ARR, EFF_ALLOC, true},
+    // Channel operations may wait for another task, which may have written
+    // anything meanwhile.
+    {"send", "sigma_chan_send", 1, TY_NIL, EFF_STORE, true},
+    {"recv", "sigma_chan_recv", 0, TY_ANY, EFF_STORE, true},
+    {"close", "sigma_chan_close", 0, TY_NIL, EFF_STORE, true},
+    {"save", "sigma_save", 1, TY_NIL, EFF_IO, true},
+    // String methods make new strings and never change the one they are
+    // called on.
+    {"split", "sigma_str_split", 1, TY_ARR, EFF_ALLOC, true},
+    {"split", "sigma_str_split_space", 0, TY_ARR, EFF_ALLOC, true},
+    {"find", "sigma_str_find", 1, TY_INT, EFF_PURE, true},
+    {"count", "sigma_str_count", 1, TY_INT, EFF_PURE, true},
+    {"replace", "sigma_str_replace", 2, TY_STR, EFF_PURE, true},
+    {"trim", "sigma_str_trim", 0, TY_STR, EFF_PURE, true},
+    {"upper", "sigma_str_upper", 0, TY_STR, EFF_PURE, true},
+    {"lower", "sigma_str_lower", 0, TY_STR, EFF_PURE, true},
+    // Table methods make new tables (or numbers) and leave the table they
+    // are called on as it was. A filter of one argument is the pipeline
+    // stage instead.
+    {"filter", "sigma_table_filter", 3, TY_ANY, EFF_ALLOC, true},
+    {"select", "sigma_table_select", 1, TY_ANY, EFF_ALLOC, true},
+    {"sort_by", "sigma_table_sort_by", 1, TY_ANY, EFF_ALLOC, true},
+    {"sort_by", "sigma_table_sort_by_order", 2, TY_ANY, EFF_ALLOC, true},
+    {"group_by", "sigma_table_group_by", 1, TY_ANY, EFF_ALLOC, true},
+    {"sum", "sigma_table_sum", 1, TY_ANY, EFF_ALLOC, true},
+    {"mean", "sigma_table_mean", 1, TY_ANY, EFF_ALLOC, true},
+    {"count", "sigma_table_count", 0, TY_ANY, EFF_ALLOC, true},
+    {"column", "sigma_table_column", 1, TY_ANY, EFF_ALLOC, true},
+    {"columns", "sigma_table_columns", 0, TY_ARR, EFF_ALLOC, true},
+};
+
+// c[i]++, in one runtime call: a dict is probed once.
+static const IRBuiltin IR_INDEX_INCREMENT = {"++", "sigma_index_increment", 2, TY_NIL, EFF_STORE, true};
+
+// Before a $for ... $in loop: raises unless the collection can be iterated.
+static const IRBuiltin IR_ITERABLE = {"$in", "sigma_iter_check", 1, TY_NIL, EFF_PURE, true};
+
+// Appends to the array a pipeline used as a value collects its items into.
+static const IRBuiltin IR_PUSH = {"push", "sigma_array_push", 2, TY_NIL, EFF_STORE};
+
+struct IRBlock;
+struct IRFunction;
+
+// A case of an IR_SWITCH: an int or a string, and the arm it leads to.
+struct IRCase {
+    IRType type;            // TY_INT or TY_STR
+    int64_t num = 0;
+    std::string str;
+    size_t arm = 0;         // index into the switch's arms
+};
+
+struct IRInstr {
+    IROp op;
+    int id = 0;
+    IRType type = TY_UNKNOWN;
+    std::vector<IRInstr*> args;
+    double num = 0;                     // IR_CONST value, IR_PARAM index
+    int64_t inum = 0;                   // IR_CONST value of type int
+    std::string name;
+    std::vector<std::string> keys;     // IR_OBJECT
+    const IRBuiltin* builtin = nullptr;
+    IRFunction* callee = nullptr;       // IR_CALL to a function of this module
+    IRBlock* targets[2] = {nullptr, nullptr};   // IR_JUMP, IR_BRANCH (true, false), IR_CHECK
+    std::vector<IRCase> cases;          // IR_SWITCH
+    std::vector<IRBlock*> arms;         // IR_SWITCH: distinct blocks, the default last
+    IRBlock* block = nullptr;
+    bool noEscape = false;              // IR_ARRAY/IR_OBJECT: may live in the C frame
+    bool fixed = false;                 // IR_ARRAY/IR_OBJECT: built once, by a top-level $fixed
+    int line = 0;                       // Sigma source line, 0 if unknown
+    IRInstr* forward = nullptr;         // set once replaced: the value to use instead
+
+    IRInstr(IROp o) : op(o) {}
+};
+
+// Follows replacements to the value currently standing for `v`.
+IRInstr* irResolve(IRInstr* v) {
+    while (v->forward) v = v->forward;
+    return v;
+}
+
+bool irIsTerminator(IROp op) {
+    return op == IR_JUMP || op == IR_BRANCH || op == IR_SWITCH || op == IR_CHECK || op == IR_RETURN;
+}
+
+bool irIsInline(IROp op) {
+    return op == IR_CONST || op == IR_PARAM;
+}
+
+bool irIsNumeric(IRType t) {
+    return t == TY_INT || t == TY_DEC || t == TY_NUM;
+}
+
+bool irIsTypedArray(IRType t) {
+    return t == TY_F64ARR || t == TY_I64ARR || t == TY_U8ARR;
+}
+
+// What indexing a value of type `t` gives: the element type of a typed
+// array, otherwise any.
+IRType irElemType(IRType t) {
+    if (t == TY_F64ARR) return TY_DEC;
+    if (t == TY_I64ARR || t == TY_U8ARR) return TY_INT;
+    return TY_ANY;
+}
+
+// Whether a[i]: v with i in bounds can still fail: a typed array only takes
+// numbers, i64 and byte arrays only whole ones, and bytes only 0..255.
+bool irStoreMayFail(IRType arr, IRType v) {
+    if (arr == TY_F64ARR) return !irIsNumeric(v);
+    if (arr == TY_I64ARR) return v != TY_INT;
+    return arr == TY_U8ARR;
+}
+
+// Whether `$for x $in` accepts any value of type `t` without checking.
+bool irIsIterable(IRType t) {
+    return t == TY_ARR || t == TY_STR || t == TY_DICT || irIsTypedArray(t);
+}
+
+IREffect irEffect(const IRInstr* in) {
+    switch (in->op) {
+        case IR_GET:
+        case IR_INDEX:
+        case IR_ELEM:
+        case IR_ITEM:
+            return EFF_LOAD;
+        case IR_ARRAY:
+        case IR_OBJECT:
+            return EFF_ALLOC;
+        case IR_CALL:
+        case IR_SPAWN:
+        case IR_SET:
+        case IR_SET_INDEX:
+        case IR_SET_ELEM:
+        case IR_SORT:
+            return EFF_STORE;
+        case IR_PRINT:
+        case IR_INPUT:
+        case IR_CATCH:
+            return EFF_IO;
+        case IR_BUILTIN:
+            return in->builtin->effect;
+        case IR_LEN: {
+            // A dict grows as it is written.
+            IRType t = in->args[0]->type;
+            return t == TY_ARR || t == TY_STR || irIsTypedArray(t) ? EFF_PURE : EFF_LOAD;
+        }
+        case IR_JUMP:
+        case IR_BRANCH:
+        case IR_SWITCH:
+        case IR_CHECK:
+        case IR_RETURN:
+            return EFF_CONTROL;
+        default:
+            return EFF_PURE;
+    }
+}
+
+// Least upper bound in the type lattice: unknown < any concrete type < any,
+// except that int and dec merge to num.
+IRType irJoin(IRType a, IRType b) {
+    if (a == TY_UNKNOWN) return b;
+    if (b == TY_UNKNOWN || a == b) return a;
+    if (irIsNumeric(a) && irIsNumeric(b)) return TY_NUM;
+    return TY_ANY;
+}
+
+struct IRBlock {
+    int id = 0;
+    std::vector<IRInstr*> instrs;       // phis first, terminator last
+    std::vector<IRBlock*> preds;        // phi operands are in this order
+
+    // SSA construction state
+    bool sealed = false;
+    std::map<int, IRInstr*> defs;
+    std::map<int, IRInstr*> incompletePhis;
+
+    IRInstr* terminator() const {
+        if (instrs.empty() || !irIsTerminator(instrs.back()->op)) return nullptr;
+        return instrs.back();
+    }
+
+    std::vector<IRBlock*> succs() const {
+        std::vector<IRBlock*> out;
+        IRInstr* t = terminator();
+        if (t && t->op == IR_JUMP) out.push_back(t->targets[0]);
+        if (t && (t->op == IR_BRANCH || t->op == IR_CHECK)) out = {t->targets[0], t->targets[1]};
+        if (t && t->op == IR_SWITCH) out = t->arms;
+        return out;
+    }
+};
+
+enum IRFunctionKind {
+    FN_SIGMA,       // SigmaValue f(SigmaValue...)
+    FN_MAIN,        // the entry module's body: int main()
+    FN_INIT         // an imported module's body: void sigma_init_<id>()
+};
+
+struct IRFunction {
+    std::string name;                           // C symbol
+    IRFunctionKind kind = FN_SIGMA;
+    std::vector<std::string> params;            // Sigma parameter names
+    std::vector<IRInstr*> paramValues;          // the IR_PARAM of each parameter
+    IRType returnType = TY_ANY;                 // join of everything it returns
+    bool mayFail = true;                        // may return with an error pending
+    // Type-specialized copy of `origin` (see ipo.cpp). Specializations are
+    // private to the module and pass and return numbers and booleans
+    // unboxed; everything else keeps the SigmaValue ABI.
+    IRFunction* origin = nullptr;
+    std::vector<std::unique_ptr<IRBlock>> blocks;   // blocks[0] is the entry
+    std::vector<std::unique_ptr<IRInstr>> pool;     // owns every instruction
+    int nextInstr = 1;
+    int nextBlock = 0;
+
+    IRInstr* make(IROp op) {
+        pool.push_back(std::make_unique<IRInstr>(op));
+        pool.back()->id = nextInstr++;
+        return pool.back().get();
+    }
+
+    IRInstr* constant(IRType type, double value = 0) {
+        IRInstr* c = make(IR_CONST);
+        c->type = type;
+        c->num = value;
+        return c;
+    }
+
+    IRInstr* intConstant(int64_t value) {
+        IRInstr* c = make(IR_CONST);
+        c->type = TY_INT;
+        c->inum = value;
+        return c;
+    }
+
+    IRBlock* newBlock() {
+        blocks.push_back(std::make_unique<IRBlock>());
+        blocks.back()->id = nextBlock++;
+        return blocks.back().get();
+    }
+};
+
+// Whether `in` may raise an error. Array accesses that the optimizer has
+// not proven in bounds can, and so can calls to other modules and to
+// functions that may fail themselves.
+bool irMayFail(const IRInstr* in) {
+    switch (in->op) {
+        case IR_INDEX:
+        case IR_SET_INDEX:
+            return true;
+        case IR_ELEM:
+            return in->args.size() > 2;
+        case IR_SET_ELEM:
+            return in->args.size() > 3 || irStoreMayFail(in->args[0]->type, in->args[2]->type);
+        case IR_BUILTIN:
+            if (in->builtin == &IR_ITERABLE) return !irIsIterable(in->args[0]->type);
+            return in->builtin->fails;
+        case IR_CALL:
+            return !in->callee || in->callee->mayFail;
+        default:
+            return false;
+    }
+}
+
+// Whether an IR_CHECK follows `in`, which then ends its block but for it.
+bool irChecked(const IRInstr* in) {
+    const auto& instrs = in->block->instrs;
+    return instrs.size() >= 2 && instrs.back()->op == IR_CHECK && instrs[instrs.size() - 2] == in;
+}
+
+struct IRModule {
+    std::vector<std::unique_ptr<IRFunction>> functions;     // module body last
+};
+
+// Lowers one module's AST to IR, building SSA form directly as it goes
+// (Braun et al., "Simple and Efficient Construction of Static Single
+// Assignment Form"): a variable read looks backwards through the CFG for
+// its reaching definition, and a block's phis are completed once all of its
+// predecessors are known ("sealed").
+class IRBuilder {
+    const ModuleInfo& mod;
+    IRFunction* fn = nullptr;
+    IRBlock* cur = nullptr;
+    std::vector<std::map<std::string, int>> scopes;
+    std::set<int> constants;
+    int nextVar = 0;
+    int line = 0;                       // of the statement being lowered
+    std::vector<IRBlock*> handlers;     // catch blocks of the enclosing $trys, innermost last
+    bool loweringFixed = false;         // in the initializer of a top-level $fixed
+
+    // --- SSA construction ---
+
+    void writeVar(int var, IRBlock* block, IRInstr* value) {
+        block->defs[var] = value;
+    }
+
+    IRInstr* readVar(int var, IRBlock* block) {
+        auto it = block->defs.find(var);
+        if (it != block->defs.end()) return irResolve(it->second);
+        return readVarRecursive(var, block);
+    }
+
+    IRInstr* newPhi(IRBlock* block) {
+        IRInstr* phi = fn->make(IR_PHI);
+        phi->block = block;
+        block->instrs.insert(block->instrs.begin(), phi);
+        return phi;
+    }
+
+    IRInstr* readVarRecursive(int var, IRBlock* block) {
+        IRInstr* value;
+        if (!block->sealed) {
+            value = newPhi(block);
+            block->incompletePhis[var] = value;
+        } else if (block->preds.empty()) {
+            value = fn->constant(TY_NIL);   // unreachable, or read before any write
+        } else if (block->preds.size() == 1) {
+            value = readVar(var, block->preds[0]);
+        } else {
+            IRInstr* phi = newPhi(block);
+            writeVar(var, block, phi);
+            value = addPhiOperands(var, phi);
+        }
+        writeVar(var, block, value);
+        return value;
+    }
+
+    IRInstr* addPhiOperands(int var, IRInstr* phi) {
+        for (IRBlock* pred : phi->block->preds) phi->args.push_back(readVar(var, pred));
+        return tryRemoveTrivialPhi(phi);
+    }
+
+    // A phi whose operands are all one value (or itself) is that value.
+    // Phis that only become trivial later are cleaned up by the optimizer.
+    IRInstr* tryRemoveTrivialPhi(IRInstr* phi) {
+        IRInstr* same = nullptr;
+        for (IRInstr* arg : phi->args) {
+            arg = irResolve(arg);
+            if (arg == same || arg == phi) continue;
+            if (same) return phi;
+            same = arg;
+        }
+        if (!same) same = fn->constant(TY_NIL);
+        phi->forward = same;
+        auto& instrs = phi->block->instrs;
+        for (size_t i = 0; i < instrs.size(); i++) {
+            if (instrs[i] == phi) {
+                instrs.erase(instrs.begin() + i);
+                break;
+            }
+        }
+        return same;
+    }
+
+    void seal(IRBlock* block) {
+        for (auto& entry : block->incompletePhis) addPhiOperands(entry.first, entry.second);
+        block->incompletePhis.clear();
+        block->sealed = true;
+    }
+
+    // --- CFG construction ---
+
+    bool terminated() {
+        return cur->terminator() != nullptr;
+    }
+
+    // Code after a return goes into a block with no predecessors. Edges out
+    // of such blocks are not recorded, so everything only reachable through
+    // them stays predecessor-free and is dropped before optimization.
+    void addEdge(IRBlock* from, IRBlock* to) {
+        if (from != fn->blocks[0].get() && from->preds.empty()) return;
+        to->preds.push_back(from);
+    }
+
+    IRInstr* append(IRInstr* in) {
+        in->block = cur;
+        cur->instrs.push_back(in);
+        return in;
+    }
+
+    // Inside a $try, a call that can fail ends its block with an IR_CHECK
+    // into the handler.
+    IRInstr* emit(IROp op, std::vector<IRInstr*> args = {}, const IRBuiltin* builtin = nullptr) {
+        IRInstr* in = fn->make(op);
+        in->args = args;
+        in->builtin = builtin;
+        in->line = line;
+        append(in);
+        if (!handlers.empty() && irMayFail(in)) {
+            IRBlock* next = fn->newBlock();
+            IRInstr* check = fn->make(IR_CHECK);
+            check->line = line;
+            check->targets[0] = next;
+            check->targets[1] = handlers.back();
+            append(check);
+            addEdge(cur, next);
+            addEdge(cur, handlers.back());
+            seal(next);
+            cur = next;
+        }
+        return in;
+    }
+
+    void jump(IRBlock* to) {
+        IRInstr* j = emit(IR_JUMP);
+        j->targets[0] = to;
+        addEdge(cur, to);
+    }
+
+    void branch(IRInstr* cond, IRBlock* ifTrue, IRBlock* ifFalse) {
+        IRInstr* b = emit(IR_BRANCH, {cond});
+        b->targets[0] = ifTrue;
+        b->targets[1] = ifFalse;
+        addEdge(cur, ifTrue);
+        addEdge(cur, ifFalse);
+    }
+
+    // --- variables ---
+
+    int lookup(const std::string& name) {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto it = scope->find(name);
+            if (it != scope->end()) return it->second;
+        }
+        return -1;
+    }
+
+    int declare(const std::string& name) {
+        int var = nextVar++;
+        scopes.back()[name] = var;
+        return var;
+    }
+
+    // `name: value` declares on first use and assigns afterwards, so a loop
+    // body can update an outer variable instead of shadowing it.
+    void assign(const std::string& name, IRInstr* value) {
+        int var = lookup(name);
+        if (var < 0) var = declare(name);
+        else if (constants.count(var)) throw std::runtime_error("Cannot reassign constant variable: " + name);
+        writeVar(var, cur, value);
+    }
+
+    // --- expressions ---
+
+    static IROp binaryOp(const std::string& op) {
+        static const std::map<std::string, IROp> ops = {
+            {"+", IR_ADD}, {"-", IR_SUB}, {"*", IR_MUL}, {"/", IR_DIV}, {"%", IR_MOD},
+            {"==", IR_EQ}, {"===", IR_STRICT_EQ}, {"!=", IR_NE},
+            {"<", IR_LT}, {">", IR_GT}, {"<=", IR_LE}, {">=", IR_GE},
+            {"&&", IR_AND}, {"||", IR_OR},
+        };
+        auto it = ops.find(op);
+        if (it == ops.end()) throw std::runtime_error("Unknown operator: " + op);
+        return it->second;
+    }
+
+    IRInstr* lowerLiteral(ASTNode* node) {
+        const std::string& text = node->value;
+        if (text[0] == '"') {
+            IRInstr* s = emit(IR_STR);
+            s->name = text.substr(1, text.size() - 2);
+            return s;
+        }
+        if (text == "true") return fn->constant(TY_BOOL, 1);
+        if (text == "false") return fn->constant(TY_BOOL, 0);
+        if (text.find('.') == std::string::npos) {
+            // Integer literal; one too large for 64 bits becomes a dec.
+            errno = 0;
+            long long n = strtoll(text.c_str(), nullptr, 10);
+            if (errno != ERANGE) return fn->intConstant(n);
+        }
+        return fn->constant(TY_DEC, strtod(text.c_str(), nullptr));
+    }
+
+    IRInstr* lowerCall(ASTNode* node) {
+        if (isRange(node)) return lowerCollect(node);
+        std::vector<IRInstr*> args;
+        for (auto& child : node->children) args.push_back(lowerExpr(child.get()));
+        return emitCall(node->value, args);
+    }
+
+    // A call of the builtin or Sigma function `name`.
+    IRInstr* emitCall(const std::string& name, const std::vector<IRInstr*>& args) {
+        if (name == "len" && args.size() == 1) return emit(IR_LEN, args);
+        for (auto& b : IR_BUILTINS) {
+            if (name == b.name && args.size() == b.arity) {
+                IRInstr* call = emit(IR_BUILTIN, args, &b);
+                call->name = b.symbol;
+                return call;
+            }
+        }
+        auto fnSym = mod.functions.find(name);
+        if (fnSym == mod.functions.end()) {
+            throw std::runtime_error("Unknown function: " + name);
+        }
+        IRInstr* call = emit(IR_CALL, args);
+        call->name = fnSym->second;
+        return call;
+    }
+
+    // The task gets the function's generic entry point, which takes every
+    // argument boxed; the runtime calls it through a pointer, so the number
+    // of arguments is checked here.
+    void lowerSpawn(ASTNode* call) {
+        const std::string& name = call->value;
+        auto fnSym = mod.functions.find(name);
+        if (fnSym == mod.functions.end()) {
+            bool builtin = name == "len" || name == "range";
+            for (auto& b : IR_BUILTINS) builtin = builtin || name == b.name;
+            throw std::runtime_error(builtin ? "Cannot $spawn the builtin " + name : "Unknown function: " + name);
+        }
+        size_t arity = mod.arities.at(name);
+        if (call->children.size() != arity) {
+            throw std::runtime_error(name + " takes " + std::to_string(arity) + " arguments, not " +
+                                     std::to_string(call->children.size()));
+        }
+        if (arity > 8) throw std::runtime_error("$spawn takes functions of at most 8 parameters");
+        std::vector<IRInstr*> args;
+        for (auto& child : call->children) args.push_back(lowerExpr(child.get()));
+        emit(IR_SPAWN, args)->name = fnSym->second;
+    }
+    
+    IRInstr* lowerMethod(ASTNode* node, IRInstr* receiver) {
+        const std::string& method = node->children[1]->value;
+        std::vector<IRInstr*> args = {receiver};
+        for (size_t i = 2; i < node->children.size(); i++) args.push_back(lowerExpr(node->children[i].get()));
+        for (auto& m : IR_METHODS) {
+            if (method == m.name && args.size() == m.arity + 1) {
+                IRInstr* call = emit(IR_BUILTIN, args, &m);
+                call->name = m.symbol;
+                return call;
+            }
+        }
+        throw std::runtime_error("Unknown method: " + method);
+    }
+
+    IRInstr* lowerExpr(ASTNode* node) {
+        switch (node->type) {
+            case NODE_LITERAL:
+                return lowerLiteral(node);
+            case NODE_IDENT: {
+                int var = lookup(node->value);
+                if (var < 0) throw std::runtime_error("Undefined variable: " + node->value);
+                return readVar(var, cur);
+            }
+            case NODE_BINARY_OP: {
+                IRInstr* left = lowerExpr(node->children[0].get());
+                IRInstr* right = lowerExpr(node->children[1].get());
+                return emit(binaryOp(node->value), {left, right});
+            }
+            case NODE_FUNC_CALL:
+                return lowerCall(node);
+            case NODE_ARRAY: {
+                std::vector<IRInstr*> elems;
+                for (auto& child : node->children) elems.push_back(lowerExpr(child.get()));
+                IRInstr* arr = emit(IR_ARRAY, elems);
+                arr->noEscape = node->noEscape;
+                arr->fixed = loweringFixed;
+                return arr;
+            }
+            case NODE_OBJECT: {
+                std::vector<IRInstr*> vals;
+                std::vector<std::string> keys;
+                for (auto& child : node->children) {
+                    keys.push_back(child->value);
+                    vals.push_back(lowerExpr(child->children[0].get()));
+                }
+                IRInstr* obj = emit(IR_OBJECT, vals);
+                obj->keys = keys;
+                obj->noEscape = node->noEscape;
+                obj->fixed = loweringFixed;
+                return obj;
+            }
+            case NODE_MEMBER_ACCESS: {
+                if (isStage(node)) return lowerCollect(node);
+                IRInstr* obj = lowerExpr(node->children[0].get());
+                const std::string& member = node->children[1]->value;
+                if (node->value == "call") return lowerMethod(node, obj);
+                if (member == "sort") {
+                    IRInstr* order = node->children.size() > 2 ? lowerExpr(node->children[2].get())
+                                                               : fn->constant(TY_NIL);
+                    return emit(IR_SORT, {obj, order});
+                }
+                IRInstr* get = emit(IR_GET, {obj});
+                get->name = member;
+                return get;
+            }
+            case NODE_INDEX_ACCESS: {
+                IRInstr* arr = lowerExpr(node->children[0].get());
+                IRInstr* idx = lowerExpr(node->children[1].get());
+                return emit(IR_INDEX, {arr, idx});
+            }
+            default:
+                throw std::runtime_error("Unsupported expression");
+        }
+    }
+
+    // --- iteration ---
+
+    // $for x $in source.map(f).filter(g).take(n) is a single loop over the
+    // source: each stage wraps the sink it passes its items on to, and the
+    // loop body is the last sink, so no stage builds an array. Used as a
+    // value, a pipeline collects its items into one new array. A sink gets
+    // each item with the block that leaves the loop, for .take().
+    using Sink = std::function<void(IRInstr* item, IRBlock* exit)>;
+
+    static bool isStage(const ASTNode* node) {
+        if (node->type != NODE_MEMBER_ACCESS || node->value != "call") return false;
+        const std::string& stage = node->children[1]->value;
+        if (stage == "filter") return node->children.size() == 3;     // tables have a filter of three
+        return stage == "map" || stage == "take";
+    }
+
+    static bool isRange(const ASTNode* node) {
+        return node->type == NODE_FUNC_CALL && node->value == "range";
+    }
+
+    // i from `from` while i < bound(), evaluated before every iteration.
+    void lowerCounted(IRInstr* from, const std::function<IRInstr*()>& bound, const Sink& body) {
+        int var = nextVar++;        // has no name, so the body cannot assign it
+        writeVar(var, cur, from);
+        IRBlock* header = fn->newBlock();
+        jump(header);
+        cur = header;
+        IRInstr* i = readVar(var, cur);
+        IRBlock* loop = fn->newBlock();
+        IRBlock* exit = fn->newBlock();
+        branch(emit(IR_LT, {i, bound()}), loop, exit);
+
+        seal(loop);
+        cur = loop;
+        body(i, exit);
+        if (!terminated()) {
+            writeVar(var, cur, emit(IR_ADD, {i, fn->intConstant(1)}));
+            jump(header);
+        }
+        seal(header);
+        seal(exit);
+        cur = exit;
+    }
+
+    // range(end) or range(start, end), counted directly; anything else is
+    // a collection, read by position. Arrays cannot change length, so for
+    // them the bound is invariant, while a dict's keys include any added
+    // during the loop.
+    void lowerSource(ASTNode* node, const Sink& sink) {
+        if (isRange(node)) {
+            size_t n = node->children.size();
+            if (n != 1 && n != 2) throw std::runtime_error("range() takes an end, or a start and an end");
+            IRInstr* from = n == 2 ? lowerExpr(node->children[0].get()) : fn->intConstant(0);
+            IRInstr* to = lowerExpr(node->children.back().get());
+            lowerCounted(from, [&] { return to; }, sink);
+            return;
+        }
+        IRInstr* c = lowerExpr(node);
+        emit(IR_BUILTIN, {c}, &IR_ITERABLE)->name = IR_ITERABLE.symbol;
+        lowerCounted(fn->intConstant(0), [&] { return emit(IR_LEN, {c}); }, [&](IRInstr* i, IRBlock* exit) {
+            sink(emit(IR_ITEM, {c, i}), exit);
+        });
+    }
+
+    void lowerPipeline(ASTNode* node, const Sink& sink) {
+        if (!isStage(node)) {
+            lowerSource(node, sink);
+            return;
+        }
+        ASTNode* source = node->children[0].get();
+        const std::string& stage = node->children[1]->value;
+        if (node->children.size() != 3) throw std::runtime_error(stage + "() takes one argument");
+        ASTNode* arg = node->children[2].get();
+        if (stage == "take") {
+            lowerTake(source, lowerExpr(arg), sink);
+            return;
+        }
+        if (arg->type != NODE_IDENT) throw std::runtime_error(stage + "() takes the name of a function");
+        lowerPipeline(source, [&](IRInstr* x, IRBlock* exit) {
+            IRInstr* y = emitCall(arg->value, {x});
+            if (stage == "map") {
+                sink(y, exit);
+                return;
+            }
+            IRBlock* keep = fn->newBlock();
+            IRBlock* next = fn->newBlock();
+            branch(y, keep, next);
+            seal(keep);
+            cur = keep;
+            sink(x, exit);
+            if (!terminated()) jump(next);
+            seal(next);
+            cur = next;
+        });
+    }
+
+    // Leaves the loop right after the n-th item, so nothing past it is
+    // computed.
+    void lowerTake(ASTNode* source, IRInstr* n, const Sink& sink) {
+        int taken = nextVar++;
+        writeVar(taken, cur, fn->intConstant(0));
+        IRBlock* run = fn->newBlock();
+        IRBlock* done = fn->newBlock();
+        branch(emit(IR_GT, {n, fn->intConstant(0)}), run, done);
+        seal(run);
+        cur = run;
+        lowerPipeline(source, [&](IRInstr* x, IRBlock* exit) {
+            IRInstr* count = emit(IR_ADD, {readVar(taken, cur), fn->intConstant(1)});
+            writeVar(taken, cur, count);
+            sink(x, exit);
+            if (terminated()) return;
+            IRBlock* more = fn->newBlock();
+            branch(emit(IR_LT, {count, n}), more, exit);
+            seal(more);
+            cur = more;
+        });
+        if (!terminated()) jump(done);
+        seal(done);
+        cur = done;
+    }
+
+    IRInstr* lowerCollect(ASTNode* node) {
+        IRInstr* out = emit(IR_ARRAY);
+        lowerPipeline(node, [&](IRInstr* x, IRBlock*) {
+            emit(IR_BUILTIN, {out, x}, &IR_PUSH)->name = IR_PUSH.symbol;
+        });
+        return out;
+    }
+
+    // --- statements ---
+
+    void lowerBody(ASTNode* node) {
+        scopes.emplace_back();
+        if (node->type == NODE_BLOCK) {
+            for (auto& child : node->children) lowerStmt(child.get());
+        } else {
+            lowerStmt(node);
+        }
+        scopes.pop_back();
+    }
+
+    void lowerIf(ASTNode* node) {
+        if (node->children.size() > 3) throw std::runtime_error("$if can only have one $el");
+        IRInstr* cond = lowerExpr(node->children[0].get());
+        IRBlock* then = fn->newBlock();
+        IRBlock* els = node->children.size() > 2 ? fn->newBlock() : nullptr;
+        IRBlock* join = fn->newBlock();
+        branch(cond, then, els ? els : join);
+
+        seal(then);
+        cur = then;
+        lowerBody(node->children[1].get());
+        if (!terminated()) jump(join);
+
+        if (els) {
+            seal(els);
+            cur = els;
+            lowerBody(node->children[2].get());
+            if (!terminated()) jump(join);
+        }
+        seal(join);
+        cur = join;
+    }
+
+    // $match: one IR_SWITCH to a block per arm. Without a `_` arm, a value
+    // that matches no case goes on past the $match.
+    void lowerMatch(ASTNode* node) {
+        IRInstr* subject = lowerExpr(node->children[0].get());
+        IRBlock* join = fn->newBlock();
+        IRInstr* sw = emit(IR_SWITCH, {subject});
+        std::set<std::string> seen;     // ints in decimal, strings quoted
+        ASTNode* other = nullptr;
+        for (size_t a = 1; a < node->children.size(); a++) {
+            ASTNode* arm = node->children[a].get();
+            if (arm->value == "_") {
+                if (other) throw std::runtime_error("$match can only have one _ case");
+                other = arm;
+                continue;
+            }
+            for (size_t i = 0; i + 1 < arm->children.size(); i++) {
+                const std::string& text = arm->children[i]->value;
+                IRCase c;
+                c.arm = sw->arms.size();
+                if (text[0] == '"') {
+                    c.type = TY_STR;
+                    c.str = text.substr(1, text.size() - 2);
+                } else {
+                    c.type = TY_INT;
+                    errno = 0;
+                    c.num = strtoll(text.c_str(), nullptr, 10);
+                    if (errno == ERANGE) throw std::runtime_error("$match case does not fit in 64 bits: " + text);
+                }
+                if (!seen.insert(c.type == TY_INT ? std::to_string(c.num) : text).second) {
+                    throw std::runtime_error("Duplicate $match case: " + text);
+                }
+                sw->cases.push_back(c);
+            }
+            sw->arms.push_back(fn->newBlock());
+        }
+        sw->arms.push_back(other ? fn->newBlock() : join);
+        for (IRBlock* arm : sw->arms) addEdge(cur, arm);
+
+        size_t next = 0;
+        for (size_t a = 1; a < node->children.size(); a++) {
+            ASTNode* arm = node->children[a].get();
+            IRBlock* block = arm == other ? sw->arms.back() : sw->arms[next++];
+            seal(block);
+            cur = block;
+            lowerBody(arm->children.back().get());
+            if (!terminated()) jump(join);
+        }
+        seal(join);
+        cur = join;
+    }
+
+    // cond: header; body ... step: back to header; exit.
+    void lowerLoop(ASTNode* cond, ASTNode* body, ASTNode* step) {
+        IRBlock* header = fn->newBlock();
+        jump(header);
+        cur = header;
+        IRInstr* c = lowerExpr(cond);
+        IRBlock* loop = fn->newBlock();
+        IRBlock* exit = fn->newBlock();
+        branch(c, loop, exit);
+
+        seal(loop);
+        cur = loop;
+        lowerBody(body);
+        if (step && !terminated()) lowerStmt(step);
+        if (!terminated()) jump(header);
+        seal(header);
+        seal(exit);
+        cur = exit;
+    }
+
+    void lowerStmt(ASTNode* node) {
+        if (terminated()) {
+            cur = fn->newBlock();
+            seal(cur);
+        }
+        line = node->line;
+        switch (node->type) {
+            case NODE_VAR_DECL: {
+                bool fixed = node->value.rfind("$fixed_", 0) == 0;
+                // A $fixed at the top level of a module body runs exactly
+                // once, so CodeGen may build its literals at compile time.
+                loweringFixed = fixed && fn->kind != FN_SIGMA && scopes.size() == 1;
+                IRInstr* value = lowerExpr(node->children[0].get());
+                loweringFixed = false;
+                if (fixed) {
+                    std::string name = node->value.substr(7);
+                    if (lookup(name) >= 0) throw std::runtime_error("Cannot reassign constant variable: " + name);
+                    int var = declare(name);
+                    constants.insert(var);
+                    writeVar(var, cur, value);
+                } else {
+                    assign(node->value, value);
+                }
+                break;
+            }
+            case NODE_INPUT: {
+                IRInstr* in = emit(IR_INPUT);
+                in->name = node->children.empty() ? "" : node->children[0]->value.substr(1, node->children[0]->value.size() - 2);
+                assign(node->value, in);
+                break;
+            }
+            case NODE_ASSIGNMENT: {
+                ASTNode* target = node->children[0].get();
+                IRInstr* base = lowerExpr(target->children[0].get());
+                if (target->type == NODE_MEMBER_ACCESS) {
+                    IRInstr* value = lowerExpr(node->children[1].get());
+                    emit(IR_SET, {base, value})->name = target->children[1]->value;
+                } else {
+                    IRInstr* idx = lowerExpr(target->children[1].get());
+                    IRInstr* value = lowerExpr(node->children[1].get());
+                    emit(IR_SET_INDEX, {base, idx, value});
+                }
+                break;
+            }
+            case NODE_UNARY_OP: {
+                ASTNode* target = node->children[0].get();
+                if (target->type == NODE_INDEX_ACCESS) {
+                    IRInstr* base = lowerExpr(target->children[0].get());
+                    IRInstr* idx = lowerExpr(target->children[1].get());
+                    emit(IR_BUILTIN, {base, idx}, &IR_INDEX_INCREMENT)->name = IR_INDEX_INCREMENT.symbol;
+                    break;
+                }
+                const std::string& name = target->value;
+                int var = lookup(name);
+                if (var < 0) throw std::runtime_error("Undefined variable: " + name);
+                IRInstr* one = fn->intConstant(1);
+                assign(name, emit(node->value == "--" ? IR_SUB : IR_ADD, {readVar(var, cur), one}));
+                break;
+            }
+            case NODE_YAP:
+                emit(IR_PRINT, {lowerExpr(node->children[0].get())});
+                break;
+            case NODE_RETURN:
+                if (fn->kind != FN_SIGMA) throw std::runtime_error("return is only allowed inside a function");
+                emit(IR_RETURN, {lowerExpr(node->children[0].get())});
+                break;
+            case NODE_FUNC_CALL:
+            case NODE_MEMBER_ACCESS:
+                lowerExpr(node);
+                break;
+            case NODE_SPAWN:
+                lowerSpawn(node->children[0].get());
+                break;
+            case NODE_IF:
+                lowerIf(node);
+                break;
+            case NODE_MATCH:
+                lowerMatch(node);
+                break;
+            case NODE_WHILE:
+                lowerLoop(node->children[0].get(), node->children[1].get(), nullptr);
+                break;
+            case NODE_FOR: {
+                // The loop variable is always fresh, even if the name is
+                // already in use outside the loop.
+                scopes.emplace_back();
+                ASTNode* init = node->children[0].get();
+                if (init->type == NODE_VAR_DECL) {
+                    writeVar(declare(init->value), cur, lowerExpr(init->children[0].get()));
+                } else {
+                    lowerStmt(init);
+                }
+                lowerLoop(node->children[1].get(), node->children[3].get(), node->children[2].get());
+                scopes.pop_back();
+                break;
+            }
+            case NODE_FOR_IN:
+                lowerPipeline(node->children[0].get(), [&](IRInstr* x, IRBlock*) {
+                    scopes.emplace_back();
+                    writeVar(declare(node->value), cur, x);
+                    lowerBody(node->children[1].get());
+                    scopes.pop_back();
+                });
+                break;
+            case NODE_TRY_CATCH: {
+                // The handler's predecessors are the checks in the body, so
+                // it sees each variable as it was when the error was raised.
+                IRBlock* handler = fn->newBlock();
+                IRBlock* join = fn->newBlock();
+                handlers.push_back(handler);
+                lowerBody(node->children[0].get());
+                handlers.pop_back();
+                if (!terminated()) jump(join);
+                seal(handler);
+                cur = handler;
+                IRInstr* err = emit(IR_CATCH);
+                if (node->children.size() > 1) {
+                    scopes.emplace_back();
+                    writeVar(declare(node->children[1]->value), cur, err);
+                    lowerBody(node->children[1].get());
+                    scopes.pop_back();
+                }
+                if (!terminated()) jump(join);
+                seal(join);
+                cur = join;
+                break;
+            }
+            case NODE_FUNC_DECL:
+                throw std::runtime_error("Functions can only be declared at the top level of a module");
+            case NODE_USE:
+                throw std::runtime_error("$use is only allowed at the top level of a module");
+            default:
+                break;
+        }
+    }
+
+    IRFunction* begin(IRModule& out, const std::string& name, IRFunctionKind kind) {
+        out.functions.push_back(std::make_unique<IRFunction>());
+        fn = out.functions.back().get();
+        fn->name = name;
+        fn->kind = kind;
+        cur = fn->newBlock();
+        seal(cur);
+        scopes.clear();
+        scopes.emplace_back();
+        constants.clear();
+        return fn;
+    }
+
+    void lowerFunction(IRModule& out, ASTNode* node) {
+        begin(out, mod.functions.at(node->value), FN_SIGMA);
+        size_t paramCount = node->children.size() - 1;
+        for (size_t i = 0; i < paramCount; i++) {
+            fn->params.push_back(node->children[i]->value);
+            IRInstr* param = fn->make(IR_PARAM);
+            param->num = i;
+            param->type = TY_ANY;
+            fn->paramValues.push_back(param);
+            writeVar(declare(node->children[i]->value), cur, param);
+        }
+        lowerBody(node->children.back().get());
+        if (!terminated()) emit(IR_RETURN, {fn->constant(TY_NIL)});
+    }
+
+public:
+    IRBuilder(const ModuleInfo& info) : mod(info) {}
+
+    // One function per Sigma function, then the module body.
+    IRModule lower(ASTNode* root) {
+        IRModule out;
+        for (auto& child : root->children) {
+            if (child->type == NODE_FUNC_DECL) lowerFunction(out, child.get());
+        }
+        begin(out, mod.isMain ? "main" : "sigma_init_" + mod.id, mod.isMain ? FN_MAIN : FN_INIT);
+        for (auto& child : root->children) {
+            if (child->type != NODE_FUNC_DECL && child->type != NODE_USE) lowerStmt(child.get());
+        }
+        if (!terminated()) emit(IR_RETURN);
+        return out;
+    }
+};
+
+// --- textual dump (sig --emit-ir) ---
+
+const char* irOpName(IROp op) {
+    static const char* names[] = {
+        "const", "param", "str", "phi",
+        "add", "sub", "mul", "div", "mod",
+        "eq", "strict_eq", "ne", "lt", "gt", "le", "ge",
+        "and", "or",
+        "builtin", "call", "spawn", "array", "object", "get", "index", "set", "set_index", "sort",
+        "len", "is_array", "elem", "set_elem", "item",
+        "print", "input", "catch", "jump", "br", "switch", "check", "ret",
+    };
+    return names[op];
+}
+
+const char* irTypeName(IRType type) {
+    static const char* names[] = {"?", "int", "dec", "num", "bool", "str", "arr", "obj", "dict", "f64[]", "i64[]", "u8[]", "nil", "any", "void"};
+    return names[type];
+}
+
+std::string irOperand(const IRInstr* v) {
+    if (v->op == IR_PARAM) return "%" + std::to_string((int)v->num);
+    if (v->op != IR_CONST) return "v" + std::to_string(v->id);
+    if (v->type == TY_NIL) return "nil";
+    if (v->type == TY_BOOL) return v->num ? "true" : "false";
+    if (v->type == TY_INT) return std::to_string(v->inum);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.17g", v->num);
+    std::string s = buf;
+    if (s.find_first_of(".en") == std::string::npos) s += ".0";
+    return s;
+}
+
+void printIR(const IRFunction& fn, std::ostream& out) {
+    out << "function " << fn.name << "(";
+    for (size_t i = 0; i < fn.params.size(); i++) {
+        out << (i ? ", %" : "%") << i << " " << fn.params[i];
+        if (fn.paramValues[i]->type != TY_ANY) out << ": " << irTypeName(fn.paramValues[i]->type);
+    }
+    out << ")";
+    if (fn.kind == FN_SIGMA) out << " -> " << irTypeName(fn.returnType);
+    out << "\n";
+    for (auto& block : fn.blocks) {
+        out << "b" << block->id << ":";
+        if (!block->preds.empty()) {
+            out << "  ; preds";
+            for (IRBlock* p : block->preds) out << " b" << p->id;
+        }
+        out << "\n";
+        for (IRInstr* in : block->instrs) {
+            out << "    ";
+            if (in->type != TY_VOID && !irIsTerminator(in->op)) out << "v" << in->id << ": " << irTypeName(in->type) << " = ";
+            out << irOpName(in->op);
+            if (in->op == IR_STR || in->op == IR_INPUT) out << " \"" << in->name << "\"";
+            else if (in->op == IR_GET || in->op == IR_SET || in->op == IR_CALL || in->op == IR_SPAWN ||
+                     in->op == IR_BUILTIN) out << " " << in->name;
+            else if (in->op == IR_OBJECT) {
+                out << " {";
+                for (size_t i = 0; i < in->keys.size(); i++) out << (i ? ", " : "") << in->keys[i];
+                out << "}";
+            }
+            if ((in->op == IR_ARRAY || in->op == IR_OBJECT) && in->noEscape) out << " stack";
+            if ((in->op == IR_ARRAY || in->op == IR_OBJECT) && in->fixed) out << " fixed";
+            for (size_t i = 0; i < in->args.size(); i++) out << (i ? ", " : " ") << irOperand(in->args[i]);
+            if (in->op == IR_JUMP) out << " b" << in->targets[0]->id;
+            if (in->op == IR_BRANCH) out << ", b" << in->targets[0]->id << ", b" << in->targets[1]->id;
+            if (in->op == IR_CHECK) out << " b" << in->targets[0]->id << ", b" << in->targets[1]->id;
+            if (in->op == IR_SWITCH) {
+                for (const IRCase& c : in->cases) {
+                    out << ", ";
+                    if (c.type == TY_INT) out << c.num;
+                    else out << "\"" << c.str << "\"";
+                    out << " b" << in->arms[c.arm]->id;
+                }
+                out << ", _ b" << in->arms.back()->id;
+            }
+            out << "\n";
+        }
+    }
+    out << "\n";
+}
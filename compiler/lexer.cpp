@@ -7,6 +7,7 @@
 class Lexer {
     std::string src;
     size_t pos = 0;
+    size_t end;
     int line = 1, col = 1;
     
     std::map<std::string, TokenType> keywords = {
@@ -15,7 +16,8 @@ class Lexer {
         {"$if", TOK_IF}, {"$el", TOK_EL}, {"$for", TOK_FOR}, 
         {"$while", TOK_WHILE}, {"$time_start", TOK_TIME_START},
         {"$time_end", TOK_TIME_END}, {"$fixed", TOK_FIXED},
-        {"$try", TOK_TRY}, {"catch", TOK_CATCH}, {"$in", TOK_IN}
+        {"$try", TOK_TRY}, {"catch", TOK_CATCH}, {"$in", TOK_IN},
+        {"$use", TOK_USE}, {"$spawn", TOK_SPAWN}, {"$match", TOK_MATCH}
     };
     
     char peek() { return pos < src.size() ? src[pos] : '\0'; }
@@ -28,7 +30,9 @@ class Lexer {
         }
     }
     
-    void skipComment() {
+    // Skips a comment at pos, if there is one, up to the newline that ends
+    // it; returns whether it did.
+    bool skipComment() {
         if (peek() == '-' && pos + 1 < src.size() && src[pos + 1] == '-') {
             if (pos + 2 < src.size() && src[pos + 2] == '-') {
                 // Multi-line comment
@@ -45,13 +49,21 @@ class Lexer {
                 // Single-line comment
                 while (peek() != '\n' && peek() != '\0') advance();
             }
+            return true;
         }
+        return false;
     }
     
+    // Digits only: an exact 64-bit integer (TOK_INT). With a decimal point:
+    // a double (TOK_NUMBER).
     Token number() {
         std::string num;
-        while (isdigit(peek()) || peek() == '.') num += advance();
-        return {TOK_NUMBER, num, line, col};
+        bool dec = false;
+        while (isdigit(peek()) || peek() == '.') {
+            if (peek() == '.') dec = true;
+            num += advance();
+        }
+        return {dec ? TOK_NUMBER : TOK_INT, num, line, col};
     }
     
     Token string() {
@@ -83,17 +95,24 @@ class Lexer {
     }
     
 public:
-    Lexer(std::string source) : src(source) {}
+    Lexer(std::string source) : src(source), end(src.size()) {}
+    
+    // Lexes only the tokens that start in [start, end), which must begin at
+    // a token boundary on line `startLine` (sig watch re-lexes the edited
+    // part of a file this way).
+    Lexer(std::string source, size_t start, int startLine, size_t end)
+        : src(source), pos(start), end(end), line(startLine) {}
     
     std::vector<Token> tokenize() {
         std::vector<Token> tokens;
         
         while (pos < src.size()) {
             skipWhitespace();
-            skipComment();
-            if (pos >= src.size()) break;
+            if (skipComment()) continue;
+            if (pos >= src.size() || pos >= end) break;
             
             char c = peek();
+            size_t start = pos, count = tokens.size();
             
             if (isdigit(c)) tokens.push_back(number());
             else if (c == '"') tokens.push_back(string());
@@ -136,6 +155,7 @@ public:
             else if (c == '-') { advance(); tokens.push_back({TOK_MINUS, "-", line, col}); }
             else if (c == '*') { advance(); tokens.push_back({TOK_STAR, "*", line, col}); }
             else if (c == '/') { advance(); tokens.push_back({TOK_SLASH, "/", line, col}); }
+            else if (c == '%') { advance(); tokens.push_back({TOK_PERCENT, "%", line, col}); }
             else if (c == '<') { advance(); tokens.push_back({TOK_LT, "<", line, col}); }
             else if (c == '>') { advance(); tokens.push_back({TOK_GT, ">", line, col}); }
             else if (c == '(') { advance(); tokens.push_back({TOK_LPAREN, "(", line, col}); }
@@ -147,9 +167,10 @@ public:
             else if (c == ',') { advance(); tokens.push_back({TOK_COMMA, ",", line, col}); }
             else if (c == '.') { advance(); tokens.push_back({TOK_DOT, ".", line, col}); }
             else { advance(); }
+            if (tokens.size() > count) tokens.back().offset = start;
         }
         
-        tokens.push_back({TOK_EOF, "", line, col});
+        tokens.push_back({TOK_EOF, "", line, col, pos});
         return tokens;
     }
 };
\ No newline at end of file
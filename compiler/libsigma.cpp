@@ -0,0 +1,176 @@
+// libsigma: the compiler as a library (see include/sigma.h).
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <dlfcn.h>
+#include <unistd.h>
+#include "lexer.cpp"
+#include "parser.cpp"
+#include "escape.cpp"
+#include "ir.cpp"
+#include "opt.cpp"
+#include "ipo.cpp"
+#include "codegen.cpp"
+#include "stats.cpp"
+#include "modules.cpp"
+#include "../include/sigma.h"
+
+// As in sigma_rt.h.
+struct SigmaExport {
+    const char* name;
+    void* fn;
+    int arity;
+};
+
+typedef int (*SigmaReport)(char*, size_t);
+
+struct sigma_function {
+    void* fn;
+    int arity;
+    SigmaReport report;     // the library's sigma_error_report
+};
+
+struct sigma_module {
+    void* handle;
+    std::unordered_map<std::string, sigma_function> functions;
+    sigma_value (*makeString)(const char*);
+};
+
+static thread_local std::string sigmaLastError;
+
+static_assert(sizeof(sigma_value) == 16 && offsetof(sigma_value, as) == 8, "sigma_value must match SigmaValue");
+
+static sigma_value sigmaFail(const std::string& message) {
+    sigmaLastError = message;
+    return sigma_nil();
+}
+
+static sigma_module* sigmaOpen(const std::string& path) {
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        sigmaLastError = dlerror();
+        return nullptr;
+    }
+    auto exports = (const SigmaExport*)dlsym(handle, "sigma_exports");
+    auto init = (void (*)(void))dlsym(handle, "sigma_library_init");
+    auto makeString = (sigma_value(*)(const char*))dlsym(handle, "sigma_make_string");
+    auto report = (SigmaReport)dlsym(handle, "sigma_error_report");
+    if (!exports || !init || !makeString || !report) {
+        sigmaLastError = path + " is not a Sigma library (build it with sig --shared)";
+        dlclose(handle);
+        return nullptr;
+    }
+    init();
+    char error[512];
+    if (report(error, sizeof(error))) {
+        sigmaLastError = std::string("Error: ") + error;
+        dlclose(handle);
+        return nullptr;
+    }
+    auto module = new sigma_module{handle, {}, makeString};
+    for (const SigmaExport* e = exports; e->name; e++) module->functions[e->name] = {e->fn, e->arity, report};
+    return module;
+}
+
+// A function that fails returns nil with the error pending; take it, so
+// that a nil result with an empty sigma_last_error() means success.
+static sigma_value sigmaResult(const sigma_function* fn, sigma_value result) {
+    if (result.type != SIGMA_NIL) return result;
+    char error[512];
+    if (fn->report(error, sizeof(error))) sigmaLastError = error;
+    else sigmaLastError.clear();
+    return result;
+}
+
+extern "C" {
+
+sigma_module* sigma_compile(const char* sgm_path) {
+    // Link into a fresh file and unlink it once loaded, so that modules
+    // compiled from the same source never share a dlopen handle.
+    char so[] = "/tmp/sigma-lib-XXXXXX.so";
+    int fd = mkstemps(so, 3);
+    if (fd < 0) {
+        sigmaLastError = "Cannot create a temporary library file";
+        return nullptr;
+    }
+    close(fd);
+    try {
+        PassStats stats;
+        ModuleGraph graph;
+        graph.load(sgm_path, stats, false);
+        graph.optimize(stats, true);
+        graph.generate(stats, false);
+        Builder builder;
+        builder.shared = true;
+        if (!builder.build(graph, so, stats)) throw std::runtime_error("Compilation failed: " + std::string(sgm_path));
+    } catch (std::exception& e) {
+        unlink(so);
+        sigmaLastError = e.what();
+        return nullptr;
+    }
+    sigma_module* module = sigmaOpen(so);
+    unlink(so);
+    return module;
+}
+
+sigma_module* sigma_load(const char* so_path) {
+    // dlopen only searches the library path for names without a slash.
+    std::string path = so_path;
+    if (path.find('/') == std::string::npos) path = "./" + path;
+    return sigmaOpen(path);
+}
+
+void sigma_unload(sigma_module* module) {
+    if (!module) return;
+    // Worker threads run the library's code for as long as the process lives.
+    auto started = (int (*)(void))dlsym(module->handle, "sigma_tasks_started");
+    if (!started || !started()) dlclose(module->handle);
+    delete module;
+}
+
+const sigma_function* sigma_function_get(const sigma_module* module, const char* name) {
+    auto it = module->functions.find(name);
+    if (it == module->functions.end()) {
+        sigmaLastError = std::string("No function named ") + name;
+        return nullptr;
+    }
+    return &it->second;
+}
+
+int sigma_function_arity(const sigma_function* fn) {
+    return fn->arity;
+}
+
+sigma_value sigma_invoke(const sigma_function* fn, const sigma_value* args, int argc) {
+    if (argc != fn->arity) return sigmaFail("Expected " + std::to_string(fn->arity) + " arguments, got " + std::to_string(argc));
+    typedef sigma_value V;
+    const V* a = args;
+    switch (argc) {
+        case 0: return sigmaResult(fn, ((V(*)())fn->fn)());
+        case 1: return sigmaResult(fn, ((V(*)(V))fn->fn)(a[0]));
+        case 2: return sigmaResult(fn, ((V(*)(V, V))fn->fn)(a[0], a[1]));
+        case 3: return sigmaResult(fn, ((V(*)(V, V, V))fn->fn)(a[0], a[1], a[2]));
+        case 4: return sigmaResult(fn, ((V(*)(V, V, V, V))fn->fn)(a[0], a[1], a[2], a[3]));
+        case 5: return sigmaResult(fn, ((V(*)(V, V, V, V, V))fn->fn)(a[0], a[1], a[2], a[3], a[4]));
+        case 6: return sigmaResult(fn, ((V(*)(V, V, V, V, V, V))fn->fn)(a[0], a[1], a[2], a[3], a[4], a[5]));
+        case 7: return sigmaResult(fn, ((V(*)(V, V, V, V, V, V, V))fn->fn)(a[0], a[1], a[2], a[3], a[4], a[5], a[6]));
+        case 8: return sigmaResult(fn, ((V(*)(V, V, V, V, V, V, V, V))fn->fn)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]));
+        default: return sigmaFail("Functions with more than 8 parameters cannot be called through libsigma");
+    }
+}
+
+sigma_value sigma_call(const sigma_module* module, const char* name, const sigma_value* args, int argc) {
+    const sigma_function* fn = sigma_function_get(module, name);
+    if (!fn) return sigma_nil();
+    return sigma_invoke(fn, args, argc);
+}
+
+sigma_value sigma_string(const sigma_module* module, const char* s) {
+    return module->makeString(s);
+}
+
+const char* sigma_last_error(void) {
+    return sigmaLastError.c_str();
+}
+
+}
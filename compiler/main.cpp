@@ -2,63 +2,155 @@
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
+#include <sys/wait.h>
 #include "lexer.cpp"
 #include "parser.cpp"
+#include "escape.cpp"
+#include "ir.cpp"
+#include "opt.cpp"
+#include "ipo.cpp"
 #include "codegen.cpp"
+#include "stats.cpp"
+#include "modules.cpp"
+#include "watch.cpp"
 
-std::string readFile(std::string path) {
-    std::ifstream file(path);
-    std::stringstream buf;
-    buf << file.rdbuf();
-    return buf.str();
-}
-
-void writeFile(std::string path, std::string content) {
-    std::ofstream file(path);
-    file << content;
+void usage() {
+    std::cerr << "Usage: sig [options] <file.sgm>\n";
+    std::cerr << "       sig watch [options] <file.sgm>   rebuild and rerun on every save\n";
+    std::cerr << "  -o <output>          write the executable to <output> instead of running it\n";
+    std::cerr << "  --shared             with -o: build a shared library for libsigma (sigma_load)\n";
+    std::cerr << "  -j <jobs>            compile up to <jobs> modules in parallel (default: all cores)\n";
+    std::cerr << "  --time-passes        report wall/CPU time per compiler stage on stderr\n";
+    std::cerr << "  --stats-json[=file]  write stage timings and counts as JSON (default: stderr)\n";
+    std::cerr << "  --mem-stats[=json]   profile allocations per source line; report on stderr at exit\n";
+    std::cerr << "  --emit-ir            print the optimized IR of every module and stop\n";
+    std::cerr << "  --emit-c             print the generated C of every module and stop\n";
+    std::cerr << "  --no-ir-opt          skip the IR optimizations (inlining, CSE, LICM, DCE, ...)\n";
 }
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
-        std::cerr << "Usage: sig <file.sgm>\n";
+    std::string filename;
+    std::string outputFile;
+    bool timePasses = false;
+    bool statsJson = false;
+    std::string statsJsonFile;
+    bool emitIR = false;
+    bool emitC = false;
+    bool irOpt = true;
+    bool memStats = false;
+    bool watch = argc > 1 && std::string(argv[1]) == "watch";
+    Builder builder;
+    
+    for (int i = watch ? 2 : 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else if (arg == "-j" && i + 1 < argc) {
+            builder.jobs = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--shared") {
+            builder.shared = true;
+        } else if (arg == "--time-passes") {
+            timePasses = true;
+        } else if (arg == "--stats-json") {
+            statsJson = true;
+        } else if (arg.rfind("--stats-json=", 0) == 0) {
+            statsJson = true;
+            statsJsonFile = arg.substr(13);
+        } else if (arg == "--mem-stats" || arg == "--mem-stats=json") {
+            memStats = true;
+            builder.cflags.push_back(arg == "--mem-stats" ? "-DSIGMA_MEM_STATS=1" : "-DSIGMA_MEM_STATS=2");
+        } else if (arg == "--emit-ir") {
+            emitIR = true;
+        } else if (arg == "--emit-c") {
+            emitC = true;
+        } else if (arg == "--no-ir-opt") {
+            irOpt = false;
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage();
+            return 1;
+        } else {
+            filename = arg;
+        }
+    }
+    
+    if (filename.empty() || (builder.shared && outputFile.empty()) || (watch && (emitIR || emitC))) {
+        usage();
         return 1;
     }
     
-    std::string filename = argv[1];
-    std::string source = readFile(filename);
+    PassStats stats;
+    auto report = [&]() {
+        if (timePasses) stats.printTable(std::cerr);
+        if (statsJson) {
+            if (statsJsonFile.empty()) {
+                stats.printJson(std::cerr);
+            } else {
+                std::ofstream out(statsJsonFile);
+                stats.printJson(out);
+            }
+        }
+    };
+    
+    if (watch) {
+        Watcher watcher(filename, builder);
+        watcher.output = outputFile;
+        watcher.memStats = memStats;
+        watcher.report = [&](PassStats& round) {
+            stats = round;
+            report();
+        };
+        return watcher.run();
+    }
     
     try {
-        // Lexing
-        Lexer lexer(source);
-        auto tokens = lexer.tokenize();
-        
-        // Parsing
-        Parser parser(tokens);
-        auto ast = parser.parse();
+        // Read, lex and parse the entry file and every module it uses
+        ModuleGraph graph;
+        graph.load(filename, stats, !builder.shared);
         
-        // Code Generation
-        CodeGen codegen;
-        std::string cCode = codegen.generate(ast.get());
+        // Lower to IR and optimize
+        graph.optimize(stats, irOpt);
+        if (emitIR) {
+            graph.printIR(std::cout);
+            report();
+            return 0;
+        }
         
-        // Write C code to temp file
-        std::string tempFile = "/tmp/sigma_temp.c";
-        writeFile(tempFile, cCode);
+        // Code Generation: one C translation unit and header per module
+        graph.generate(stats, memStats);
+        if (emitC) {
+            graph.printC(std::cout);
+            report();
+            return 0;
+        }
         
-        // Compile with GCC
-        std::string compileCmd = "gcc -O3 " + tempFile + " -o /tmp/sigma_out -lm";
-        int compileResult = system(compileCmd.c_str());
+        // Compile changed modules in parallel, then link
+        std::string exeFile = outputFile.empty() ? "/tmp/sigma_out" : outputFile;
+        bool built = builder.build(graph, exeFile, stats);
+        stats.count("gcc_ms", (long long)(stats.wallMs("gcc") + stats.wallMs("link")));
         
-        if (compileResult != 0) {
+        if (!built) {
             std::cerr << "Compilation failed!\n";
+            report();
             return 1;
         }
         
+        if (!outputFile.empty()) {
+            report();
+            return 0;
+        }
+        
         // Run the compiled program
-        int runResult = system("/tmp/sigma_out");
+        int runResult;
+        {
+            auto t = stats.childPass("run");
+            runResult = system(exeFile.c_str());
+        }
+        report();
         
-        return runResult;
+        return WIFEXITED(runResult) ? WEXITSTATUS(runResult) : 1;
     } catch (std::exception& e) {
         std::cerr << "Error: " << e.what() << "\n";
+        report();
         return 1;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,685 @@
+#include "../include/ast.h"
+#include "sigma_rt_embed.h"
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace fs = std::filesystem;
+
+// sig watch compiles a module as several small translation units, named
+// after the C symbol of their first function.
+struct Shard {
+    std::string name;
+    std::string source;
+};
+
+// One `.sgm` file: its syntax tree, its direct imports and, once lowered, its
+// IR and the C translation unit and header CodeGen produced for it.
+struct Module {
+    std::string path;                  // canonical path of the .sgm file
+    std::unique_ptr<ASTNode> ast;
+    std::vector<Module*> imports;      // direct `$use` dependencies
+    ModuleInfo info;
+    IRModule ir;
+    std::string header;
+    std::string source;
+    std::vector<Shard> shards;         // instead of `source`, for sig watch
+};
+
+// Keeps each file's text and top-level statements between builds, so that
+// sig watch re-lexes and re-parses only the statements an edit touched. The
+// old and new text share a prefix and a suffix: statements wholly inside
+// them are reused, those after the edit moved to their new lines, and only
+// the text in between is parsed again. So is the statement before the edit,
+// since the parser decided where it ends by looking at the token after it.
+// Anything that does not splice cleanly falls back to parsing the file.
+class ParseCache {
+    struct File {
+        std::string text;
+        std::vector<size_t> starts;     // source offset of each top-level statement
+        std::unique_ptr<ASTNode> ast;   // while no ModuleGraph holds it
+    };
+    std::map<std::string, File> files;
+
+    // Escape analysis runs again on reused statements, and only ever sets
+    // noEscape, so the old verdicts are cleared.
+    static void reuse(ASTNode* node, int shift) {
+        node->noEscape = false;
+        if (node->line) node->line += shift;
+        for (auto& child : node->children) reuse(child.get(), shift);
+    }
+
+    static std::unique_ptr<ASTNode> parseAll(const std::string& text, std::vector<size_t>& starts, PassStats& stats) {
+        std::vector<Token> tokens;
+        {
+            auto t = stats.pass("lex");
+            tokens = Lexer(text).tokenize();
+        }
+        stats.count("tokens", tokens.size());
+        auto t = stats.pass("parse");
+        auto root = std::make_unique<ASTNode>(NODE_PROGRAM);
+        size_t stop;
+        root->children = Parser(tokens).parseStatements(text.size(), starts, stop);
+        stats.count("statements_reparsed", root->children.size());
+        return root;
+    }
+
+    // Null if the edit cannot be spliced into the old tree, which is then
+    // left as it was.
+    std::unique_ptr<ASTNode> reparse(File& f, const std::string& text, std::vector<size_t>& starts, PassStats& stats) {
+        auto& stmts = f.ast->children;
+        size_t count = stmts.size();
+        const std::string& old = f.text;
+        size_t n = old.size(), m = text.size();
+        size_t pre = 0, suf = 0;
+        while (pre < n && pre < m && old[pre] == text[pre]) pre++;
+        while (suf < n - pre && suf < m - pre && old[n - 1 - suf] == text[m - 1 - suf]) suf++;
+        if (count == 0) return nullptr;
+
+        // Statements [first, last) are parsed again: from the one before
+        // the statement the edit starts in, up to the first that starts in
+        // the unchanged suffix.
+        size_t first = count, last = count;
+        if (n != m || pre != n) {
+            size_t edited = 0;
+            while (edited + 1 < count && f.starts[edited + 1] <= pre) edited++;
+            first = edited > 0 ? edited - 1 : 0;
+            last = edited + 1;
+            while (last < count && f.starts[last] < n - suf) last++;
+        }
+        size_t begin = first == 0 ? 0 : first < count ? f.starts[first] : m;
+        size_t end = last < count ? f.starts[last] + m - n : m;
+
+        // Lexing stops after the token at `end`, which the parser has to
+        // see to know that the last statement before it is complete.
+        std::vector<Token> tokens;
+        {
+            auto t = stats.pass("lex");
+            int line = first == 0 ? 1 : first < count ? stmts[first]->line : 0;
+            tokens = Lexer(text, begin, line, end + 1).tokenize();
+        }
+        stats.count("tokens", tokens.size());
+        std::vector<size_t> region;
+        std::vector<std::unique_ptr<ASTNode>> parsed;
+        size_t stop;
+        {
+            auto t = stats.pass("parse");
+            parsed = Parser(tokens).parseStatements(end, region, stop);
+        }
+        if (stop != end) return nullptr;
+        int shift = 0;
+        if (last < count) shift = tokens[tokens.size() - 2].line - stmts[last]->line;
+
+        auto root = std::make_unique<ASTNode>(NODE_PROGRAM);
+        for (size_t i = 0; i < first; i++) {
+            reuse(stmts[i].get(), 0);
+            root->children.push_back(std::move(stmts[i]));
+            starts.push_back(f.starts[i]);
+        }
+        for (size_t i = 0; i < parsed.size(); i++) {
+            root->children.push_back(std::move(parsed[i]));
+            starts.push_back(region[i]);
+        }
+        for (size_t i = last; i < count; i++) {
+            reuse(stmts[i].get(), shift);
+            root->children.push_back(std::move(stmts[i]));
+            starts.push_back(f.starts[i] + m - n);
+        }
+        f.ast.reset();
+        stats.count("statements_reparsed", parsed.size());
+        stats.count("statements_reused", count - (last - first));
+        return root;
+    }
+
+public:
+    // The syntax tree of `text`, the new contents of the file at `path`.
+    // Throws on syntax errors, and then keeps what it had for the next try.
+    std::unique_ptr<ASTNode> parse(const std::string& path, const std::string& text, PassStats& stats) {
+        File& f = files[path];
+        std::vector<size_t> starts;
+        std::unique_ptr<ASTNode> ast;
+        if (f.ast) {
+            try {
+                ast = reparse(f, text, starts, stats);
+            } catch (std::exception&) {
+                // reported by the full parse below
+            }
+        }
+        if (!ast) {
+            starts.clear();
+            ast = parseAll(text, starts, stats);
+        }
+        f.text = text;
+        f.starts = std::move(starts);
+        return ast;
+    }
+
+    // Takes back the tree `parse` returned once the build is done with it.
+    void keep(const std::string& path, std::unique_ptr<ASTNode> ast) {
+        auto it = files.find(path);
+        if (it != files.end()) it->second.ast = std::move(ast);
+    }
+};
+
+// Loads the entry file and everything it `$use`s, transitively. Modules are
+// kept in dependency order: every module comes after the modules it imports,
+// and the entry module is last.
+class ModuleGraph {
+    std::map<std::string, Module*> byPath;
+    std::set<std::string> loading;
+    std::set<std::string> ids = {"main", "sigma_rt", "sigma_lib", "sigma_lines"};   // reserved file names
+
+    static std::string readSource(const std::string& path) {
+        std::ifstream file(path);
+        if (!file) throw std::runtime_error("Cannot open module: " + path);
+        std::stringstream buf;
+        buf << file.rdbuf();
+        return buf.str();
+    }
+
+    std::string uniqueId(const std::string& path) {
+        std::string base = fs::path(path).stem().string();
+        std::string id;
+        for (char c : base) id += isalnum((unsigned char)c) ? c : '_';
+        if (id.empty() || isdigit((unsigned char)id[0])) id = "m_" + id;
+        std::string candidate = id;
+        for (int n = 2; ids.count(candidate); n++) {
+            candidate = id + "_" + std::to_string(n);
+        }
+        ids.insert(candidate);
+        return candidate;
+    }
+
+    Module* load(const std::string& rawPath, bool isMain, PassStats& stats) {
+        std::string path = fs::weakly_canonical(fs::path(rawPath)).string();
+        auto found = byPath.find(path);
+        if (found != byPath.end()) return found->second;
+        if (loading.count(path)) throw std::runtime_error("Circular $use of module: " + path);
+        loading.insert(path);
+
+        auto mod = std::make_unique<Module>();
+        mod->path = path;
+
+        std::string source;
+        {
+            auto t = stats.pass("read");
+            source = readSource(path);
+        }
+        stats.count("source_bytes", source.size());
+
+        if (parseCache) {
+            mod->ast = parseCache->parse(path, source, stats);
+        } else {
+            std::vector<Token> tokens;
+            {
+                auto t = stats.pass("lex");
+                Lexer lexer(source);
+                tokens = lexer.tokenize();
+            }
+            stats.count("tokens", tokens.size());
+
+            auto t = stats.pass("parse");
+            Parser parser(tokens);
+            mod->ast = parser.parse();
+        }
+        stats.count("ast_nodes", countNodes(mod->ast.get()));
+
+        fs::path dir = fs::path(path).parent_path();
+        for (auto& child : mod->ast->children) {
+            if (child->type != NODE_USE) continue;
+            Module* dep = load((dir / child->value).string(), false, stats);
+            mod->imports.push_back(dep);
+        }
+
+        mod->info.isMain = isMain;
+        mod->info.id = isMain ? "main" : uniqueId(path);
+        mod->info.file = fs::path(path).filename().string();
+
+        loading.erase(path);
+        Module* raw = mod.get();
+        byPath[path] = raw;
+        modules.push_back(std::move(mod));
+        return raw;
+    }
+
+    // Resolve which C symbol each callable name refers to. A module sees its
+    // own functions and the functions of the modules it imports directly.
+    void resolveSymbols() {
+        for (auto& mod : modules) {
+            for (auto& child : mod->ast->children) {
+                if (child->type != NODE_FUNC_DECL) continue;
+                if (mod->info.functions.count(child->value)) {
+                    throw std::runtime_error("Function '" + child->value + "' is defined twice in " + mod->path);
+                }
+                mod->info.functions[child->value] = "sg_" + mod->info.id + "__" + child->value;
+                mod->info.arities[child->value] = child->children.size() - 1;
+            }
+        }
+        for (auto& mod : modules) {
+            std::map<std::string, std::string> own = mod->info.functions;
+            std::map<std::string, Module*> from;
+            for (Module* dep : mod->imports) {
+                mod->info.imports.push_back(dep->info.id);
+                for (auto& child : dep->ast->children) {
+                    if (child->type != NODE_FUNC_DECL || own.count(child->value)) continue;
+                    auto prev = from.find(child->value);
+                    if (prev != from.end() && prev->second != dep) {
+                        throw std::runtime_error("Function '" + child->value + "' is imported from both " +
+                                                 prev->second->path + " and " + dep->path);
+                    }
+                    from[child->value] = dep;
+                    mod->info.functions[child->value] = dep->info.functions.at(child->value);
+                    mod->info.arities[child->value] = dep->info.arities.at(child->value);
+                }
+            }
+        }
+        Module* entry = modules.back().get();
+        for (auto& mod : modules) {
+            if (mod.get() != entry) entry->info.initOrder.push_back(mod->info.id);
+        }
+    }
+
+public:
+    std::vector<std::unique_ptr<Module>> modules;
+    // sig watch: reuse the syntax trees of the statements an edit left alone.
+    ParseCache* parseCache = nullptr;
+    // Libraries only: C source of the unit that exports the entry module's
+    // functions (see generateLibrary).
+    std::string library;
+    // sig watch: C source of the unit that holds every shard's line table.
+    std::string lines;
+
+    // A program's entry module becomes main(); a library's is initialized
+    // like any other module, by sigma_library_init.
+    void load(const std::string& entryPath, PassStats& stats, bool program = true) {
+        load(entryPath, program, stats);
+        resolveSymbols();
+        stats.count("modules", modules.size());
+    }
+
+    // Lower every module to IR and optimize it (or only analyse it, which
+    // CodeGen needs either way).
+    void optimize(PassStats& stats, bool enabled) {
+        {
+            auto t = stats.pass("escape");
+            for (auto& mod : modules) EscapeAnalysis().run(mod->ast.get());
+        }
+        {
+            auto t = stats.pass("lower");
+            for (auto& mod : modules) mod->ir = IRBuilder(mod->info).lower(mod->ast.get());
+        }
+        auto t = stats.pass("optimize");
+        for (auto& mod : modules) {
+            ModuleOptimizer opt(mod->ir);
+            opt.run(enabled);
+            stats.count("inlined", opt.inlined);
+            stats.count("specialized", opt.specialized);
+            stats.count("checks_removed", opt.checksRemoved);
+            stats.count("cse_removed", opt.cseRemoved);
+            stats.count("licm_hoisted", opt.hoisted);
+            stats.count("dce_removed", opt.dceRemoved);
+            for (auto& fn : mod->ir.functions) {
+                long long instrs = 0;
+                for (auto& block : fn->blocks) instrs += block->instrs.size();
+                stats.count("ir_instrs", instrs);
+            }
+        }
+    }
+
+    void printIR(std::ostream& out) {
+        for (auto& mod : modules) {
+            out << "; module " << mod->info.id << " (" << mod->path << ")\n";
+            for (auto& fn : mod->ir.functions) ::printIR(*fn, out);
+        }
+    }
+
+    void printC(std::ostream& out) {
+        for (auto& mod : modules) {
+            out << "// " << mod->info.id << ".h (" << mod->path << ")\n" << mod->header;
+            out << "// " << mod->info.id << ".c\n" << mod->source;
+        }
+        if (!library.empty()) out << "// sigma_lib.c\n" << library;
+    }
+
+    void generate(PassStats& stats, bool memStats) {
+        auto t = stats.pass("codegen");
+        for (auto& mod : modules) {
+            mod->header = CodeGen::generateHeader(mod->ast.get(), mod->info);
+            CodeGen codegen;
+            codegen.memStats = memStats;
+            mod->source = codegen.generate(mod->ir, mod->info);
+            stats.count("c_bytes", mod->header.size() + mod->source.size());
+        }
+        if (!modules.back()->info.isMain) generateLibrary();
+    }
+
+    // Shards hold a few functions each: one ends after a function whose
+    // name hashes to 0 mod 4, or once it has SHARD_INSTRS instructions, so
+    // adding or removing a function moves no boundaries but its own. The
+    // module body is a shard of its own.
+    static constexpr size_t SHARD_INSTRS = 256;
+
+    static bool endsShard(const std::string& name) {
+        unsigned h = 2166136261u;
+        for (unsigned char c : name) h = (h ^ c) * 16777619u;
+        return h % 4 == 0;
+    }
+
+    // sig watch: like generate, but each module becomes shards (see
+    // CodeGen::generateShard) and the line tables a unit of their own. A
+    // module with specializations stays whole, since they are static.
+    void generateShards(PassStats& stats, bool memStats) {
+        auto t = stats.pass("codegen");
+        std::stringstream table;
+        for (auto& mod : modules) {
+            mod->header = CodeGen::generateHeader(mod->ast.get(), mod->info);
+            bool whole = false;
+            for (auto& f : mod->ir.functions) whole = whole || f->origin;
+            std::vector<std::vector<const IRFunction*>> groups;
+            size_t instrs = 0;
+            bool ended = true;
+            for (auto& f : mod->ir.functions) {
+                if (groups.empty() || (!whole && (ended || f->kind != FN_SIGMA))) {
+                    groups.emplace_back();
+                    instrs = 0;
+                }
+                groups.back().push_back(f.get());
+                for (auto& block : f->blocks) instrs += block->instrs.size();
+                ended = instrs >= SHARD_INSTRS || endsShard(f->name);
+            }
+            mod->shards.clear();
+            for (auto& group : groups) {
+                std::string name = group[0]->name;
+                std::vector<int> lines;
+                CodeGen codegen;
+                codegen.memStats = memStats;
+                mod->shards.push_back({name, codegen.generateShard(group, mod->info, "sigma_lines_" + name, lines)});
+                stats.count("c_bytes", mod->shards.back().source.size());
+                table << "const int sigma_lines_" << name << "[] = {";
+                for (size_t i = 0; i < lines.size(); i++) table << (i ? ", " : "") << lines[i];
+                table << (lines.empty() ? "0};\n" : "};\n");
+            }
+            stats.count("shards", mod->shards.size());
+        }
+        lines = table.str();
+        if (!modules.back()->info.isMain) generateLibrary();
+    }
+
+    // The table libsigma finds a library's functions through (sigma_exports)
+    // and the function that runs every module's top-level statements once,
+    // dependencies first. It stops at the first error, leaving it pending
+    // for libsigma to report.
+    void generateLibrary() {
+        Module* entry = modules.back().get();
+        std::stringstream c;
+        c << "#include \"sigma_rt.h\"\n";
+        for (auto& mod : modules) c << "#include \"" << mod->info.id << ".h\"\n";
+        c << "\nconst SigmaExport sigma_exports[] = {\n";
+        for (auto& child : entry->ast->children) {
+            if (child->type != NODE_FUNC_DECL) continue;
+            c << "  {\"" << child->value << "\", (void*)" << entry->info.functions.at(child->value) << ", "
+              << child->children.size() - 1 << "},\n";
+        }
+        c << "  {NULL, NULL, 0}\n};\n\n";
+        c << "void sigma_library_init(void) {\n";
+        c << "  static int done;\n";
+        c << "  if (done) return;\n";
+        c << "  done = 1;\n";
+        for (auto& mod : modules) {
+            c << "  sigma_init_" << mod->info.id << "();\n";
+            c << "  if (sigma_failed) return;\n";
+        }
+        c << "}\n";
+        library = c.str();
+    }
+};
+
+// Compiles each module (and the runtime) to an object file cached by a hash
+// of everything that goes into it, then links them. Objects that are not in
+// the cache are compiled in parallel.
+class Builder {
+    struct Unit {
+        std::string name;       // file name stem in the work directory
+        std::string key;        // content hash
+        std::string object;     // cached object path
+        bool cached;
+        bool generated;         // compiled with unitCflags too
+    };
+
+    std::string cacheDir;
+    std::string workDir;
+    std::map<std::string, std::string> written;     // work directory file -> content key
+    bool headerPrecompiled = false;
+
+    static std::string defaultCacheDir() {
+        if (const char* dir = getenv("SIGMA_CACHE_DIR")) return dir;
+        if (const char* xdg = getenv("XDG_CACHE_HOME")) return std::string(xdg) + "/sigma";
+        if (const char* home = getenv("HOME")) return std::string(home) + "/.cache/sigma";
+        return "/tmp/sigma-cache";
+    }
+
+    // 64-bit FNV-1a; the input length is folded into the key as well.
+    static std::string contentKey(const std::string& data) {
+        unsigned long long h = 1469598103934665603ULL;
+        for (unsigned char c : data) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        char buf[48];
+        snprintf(buf, sizeof(buf), "%016llx-%zx", h, data.size());
+        return buf;
+    }
+
+    static void writeFile(const std::string& path, const std::string& content) {
+        std::ofstream file(path);
+        file << content;
+        if (!file) throw std::runtime_error("Cannot write " + path);
+    }
+
+    // Writes a file into the work directory unless an earlier build of
+    // this Builder left it there with the same key.
+    void update(const std::string& name, const std::string& content, const std::string& key) {
+        auto it = written.find(name);
+        if (it != written.end() && it->second == key) return;
+        writeFile(workDir + "/" + name, content);
+        written[name] = key;
+    }
+
+    static int run(const std::vector<std::string>& args, bool quiet = false) {
+        std::vector<char*> argv;
+        for (auto& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+        argv.push_back(nullptr);
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        if (quiet) {
+            posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+            posix_spawn_file_actions_adddup2(&actions, 1, 2);
+        }
+        pid_t pid;
+        int spawned = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        if (spawned != 0) return -1;
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0) {
+            if (errno != EINTR) return -1;
+        }
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+public:
+    std::string cc = "gcc";
+    std::vector<std::string> cflags = {"-O3"};
+    // Added for the units CodeGen produced, but not the runtime (sig watch
+    // builds them with -O0 against the usual runtime object).
+    std::vector<std::string> unitCflags;
+    // Compile sigma_rt.h once per work directory for the generated units
+    // (sig watch, where it is most of the cost of compiling a small unit).
+    bool precompileHeader = false;
+    // Generated units call the runtime's inline helpers instead of compiling
+    // their own copies (SIGMA_OUTLINE in sigma_rt.h); one -O3 unit defines them.
+    bool outlineHelpers = false;
+    std::vector<std::string> ldflags;
+    bool shared = false;        // link a shared library (sig --shared, libsigma)
+    int jobs = (int)std::max(1u, std::thread::hardware_concurrency());
+    int compiled = 0;
+    int cacheHits = 0;
+
+    Builder() : cacheDir(defaultCacheDir()) {}
+
+    // Links with mold, lld or gold if gcc can find one (sig watch links
+    // after every edit, and bfd is the slowest of them).
+    void useFastLinker() {
+        for (const char* ld : {"mold", "lld", "gold"}) {
+            std::string flag = std::string("-fuse-ld=") + ld;
+            if (run({cc, flag, "-Wl,--version"}, true) == 0) {
+                ldflags = {flag};
+                return;
+            }
+        }
+    }
+
+    ~Builder() {
+        if (!workDir.empty()) {
+            std::error_code ec;
+            fs::remove_all(workDir, ec);
+        }
+    }
+
+    // Returns false if any compile or the link failed (gcc has already
+    // printed its diagnostics). Repeated builds reuse the work directory.
+    bool build(ModuleGraph& graph, const std::string& exe, PassStats& stats) {
+        std::vector<std::string> cflags = this->cflags;
+        if (shared) cflags.push_back("-fPIC");
+        std::vector<std::string> genCflags = cflags;
+        genCflags.insert(genCflags.end(), unitCflags.begin(), unitCflags.end());
+        if (outlineHelpers) genCflags.push_back("-DSIGMA_OUTLINE");
+        std::vector<Unit> units;
+        {
+            auto t = stats.pass("write");
+            if (workDir.empty()) {
+                char tmpl[] = "/tmp/sigma-build-XXXXXX";
+                if (!mkdtemp(tmpl)) throw std::runtime_error("Cannot create build directory");
+                workDir = tmpl;
+                fs::create_directories(cacheDir + "/obj");
+            }
+
+            std::string flags, genFlags;
+            for (auto& f : cflags) flags += f + " ";
+            for (auto& f : genCflags) genFlags += f + " ";
+            std::string runtimeHeader = sigma_rt_h_src;
+            units.push_back({"sigma_rt", contentKey(flags + '\0' + runtimeHeader + '\0' + sigma_rt_c_src), "", false, false});
+            update("sigma_rt.h", runtimeHeader, units[0].key);
+            update("sigma_rt.c", sigma_rt_c_src, units[0].key);
+            if (outlineHelpers) {
+                std::string source = "#define SIGMA_OUTLINE_DEFINITIONS\n#include \"sigma_rt.h\"\n";
+                units.push_back({"sigma_outline", contentKey(flags + '\0' + runtimeHeader + '\0' + source), "", false, false});
+                update("sigma_outline.c", source, units.back().key);
+            }
+
+            std::map<std::string, const std::string*> headers;
+            for (auto& mod : graph.modules) {
+                headers[mod->info.id] = &mod->header;
+                update(mod->info.id + ".h", mod->header, contentKey(mod->header));
+            }
+            // Shards include only the runtime header, which is hashed once.
+            std::string shardInput = genFlags + '\0' + contentKey(runtimeHeader) + '\0';
+            for (auto& mod : graph.modules) {
+                for (auto& shard : mod->shards) {
+                    units.push_back({shard.name, contentKey(shardInput + shard.source), "", false, true});
+                    update(shard.name + ".c", shard.source, units.back().key);
+                }
+                if (!mod->shards.empty()) continue;
+                // Everything the translation unit includes is part of its key.
+                std::string input = genFlags + '\0' + runtimeHeader + '\0' + mod->header;
+                for (auto& dep : mod->info.imports) input += '\0' + *headers[dep];
+                input += '\0' + mod->source;
+                units.push_back({mod->info.id, contentKey(input), "", false, true});
+                update(mod->info.id + ".c", mod->source, units.back().key);
+            }
+            if (!graph.lines.empty()) {
+                units.push_back({"sigma_lines", contentKey(genFlags + '\0' + graph.lines), "", false, true});
+                update("sigma_lines.c", graph.lines, units.back().key);
+            }
+            if (!graph.library.empty()) {
+                std::string input = genFlags + '\0' + runtimeHeader;
+                for (auto& mod : graph.modules) input += '\0' + mod->header;
+                units.push_back({"sigma_lib", contentKey(input + '\0' + graph.library), "", false, true});
+                update("sigma_lib.c", graph.library, units.back().key);
+            }
+            for (auto& u : units) {
+                u.object = cacheDir + "/obj/" + u.key + ".o";
+                u.cached = fs::exists(u.object);
+            }
+        }
+
+        std::vector<Unit*> pending;
+        cacheHits = 0;
+        for (auto& u : units) {
+            if (u.cached) cacheHits++;
+            else pending.push_back(&u);
+        }
+        compiled = pending.size();
+        stats.count("objects_compiled", compiled);
+        stats.count("cache_hits", cacheHits);
+
+        std::atomic<size_t> next(0);
+        std::atomic<bool> failed(false);
+        {
+            auto t = stats.childPass("gcc");
+            if (precompileHeader && !headerPrecompiled && !pending.empty()) {
+                // Units fall back to the header itself if this fails.
+                std::vector<std::string> cmd = {cc};
+                cmd.insert(cmd.end(), genCflags.begin(), genCflags.end());
+                cmd.insert(cmd.end(), {"-x", "c-header", workDir + "/sigma_rt.h", "-o", workDir + "/sigma_rt.h.gch"});
+                run(cmd);
+                headerPrecompiled = true;
+            }
+            auto worker = [&]() {
+                for (size_t i = next++; i < pending.size(); i = next++) {
+                    Unit* u = pending[i];
+                    // Compile to a private name and rename into place so that
+                    // concurrent sig processes never see a partial object.
+                    std::string tmp = u->object + ".tmp" + std::to_string(getpid()) + "-" + std::to_string(i);
+                    std::vector<std::string> cmd = {cc};
+                    auto& flags = u->generated ? genCflags : cflags;
+                    cmd.insert(cmd.end(), flags.begin(), flags.end());
+                    cmd.insert(cmd.end(), {"-I", workDir, "-c", workDir + "/" + u->name + ".c", "-o", tmp});
+                    if (run(cmd) != 0 || rename(tmp.c_str(), u->object.c_str()) != 0) {
+                        unlink(tmp.c_str());
+                        failed = true;
+                    }
+                }
+            };
+            std::vector<std::thread> threads;
+            int n = std::min<int>(jobs, pending.size());
+            for (int i = 1; i < n; i++) threads.emplace_back(worker);
+            worker();
+            for (auto& th : threads) th.join();
+        }
+        if (failed) return false;
+
+        auto t = stats.childPass("link");
+        std::vector<std::string> cmd = {cc};
+        for (auto& u : units) cmd.push_back(u.object);
+        if (shared) cmd.push_back("-shared");
+        cmd.insert(cmd.end(), ldflags.begin(), ldflags.end());
+        cmd.insert(cmd.end(), {"-o", exe, "-lm", "-pthread"});
+        return run(cmd) == 0;
+    }
+};
@@ -0,0 +1,937 @@
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// SSA optimizations over one IRFunction, in order:
+//
+//   cleanup   drop unreachable blocks and phis that merge a single value
+//             (copy propagation: SSA construction never creates copies),
+//             and merge straight-line chains of blocks
+//   types     infer a static type for every value, using integer ranges to
+//             prove that int arithmetic cannot overflow
+//   fold      evaluate arithmetic and comparisons on constants, and turn
+//             branches on constants into jumps
+//   checks    drop the type and bounds checks of arr[i] where dominating
+//             conditions prove 0 <= i < len(arr)
+//   cse       reuse an earlier identical computation that dominates this one
+//   licm      hoist loop-invariant computations into the loop preheader
+//   dce       delete values that are never used and have no effects
+//
+// Runtime calls are classified by irEffect(): pure ones can be merged and
+// moved freely; loads (object fields, array elements) only while no store or
+// call can have changed memory in between. Calls that may raise an error
+// (irMayFail) are never deleted or hoisted, since that would add or drop
+// the error, but a repeat of one can reuse the first's result.
+class Optimizer {
+    IRFunction& fn;
+    std::vector<IRBlock*> rpo;
+    std::map<IRBlock*, int> order;      // position in rpo
+    std::map<IRBlock*, IRBlock*> idom;
+    std::map<IRBlock*, std::vector<IRBlock*>> domChildren;
+    std::map<IRInstr*, int> memState;   // loads: which memory version they read
+
+    // Bounds on an int value.
+    struct Range {
+        int64_t lo = INT64_MIN;
+        int64_t hi = INT64_MAX;
+    };
+    std::map<IRInstr*, Range> ranges;   // per type inference sweep
+
+public:
+    int checksRemoved = 0;
+    int cseRemoved = 0;
+    int hoisted = 0;
+    int dceRemoved = 0;
+
+private:
+    // --- helpers ---
+
+    void replace(IRInstr* in, IRInstr* with) {
+        in->forward = with;
+    }
+
+    // Point every operand at its replacement and drop replaced instructions.
+    void rewrite() {
+        for (auto& block : fn.blocks) {
+            std::vector<IRInstr*> kept;
+            for (IRInstr* in : block->instrs) {
+                if (in->forward) continue;
+                for (auto& arg : in->args) arg = irResolve(arg);
+                kept.push_back(in);
+            }
+            block->instrs = kept;
+        }
+    }
+
+    void computeOrder() {
+        rpo.clear();
+        order.clear();
+        std::set<IRBlock*> seen;
+        std::vector<IRBlock*> post;
+        std::vector<std::pair<IRBlock*, size_t>> stack = {{fn.blocks[0].get(), 0}};
+        seen.insert(fn.blocks[0].get());
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            std::vector<IRBlock*> succs = top.first->succs();
+            if (top.second < succs.size()) {
+                IRBlock* next = succs[top.second++];
+                if (seen.insert(next).second) stack.push_back({next, 0});
+            } else {
+                post.push_back(top.first);
+                stack.pop_back();
+            }
+        }
+        rpo.assign(post.rbegin(), post.rend());
+        for (size_t i = 0; i < rpo.size(); i++) order[rpo[i]] = i;
+    }
+
+    // Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".
+    void computeDominators() {
+        idom.clear();
+        domChildren.clear();
+        IRBlock* entry = rpo[0];
+        idom[entry] = entry;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t i = 1; i < rpo.size(); i++) {
+                IRBlock* b = rpo[i];
+                IRBlock* newIdom = nullptr;
+                for (IRBlock* p : b->preds) {
+                    if (!idom.count(p)) continue;
+                    if (!newIdom) {
+                        newIdom = p;
+                        continue;
+                    }
+                    IRBlock* x = p;
+                    IRBlock* y = newIdom;
+                    while (x != y) {
+                        while (order[x] > order[y]) x = idom[x];
+                        while (order[y] > order[x]) y = idom[y];
+                    }
+                    newIdom = x;
+                }
+                if (idom[b] != newIdom) {
+                    idom[b] = newIdom;
+                    changed = true;
+                }
+            }
+        }
+        for (size_t i = 1; i < rpo.size(); i++) domChildren[idom[rpo[i]]].push_back(rpo[i]);
+    }
+
+    bool dominates(IRBlock* a, IRBlock* b) {
+        while (true) {
+            if (a == b) return true;
+            if (b == idom[b]) return false;
+            b = idom[b];
+        }
+    }
+
+    // --- cleanup ---
+
+    void removeUnreachable() {
+        // Lowering leaves dead code without predecessors (and does not
+        // record its outgoing edges); folded branches leave whole regions
+        // that are only reachable from dead code.
+        std::set<IRBlock*> reachable = {fn.blocks[0].get()};
+        std::vector<IRBlock*> work = {fn.blocks[0].get()};
+        while (!work.empty()) {
+            IRBlock* b = work.back();
+            work.pop_back();
+            for (IRBlock* s : b->succs()) {
+                if (reachable.insert(s).second) work.push_back(s);
+            }
+        }
+        std::vector<std::unique_ptr<IRBlock>> kept;
+        for (auto& block : fn.blocks) {
+            if (reachable.count(block.get())) kept.push_back(std::move(block));
+        }
+        fn.blocks = std::move(kept);
+        for (auto& block : fn.blocks) {
+            for (size_t i = block->preds.size(); i-- > 0;) {
+                if (reachable.count(block->preds[i])) continue;
+                block->preds.erase(block->preds.begin() + i);
+                for (IRInstr* in : block->instrs) {
+                    if (in->op == IR_PHI) in->args.erase(in->args.begin() + i);
+                }
+            }
+            for (IRInstr* in : block->instrs) in->block = block.get();
+        }
+    }
+
+    void removeTrivialPhis() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto& block : fn.blocks) {
+                for (IRInstr* in : block->instrs) {
+                    if (in->op != IR_PHI || in->forward) continue;
+                    IRInstr* same = nullptr;
+                    bool trivial = true;
+                    for (IRInstr* arg : in->args) {
+                        arg = irResolve(arg);
+                        if (arg == same || arg == in) continue;
+                        if (same) {
+                            trivial = false;
+                            break;
+                        }
+                        same = arg;
+                    }
+                    if (trivial) {
+                        replace(in, same ? same : fn.constant(TY_NIL));
+                        changed = true;
+                    }
+                }
+            }
+        }
+        rewrite();
+    }
+
+    // Appends a block's only successor to it when the block is that
+    // successor's only predecessor (inlining leaves chains of these).
+    void mergeBlocks() {
+        for (auto& block : fn.blocks) {
+            while (true) {
+                IRInstr* jump = block->terminator();
+                if (!jump || jump->op != IR_JUMP) break;
+                IRBlock* next = jump->targets[0];
+                if (next->preds.size() != 1 || next == fn.blocks[0].get()) break;
+                block->instrs.pop_back();
+                for (IRInstr* in : next->instrs) {
+                    in->block = block.get();
+                    block->instrs.push_back(in);
+                }
+                next->instrs.clear();
+                next->preds.clear();
+                for (IRBlock* succ : block->succs()) {
+                    std::replace(succ->preds.begin(), succ->preds.end(), next, block.get());
+                }
+            }
+        }
+        std::vector<std::unique_ptr<IRBlock>> kept;
+        for (auto& block : fn.blocks) {
+            if (!block->instrs.empty()) kept.push_back(std::move(block));
+        }
+        fn.blocks = std::move(kept);
+    }
+
+    // --- integer ranges ---
+
+    // An int sum, difference or product is an int only if it cannot
+    // overflow; otherwise it is a num, computed by a runtime helper that
+    // promotes to a dec. Ranges come from constants, from induction
+    // variables (a phi stepped by a positive constant only moves away from
+    // its start) and from the branch conditions that dominate the
+    // arithmetic: in the body of `$for (i: 0, i < n, i++)`, i is at most
+    // n - 1, so i + 1 is an int.
+
+    static bool fits(__int128 x) {
+        return x >= INT64_MIN && x <= INT64_MAX;
+    }
+
+    Range range(IRInstr* v, int depth = 0) {
+        if (v->type != TY_INT || depth > 6) return Range();
+        if (v->op == IR_CONST) return {v->inum, v->inum};
+        if (v->op == IR_LEN) return {0, INT64_MAX};
+        if ((v->op == IR_INDEX || v->op == IR_ELEM || v->op == IR_ITEM) && v->args[0]->type == TY_U8ARR) return {0, 255};
+        auto it = ranges.find(v);
+        if (it != ranges.end()) return it->second;
+        ranges[v] = Range();    // recursion through a cycle: no bounds
+        Range r;
+        if (v->op == IR_PHI) r = phiRange(v, depth);
+        else if (!arithRange(v, depth, r)) r = Range();
+        ranges[v] = r;
+        return r;
+    }
+
+    Range phiRange(IRInstr* phi, int depth) {
+        int direction = 0;
+        bool start = false;
+        Range r = {INT64_MAX, INT64_MIN};
+        for (IRInstr* arg : phi->args) {
+            if (arg == phi || arg->type == TY_UNKNOWN) continue;
+            bool step = (arg->op == IR_ADD || arg->op == IR_SUB) && arg->type == TY_INT && arg->args[0] == phi &&
+                        arg->args[1]->op == IR_CONST && arg->args[1]->type == TY_INT && arg->args[1]->inum > 0;
+            if (step) {
+                int d = arg->op == IR_ADD ? 1 : -1;
+                if (direction && direction != d) return Range();
+                direction = d;
+                continue;
+            }
+            Range a = range(arg, depth + 1);
+            r.lo = std::min(r.lo, a.lo);
+            r.hi = std::max(r.hi, a.hi);
+            start = true;
+        }
+        if (!start) return Range();
+        if (direction > 0) r.hi = INT64_MAX;
+        if (direction < 0) r.lo = INT64_MIN;
+        return r;
+    }
+
+    // Narrows `r`, the range of `x` in `block`, by the conditions of the
+    // branches that must have been taken to get there.
+    Range refine(IRInstr* x, IRBlock* block, Range r, int depth) {
+        IRBlock* b = block;
+        for (int steps = 0; steps < 32 && idom.count(b); steps++) {
+            if (b->preds.size() == 1) {
+                IRInstr* br = b->preds[0]->terminator();
+                if (br && br->op == IR_BRANCH && br->targets[0] != br->targets[1]) {
+                    narrow(x, br->args[0], br->targets[0] == b, r, depth);
+                }
+            }
+            if (idom[b] == b) break;
+            b = idom[b];
+        }
+        return r;
+    }
+
+    // What the int comparison `cond` says about x on its `taken` edge, as
+    // `x op other`; false if cond does not compare x.
+    static bool relation(IRInstr* x, IRInstr* cond, bool taken, IROp& op, IRInstr*& other) {
+        static const std::map<IROp, IROp> mirror = {
+            {IR_LT, IR_GT}, {IR_GT, IR_LT}, {IR_LE, IR_GE}, {IR_GE, IR_LE}, {IR_EQ, IR_EQ}, {IR_NE, IR_NE},
+        };
+        static const std::map<IROp, IROp> negate = {
+            {IR_LT, IR_GE}, {IR_GE, IR_LT}, {IR_GT, IR_LE}, {IR_LE, IR_GT}, {IR_EQ, IR_NE}, {IR_NE, IR_EQ},
+        };
+        op = cond->op == IR_STRICT_EQ ? IR_EQ : cond->op;
+        if (!mirror.count(op) || cond->args[0]->type != TY_INT || cond->args[1]->type != TY_INT) return false;
+        other = cond->args[1];
+        if (cond->args[1] == x) {
+            other = cond->args[0];
+            op = mirror.at(op);
+        } else if (cond->args[0] != x) {
+            return false;
+        }
+        if (!taken) op = negate.at(op);
+        return true;
+    }
+
+    void narrow(IRInstr* x, IRInstr* cond, bool taken, Range& r, int depth) {
+        IROp op;
+        IRInstr* other;
+        if (!relation(x, cond, taken, op, other)) return;
+        Range y = range(other, depth + 1);
+        switch (op) {
+            case IR_LT: if (y.hi > INT64_MIN) r.hi = std::min(r.hi, y.hi - 1); break;
+            case IR_LE: r.hi = std::min(r.hi, y.hi); break;
+            case IR_GT: if (y.lo < INT64_MAX) r.lo = std::max(r.lo, y.lo + 1); break;
+            case IR_GE: r.lo = std::max(r.lo, y.lo); break;
+            case IR_EQ:
+                r.lo = std::max(r.lo, y.lo);
+                r.hi = std::min(r.hi, y.hi);
+                break;
+            default: break;
+        }
+    }
+
+    // The range of int arithmetic `in`, or false if it might overflow (or
+    // trap: x % 0, INT64_MIN % -1).
+    bool arithRange(IRInstr* in, int depth, Range& out) {
+        if (in->args.size() != 2) return false;
+        Range a = refine(in->args[0], in->block, range(in->args[0], depth + 1), depth);
+        Range b = refine(in->args[1], in->block, range(in->args[1], depth + 1), depth);
+        __int128 lo, hi;
+        switch (in->op) {
+            case IR_ADD:
+                lo = (__int128)a.lo + b.lo;
+                hi = (__int128)a.hi + b.hi;
+                break;
+            case IR_SUB:
+                lo = (__int128)a.lo - b.hi;
+                hi = (__int128)a.hi - b.lo;
+                break;
+            case IR_MUL: {
+                __int128 p[] = {(__int128)a.lo * b.lo, (__int128)a.lo * b.hi, (__int128)a.hi * b.lo, (__int128)a.hi * b.hi};
+                lo = *std::min_element(p, p + 4);
+                hi = *std::max_element(p, p + 4);
+                break;
+            }
+            case IR_MOD:
+                // Positive divisors only; the result has the sign of a.
+                if (b.lo < 1) return false;
+                lo = a.lo >= 0 ? 0 : -(__int128)(b.hi - 1);
+                hi = a.hi <= 0 ? 0 : (__int128)(b.hi - 1);
+                break;
+            default:
+                return false;
+        }
+        if (!fits(lo) || !fits(hi)) return false;
+        out = {(int64_t)lo, (int64_t)hi};
+        return true;
+    }
+
+    // --- types ---
+
+    IRType arithType(IRInstr* in) {
+        IRType a = in->args[0]->type, b = in->args[1]->type;
+        if (in->op == IR_ADD && (a == TY_STR || b == TY_STR)) return TY_STR;
+        if (a == TY_UNKNOWN || b == TY_UNKNOWN) return TY_UNKNOWN;
+        // `+` may still concatenate; the other operators treat anything
+        // that is not a number as 0.
+        if (in->op == IR_ADD && (!irIsNumeric(a) || !irIsNumeric(b))) return TY_ANY;
+        if (a == TY_INT && b == TY_INT) {
+            Range r;
+            return in->op != IR_DIV && arithRange(in, 0, r) ? TY_INT : TY_NUM;
+        }
+        return a == TY_DEC || b == TY_DEC ? TY_DEC : TY_NUM;
+    }
+
+    IRType resultType(IRInstr* in) {
+        switch (in->op) {
+            case IR_CONST:
+            case IR_PARAM:
+                return in->type;
+            case IR_STR:
+            case IR_INPUT:
+                return TY_STR;
+            case IR_PHI: {
+                IRType t = TY_UNKNOWN;
+                for (IRInstr* arg : in->args) t = irJoin(t, arg->type);
+                return t;
+            }
+            case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+                return arithType(in);
+            case IR_EQ: case IR_STRICT_EQ: case IR_NE:
+            case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+            case IR_AND: case IR_OR:
+                return TY_BOOL;
+            case IR_BUILTIN:
+                return in->builtin->result;
+            case IR_ARRAY:
+                return TY_ARR;
+            case IR_OBJECT:
+            case IR_CATCH:
+                return TY_OBJ;
+            case IR_CALL:
+                return in->callee ? in->callee->returnType : TY_ANY;
+            case IR_LEN:
+                return TY_INT;
+            case IR_IS_ARRAY:
+                return TY_BOOL;
+            case IR_INDEX: case IR_ELEM:
+                return irElemType(in->args[0]->type);
+            case IR_ITEM:
+                return in->args[0]->type == TY_STR ? TY_STR : irElemType(in->args[0]->type);
+            case IR_SORT:
+                return irIsTypedArray(in->args[0]->type) ? in->args[0]->type : TY_ANY;
+            case IR_GET:
+                return TY_ANY;
+            default:
+                return TY_VOID;
+        }
+    }
+
+public:
+    // Optimistic: loop phis start unknown and settle on the join of what
+    // actually reaches them, so a counter that starts and stays an int is
+    // an int64_t. Calls to functions of this module take the callee's
+    // returnType; with `settle` false, values that are still unknown (say,
+    // the result of a recursive call whose return type is being inferred
+    // by ModuleOptimizer) are left unknown instead of becoming any.
+    void inferTypes(bool settle = true) {
+        computeOrder();
+        computeDominators();
+        for (auto& block : fn.blocks) {
+            for (IRInstr* in : block->instrs) in->type = TY_UNKNOWN;
+        }
+        for (int round = 0; round < (settle ? 2 : 1); round++) {
+            bool changed = true;
+            for (int sweep = 0; changed; sweep++) {
+                changed = false;
+                ranges.clear();
+                for (IRBlock* block : rpo) {
+                    for (IRInstr* in : block->instrs) {
+                        IRType t = resultType(in);
+                        if (round == 1 && t == TY_UNKNOWN) t = TY_ANY;
+                        // Ranges can make a type more precise again; should
+                        // that ever keep going, only allow widening.
+                        if (sweep > 50) t = irJoin(in->type, t);
+                        if (t != in->type) {
+                            in->type = t;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+        ranges.clear();
+    }
+
+private:
+    // --- fold ---
+
+    IRInstr* foldInt(IRInstr* in, int64_t x, int64_t y) {
+        int64_t r;
+        switch (in->op) {
+            case IR_ADD: return __builtin_add_overflow(x, y, &r) ? nullptr : fn.intConstant(r);
+            case IR_SUB: return __builtin_sub_overflow(x, y, &r) ? nullptr : fn.intConstant(r);
+            case IR_MUL: return __builtin_mul_overflow(x, y, &r) ? nullptr : fn.intConstant(r);
+            case IR_LT: return fn.constant(TY_BOOL, x < y);
+            case IR_GT: return fn.constant(TY_BOOL, x > y);
+            case IR_LE: return fn.constant(TY_BOOL, x <= y);
+            case IR_GE: return fn.constant(TY_BOOL, x >= y);
+            case IR_EQ: case IR_STRICT_EQ: return fn.constant(TY_BOOL, x == y);
+            case IR_NE: return fn.constant(TY_BOOL, x != y);
+            default: return nullptr;
+        }
+    }
+
+    IRInstr* fold(IRInstr* in) {
+        if (in->args.size() != 2) return nullptr;
+        IRInstr* a = in->args[0];
+        IRInstr* b = in->args[1];
+        if (a->op == IR_CONST && b->op == IR_CONST && a->type == TY_INT && b->type == TY_INT) {
+            return foldInt(in, a->inum, b->inum);
+        }
+        if (a->op != IR_CONST || b->op != IR_CONST || a->type != TY_DEC || b->type != TY_DEC) return nullptr;
+        double x = a->num, y = b->num;
+        switch (in->op) {
+            case IR_ADD: return fn.constant(TY_DEC, x + y);
+            case IR_SUB: return fn.constant(TY_DEC, x - y);
+            case IR_MUL: return fn.constant(TY_DEC, x * y);
+            case IR_LT: return fn.constant(TY_BOOL, x < y);
+            case IR_GT: return fn.constant(TY_BOOL, x > y);
+            case IR_LE: return fn.constant(TY_BOOL, x <= y);
+            case IR_GE: return fn.constant(TY_BOOL, x >= y);
+            case IR_EQ: case IR_STRICT_EQ: return fn.constant(TY_BOOL, x == y);
+            case IR_NE: return fn.constant(TY_BOOL, x != y);
+            default: return nullptr;    // leave division and fmod to C
+        }
+    }
+
+    void foldConstants() {
+        for (IRBlock* block : rpo) {
+            for (IRInstr* in : block->instrs) {
+                for (auto& arg : in->args) arg = irResolve(arg);
+                if (IRInstr* c = fold(in)) replace(in, c);
+            }
+        }
+        rewrite();
+    }
+
+    static void removeEdge(IRBlock* from, IRBlock* dead) {
+        auto& preds = dead->preds;
+        size_t i = std::find(preds.begin(), preds.end(), from) - preds.begin();
+        preds.erase(preds.begin() + i);
+        for (IRInstr* in : dead->instrs) {
+            if (in->op == IR_PHI) in->args.erase(in->args.begin() + i);
+        }
+    }
+
+    // Where an IR_SWITCH on a constant int, dec or string literal goes, or
+    // null if the value is not one of those.
+    static IRBlock* switchTarget(IRInstr* sw) {
+        IRInstr* v = sw->args[0];
+        bool isInt = v->op == IR_CONST && v->type == TY_INT;
+        bool isDec = v->op == IR_CONST && v->type == TY_DEC;
+        if (!isInt && !isDec && v->op != IR_STR) return nullptr;
+        for (const IRCase& c : sw->cases) {
+            bool match = c.type == TY_STR ? v->op == IR_STR && v->name == c.str
+                                          : (isInt && v->inum == c.num) || (isDec && v->num == (double)c.num);
+            if (match) return sw->arms[c.arm];
+        }
+        return sw->arms.back();
+    }
+
+    // Turns branches and switches on constants (common once a call with a
+    // constant argument has been inlined) into jumps. Returns whether any
+    // changed.
+    bool foldBranches() {
+        bool changed = false;
+        for (IRBlock* block : rpo) {
+            IRInstr* br = block->terminator();
+            if (br && br->op == IR_SWITCH) {
+                IRBlock* taken = switchTarget(br);
+                if (!taken) continue;
+                for (IRBlock* arm : br->arms) {
+                    if (arm != taken) removeEdge(block, arm);
+                }
+                br->op = IR_JUMP;
+                br->args.clear();
+                br->cases.clear();
+                br->arms.clear();
+                br->targets[0] = taken;
+                changed = true;
+                continue;
+            }
+            if (!br || br->op != IR_BRANCH || br->args[0]->op != IR_CONST) continue;
+            bool taken = br->args[0]->type != TY_NIL && br->args[0]->num != 0;
+            removeEdge(block, br->targets[taken ? 1 : 0]);
+            br->op = IR_JUMP;
+            br->args.clear();
+            br->targets[0] = br->targets[taken ? 0 : 1];
+            br->targets[1] = nullptr;
+            changed = true;
+        }
+        return changed;
+    }
+
+    // --- checks ---
+
+    // Arrays and typed arrays never change length, so an index that a
+    // dominating condition keeps below len(arr) stays in bounds: the body of
+    // `$for (i: 0, i < len(arr), i++)` can read and write arr[i] directly.
+    // The condition also proves that len(arr) > 0, but a string has a length
+    // too; unless arr is known to be an array, the access keeps a type check
+    // that does not depend on i, which LICM then hoists along with len(arr).
+
+    static bool isIntConst(const IRInstr* v) {
+        return v->op == IR_CONST && v->type == TY_INT;
+    }
+
+    // The len(arr) that the branches leading to `block` keep x below, if any.
+    IRInstr* lengthBound(IRInstr* x, IRInstr* arr, IRBlock* block) {
+        IRBlock* b = block;
+        for (int steps = 0; steps < 32 && idom.count(b); steps++) {
+            IRInstr* br = b->preds.size() == 1 ? b->preds[0]->terminator() : nullptr;
+            IROp op;
+            IRInstr* bound;
+            if (br && br->op == IR_BRANCH && br->targets[0] != br->targets[1] &&
+                relation(x, br->args[0], br->targets[0] == b, op, bound)) {
+                // x < len(arr), or x <= len(arr) - c with c >= 1
+                if (op == IR_LE && bound->op == IR_SUB && isIntConst(bound->args[1]) && bound->args[1]->inum >= 1) {
+                    op = IR_LT;
+                    bound = bound->args[0];
+                }
+                if (op == IR_LT && bound->op == IR_LEN && bound->args[0] == arr) return bound;
+            }
+            if (idom[b] == b) break;
+            b = idom[b];
+        }
+        return nullptr;
+    }
+
+    // The len(arr) that proves arr[idx] in bounds in `block`, if any.
+    IRInstr* boundingLength(IRInstr* idx, IRInstr* arr, IRBlock* block) {
+        if (idx->type != TY_INT || refine(idx, block, range(idx), 0).lo < 0) return nullptr;
+        if (IRInstr* len = lengthBound(idx, arr, block)) return len;
+        // arr[i - c] for c >= 0 is in bounds wherever arr[i] is.
+        bool offset = (idx->op == IR_SUB && isIntConst(idx->args[1]) && idx->args[1]->inum >= 0) ||
+                      (idx->op == IR_ADD && isIntConst(idx->args[1]) && idx->args[1]->inum <= 0);
+        if (!offset || idx->args[0]->type != TY_INT) return nullptr;
+        return lengthBound(idx->args[0], arr, block);
+    }
+
+    // The IR_IS_ARRAY check of len's operand, placed right after len, which
+    // dominates every access it bounds.
+    IRInstr* arrayGuard(IRInstr* len, std::map<IRInstr*, IRInstr*>& guards) {
+        auto it = guards.find(len);
+        if (it != guards.end()) return it->second;
+        IRInstr* guard = fn.make(IR_IS_ARRAY);
+        guard->args = {len->args[0]};
+        guard->type = TY_BOOL;
+        guard->line = len->line;
+        guard->block = len->block;
+        auto& instrs = len->block->instrs;
+        instrs.insert(std::find(instrs.begin(), instrs.end(), len) + 1, guard);
+        guards[len] = guard;
+        return guard;
+    }
+
+    void eliminateChecks() {
+        std::map<IRInstr*, IRInstr*> guards;
+        for (IRBlock* block : rpo) {
+            for (size_t i = 0; i < block->instrs.size(); i++) {
+                IRInstr* in = block->instrs[i];
+                if (in->op != IR_INDEX && in->op != IR_SET_INDEX && in->op != IR_ITEM) continue;
+                IRInstr* arr = in->args[0];
+                if (arr->type != TY_ARR && arr->type != TY_ANY && !irIsTypedArray(arr->type)) continue;
+                // An item of a $for ... $in collection is an element only
+                // if the collection is an array.
+                if (in->op == IR_ITEM && arr->type == TY_ANY) continue;
+                IRInstr* len = boundingLength(in->args[1], arr, block);
+                if (!len) continue;
+                IRInstr* guard = arr->type == TY_ANY ? arrayGuard(len, guards) : nullptr;
+                in->op = in->op == IR_SET_INDEX ? IR_SET_ELEM : IR_ELEM;
+                if (guard) in->args.push_back(guard);
+                checksRemoved++;
+            }
+        }
+        ranges.clear();
+    }
+
+    // --- memory versions ---
+
+    static bool writesMemory(const IRInstr* in) {
+        return irEffect(in) == EFF_STORE;
+    }
+
+    // Numbers every state of array/object memory: a block starts in its
+    // predecessors' state if they agree (for loop headers: if the loop
+    // stores nothing), and every store or call starts a new state. Two
+    // loads of the same operands in the same state read the same value.
+    void computeMemoryStates(const std::map<IRBlock*, std::set<IRBlock*>>& loops) {
+        memState.clear();
+        std::map<IRBlock*, int> out;
+        int next = 1;
+        for (IRBlock* block : rpo) {
+            int state;
+            if (block == rpo[0]) {
+                state = 0;
+            } else {
+                state = -1;
+                bool agree = true;
+                for (IRBlock* p : block->preds) {
+                    auto it = out.find(p);
+                    if (it == out.end()) continue;      // back edge
+                    if (state == -1) state = it->second;
+                    else if (state != it->second) agree = false;
+                }
+                auto loop = loops.find(block);
+                if (loop != loops.end()) {
+                    for (IRBlock* b : loop->second) {
+                        for (IRInstr* in : b->instrs) {
+                            if (writesMemory(in)) agree = false;
+                        }
+                    }
+                }
+                if (!agree || state == -1) state = next++;
+            }
+            for (IRInstr* in : block->instrs) {
+                if (irEffect(in) == EFF_LOAD) memState[in] = state;
+                if (writesMemory(in)) state = next++;
+            }
+            out[block] = state;
+        }
+    }
+
+    // --- loops ---
+
+    // Natural loops by header: the header plus every block that reaches a
+    // back edge into it without going through it.
+    std::map<IRBlock*, std::set<IRBlock*>> findLoops() {
+        std::map<IRBlock*, std::set<IRBlock*>> loops;
+        for (IRBlock* block : rpo) {
+            for (IRBlock* succ : block->succs()) {
+                if (!dominates(succ, block)) continue;
+                auto& body = loops[succ];
+                body.insert(succ);
+                std::vector<IRBlock*> work = {block};
+                while (!work.empty()) {
+                    IRBlock* b = work.back();
+                    work.pop_back();
+                    if (!body.insert(b).second) continue;
+                    for (IRBlock* p : b->preds) work.push_back(p);
+                }
+            }
+        }
+        return loops;
+    }
+
+    // --- cse ---
+
+    static bool cseable(const IRInstr* in) {
+        if (in->op == IR_PHI || irIsInline(in->op)) return false;
+        IREffect e = irEffect(in);
+        return e == EFF_PURE || e == EFF_LOAD;
+    }
+
+    std::string key(IRInstr* in) {
+        std::string k = std::to_string(in->op) + ":" + in->name;
+        for (IRInstr* arg : in->args) {
+            k += ",";
+            if (arg->op == IR_CONST) k += "c" + irOperand(arg) + irTypeName(arg->type);
+            else if (arg->op == IR_PARAM) k += irOperand(arg);
+            else k += std::to_string(arg->id);
+        }
+        if (irEffect(in) == EFF_LOAD) k += "@" + std::to_string(memState[in]);
+        return k;
+    }
+
+    void cse(IRBlock* block, std::map<std::string, IRInstr*>& available) {
+        std::vector<std::string> added;
+        for (IRInstr* in : block->instrs) {
+            for (auto& arg : in->args) arg = irResolve(arg);
+            if (!cseable(in)) continue;
+            std::string k = key(in);
+            auto it = available.find(k);
+            if (it != available.end()) {
+                replace(in, it->second);
+                cseRemoved++;
+            } else {
+                available[k] = in;
+                added.push_back(k);
+            }
+        }
+        for (IRBlock* child : domChildren[block]) cse(child, available);
+        for (auto& k : added) available.erase(k);
+    }
+
+    // --- licm ---
+
+    static bool hoistable(const IRInstr* in, bool loopStores) {
+        if (in->op == IR_PHI || in->op == IR_ELEM || in->op == IR_ITEM || irIsTerminator(in->op) || irMayFail(in)) return false;
+        IREffect e = irEffect(in);
+        // Everything else that is pure or loading is also safe to run
+        // speculatively: a missing field is nil. IR_ELEM and IR_ITEM are
+        // only in bounds where they are, and an access that may raise must
+        // only raise if the loop actually runs it.
+        return e == EFF_PURE || (e == EFF_LOAD && !loopStores);
+    }
+
+    void licm(IRBlock* header, const std::set<IRBlock*>& body) {
+        IRBlock* pre = nullptr;
+        for (IRBlock* p : header->preds) {
+            if (body.count(p)) continue;
+            if (pre) return;
+            pre = p;
+        }
+        if (!pre || pre->succs().size() != 1) return;
+
+        bool loopStores = false;
+        for (IRBlock* b : body) {
+            for (IRInstr* in : b->instrs) {
+                if (writesMemory(in)) loopStores = true;
+            }
+        }
+        std::vector<IRBlock*> blocks;
+        for (IRBlock* b : rpo) {
+            if (body.count(b)) blocks.push_back(b);
+        }
+        for (IRBlock* b : blocks) {
+            std::vector<IRInstr*> kept;
+            for (IRInstr* in : b->instrs) {
+                bool invariant = hoistable(in, loopStores);
+                for (IRInstr* arg : in->args) {
+                    if (arg->block && body.count(arg->block)) invariant = false;
+                }
+                if (!invariant) {
+                    kept.push_back(in);
+                    continue;
+                }
+                in->block = pre;
+                pre->instrs.insert(pre->instrs.end() - 1, in);
+                hoisted++;
+            }
+            b->instrs = kept;
+        }
+    }
+
+    // --- dce ---
+
+    void dce() {
+        std::set<IRInstr*> live;
+        std::vector<IRInstr*> work;
+        for (auto& block : fn.blocks) {
+            for (IRInstr* in : block->instrs) {
+                IREffect e = irEffect(in);
+                if (e == EFF_STORE || e == EFF_IO || e == EFF_CONTROL || irMayFail(in)) {
+                    live.insert(in);
+                    work.push_back(in);
+                }
+            }
+        }
+        while (!work.empty()) {
+            IRInstr* in = work.back();
+            work.pop_back();
+            for (IRInstr* arg : in->args) {
+                if (live.insert(arg).second) work.push_back(arg);
+            }
+        }
+        for (auto& block : fn.blocks) {
+            std::vector<IRInstr*> kept;
+            for (IRInstr* in : block->instrs) {
+                if (live.count(in)) kept.push_back(in);
+                else dceRemoved++;
+            }
+            block->instrs = kept;
+        }
+    }
+
+public:
+    Optimizer(IRFunction& f) : fn(f) {}
+
+    // Turns the IR_CHECKs after calls that cannot fail (anymore: the access
+    // was proven in bounds, or the callee turned out not to raise) into
+    // jumps, dropping the edges into the handler. Run cleanup() afterwards.
+    void simplifyChecks() {
+        for (auto& block : fn.blocks) {
+            IRInstr* check = block->terminator();
+            if (!check || check->op != IR_CHECK) continue;
+            auto& instrs = block->instrs;
+            if (instrs.size() >= 2 && irMayFail(instrs[instrs.size() - 2])) continue;
+            IRBlock* handler = check->targets[1];
+            check->op = IR_JUMP;
+            check->targets[1] = nullptr;
+            auto& preds = handler->preds;
+            size_t i = std::find(preds.begin(), preds.end(), block.get()) - preds.begin();
+            preds.erase(preds.begin() + i);
+            for (IRInstr* in : handler->instrs) {
+                if (in->op == IR_PHI) in->args.erase(in->args.begin() + i);
+            }
+        }
+    }
+
+    // Run once after lowering and again after anything that rewires the
+    // CFG (inlining); everything else assumes a clean graph.
+    void cleanup() {
+        removeUnreachable();
+        removeTrivialPhis();
+        mergeBlocks();
+    }
+
+    // Expects cleanup() to have run and callee return types to be final.
+    void optimize() {
+        computeOrder();
+        computeDominators();
+        inferTypes();
+        foldConstants();
+        if (foldBranches()) {
+            cleanup();
+            computeOrder();
+            computeDominators();
+            inferTypes();
+        }
+        eliminateChecks();
+
+        auto loops = findLoops();
+        computeMemoryStates(loops);
+        std::map<std::string, IRInstr*> available;
+        cse(rpo[0], available);
+        rewrite();
+
+        // Inner loops first, so that what they hoist can move further out.
+        // Loops of the same size go in program order, not header address
+        // order, so that the output does not depend on the allocator.
+        std::vector<std::pair<IRBlock*, std::set<IRBlock*>>> nest(loops.begin(), loops.end());
+        std::sort(nest.begin(), nest.end(), [&](const auto& a, const auto& b) {
+            if (a.second.size() != b.second.size()) return a.second.size() < b.second.size();
+            return order[a.first] < order[b.first];
+        });
+        for (auto& loop : nest) licm(loop.first, loop.second);
+
+        dce();
+        inferTypes();
+    }
+};
+
+// Lays blocks out in reverse postorder, which CodeGen relies on for
+// fallthrough, and renumbers them.
+void irFinish(IRFunction& fn) {
+    std::map<IRBlock*, int> pos;
+    std::vector<IRBlock*> post;
+    std::set<IRBlock*> seen = {fn.blocks[0].get()};
+    std::vector<std::pair<IRBlock*, size_t>> stack = {{fn.blocks[0].get(), 0}};
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        std::vector<IRBlock*> succs = top.first->succs();
+        if (top.second < succs.size()) {
+            IRBlock* next = succs[top.second++];
+            if (seen.insert(next).second) stack.push_back({next, 0});
+        } else {
+            post.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+    for (size_t i = 0; i < post.size(); i++) pos[post[post.size() - 1 - i]] = i;
+    std::sort(fn.blocks.begin(), fn.blocks.end(), [&](const auto& a, const auto& b) {
+        return pos[a.get()] < pos[b.get()];
+    });
+    for (size_t i = 0; i < fn.blocks.size(); i++) fn.blocks[i]->id = i;
+}
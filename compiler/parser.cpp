@@ -17,7 +17,7 @@ class Parser {
     }
     
     std::unique_ptr<ASTNode> parsePrimary() {
-        if (check(TOK_NUMBER)) {
+        if (check(TOK_NUMBER) || check(TOK_INT)) {
             auto node = std::make_unique<ASTNode>(NODE_LITERAL, advance().value);
             return node;
         }
@@ -57,6 +57,8 @@ class Parser {
         if (check(TOK_IDENT)) {
             auto name = advance().value;
             
+            auto node = std::make_unique<ASTNode>(NODE_IDENT, name);
+            
             // Check for function call (built-in functions like check_type, to_int, etc.)
             if (check(TOK_LPAREN)) {
                 auto call = std::make_unique<ASTNode>(NODE_FUNC_CALL, name);
@@ -66,11 +68,10 @@ class Parser {
                     if (check(TOK_COMMA)) advance();
                 }
                 expect(TOK_RPAREN);
-                return call;
+                if (!check(TOK_DOT)) return call;
+                node = std::move(call);     // range(10).map(f)
             }
             
-            auto node = std::make_unique<ASTNode>(NODE_IDENT, name);
-            
             while (true) {
                 if (check(TOK_DOT)) {
                     advance();
@@ -96,6 +97,18 @@ class Parser {
                             }
                             expect(TOK_RPAREN);
                             return access;
+                        } else if (check(TOK_LPAREN)) {
+                            // Method call: receiver, method, arguments
+                            auto access = std::make_unique<ASTNode>(NODE_MEMBER_ACCESS, "call");
+                            access->children.push_back(std::move(node));
+                            access->children.push_back(std::make_unique<ASTNode>(NODE_IDENT, method));
+                            advance(); // (
+                            while (!check(TOK_RPAREN)) {
+                                access->children.push_back(parseExpression());
+                                if (check(TOK_COMMA)) advance();
+                            }
+                            expect(TOK_RPAREN);
+                            node = std::move(access);
                         } else {
                             auto access = std::make_unique<ASTNode>(NODE_MEMBER_ACCESS);
                             access->children.push_back(std::move(node));
@@ -128,7 +141,7 @@ class Parser {
     
     std::unique_ptr<ASTNode> parseTerm() {
         auto left = parsePrimary();
-        while (check(TOK_STAR) || check(TOK_SLASH)) {
+        while (check(TOK_STAR) || check(TOK_SLASH) || check(TOK_PERCENT)) {
             auto op = advance().value;
             auto right = parsePrimary();
             auto node = std::make_unique<ASTNode>(NODE_BINARY_OP, op);
@@ -179,7 +192,31 @@ class Parser {
         return left;
     }
     
+    // A $match case: an int (possibly negative) or a string.
+    std::unique_ptr<ASTNode> parseCase() {
+        if (check(TOK_MINUS)) {
+            advance();
+            return std::make_unique<ASTNode>(NODE_LITERAL, "-" + expect(TOK_INT).value);
+        }
+        if (check(TOK_INT)) return std::make_unique<ASTNode>(NODE_LITERAL, advance().value);
+        if (check(TOK_STRING)) return std::make_unique<ASTNode>(NODE_LITERAL, "\"" + advance().value + "\"");
+        throw std::runtime_error("$match cases must be int or string literals");
+    }
+    
     std::unique_ptr<ASTNode> parseStatement() {
+        int line = peek().line;
+        auto node = parseStatementAt();
+        node->line = line;
+        return node;
+    }
+    
+    std::unique_ptr<ASTNode> parseStatementAt() {
+        if (check(TOK_USE)) {
+            advance();
+            if (!check(TOK_STRING)) throw std::runtime_error("Expected module path string after $use");
+            return std::make_unique<ASTNode>(NODE_USE, advance().value);
+        }
+        
         if (check(TOK_IN)) {
             advance();
             auto varName = expect(TOK_IDENT).value;
@@ -196,6 +233,15 @@ class Parser {
             return node;
         }
         
+        if (check(TOK_SPAWN)) {
+            advance();
+            auto call = parsePrimary();
+            if (call->type != NODE_FUNC_CALL) throw std::runtime_error("Expected a function call after $spawn");
+            auto node = std::make_unique<ASTNode>(NODE_SPAWN);
+            node->children.push_back(std::move(call));
+            return node;
+        }
+        
         if (check(TOK_YAP)) {
             advance();
             auto node = std::make_unique<ASTNode>(NODE_YAP);
@@ -274,8 +320,62 @@ class Parser {
             return node;
         }
         
+        if (check(TOK_MATCH)) {
+            advance();
+            auto node = std::make_unique<ASTNode>(NODE_MATCH);
+            node->children.push_back(parseLogical());
+            expect(TOK_DCOLON);
+            expect(TOK_LBRACE);
+            while (!check(TOK_RBRACE)) {
+                // 1, 2 => body   "a" => { ... }   _ => body
+                auto arm = std::make_unique<ASTNode>(NODE_BLOCK);
+                if (check(TOK_IDENT) && peek().value == "_") {
+                    advance();
+                    arm->value = "_";
+                } else {
+                    arm->children.push_back(parseCase());
+                    while (check(TOK_COMMA)) {
+                        advance();
+                        arm->children.push_back(parseCase());
+                    }
+                }
+                expect(TOK_ARROW);
+                if (check(TOK_LBRACE)) {
+                    advance();
+                    auto block = std::make_unique<ASTNode>(NODE_BLOCK);
+                    while (!check(TOK_RBRACE)) block->children.push_back(parseStatement());
+                    expect(TOK_RBRACE);
+                    arm->children.push_back(std::move(block));
+                } else {
+                    arm->children.push_back(parseStatement());
+                }
+                node->children.push_back(std::move(arm));
+                if (check(TOK_COMMA)) advance();
+            }
+            expect(TOK_RBRACE);
+            return node;
+        }
+        
         if (check(TOK_FOR)) {
             advance();
+            if (check(TOK_IDENT)) {
+                // $for x $in collection; at the start of a statement, $in
+                // reads a line of input instead.
+                auto node = std::make_unique<ASTNode>(NODE_FOR_IN, advance().value);
+                expect(TOK_IN);
+                node->children.push_back(parseExpression());
+                expect(TOK_DCOLON);
+                if (check(TOK_LBRACE)) {
+                    advance();
+                    auto block = std::make_unique<ASTNode>(NODE_BLOCK);
+                    while (!check(TOK_RBRACE)) block->children.push_back(parseStatement());
+                    expect(TOK_RBRACE);
+                    node->children.push_back(std::move(block));
+                } else {
+                    node->children.push_back(parseStatement());
+                }
+                return node;
+            }
             expect(TOK_LPAREN);
             auto init = parseStatement();
             expect(TOK_COMMA);
@@ -368,7 +468,16 @@ class Parser {
                 advance();
                 if (check(TOK_IDENT)) {
                     std::string method = advance().value;
-                    if ((method == "run" || method == "sort") && check(TOK_LPAREN)) {
+                    if (method == "sort" && check(TOK_LPAREN)) {
+                        auto access = std::make_unique<ASTNode>(NODE_MEMBER_ACCESS);
+                        access->children.push_back(std::make_unique<ASTNode>(NODE_IDENT, name));
+                        access->children.push_back(std::make_unique<ASTNode>(NODE_IDENT, method));
+                        advance();
+                        if (!check(TOK_RPAREN)) access->children.push_back(parseExpression());
+                        expect(TOK_RPAREN);
+                        return access;
+                    }
+                    if (method == "run" && check(TOK_LPAREN)) {
                         auto call = std::make_unique<ASTNode>(NODE_FUNC_CALL, name);
                         advance();
                         while (!check(TOK_RPAREN)) {
@@ -382,7 +491,8 @@ class Parser {
                 pos = savedPos;
             }
             
-            // Check for assignment (property or array element)
+            // Check for assignment (property or array element), or a method
+            // call made for its effect: c.send(x)
             if (check(TOK_DOT) || check(TOK_LBRACK)) {
                 auto lhs = std::make_unique<ASTNode>(NODE_IDENT, name);
                 
@@ -394,6 +504,15 @@ class Parser {
                         auto access = std::make_unique<ASTNode>(NODE_MEMBER_ACCESS);
                         access->children.push_back(std::move(lhs));
                         access->children.push_back(std::make_unique<ASTNode>(NODE_IDENT, member));
+                        if (check(TOK_LPAREN)) {
+                            access->value = "call";
+                            advance(); // (
+                            while (!check(TOK_RPAREN)) {
+                                access->children.push_back(parseExpression());
+                                if (check(TOK_COMMA)) advance();
+                            }
+                            expect(TOK_RPAREN);
+                        }
                         lhs = std::move(access);
                     } else {
                         advance(); // [
@@ -413,6 +532,16 @@ class Parser {
                     node->children.push_back(parseExpression());
                     return node;
                 }
+                
+                // Element increment: counts[word]++
+                if (check(TOK_PLUSPLUS) && lhs->type == NODE_INDEX_ACCESS) {
+                    advance();
+                    auto node = std::make_unique<ASTNode>(NODE_UNARY_OP, "++");
+                    node->children.push_back(std::move(lhs));
+                    return node;
+                }
+                
+                if (lhs->type == NODE_MEMBER_ACCESS && lhs->value == "call") return lhs;
             }
             
             // Check for variable declaration
@@ -445,4 +574,17 @@ public:
         }
         return root;
     }
+
+    // The top-level statements that start before source offset `end`, and
+    // the offset each one starts at. `stop` is set to where the last one
+    // ended: the offset of the token after it.
+    std::vector<std::unique_ptr<ASTNode>> parseStatements(size_t end, std::vector<size_t>& starts, size_t& stop) {
+        std::vector<std::unique_ptr<ASTNode>> stmts;
+        while (!check(TOK_EOF) && peek().offset < end) {
+            starts.push_back(peek().offset);
+            stmts.push_back(parseStatement());
+        }
+        stop = peek().offset;
+        return stmts;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "../include/ast.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <sys/resource.h>
+
+// Per-stage wall and CPU timing for `sig --time-passes` / `--stats-json`.
+// Stages run in-process (lexing, parsing, ...) are charged the process CPU
+// time; stages that run a child (gcc, the compiled program) are charged the
+// children's CPU time, so the two are never mixed up.
+class PassStats {
+    struct Pass {
+        std::string name;
+        double wallMs;
+        double cpuMs;
+    };
+
+    std::vector<Pass> passes;
+    std::vector<std::pair<std::string, long long>> counts;
+
+    static double wallNow() {
+        using namespace std::chrono;
+        return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    static double selfCpuNow() {
+        timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+    }
+
+    static double childCpuNow() {
+        rusage ru;
+        getrusage(RUSAGE_CHILDREN, &ru);
+        return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3 +
+               (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+    }
+
+    // A pass that runs more than once (e.g. lexing each module) accumulates.
+    void record(const std::string& name, double wall, double cpu) {
+        for (auto& p : passes) {
+            if (p.name == name) {
+                p.wallMs += wall;
+                p.cpuMs += cpu;
+                return;
+            }
+        }
+        passes.push_back({name, wall, cpu});
+    }
+
+public:
+    class Scope {
+        PassStats* stats;
+        std::string name;
+        bool child;
+        double wall0, cpu0;
+
+    public:
+        Scope(PassStats* s, std::string n, bool c)
+            : stats(s), name(n), child(c),
+              wall0(wallNow()), cpu0(c ? childCpuNow() : selfCpuNow()) {}
+        ~Scope() {
+            double cpu = (child ? childCpuNow() : selfCpuNow()) - cpu0;
+            stats->record(name, wallNow() - wall0, cpu);
+        }
+    };
+
+    // Times the enclosing block as an in-process pass.
+    Scope pass(std::string name) { return Scope(this, name, false); }
+
+    // Times the enclosing block as a pass that runs child processes.
+    Scope childPass(std::string name) { return Scope(this, name, true); }
+
+    void count(std::string name, long long value) {
+        for (auto& c : counts) {
+            if (c.first == name) {
+                c.second += value;
+                return;
+            }
+        }
+        counts.push_back({name, value});
+    }
+
+    double wallMs(const std::string& name) const {
+        for (auto& p : passes) {
+            if (p.name == name) return p.wallMs;
+        }
+        return 0;
+    }
+
+    // The name column is as wide as the longest pass or count name.
+    void printTable(std::ostream& out) const {
+        double totalWall = 0, totalCpu = 0;
+        size_t width = 12;
+        for (auto& p : passes) {
+            totalWall += p.wallMs;
+            totalCpu += p.cpuMs;
+            width = std::max(width, p.name.size());
+        }
+        for (auto& c : counts) width = std::max(width, c.first.size());
+        int w = (int)std::min(width, (size_t)64);
+        char line[160];
+        out << "===-- sig pass timings --===\n";
+        snprintf(line, sizeof(line), "  %-*s %12s %12s %7s\n", w, "pass", "wall (ms)", "cpu (ms)", "wall %");
+        out << line;
+        for (auto& p : passes) {
+            snprintf(line, sizeof(line), "  %-*s %12.3f %12.3f %6.1f%%\n", w, p.name.c_str(),
+                     p.wallMs, p.cpuMs, totalWall > 0 ? 100.0 * p.wallMs / totalWall : 0.0);
+            out << line;
+        }
+        snprintf(line, sizeof(line), "  %-*s %12.3f %12.3f\n", w, "total", totalWall, totalCpu);
+        out << line;
+        out << "===-- sig counts --===\n";
+        for (auto& c : counts) {
+            snprintf(line, sizeof(line), "  %-*s %12lld\n", w, c.first.c_str(), c.second);
+            out << line;
+        }
+    }
+
+    void printJson(std::ostream& out) const {
+        char num[64];
+        out << "{\n  \"passes\": [";
+        for (size_t i = 0; i < passes.size(); i++) {
+            snprintf(num, sizeof(num), "%.3f", passes[i].wallMs);
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << passes[i].name << "\", \"wall_ms\": " << num;
+            snprintf(num, sizeof(num), "%.3f", passes[i].cpuMs);
+            out << ", \"cpu_ms\": " << num << "}";
+        }
+        out << "\n  ],\n  \"counts\": {";
+        for (size_t i = 0; i < counts.size(); i++) {
+            out << (i ? ",\n" : "\n") << "    \"" << counts[i].first << "\": " << counts[i].second;
+        }
+        out << "\n  }\n}\n";
+    }
+};
+
+long long countNodes(const ASTNode* node) {
+    long long n = 1;
+    for (auto& child : node->children) n += countNodes(child.get());
+    return n;
+}
@@ -0,0 +1,150 @@
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <set>
+#include <string>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t watchInterrupted = 0;
+
+static void onWatchInterrupt(int) {
+    watchInterrupted = 1;
+}
+
+// `sig watch`: builds and runs the program, then again every time one of
+// its files is saved, until interrupted.
+//
+// Between builds it keeps the syntax trees of every file (ParseCache), the
+// work directory and the object cache. Each module is compiled as shards of
+// a few functions at -O0, against a precompiled runtime header and the
+// usual -O3 runtime object, and calls one -O3 copy of the runtime's inline
+// helpers instead of compiling its own. An edit recompiles the shards whose
+// C changed and relinks. IR optimizations are off, as with --no-ir-opt:
+// inlining and specialization would tie each function's C to its callees.
+//
+// Files are watched through their directories, since many editors save by
+// writing a new file and renaming it over the old one.
+class Watcher {
+    std::string entry;
+    std::string exe;
+    ParseCache cache;
+    int fd = -1;
+    std::set<std::string> dirs;
+
+    void watchDirectory(const std::string& dir) {
+        if (!dirs.insert(dir).second) return;
+        if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            std::cerr << "sig watch: cannot watch " << dir << "\n";
+        }
+    }
+
+    // Blocks until a .sgm file in a watched directory has been written.
+    // False if interrupted.
+    bool waitForChange() {
+        alignas(inotify_event) char buf[16384];
+        bool changed = false;
+        while (!changed) {
+            pollfd p = {fd, POLLIN, 0};
+            if (poll(&p, 1, -1) < 0) {
+                if (watchInterrupted) return false;
+                continue;
+            }
+            // Take every event that is already queued, so that one save
+            // that produced several is one build.
+            while (true) {
+                ssize_t n = read(fd, buf, sizeof(buf));
+                if (n <= 0) break;
+                for (char* at = buf; at < buf + n;) {
+                    auto* e = (inotify_event*)at;
+                    std::string name = e->len ? e->name : "";
+                    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".sgm") == 0) changed = true;
+                    at += sizeof(inotify_event) + e->len;
+                }
+            }
+        }
+        return true;
+    }
+
+    static double msSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void rebuild() {
+        auto start = std::chrono::steady_clock::now();
+        PassStats stats;
+        ModuleGraph graph;
+        graph.parseCache = &cache;
+        bool built = false;
+        try {
+            graph.load(entry, stats, !builder.shared);
+            graph.optimize(stats, false);
+            graph.generateShards(stats, memStats);
+            built = builder.build(graph, exe, stats);
+            if (!built) std::cerr << "Compilation failed!\n";
+        } catch (std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+        }
+        for (auto& mod : graph.modules) {
+            watchDirectory(fs::path(mod->path).parent_path().string());
+            cache.keep(mod->path, std::move(mod->ast));
+        }
+        double ms = msSince(start);
+
+        if (built) {
+            fprintf(stderr, "sig watch: built in %.0f ms (%d of %d units compiled)\n", ms,
+                    builder.compiled, builder.compiled + builder.cacheHits);
+            if (output.empty()) {
+                auto t = stats.childPass("run");
+                int status = system(exe.c_str());
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    fprintf(stderr, "sig watch: program exited with status %d\n",
+                            WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+                }
+            }
+        }
+        if (report) report(stats);
+        fprintf(stderr, "sig watch: waiting for changes (Ctrl-C to stop)\n");
+    }
+
+public:
+    Builder& builder;
+    std::string output;                         // -o: only build it there
+    bool memStats = false;
+    std::function<void(PassStats&)> report;     // --time-passes, --stats-json
+
+    Watcher(const std::string& entryPath, Builder& builder)
+        : entry(fs::weakly_canonical(fs::path(entryPath)).string()), builder(builder) {
+        builder.unitCflags = {"-O0"};
+        builder.precompileHeader = true;
+        builder.outlineHelpers = true;
+        builder.useFastLinker();
+    }
+
+    ~Watcher() {
+        if (fd >= 0) close(fd);
+        if (output.empty() && !exe.empty()) unlink(exe.c_str());
+    }
+
+    int run() {
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "sig watch: inotify is not available\n";
+            return 1;
+        }
+        exe = output.empty() ? "/tmp/sigma_watch_" + std::to_string(getpid()) : output;
+        watchDirectory(fs::path(entry).parent_path().string());
+
+        // No SA_RESTART: Ctrl-C has to wake the poll in waitForChange.
+        struct sigaction sa = {};
+        sa.sa_handler = onWatchInterrupt;
+        sigaction(SIGINT, &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+
+        rebuild();
+        while (!watchInterrupted && waitForChange()) rebuild();
+        return 0;
+    }
+};
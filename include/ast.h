@@ -16,6 +16,7 @@ enum ASTNodeType {
     NODE_RETURN,
     NODE_IF,
     NODE_FOR,
+    NODE_FOR_IN,        // $for x $in collection: variable in value, collection and body
     NODE_WHILE,
     NODE_BLOCK,
     NODE_YAP,
@@ -24,13 +25,20 @@ enum ASTNodeType {
     NODE_MEMBER_ACCESS,
     NODE_INDEX_ACCESS,
     NODE_TRY_CATCH,
-    NODE_INPUT
+    NODE_INPUT,
+    NODE_USE,
+    NODE_SPAWN,         // $spawn f.run(args): the call
+    NODE_MATCH          // $match value :: { cases => body }: the value, then one NODE_BLOCK
+                        // per arm holding its cases (int and string literals; none, with
+                        // value "_", for the default) and its body last
 };
 
 struct ASTNode {
     ASTNodeType type;
     std::string value;
     std::vector<std::unique_ptr<ASTNode>> children;
+    bool noEscape = false;   // array/object literal that may live on the stack
+    int line = 0;            // statements: source line they start on
     
     ASTNode(ASTNodeType t, std::string v = "") : type(t), value(v) {}
 };
\ No newline at end of file
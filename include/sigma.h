@@ -0,0 +1,168 @@
+// libsigma: compile a Sigma module once and call its functions in-process.
+//
+//   sigma_module* m = sigma_compile("rules.sgm");
+//   const sigma_function* score = sigma_function_get(m, "score");
+//   sigma_value args[] = {sigma_int(3), sigma_dec(0.5)};
+//   sigma_value result = sigma_invoke(score, args, 2);
+//
+// sigma_compile runs the Sigma compiler and gcc once and links the module,
+// the modules it uses and the runtime into a shared object, which is then
+// loaded with dlopen. sig --shared -o rules.so rules.sgm builds the same
+// object ahead of time for sigma_load. Loading runs the module's top-level
+// statements once.
+//
+// Functions that fail return NULL (or a nil value) and leave a message for
+// sigma_last_error. That includes Sigma errors that nothing catches, in the
+// module's top-level statements (sigma_compile and sigma_load fail) or in a
+// called function.
+#ifndef SIGMA_H
+#define SIGMA_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The value ABI. It is the runtime's own representation, so values cross
+// into and out of compiled code without conversion: 16 bytes, a type tag
+// followed by the payload. The numbering is stable.
+typedef enum {
+  SIGMA_NIL = 0,
+  SIGMA_DEC = 1,
+  SIGMA_INT = 2,
+  SIGMA_STR = 3,
+  SIGMA_BOOL = 4,
+  SIGMA_ARR = 5,
+  SIGMA_OBJ = 6,
+  SIGMA_DICT = 7,
+  SIGMA_TYPED = 8,
+  SIGMA_CHAN = 9,
+  SIGMA_TABLE = 10
+} sigma_type;
+
+typedef struct {
+  sigma_type type;
+  union {
+    double dec;
+    int64_t i;
+    const char* str;    // immutable, owned by the module; valid while it is loaded
+    int b;
+    void* ref;          // arrays, objects, dicts, typed arrays, channels and tables
+  } as;
+} sigma_value;
+
+typedef struct sigma_module sigma_module;
+typedef struct sigma_function sigma_function;
+
+// Compiles `sgm_path` and loads it.
+sigma_module* sigma_compile(const char* sgm_path);
+// Loads a library built with sig --shared.
+sigma_module* sigma_load(const char* so_path);
+// Frees the module. A library whose code has run $spawn stays mapped: its
+// worker threads outlive it.
+void sigma_unload(sigma_module* module);
+
+// A function of the module's entry file, or NULL if there is none.
+const sigma_function* sigma_function_get(const sigma_module* module, const char* name);
+int sigma_function_arity(const sigma_function* fn);
+
+// Calls `fn` with exactly its arity in arguments (at most 8). A nil result
+// is a failure if sigma_last_error() is not empty, with the message and the
+// Sigma source line, e.g. "Index 3 out of bounds for an array of 3
+// (rules.sgm:12)".
+sigma_value sigma_invoke(const sigma_function* fn, const sigma_value* args, int argc);
+// Looks `name` up and calls it; prefer sigma_function_get for repeated calls.
+sigma_value sigma_call(const sigma_module* module, const char* name, const sigma_value* args, int argc);
+
+// The message of the last failure on this thread.
+const char* sigma_last_error(void);
+
+static inline sigma_value sigma_nil(void) {
+  sigma_value v; v.type = SIGMA_NIL; v.as.i = 0; return v;
+}
+
+static inline sigma_value sigma_int(int64_t i) {
+  sigma_value v; v.type = SIGMA_INT; v.as.i = i; return v;
+}
+
+static inline sigma_value sigma_dec(double d) {
+  sigma_value v; v.type = SIGMA_DEC; v.as.dec = d; return v;
+}
+
+static inline sigma_value sigma_bool(int b) {
+  sigma_value v; v.type = SIGMA_BOOL; v.as.i = 0; v.as.b = b != 0; return v;
+}
+
+// Strings carry a header the runtime fills in, so they are made by the module.
+sigma_value sigma_string(const sigma_module* module, const char* s);
+
+#ifdef __cplusplus
+}
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace sigma {
+
+// Owns a loaded module; errors are thrown as std::runtime_error.
+//
+//   auto rules = sigma::Module::compile("rules.sgm");
+//   sigma_value s = rules.call("score", 3, 0.5, "gold");
+class Module {
+    sigma_module* m = nullptr;
+
+    explicit Module(sigma_module* module) : m(module) {
+        if (!m) throw std::runtime_error(sigma_last_error());
+    }
+
+    sigma_value value(sigma_value v) const { return v; }
+    sigma_value value(int i) const { return sigma_int(i); }
+    sigma_value value(long i) const { return sigma_int(i); }
+    sigma_value value(long long i) const { return sigma_int(i); }
+    sigma_value value(double d) const { return sigma_dec(d); }
+    sigma_value value(bool b) const { return sigma_bool(b); }
+    sigma_value value(const char* s) const { return sigma_string(m, s); }
+    sigma_value value(const std::string& s) const { return sigma_string(m, s.c_str()); }
+
+public:
+    static Module compile(const std::string& sgmPath) { return Module(sigma_compile(sgmPath.c_str())); }
+    static Module load(const std::string& soPath) { return Module(sigma_load(soPath.c_str())); }
+
+    Module(Module&& other) noexcept : m(std::exchange(other.m, nullptr)) {}
+    Module& operator=(Module&& other) noexcept {
+        std::swap(m, other.m);
+        return *this;
+    }
+    ~Module() {
+        if (m) sigma_unload(m);
+    }
+
+    const sigma_function* function(const char* name) const {
+        const sigma_function* fn = sigma_function_get(m, name);
+        if (!fn) throw std::runtime_error(sigma_last_error());
+        return fn;
+    }
+
+    template <class... Args>
+    sigma_value call(const sigma_function* fn, Args&&... args) const {
+        sigma_value argv[sizeof...(Args) + 1] = {value(std::forward<Args>(args))...};
+        if ((int)sizeof...(Args) != sigma_function_arity(fn)) throw std::runtime_error("wrong number of arguments");
+        sigma_value result = sigma_invoke(fn, argv, (int)sizeof...(Args));
+        if (result.type == SIGMA_NIL && *sigma_last_error()) throw std::runtime_error(sigma_last_error());
+        return result;
+    }
+
+    template <class... Args>
+    sigma_value call(const char* name, Args&&... args) const {
+        return call(function(name), std::forward<Args>(args)...);
+    }
+
+    sigma_module* get() const { return m; }
+};
+
+}  // namespace sigma
+#endif
+
+#endif
@@ -3,8 +3,8 @@
 
 enum TokenType {
     TOK_EOF,
-    TOK_NUMBER, TOK_STRING, TOK_IDENT,
-    TOK_PLUS, TOK_MINUS, TOK_STAR, TOK_SLASH,
+    TOK_NUMBER, TOK_INT, TOK_STRING, TOK_IDENT,
+    TOK_PLUS, TOK_MINUS, TOK_STAR, TOK_SLASH, TOK_PERCENT,
     TOK_LPAREN, TOK_RPAREN, TOK_LBRACE, TOK_RBRACE,
     TOK_LBRACK, TOK_RBRACK,
     TOK_COMMA, TOK_DOT, TOK_COLON, TOK_DCOLON,
@@ -14,11 +14,13 @@ enum TokenType {
     TOK_YAP, TOK_ARROW, TOK_PLUSPLUS,
     TOK_TIME_START, TOK_TIME_END, TOK_FIXED,
     TOK_TRY, TOK_CATCH, TOK_IN,
-    TOK_AND, TOK_OR
+    TOK_AND, TOK_OR,
+    TOK_USE, TOK_SPAWN, TOK_MATCH
 };
 
 struct Token {
     TokenType type;
     std::string value;
     int line, col;
+    size_t offset = 0;      // of its first character in the source
 };
\ No newline at end of file
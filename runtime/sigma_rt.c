@@ -0,0 +1,5010 @@
+// Sigma runtime: out-of-line parts. See sigma_rt.h.
+
+#include "sigma_rt.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+#ifdef SIGMA_MEM_STATS
+// --- allocation profiling ---
+
+_Thread_local const char* sigma_mem_file;
+_Thread_local int sigma_mem_line;
+
+// Per-site totals, in an open-addressing table keyed by (file, line). File
+// names are the per-module constants CodeGen emits, so pointers identify
+// them.
+typedef struct {
+  const char* file;
+  int line;
+  int used;
+  uint64_t count;
+  uint64_t bytes;
+} SigmaMemSite;
+
+#define SIGMA_MEM_SITES 4096
+#define SIGMA_MEM_BUCKETS 64
+static SigmaMemSite sigma_mem_sites[SIGMA_MEM_SITES];
+static uint64_t sigma_mem_histogram[SIGMA_MEM_BUCKETS];
+static uint64_t sigma_mem_count, sigma_mem_bytes, sigma_mem_live, sigma_mem_peak;
+// Tasks allocate from every worker thread; the totals take this lock.
+static pthread_mutex_t sigma_mem_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Every block carries its size in front, so that free and realloc can keep
+// the live total; 16 bytes keep the payload aligned like malloc's.
+typedef union {
+  size_t size;
+  max_align_t align;
+} SigmaMemHeader;
+
+static void sigma_mem_record(size_t size) {
+  pthread_mutex_lock(&sigma_mem_lock);
+  uintptr_t key = (uintptr_t)sigma_mem_file * 31 + (unsigned)sigma_mem_line;
+  size_t i = (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 52) & (SIGMA_MEM_SITES - 1);
+  for (size_t probes = 0; probes < SIGMA_MEM_SITES; probes++, i = (i + 1) & (SIGMA_MEM_SITES - 1)) {
+    SigmaMemSite* site = &sigma_mem_sites[i];
+    if (!site->used) {
+      site->used = 1;
+      site->file = sigma_mem_file;
+      site->line = sigma_mem_line;
+    } else if (site->file != sigma_mem_file || site->line != sigma_mem_line) {
+      continue;
+    }
+    site->count++;
+    site->bytes += size;
+    break;
+  }
+  int bucket = size <= 1 ? 0 : 64 - __builtin_clzll((unsigned long long)size - 1);
+  sigma_mem_histogram[bucket]++;
+  sigma_mem_count++;
+  sigma_mem_bytes += size;
+  sigma_mem_live += size;
+  if (sigma_mem_live > sigma_mem_peak) sigma_mem_peak = sigma_mem_live;
+  pthread_mutex_unlock(&sigma_mem_lock);
+}
+
+static void* sigma_mem_malloc(size_t size) {
+  SigmaMemHeader* h = malloc(sizeof(SigmaMemHeader) + size);
+  if (!h) return NULL;
+  h->size = size;
+  sigma_mem_record(size);
+  return h + 1;
+}
+
+static void* sigma_mem_calloc(size_t n, size_t size) {
+  void* p = sigma_mem_malloc(n * size);
+  if (p) memset(p, 0, n * size);
+  return p;
+}
+
+static void sigma_mem_free(void* p) {
+  if (!p) return;
+  SigmaMemHeader* h = (SigmaMemHeader*)p - 1;
+  pthread_mutex_lock(&sigma_mem_lock);
+  sigma_mem_live -= h->size;
+  pthread_mutex_unlock(&sigma_mem_lock);
+  free(h);
+}
+
+// A realloc counts as an allocation of the new size at the current line.
+static void* sigma_mem_realloc(void* p, size_t size) {
+  if (!p) return sigma_mem_malloc(size);
+  SigmaMemHeader* h = (SigmaMemHeader*)p - 1;
+  size_t old = h->size;
+  h = realloc(h, sizeof(SigmaMemHeader) + size);
+  if (!h) return NULL;
+  h->size = size;
+  pthread_mutex_lock(&sigma_mem_lock);
+  sigma_mem_live -= old;
+  pthread_mutex_unlock(&sigma_mem_lock);
+  sigma_mem_record(size);
+  return h + 1;
+}
+
+static int sigma_mem_by_bytes(const void* a, const void* b) {
+  const SigmaMemSite* x = a;
+  const SigmaMemSite* y = b;
+  if (x->bytes != y->bytes) return x->bytes < y->bytes ? 1 : -1;
+  return x->count < y->count ? 1 : x->count > y->count ? -1 : 0;
+}
+
+static void sigma_mem_site_name(const SigmaMemSite* site, char* buf, size_t size) {
+  if (site->file) snprintf(buf, size, "%s:%d", site->file, site->line);
+  else snprintf(buf, size, "(startup)");
+}
+
+static void sigma_mem_report(void) {
+  FILE* out = stderr;
+  const char* path = getenv("SIGMA_MEM_STATS_FILE");
+  if (path && *path && !(out = fopen(path, "w"))) out = stderr;
+
+  SigmaMemSite sites[SIGMA_MEM_SITES];
+  size_t n = 0;
+  for (size_t i = 0; i < SIGMA_MEM_SITES; i++) {
+    if (sigma_mem_sites[i].used) sites[n++] = sigma_mem_sites[i];
+  }
+  qsort(sites, n, sizeof(SigmaMemSite), sigma_mem_by_bytes);
+  char name[256];
+
+#if SIGMA_MEM_STATS == 2
+  fprintf(out, "{\n  \"allocations\": %" PRIu64 ",\n  \"bytes\": %" PRIu64 ",\n", sigma_mem_count, sigma_mem_bytes);
+  fprintf(out, "  \"peak_live_bytes\": %" PRIu64 ",\n  \"live_at_exit_bytes\": %" PRIu64 ",\n", sigma_mem_peak, sigma_mem_live);
+  fprintf(out, "  \"sites\": [");
+  for (size_t i = 0; i < n; i++) {
+    fprintf(out, "%s\n    {\"file\": ", i ? "," : "");
+    if (sites[i].file) fprintf(out, "\"%s\", \"line\": %d", sites[i].file, sites[i].line);
+    else fprintf(out, "null, \"line\": null");
+    fprintf(out, ", \"allocations\": %" PRIu64 ", \"bytes\": %" PRIu64 "}", sites[i].count, sites[i].bytes);
+  }
+  fprintf(out, "%s],\n  \"histogram\": [", n ? "\n  " : "");
+  int first = 1;
+  for (int b = 0; b < SIGMA_MEM_BUCKETS; b++) {
+    if (!sigma_mem_histogram[b]) continue;
+    fprintf(out, "%s\n    {\"max_bytes\": %llu, \"allocations\": %" PRIu64 "}", first ? "" : ",", 1ULL << b, sigma_mem_histogram[b]);
+    first = 0;
+  }
+  fprintf(out, "%s]\n}\n", first ? "" : "\n  ");
+#else
+  fprintf(out, "\n--- sigma memory ---\n");
+  fprintf(out, "%" PRIu64 " allocations, %" PRIu64 " bytes; peak live %" PRIu64 " bytes, %" PRIu64 " live at exit\n\n",
+          sigma_mem_count, sigma_mem_bytes, sigma_mem_peak, sigma_mem_live);
+  fprintf(out, "%-32s %14s %16s\n", "site", "allocations", "bytes");
+  for (size_t i = 0; i < n; i++) {
+    sigma_mem_site_name(&sites[i], name, sizeof(name));
+    fprintf(out, "%-32s %14" PRIu64 " %16" PRIu64 "\n", name, sites[i].count, sites[i].bytes);
+  }
+  fprintf(out, "\n%-32s %14s\n", "size (bytes)", "allocations");
+  for (int b = 0; b < SIGMA_MEM_BUCKETS; b++) {
+    if (!sigma_mem_histogram[b]) continue;
+    unsigned long long hi = 1ULL << b, lo = b ? (1ULL << (b - 1)) + 1 : 0;
+    snprintf(name, sizeof(name), "%llu - %llu", lo, hi);
+    fprintf(out, "%-32s %14" PRIu64 "\n", name, sigma_mem_histogram[b]);
+  }
+#endif
+  if (out != stderr) fclose(out);
+}
+
+__attribute__((constructor)) static void sigma_mem_start(void) {
+  atexit(sigma_mem_report);
+}
+
+// Everything below allocates through the profiler.
+#define malloc(n) sigma_mem_malloc(n)
+#define calloc(n, size) sigma_mem_calloc(n, size)
+#define realloc(p, n) sigma_mem_realloc(p, n)
+#define free(p) sigma_mem_free(p)
+#endif
+
+// --- errors ---
+
+static const char* const sigma_elem_array[] = {"an f64 array", "an i64 array", "a byte array"};
+
+// What v is, with its article, for error messages: "an int", "a string".
+static const char* sigma_a_type(SigmaValue v) {
+  switch (v.type) {
+    case TYPE_NIL: return "nil";
+    case TYPE_NUMBER: return "a dec";
+    case TYPE_INT: return "an int";
+    case TYPE_STRING: return "a string";
+    case TYPE_BOOL: return "a bool";
+    case TYPE_ARRAY: return "an array";
+    case TYPE_OBJECT: return "an object";
+    case TYPE_DICT: return "a dict";
+    case TYPE_TYPED: return sigma_elem_array[v.as.typed->kind];
+    case TYPE_CHAN: return "a channel";
+    case TYPE_TABLE: return "a table";
+    default: return "an unknown value";
+  }
+}
+
+_Thread_local int sigma_failed;
+static _Thread_local SigmaValue sigma_error_value;
+static _Thread_local int sigma_error_located;
+
+SigmaValue sigma_error_raise(SigmaValue error) {
+  if (error.type != TYPE_OBJECT) {
+    const char* key = "message";
+    SigmaValue message = sigma_to_str(error);
+    error = sigma_make_object_of(1, &key, &message);
+  }
+  sigma_error_value = error;
+  sigma_error_located = 0;
+  sigma_failed = 1;
+  return sigma_make_nil();
+}
+
+void sigma_error(const char* fmt, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  sigma_error_raise(sigma_make_string(buf));
+}
+
+void sigma_error_locate(const char* file, int line) {
+  if (sigma_error_located || !file) return;
+  sigma_object_set(sigma_error_value, "line", sigma_make_int(line));
+  sigma_object_set(sigma_error_value, "file", sigma_make_string(file));
+  sigma_error_located = 1;
+}
+
+SigmaValue sigma_error_catch(void) {
+  SigmaValue error = sigma_error_value;
+  sigma_error_value = sigma_make_nil();
+  sigma_failed = 0;
+  return error;
+}
+
+// Clears the pending error, if any, and describes it in `buf` as
+// "message (file:line)". Returns whether there was one.
+int sigma_error_report(char* buf, size_t size) {
+  if (!sigma_failed) return 0;
+  SigmaValue error = sigma_error_catch();
+  SigmaValue message = sigma_to_str(sigma_object_get(error, "message"));
+  SigmaValue file = sigma_object_get(error, "file");
+  SigmaValue line = sigma_object_get(error, "line");
+  if (file.type == TYPE_STRING && line.type == TYPE_INT) {
+    snprintf(buf, size, "%s (%s:%" PRId64 ")", message.as.string, file.as.string, line.as.integer);
+  } else {
+    snprintf(buf, size, "%s", message.as.string);
+  }
+  return 1;
+}
+
+void sigma_error_uncaught(void) {
+  char buf[512];
+  sigma_error_report(buf, sizeof(buf));
+  fflush(stdout);
+  fprintf(stderr, "Error: %s\n", buf);
+  exit(1);
+}
+
+// --- tasks ---
+
+// M:N scheduling. A task is a coroutine with a stack of its own; a pool of
+// worker threads (one per core, or $SIGMA_WORKERS), started by the first
+// $spawn, runs them. Each worker takes tasks from its own queue, oldest
+// first; an idle one steals half of another's queue, spins for a while,
+// and then sleeps until a task is ready. A task only leaves its worker at a
+// channel operation or blocking I/O: it parks, and whoever readies it again
+// queues it on their own worker, or on the next one round robin if they are
+// not a task. Threads that are not workers (main, a libsigma host) never
+// run tasks; they wait for a channel on a condition variable.
+//
+// A task may resume on a different worker than it parked on. Code that runs
+// on both sides of a park re-reads the current worker through
+// sigma_this_worker rather than reusing a thread-local address computed
+// before.
+
+typedef struct SigmaTask SigmaTask;
+
+// Each task has a stack of SIGMA_TASK_STACK bytes above a guard page, with
+// the task itself at the top. The kernel only commits pages as the stack
+// first reaches them, so a task that stays shallow costs a page or two.
+// Stacks come SIGMA_STACK_CHUNK to a mapping, and finished tasks wait in a
+// free list for the next $spawn. A worker with nothing to do gives the
+// pages of all but SIGMA_WARM_TASKS of them back to the kernel.
+//
+// A guard page splits its mapping in two, and Linux caps a process at
+// about 65000 pieces, so only the first SIGMA_GUARDED_TASKS stacks get one.
+// Stacks past those overflow into their neighbour instead of faulting.
+#define SIGMA_TASK_STACK (256 * 1024)
+#define SIGMA_STACK_CHUNK 64
+#define SIGMA_WARM_TASKS 1024
+#define SIGMA_GUARDED_TASKS 16384
+
+#if (defined(__x86_64__) || defined(__aarch64__)) && !defined(SIGMA_UCONTEXT)
+// A suspended context is its stack pointer. sigma_switch pushes the
+// callee-saved registers (on x86-64 also the SSE and x87 control words),
+// stores the stack pointer in *from, and pops the same from `to`.
+typedef void* SigmaContext;
+void sigma_switch(SigmaContext* from, SigmaContext to) __attribute__((visibility("hidden")));
+
+#ifdef __APPLE__
+#define SIGMA_ASM_FUNCTION(name) ".text\n.globl _" #name "\n.private_extern _" #name "\n.p2align 4\n_" #name ":\n"
+#define SIGMA_ASM_END ""
+#else
+#define SIGMA_ASM_FUNCTION(name) \
+  ".pushsection .text\n.globl " #name "\n.hidden " #name "\n.type " #name ", %function\n.p2align 4\n" #name ":\n"
+#define SIGMA_ASM_END ".popsection\n"
+#endif
+
+#ifdef __x86_64__
+__asm__(SIGMA_ASM_FUNCTION(sigma_switch)
+        "  pushq %rbp\n"
+        "  pushq %rbx\n"
+        "  pushq %r12\n"
+        "  pushq %r13\n"
+        "  pushq %r14\n"
+        "  pushq %r15\n"
+        "  subq $8, %rsp\n"
+        "  stmxcsr (%rsp)\n"
+        "  fnstcw 4(%rsp)\n"
+        "  movq %rsp, (%rdi)\n"
+        "  movq %rsi, %rsp\n"
+        "  ldmxcsr (%rsp)\n"
+        "  fldcw 4(%rsp)\n"
+        "  addq $8, %rsp\n"
+        "  popq %r15\n"
+        "  popq %r14\n"
+        "  popq %r13\n"
+        "  popq %r12\n"
+        "  popq %rbx\n"
+        "  popq %rbp\n"
+        "  ret\n"
+        SIGMA_ASM_END);
+
+// `top` is 16-byte aligned. The first switch pops zeroed registers and the
+// default control words, and returns into `entry` as if it had been called.
+static void sigma_context_init(SigmaContext* ctx, char* top, void (*entry)(void)) {
+  uint64_t* sp = (uint64_t*)top;
+  *--sp = 0;                                // entry's return address: it never returns
+  *--sp = (uint64_t)(uintptr_t)entry;
+  for (int i = 0; i < 6; i++) *--sp = 0;    // rbp, rbx, r12-r15
+  *--sp = 0x037f00001f80ULL;                // MXCSR 0x1f80, x87 control word 0x37f
+  *ctx = sp;
+}
+#else
+__asm__(SIGMA_ASM_FUNCTION(sigma_switch)
+        "  sub sp, sp, #160\n"
+        "  stp x19, x20, [sp, #0]\n"
+        "  stp x21, x22, [sp, #16]\n"
+        "  stp x23, x24, [sp, #32]\n"
+        "  stp x25, x26, [sp, #48]\n"
+        "  stp x27, x28, [sp, #64]\n"
+        "  stp x29, x30, [sp, #80]\n"
+        "  stp d8, d9, [sp, #96]\n"
+        "  stp d10, d11, [sp, #112]\n"
+        "  stp d12, d13, [sp, #128]\n"
+        "  stp d14, d15, [sp, #144]\n"
+        "  mov x9, sp\n"
+        "  str x9, [x0]\n"
+        "  mov sp, x1\n"
+        "  ldp x19, x20, [sp, #0]\n"
+        "  ldp x21, x22, [sp, #16]\n"
+        "  ldp x23, x24, [sp, #32]\n"
+        "  ldp x25, x26, [sp, #48]\n"
+        "  ldp x27, x28, [sp, #64]\n"
+        "  ldp x29, x30, [sp, #80]\n"
+        "  ldp d8, d9, [sp, #96]\n"
+        "  ldp d10, d11, [sp, #112]\n"
+        "  ldp d12, d13, [sp, #128]\n"
+        "  ldp d14, d15, [sp, #144]\n"
+        "  add sp, sp, #160\n"
+        "  ret\n"
+        SIGMA_ASM_END);
+
+// The first switch loads zeroed registers and returns into `entry` (x30)
+// with the stack pointer at `top`.
+static void sigma_context_init(SigmaContext* ctx, char* top, void (*entry)(void)) {
+  uint64_t* sp = (uint64_t*)(top - 160);
+  memset(sp, 0, 160);
+  sp[11] = (uint64_t)(uintptr_t)entry;
+  *ctx = sp;
+}
+#endif
+
+static inline void sigma_context_switch(SigmaContext* from, SigmaContext* to) {
+  sigma_switch(from, *to);
+}
+#else
+// Elsewhere, ucontext, which also saves and restores the signal mask: a
+// system call per switch.
+#include <ucontext.h>
+typedef ucontext_t SigmaContext;
+
+static void sigma_context_init(SigmaContext* ctx, char* top, void (*entry)(void)) {
+  getcontext(ctx);
+  ctx->uc_stack.ss_size = SIGMA_TASK_STACK - 1024;
+  ctx->uc_stack.ss_sp = top - ctx->uc_stack.ss_size;
+  ctx->uc_link = NULL;
+  makecontext(ctx, entry, 0);
+}
+
+static inline void sigma_context_switch(SigmaContext* from, SigmaContext* to) {
+  swapcontext(from, to);
+}
+#endif
+
+// How a thread that is not a worker waits for a channel.
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  int woken;
+} SigmaParking;
+
+struct SigmaTask {
+  SigmaContext ctx;
+  SigmaTask* next;          // in a worker's queue or a channel's waiters
+  SigmaValue value;         // handed over by a channel
+  int closed;               // woken by close(), not by a value
+  SigmaParking* thread;     // set for a thread that is not a worker
+  void* fn;
+  int argc;
+  SigmaValue args[SIGMA_SPAWN_MAX];
+  char* stack;              // its slot: guard page, stack, then this
+};
+
+static pthread_mutex_t sigma_free_lock = PTHREAD_MUTEX_INITIALIZER;
+static SigmaTask* sigma_free_tasks;
+static int sigma_free_count;
+static SigmaTask* sigma_cold_tasks;     // free, with their pages given back
+static char* sigma_chunk;               // the next unused slot
+static int sigma_chunk_left;
+static int sigma_stacks;                // slots handed out so far
+
+static size_t sigma_page_size(void) {
+  static size_t page;
+  if (!page) page = (size_t)sysconf(_SC_PAGESIZE);
+  return page;
+}
+
+static SigmaTask* sigma_task_new(void) {
+  size_t page = sigma_page_size();
+  size_t slot = page + SIGMA_TASK_STACK;
+  pthread_mutex_lock(&sigma_free_lock);
+  SigmaTask* t = sigma_free_tasks;
+  if (t) {
+    sigma_free_tasks = t->next;
+    sigma_free_count--;
+    pthread_mutex_unlock(&sigma_free_lock);
+    return t;
+  }
+  if ((t = sigma_cold_tasks)) {
+    sigma_cold_tasks = t->next;
+    pthread_mutex_unlock(&sigma_free_lock);
+    return t;
+  }
+  if (!sigma_chunk_left) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    char* chunk = mmap(NULL, slot * SIGMA_STACK_CHUNK, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (chunk == MAP_FAILED) {
+      sigma_error("Cannot start a task: %s", strerror(errno));
+      sigma_error_uncaught();
+    }
+    sigma_chunk = chunk;
+    sigma_chunk_left = SIGMA_STACK_CHUNK;
+  }
+  char* stack = sigma_chunk;
+  sigma_chunk += slot;
+  sigma_chunk_left--;
+  int guarded = sigma_stacks++ < SIGMA_GUARDED_TASKS;
+  pthread_mutex_unlock(&sigma_free_lock);
+  if (guarded) mprotect(stack, page, PROT_NONE);
+  t = (SigmaTask*)(stack + slot) - 1;
+  t->stack = stack;
+  return t;
+}
+
+static void sigma_task_free(SigmaTask* t) {
+  pthread_mutex_lock(&sigma_free_lock);
+  t->next = sigma_free_tasks;
+  sigma_free_tasks = t;
+  sigma_free_count++;
+  pthread_mutex_unlock(&sigma_free_lock);
+}
+
+// Moves the free tasks past the first SIGMA_WARM_TASKS to the cold list,
+// releasing their stacks: everything below the page that holds the task.
+static void sigma_trim_stacks(void) {
+  if (__atomic_load_n(&sigma_free_count, __ATOMIC_RELAXED) <= SIGMA_WARM_TASKS) return;
+  pthread_mutex_lock(&sigma_free_lock);
+  SigmaTask* last = sigma_free_tasks;
+  for (int i = 1; last && i < SIGMA_WARM_TASKS; i++) last = last->next;
+  SigmaTask* trim = last ? last->next : NULL;
+  if (trim) {
+    last->next = NULL;
+    sigma_free_count = SIGMA_WARM_TASKS;
+  }
+  pthread_mutex_unlock(&sigma_free_lock);
+  if (!trim) return;
+  size_t page = sigma_page_size();
+  SigmaTask* tail = trim;
+  for (SigmaTask* t = trim; t; t = t->next) {
+    char* end = (char*)((uintptr_t)t & ~(uintptr_t)(page - 1));
+    madvise(t->stack + page, (size_t)(end - t->stack) - page, MADV_DONTNEED);
+    tail = t;
+  }
+  pthread_mutex_lock(&sigma_free_lock);
+  tail->next = sigma_cold_tasks;
+  sigma_cold_tasks = trim;
+  pthread_mutex_unlock(&sigma_free_lock);
+}
+
+typedef struct {
+  pthread_mutex_t lock;     // guards the queue
+  SigmaTask** queue;        // ring buffer of ready tasks
+  size_t head, count, capacity;
+  SigmaContext sched;       // the worker's own stack, while a task runs
+  SigmaTask* current;
+  SigmaTask* finished;      // a task that returned, whose stack is now free
+  pthread_mutex_t* unlock;  // to release once `current` has switched out
+  uint64_t seed;            // picks whom to steal from
+} SigmaWorker;
+
+static SigmaWorker* sigma_workers;
+static int sigma_worker_count;
+static pthread_once_t sigma_sched_once = PTHREAD_ONCE_INIT;
+static _Thread_local SigmaWorker* sigma_worker;
+
+static atomic_long sigma_queued;            // ready tasks in all queues
+static atomic_int sigma_spinning;           // workers looking for one
+static atomic_int sigma_idle;               // workers asleep
+static atomic_int sigma_threads;            // non-workers that used a channel
+static atomic_int sigma_parked_threads;     // those of them waiting for one
+static atomic_int sigma_io_pending;         // tasks waiting for an I/O thread
+static atomic_uint sigma_next_worker;
+static pthread_mutex_t sigma_idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sigma_idle_wake = PTHREAD_COND_INITIALIZER;
+
+// Rounds an idle worker spins before it sleeps; on a single core, none.
+#define SIGMA_SPIN 4096
+static int sigma_spin;
+
+__attribute__((noinline)) static SigmaWorker* sigma_this_worker(void) {
+  return sigma_worker;
+}
+
+static inline void sigma_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ volatile("yield");
+#endif
+}
+
+static void sigma_queue_push(SigmaWorker* w, SigmaTask* t) {
+  pthread_mutex_lock(&w->lock);
+  if (w->count == w->capacity) {
+    size_t capacity = w->capacity ? w->capacity * 2 : 64;
+    SigmaTask** queue = malloc(capacity * sizeof(SigmaTask*));
+    for (size_t i = 0; i < w->count; i++) queue[i] = w->queue[(w->head + i) & (w->capacity - 1)];
+    free(w->queue);
+    w->queue = queue;
+    w->head = 0;
+    w->capacity = capacity;
+  }
+  w->queue[(w->head + w->count++) & (w->capacity - 1)] = t;
+  pthread_mutex_unlock(&w->lock);
+}
+
+// Takes up to `max` tasks from the front of w's queue.
+static size_t sigma_queue_take(SigmaWorker* w, SigmaTask** out, size_t max) {
+  pthread_mutex_lock(&w->lock);
+  size_t n = w->count < max ? w->count : max;
+  for (size_t i = 0; i < n; i++) {
+    out[i] = w->queue[w->head];
+    w->head = (w->head + 1) & (w->capacity - 1);
+  }
+  w->count -= n;
+  pthread_mutex_unlock(&w->lock);
+  return n;
+}
+
+// Moves half of the first non-empty queue after a random one into w's, and
+// returns the oldest of those tasks to run.
+static SigmaTask* sigma_steal(SigmaWorker* w) {
+  SigmaTask* stolen[32];
+  w->seed = w->seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  int start = (int)((w->seed >> 33) % (uint64_t)sigma_worker_count);
+  for (int k = 0; k < sigma_worker_count; k++) {
+    SigmaWorker* victim = &sigma_workers[(start + k) % sigma_worker_count];
+    if (victim == w || !__atomic_load_n(&victim->count, __ATOMIC_RELAXED)) continue;
+    size_t half = (victim->count + 1) / 2;
+    size_t n = sigma_queue_take(victim, stolen, half < 32 ? half : 32);
+    for (size_t i = 1; i < n; i++) sigma_queue_push(w, stolen[i]);
+    if (n) return stolen[0];
+  }
+  return NULL;
+}
+
+__attribute__((noreturn, cold)) static void sigma_deadlock(void) {
+  sigma_error("Deadlock: every task is waiting on a channel");
+  sigma_error_uncaught();
+}
+
+// With sigma_idle_lock held. Nothing can ready a task any more once every
+// worker is asleep, no task is queued or waiting for I/O, and every thread
+// that has used a channel is waiting on one. (A host thread that has not
+// used one yet could still send; such a program has to be the rare one.)
+static void sigma_check_deadlock(void) {
+  int parked = atomic_load(&sigma_parked_threads);
+  if (parked > 0 && parked == atomic_load(&sigma_threads) && atomic_load(&sigma_idle) == sigma_worker_count &&
+      atomic_load(&sigma_queued) == 0 && atomic_load(&sigma_io_pending) == 0) {
+    sigma_deadlock();
+  }
+}
+
+static void sigma_wake_idle(void) {
+  pthread_mutex_lock(&sigma_idle_lock);
+  pthread_cond_signal(&sigma_idle_wake);
+  pthread_mutex_unlock(&sigma_idle_lock);
+}
+
+// Makes a parked task (or thread) runnable again.
+static void sigma_ready(SigmaTask* t) {
+  if (t->thread) {
+    SigmaParking* p = t->thread;
+    pthread_mutex_lock(&p->lock);
+    p->woken = 1;
+    atomic_fetch_sub(&sigma_parked_threads, 1);
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    return;
+  }
+  SigmaWorker* w = sigma_this_worker();
+  if (!w) w = &sigma_workers[atomic_fetch_add(&sigma_next_worker, 1) % (unsigned)sigma_worker_count];
+  sigma_queue_push(w, t);
+  atomic_fetch_add(&sigma_queued, 1);
+  // A spinning worker will find it; otherwise wake a sleeping one.
+  if (atomic_load(&sigma_idle) > 0 && atomic_load(&sigma_spinning) == 0) sigma_wake_idle();
+}
+
+static SigmaTask* sigma_find_task(SigmaWorker* w) {
+  SigmaTask* t;
+  if (sigma_queue_take(w, &t, 1) || (t = sigma_steal(w))) {
+    atomic_fetch_sub(&sigma_queued, 1);
+    return t;
+  }
+  return NULL;
+}
+
+static SigmaTask* sigma_next_task(SigmaWorker* w) {
+  for (;;) {
+    SigmaTask* t = sigma_find_task(w);
+    if (t) return t;
+    // Spinning first means that a task about to be readied (by the other
+    // end of a busy channel) starts without a wakeup.
+    atomic_fetch_add(&sigma_spinning, 1);
+    for (int i = 0; i < sigma_spin && !t; i++) {
+      if (atomic_load(&sigma_queued) > 0) t = sigma_find_task(w);
+      else sigma_cpu_relax();
+    }
+    // The last spinner to find work wakes a sleeper for whatever is left.
+    if (atomic_fetch_sub(&sigma_spinning, 1) == 1 && t && atomic_load(&sigma_queued) > 0 && atomic_load(&sigma_idle) > 0) {
+      sigma_wake_idle();
+    }
+    if (t) return t;
+    sigma_trim_stacks();
+    pthread_mutex_lock(&sigma_idle_lock);
+    atomic_fetch_add(&sigma_idle, 1);
+    if (atomic_load(&sigma_queued) == 0) sigma_check_deadlock();
+    while (atomic_load(&sigma_queued) == 0) pthread_cond_wait(&sigma_idle_wake, &sigma_idle_lock);
+    atomic_fetch_sub(&sigma_idle, 1);
+    pthread_mutex_unlock(&sigma_idle_lock);
+  }
+}
+
+static void* sigma_worker_main(void* arg) {
+  SigmaWorker* w = arg;
+  sigma_worker = w;
+  for (;;) {
+    SigmaTask* t = sigma_next_task(w);
+    w->current = t;
+    sigma_context_switch(&w->sched, &t->ctx);
+    w->current = NULL;
+    if (w->finished) {
+      sigma_task_free(w->finished);
+      w->finished = NULL;
+    }
+    if (w->unlock) {
+      pthread_mutex_unlock(w->unlock);
+      w->unlock = NULL;
+    }
+  }
+  return NULL;
+}
+
+static void sigma_sched_start(void) {
+  const char* env = getenv("SIGMA_WORKERS");
+  int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int n = env && *env ? atoi(env) : cores;
+  if (n < 1) n = 1;
+  sigma_spin = cores > 1 ? SIGMA_SPIN : 0;
+  sigma_workers = calloc((size_t)n, sizeof(SigmaWorker));
+  for (int i = 0; i < n; i++) {
+    pthread_mutex_init(&sigma_workers[i].lock, NULL);
+    sigma_workers[i].seed = (uint64_t)i + 1;
+  }
+  __atomic_store_n(&sigma_worker_count, n, __ATOMIC_RELEASE);
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  for (int i = 0; i < n; i++) {
+    pthread_t thread;
+    if (pthread_create(&thread, &attr, sigma_worker_main, &sigma_workers[i]) != 0) {
+      sigma_error("Cannot start a worker thread");
+      sigma_error_uncaught();
+    }
+  }
+  pthread_attr_destroy(&attr);
+}
+
+typedef SigmaValue (*SigmaFn0)(void);
+typedef SigmaValue (*SigmaFn1)(SigmaValue);
+typedef SigmaValue (*SigmaFn2)(SigmaValue, SigmaValue);
+typedef SigmaValue (*SigmaFn3)(SigmaValue, SigmaValue, SigmaValue);
+typedef SigmaValue (*SigmaFn4)(SigmaValue, SigmaValue, SigmaValue, SigmaValue);
+typedef SigmaValue (*SigmaFn5)(SigmaValue, SigmaValue, SigmaValue, SigmaValue, SigmaValue);
+typedef SigmaValue (*SigmaFn6)(SigmaValue, SigmaValue, SigmaValue, SigmaValue, SigmaValue, SigmaValue);
+typedef SigmaValue (*SigmaFn7)(SigmaValue, SigmaValue, SigmaValue, SigmaValue, SigmaValue, SigmaValue, SigmaValue);
+typedef SigmaValue (*SigmaFn8)(SigmaValue, SigmaValue, SigmaValue, SigmaValue, SigmaValue, SigmaValue, SigmaValue,
+                               SigmaValue);
+
+static void sigma_task_entry(void) {
+  SigmaTask* t = sigma_this_worker()->current;
+  SigmaValue* a = t->args;
+  switch (t->argc) {
+    case 0: ((SigmaFn0)t->fn)(); break;
+    case 1: ((SigmaFn1)t->fn)(a[0]); break;
+    case 2: ((SigmaFn2)t->fn)(a[0], a[1]); break;
+    case 3: ((SigmaFn3)t->fn)(a[0], a[1], a[2]); break;
+    case 4: ((SigmaFn4)t->fn)(a[0], a[1], a[2], a[3]); break;
+    case 5: ((SigmaFn5)t->fn)(a[0], a[1], a[2], a[3], a[4]); break;
+    case 6: ((SigmaFn6)t->fn)(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+    case 7: ((SigmaFn7)t->fn)(a[0], a[1], a[2], a[3], a[4], a[5], a[6]); break;
+    default: ((SigmaFn8)t->fn)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]); break;
+  }
+  if (sigma_failed) sigma_error_uncaught();
+  SigmaWorker* w = sigma_this_worker();
+  w->finished = t;
+  sigma_context_switch(&t->ctx, &w->sched);
+  __builtin_unreachable();
+}
+
+void sigma_spawn(void* fn, int argc, const SigmaValue* args) {
+  pthread_once(&sigma_sched_once, sigma_sched_start);
+  SigmaTask* t = sigma_task_new();
+  t->next = NULL;
+  t->thread = NULL;
+  t->fn = fn;
+  t->argc = argc;
+  if (argc) memcpy(t->args, args, (size_t)argc * sizeof(SigmaValue));
+  sigma_context_init(&t->ctx, (char*)((uintptr_t)t & ~(uintptr_t)15), sigma_task_entry);
+  sigma_ready(t);
+}
+
+int sigma_tasks_started(void) {
+  return __atomic_load_n(&sigma_worker_count, __ATOMIC_ACQUIRE) > 0;
+}
+
+// The task running this code or, on any other thread, a stand-in that
+// parks the thread itself.
+static SigmaTask* sigma_self(void) {
+  SigmaWorker* w = sigma_this_worker();
+  if (w) return w->current;
+  // On the heap, to keep the library's static TLS small (see sigma_chars).
+  static _Thread_local SigmaTask* self;
+  if (!self) {
+    self = calloc(1, sizeof(SigmaTask) + sizeof(SigmaParking));
+    self->thread = (SigmaParking*)(self + 1);
+    pthread_mutex_init(&self->thread->lock, NULL);
+    pthread_cond_init(&self->thread->wake, NULL);
+    atomic_fetch_add(&sigma_threads, 1);
+  }
+  return self;
+}
+
+// Suspends `self` until sigma_ready(self). The caller holds `held`, which
+// is released once a wakeup can no longer be missed: for a task, after it
+// has switched off its worker.
+static void sigma_park(SigmaTask* self, pthread_mutex_t* held) {
+  if (!self->thread) {
+    SigmaWorker* w = sigma_this_worker();
+    w->unlock = held;
+    sigma_context_switch(&self->ctx, &w->sched);
+    return;
+  }
+  SigmaParking* p = self->thread;
+  pthread_mutex_lock(&p->lock);
+  atomic_fetch_add(&sigma_parked_threads, 1);
+  pthread_mutex_unlock(held);
+  if (!sigma_worker_count) sigma_deadlock();
+  pthread_mutex_lock(&sigma_idle_lock);
+  sigma_check_deadlock();
+  pthread_mutex_unlock(&sigma_idle_lock);
+  while (!p->woken) pthread_cond_wait(&p->wake, &p->lock);
+  p->woken = 0;
+  pthread_mutex_unlock(&p->lock);
+}
+
+// --- blocking I/O ---
+
+// Blocking reads (lines(), $in) in a task go to a small pool of I/O threads
+// while the task parks, so that its worker keeps running other tasks.
+// A job must not raise: it runs on another thread, whose error slot is not
+// the task's.
+typedef struct SigmaIoJob {
+  void (*run)(struct SigmaIoJob* job);
+  SigmaTask* task;
+  struct SigmaIoJob* next;
+} SigmaIoJob;
+
+#define SIGMA_IO_THREADS 4
+
+static pthread_mutex_t sigma_io_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sigma_io_wake = PTHREAD_COND_INITIALIZER;
+static SigmaIoJob* sigma_io_head;
+static SigmaIoJob** sigma_io_tail = &sigma_io_head;
+static pthread_once_t sigma_io_once = PTHREAD_ONCE_INIT;
+
+static void* sigma_io_main(void* arg) {
+  (void)arg;
+  for (;;) {
+    pthread_mutex_lock(&sigma_io_lock);
+    while (!sigma_io_head) pthread_cond_wait(&sigma_io_wake, &sigma_io_lock);
+    SigmaIoJob* job = sigma_io_head;
+    if (!(sigma_io_head = job->next)) sigma_io_tail = &sigma_io_head;
+    pthread_mutex_unlock(&sigma_io_lock);
+    job->run(job);
+    sigma_ready(job->task);
+    atomic_fetch_sub(&sigma_io_pending, 1);
+  }
+  return NULL;
+}
+
+static void sigma_io_start(void) {
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  for (int i = 0; i < SIGMA_IO_THREADS; i++) {
+    pthread_t thread;
+    if (pthread_create(&thread, &attr, sigma_io_main, NULL) != 0) {
+      sigma_error("Cannot start an I/O thread");
+      sigma_error_uncaught();
+    }
+  }
+  pthread_attr_destroy(&attr);
+}
+
+// Runs job->run(job): on an I/O thread while the calling task waits, or
+// right away on a thread that is not a worker.
+static void sigma_offload(SigmaIoJob* job) {
+  SigmaWorker* w = sigma_this_worker();
+  if (!w) {
+    job->run(job);
+    return;
+  }
+  pthread_once(&sigma_io_once, sigma_io_start);
+  job->task = w->current;
+  job->next = NULL;
+  atomic_fetch_add(&sigma_io_pending, 1);
+  pthread_mutex_lock(&sigma_io_lock);
+  *sigma_io_tail = job;
+  sigma_io_tail = &job->next;
+  pthread_cond_signal(&sigma_io_wake);
+  sigma_park(job->task, &sigma_io_lock);
+}
+
+// --- channels ---
+
+// A channel is a ring buffer of `capacity` values under a lock, with the
+// tasks waiting to send and to receive in FIFO order. A value goes straight
+// to a waiting receiver; with capacity 0, a sender always waits for one.
+typedef struct {
+  SigmaTask* head;
+  SigmaTask* tail;
+} SigmaWaiters;
+
+struct SigmaChan {
+  pthread_mutex_t lock;
+  SigmaValue* buf;
+  int64_t capacity, head, count;
+  int closed;
+  SigmaWaiters receivers;
+  SigmaWaiters senders;     // each with the value it sends
+};
+
+static void sigma_waiters_push(SigmaWaiters* q, SigmaTask* t) {
+  t->next = NULL;
+  if (q->tail) q->tail->next = t;
+  else q->head = t;
+  q->tail = t;
+}
+
+static SigmaTask* sigma_waiters_pop(SigmaWaiters* q) {
+  SigmaTask* t = q->head;
+  if (t && !(q->head = t->next)) q->tail = NULL;
+  return t;
+}
+
+SigmaValue sigma_make_chan_sized(SigmaValue capacity) {
+  int64_t n = sigma_int_arg(capacity);
+  SigmaChan* c = calloc(1, sizeof(SigmaChan));
+  pthread_mutex_init(&c->lock, NULL);
+  c->capacity = n < 0 ? 0 : n > (1 << 30) ? (1 << 30) : n;
+  if (c->capacity) c->buf = malloc((size_t)c->capacity * sizeof(SigmaValue));
+  SigmaValue v; v.type = TYPE_CHAN; v.as.chan = c; return v;
+}
+
+SigmaValue sigma_make_chan(void) {
+  return sigma_make_chan_sized(sigma_make_int(0));
+}
+
+__attribute__((noinline, cold)) static SigmaValue sigma_chan_error(const char* method, SigmaValue v) {
+  sigma_error("Cannot call %s on %s", method, sigma_a_type(v));
+  return sigma_make_nil();
+}
+
+__attribute__((noinline, cold)) static SigmaValue sigma_chan_closed(const char* what) {
+  sigma_error("%s a closed channel", what);
+  return sigma_make_nil();
+}
+
+SigmaValue sigma_chan_send(SigmaValue chan, SigmaValue v) {
+  if (chan.type != TYPE_CHAN) return sigma_chan_error("send", chan);
+  SigmaChan* c = chan.as.chan;
+  pthread_mutex_lock(&c->lock);
+  if (c->closed) {
+    pthread_mutex_unlock(&c->lock);
+    return sigma_chan_closed("Cannot send on");
+  }
+  SigmaTask* receiver = sigma_waiters_pop(&c->receivers);
+  if (receiver) {
+    receiver->value = v;
+    pthread_mutex_unlock(&c->lock);
+    sigma_ready(receiver);
+    return sigma_make_nil();
+  }
+  if (c->count < c->capacity) {
+    c->buf[(c->head + c->count++) % c->capacity] = v;
+    pthread_mutex_unlock(&c->lock);
+    return sigma_make_nil();
+  }
+  SigmaTask* self = sigma_self();
+  self->value = v;
+  self->closed = 0;
+  sigma_waiters_push(&c->senders, self);
+  sigma_park(self, &c->lock);
+  if (self->closed) return sigma_chan_closed("Cannot send on");
+  return sigma_make_nil();
+}
+
+SigmaValue sigma_chan_recv(SigmaValue chan) {
+  if (chan.type != TYPE_CHAN) return sigma_chan_error("recv", chan);
+  SigmaChan* c = chan.as.chan;
+  pthread_mutex_lock(&c->lock);
+  SigmaTask* sender = sigma_waiters_pop(&c->senders);
+  SigmaValue v;
+  if (c->count > 0) {
+    // The oldest buffered value; a waiting sender's takes its place.
+    v = c->buf[c->head];
+    c->head = (c->head + 1) % c->capacity;
+    if (sender) c->buf[(c->head + c->count - 1) % c->capacity] = sender->value;
+    else c->count--;
+  } else if (sender) {
+    v = sender->value;
+  } else if (c->closed) {
+    pthread_mutex_unlock(&c->lock);
+    return sigma_make_nil();
+  } else {
+    SigmaTask* self = sigma_self();
+    self->value = sigma_make_nil();
+    self->closed = 0;
+    sigma_waiters_push(&c->receivers, self);
+    sigma_park(self, &c->lock);
+    return self->value;
+  }
+  pthread_mutex_unlock(&c->lock);
+  if (sender) sigma_ready(sender);
+  return v;
+}
+
+SigmaValue sigma_chan_close(SigmaValue chan) {
+  if (chan.type != TYPE_CHAN) return sigma_chan_error("close", chan);
+  SigmaChan* c = chan.as.chan;
+  pthread_mutex_lock(&c->lock);
+  if (c->closed) {
+    pthread_mutex_unlock(&c->lock);
+    return sigma_chan_closed("Cannot close");
+  }
+  c->closed = 1;
+  SigmaTask* receivers = c->receivers.head;
+  SigmaTask* senders = c->senders.head;
+  c->receivers.head = c->receivers.tail = c->senders.head = c->senders.tail = NULL;
+  pthread_mutex_unlock(&c->lock);
+  // Waiting receivers get nil; waiting senders fail.
+  for (SigmaTask *t = receivers, *next; t; t = next) {
+    next = t->next;
+    t->closed = 1;
+    sigma_ready(t);
+  }
+  for (SigmaTask *t = senders, *next; t; t = next) {
+    next = t->next;
+    t->closed = 1;
+    sigma_ready(t);
+  }
+  return sigma_make_nil();
+}
+
+// --- strings ---
+
+// 64-bit string hash, after wyhash (Wang Yi): keys of up to 16 bytes are
+// read as two overlapping words and folded with a single 64x64->128-bit
+// multiply, longer ones 16 bytes (or, past 48, three independent lanes of
+// 16) per multiply. The seed is fixed: CodeGen hashes $fixed strings at
+// compile time (CodeGen::hashBytes), and the two must agree.
+static const uint64_t sigma_wyp[4] = {
+  0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+static inline uint64_t sigma_wymix(uint64_t a, uint64_t b) {
+  __uint128_t r = (__uint128_t)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+static inline uint64_t sigma_wyr8(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static inline uint64_t sigma_wyr4(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static uint64_t sigma_hash_bytes(const char* s, size_t len) {
+  const uint8_t* p = (const uint8_t*)s;
+  uint64_t seed = sigma_wymix(sigma_wyp[0], sigma_wyp[1]);
+  uint64_t a, b;
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (sigma_wyr4(p) << 32) | sigma_wyr4(p + ((len >> 3) << 2));
+      b = (sigma_wyr4(p + len - 4) << 32) | sigma_wyr4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = sigma_wymix(sigma_wyr8(p) ^ sigma_wyp[1], sigma_wyr8(p + 8) ^ seed);
+        see1 = sigma_wymix(sigma_wyr8(p + 16) ^ sigma_wyp[2], sigma_wyr8(p + 24) ^ see1);
+        see2 = sigma_wymix(sigma_wyr8(p + 32) ^ sigma_wyp[3], sigma_wyr8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = sigma_wymix(sigma_wyr8(p) ^ sigma_wyp[1], sigma_wyr8(p + 8) ^ seed);
+      p += 16;
+      i -= 16;
+    }
+    a = sigma_wyr8(p + i - 16);
+    b = sigma_wyr8(p + i - 8);
+  }
+  __uint128_t r = (__uint128_t)(a ^ sigma_wyp[1]) * (b ^ seed);
+  return sigma_wymix((uint64_t)r ^ sigma_wyp[0] ^ len, (uint64_t)(r >> 64) ^ sigma_wyp[1]);
+}
+
+// A string of `len` characters for the caller to fill in before calling
+// sigma_string_finish.
+static SigmaString* sigma_string_alloc(size_t len) {
+  SigmaString* str = malloc(sizeof(SigmaString) + len + 1);
+  str->len = len;
+  str->flags = 0;
+  str->chars[len] = '\0';
+  return str;
+}
+
+static SigmaValue sigma_string_finish(SigmaString* str) {
+  str->hash = sigma_hash_bytes(str->chars, str->len);
+  SigmaValue v; v.type = TYPE_STRING; v.as.string = str->chars;
+  return v;
+}
+
+SigmaValue sigma_make_string_n(const char* s, size_t len) {
+  SigmaString* str = sigma_string_alloc(len);
+  memcpy(str->chars, s, len);
+  return sigma_string_finish(str);
+}
+
+SigmaValue sigma_make_string(const char* s) {
+  return sigma_make_string_n(s, strlen(s));
+}
+
+int sigma_str_equals_slow(const SigmaString* a, const SigmaString* b) {
+  if (a->flags & b->flags & SIGMA_INTERNED) return 0;
+  return memcmp(a->chars, b->chars, a->len) == 0;
+}
+
+// The intern table: open addressing over a power-of-two array, at most
+// half full. Interning happens while a program starts (string literals,
+// see CodeGen), before any other thread exists.
+static SigmaString** sigma_interned;
+static size_t sigma_interned_cap;
+static size_t sigma_interned_count;
+
+static void sigma_intern_insert(SigmaString* str) {
+  size_t i = str->hash & (sigma_interned_cap - 1);
+  while (sigma_interned[i]) i = (i + 1) & (sigma_interned_cap - 1);
+  sigma_interned[i] = str;
+}
+
+SigmaValue sigma_intern(const char* s) {
+  size_t len = strlen(s);
+  uint64_t hash = sigma_hash_bytes(s, len);
+  if (sigma_interned_cap) {
+    for (size_t i = hash & (sigma_interned_cap - 1); sigma_interned[i]; i = (i + 1) & (sigma_interned_cap - 1)) {
+      SigmaString* str = sigma_interned[i];
+      if (str->hash == hash && str->len == len && memcmp(str->chars, s, len) == 0) {
+        SigmaValue v; v.type = TYPE_STRING; v.as.string = str->chars;
+        return v;
+      }
+    }
+  }
+  if (2 * (sigma_interned_count + 1) > sigma_interned_cap) {
+    SigmaString** old = sigma_interned;
+    size_t oldCap = sigma_interned_cap;
+    sigma_interned_cap = oldCap ? oldCap * 2 : 256;
+    sigma_interned = calloc(sigma_interned_cap, sizeof(SigmaString*));
+    for (size_t i = 0; i < oldCap; i++) {
+      if (old[i]) sigma_intern_insert(old[i]);
+    }
+    free(old);
+  }
+  SigmaValue v = sigma_make_string_n(s, len);
+  SigmaString* str = sigma_str_header(v.as.string);
+  str->flags |= SIGMA_INTERNED;
+  sigma_intern_insert(str);
+  sigma_interned_count++;
+  return v;
+}
+
+// Strings the runtime itself returns, interned up front so that, say,
+// check_type(x) == "int" is a pointer comparison.
+enum { NAME_NIL, NAME_DEC, NAME_INT, NAME_STR, NAME_BOOL, NAME_ARR, NAME_OBJ, NAME_DICT, NAME_F64, NAME_I64, NAME_U8, NAME_CHAN, NAME_TABLE, NAME_UNKNOWN, NAME_TRUE, NAME_FALSE, NAME_COUNT };
+static SigmaValue sigma_names[NAME_COUNT];
+
+__attribute__((constructor)) static void sigma_intern_names(void) {
+  static const char* names[NAME_COUNT] = {"nil", "dec", "int", "str", "bool", "arr", "obj", "dict", "f64[]", "i64[]", "u8[]", "chan", "table", "unknown", "true", "false"};
+  for (int i = 0; i < NAME_COUNT; i++) sigma_names[i] = sigma_intern(names[i]);
+}
+
+SigmaValue sigma_make_literal(const char* literal) {
+  if (literal[0] == '"') {
+    return sigma_make_string_n(literal + 1, strlen(literal) - 2);
+  } else if (strcmp(literal, "true") == 0) {
+    return sigma_make_bool(1);
+  } else if (strcmp(literal, "false") == 0) {
+    return sigma_make_bool(0);
+  } else if (strchr(literal, '.')) {
+    return sigma_make_number(atof(literal));
+  } else {
+    return sigma_make_int(strtoll(literal, NULL, 10));
+  }
+}
+
+typedef struct {
+  SigmaIoJob job;
+  char buffer[1024];
+  int ok;
+} SigmaInputJob;
+
+static void sigma_read_input(SigmaIoJob* job) {
+  SigmaInputJob* read = (SigmaInputJob*)job;
+  read->ok = fgets(read->buffer, sizeof(read->buffer), stdin) != NULL;
+}
+
+SigmaValue sigma_input(const char* prompt) {
+  if (prompt && strlen(prompt) > 0) {
+    printf("%s", prompt);
+    fflush(stdout);
+  }
+  SigmaInputJob read = {{sigma_read_input, NULL, NULL}, {0}, 0};
+  sigma_offload(&read.job);
+  if (!read.ok) {
+    return sigma_make_string("");
+  }
+  char* buffer = read.buffer;
+  size_t len = strlen(buffer);
+  if (len > 0 && buffer[len-1] == '\n') {
+    buffer[--len] = '\0';
+  }
+  return sigma_make_string_n(buffer, len);
+}
+
+SigmaValue sigma_type_of(SigmaValue v) {
+  switch (v.type) {
+    case TYPE_NIL: return sigma_names[NAME_NIL];
+    case TYPE_NUMBER: return sigma_names[NAME_DEC];
+    case TYPE_INT: return sigma_names[NAME_INT];
+    case TYPE_STRING: return sigma_names[NAME_STR];
+    case TYPE_BOOL: return sigma_names[NAME_BOOL];
+    case TYPE_ARRAY: return sigma_names[NAME_ARR];
+    case TYPE_OBJECT: return sigma_names[NAME_OBJ];
+    case TYPE_DICT: return sigma_names[NAME_DICT];
+    case TYPE_TYPED: return sigma_names[NAME_F64 + v.as.typed->kind];
+    case TYPE_CHAN: return sigma_names[NAME_CHAN];
+    case TYPE_TABLE: return sigma_names[NAME_TABLE];
+    default: return sigma_names[NAME_UNKNOWN];
+  }
+}
+
+// Rounds down. A dec outside the 64-bit range stays a (whole) dec.
+static SigmaValue sigma_floor_to_int(double x) {
+  double f = floor(x);
+  if (f >= -9223372036854775808.0 && f < 9223372036854775808.0) return sigma_make_int((int64_t)f);
+  return sigma_make_number(f);
+}
+
+SigmaValue sigma_to_int(SigmaValue v) {
+  switch (v.type) {
+    case TYPE_INT:
+      return v;
+    case TYPE_NUMBER:
+      return sigma_floor_to_int(v.as.number);
+    case TYPE_STRING: {
+      // Whole numbers are parsed exactly, anything else through a double.
+      char* end;
+      long long n = strtoll(v.as.string, &end, 10);
+      if (end != v.as.string && *end == '\0') return sigma_make_int(n);
+      return sigma_floor_to_int(atof(v.as.string));
+    }
+    case TYPE_BOOL:
+      return sigma_make_int(v.as.boolean ? 1 : 0);
+    default:
+      return sigma_make_int(0);
+  }
+}
+
+SigmaValue sigma_to_dec(SigmaValue v) {
+  switch (v.type) {
+    case TYPE_NUMBER:
+      return v;
+    case TYPE_INT:
+      return sigma_make_number((double)v.as.integer);
+    case TYPE_STRING:
+      return sigma_make_number(atof(v.as.string));
+    case TYPE_BOOL:
+      return sigma_make_number(v.as.boolean ? 1.0 : 0.0);
+    default:
+      return sigma_make_number(0.0);
+  }
+}
+
+SigmaValue sigma_to_str(SigmaValue v) {
+  char buffer[64];
+  switch (v.type) {
+    case TYPE_NIL:
+      return sigma_names[NAME_NIL];
+    case TYPE_NUMBER:
+      if (v.as.number == floor(v.as.number)) {
+        sprintf(buffer, "%.0f", v.as.number);
+      } else {
+        sprintf(buffer, "%g", v.as.number);
+      }
+      return sigma_make_string(buffer);
+    case TYPE_INT:
+      sprintf(buffer, "%" PRId64, v.as.integer);
+      return sigma_make_string(buffer);
+    case TYPE_STRING:
+      return v;
+    case TYPE_BOOL:
+      return sigma_names[v.as.boolean ? NAME_TRUE : NAME_FALSE];
+    case TYPE_ARRAY:
+    case TYPE_TYPED:
+      return sigma_make_string("[array]");
+    case TYPE_OBJECT:
+      return sigma_make_string("[object]");
+    case TYPE_DICT:
+      return sigma_make_string("[dict]");
+    case TYPE_CHAN:
+      return sigma_make_string("[chan]");
+    case TYPE_TABLE:
+      return sigma_make_string("[table]");
+    default:
+      return sigma_make_string("unknown");
+  }
+}
+
+_Thread_local uint64_t sigma_rng[4];
+_Thread_local int sigma_rng_seeded;
+
+static uint64_t sigma_splitmix64(uint64_t* x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Expands a 64-bit seed into a full state, as the xoshiro authors
+// recommend; the result is never all zeros.
+void sigma_rng_seed(uint64_t seed) {
+  for (int i = 0; i < 4; i++) sigma_rng[i] = sigma_splitmix64(&seed);
+  sigma_rng_seeded = 1;
+}
+
+// Different for every run and, through the state's address, every thread.
+void sigma_rng_seed_from_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  sigma_rng_seed(((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec) ^ (uint64_t)(uintptr_t)sigma_rng);
+}
+
+SigmaValue sigma_seed(SigmaValue n) {
+  sigma_rng_seed((uint64_t)sigma_int_arg(n));
+  return sigma_make_nil();
+}
+
+// A random number with `digits` digits (1 to 18).
+SigmaValue sigma_random(SigmaValue digits) {
+  int64_t d = sigma_int_arg(digits);
+  if (d <= 0) d = 1;
+  if (d > 18) d = 18;
+  int64_t min = 1;
+  for (int64_t i = 1; i < d; i++) min *= 10;
+  return sigma_make_int(sigma_rng_range(min, min * 10 - 1));
+}
+
+SigmaValue sigma_make_array() {
+  SigmaValue v;
+  v.type = TYPE_ARRAY;
+  v.as.array = malloc(sizeof(SigmaArray));
+  v.as.array->items = malloc(sizeof(void*) * 10);
+  v.as.array->size = 0;
+  v.as.array->capacity = 10;
+  v.as.array->flags = 0;
+  return v;
+}
+
+// An array of exactly n elements: one buffer for the item pointers and one
+// for all the element boxes, instead of a fixed 10 slots and a malloc per
+// element. The caller fills in the boxes.
+static SigmaValue sigma_alloc_array(int n, SigmaValue** boxes) {
+  SigmaValue v;
+  v.type = TYPE_ARRAY;
+  v.as.array = malloc(sizeof(SigmaArray));
+  v.as.array->capacity = n > 0 ? n : 4;
+  v.as.array->items = malloc(sizeof(void*) * v.as.array->capacity);
+  v.as.array->size = n;
+  v.as.array->flags = 0;
+  *boxes = n > 0 ? malloc(sizeof(SigmaValue) * n) : NULL;
+  for (int i = 0; i < n; i++) v.as.array->items[i] = &(*boxes)[i];
+  return v;
+}
+
+// Exact-size array literal.
+SigmaValue sigma_make_array_of(int n, const SigmaValue* vals) {
+  SigmaValue* boxes;
+  SigmaValue v = sigma_alloc_array(n, &boxes);
+  for (int i = 0; i < n; i++) boxes[i] = vals[i];
+  return v;
+}
+
+// Bulk draws for random_array: four independent xoshiro256** streams,
+// seeded from the thread's generator, stepped side by side so that the
+// compiler can keep them in vector registers. Each call fills `out` with
+// SIGMA_RNG_BATCH raw 64-bit draws.
+#define SIGMA_RNG_LANES 4
+#define SIGMA_RNG_BATCH 256
+
+typedef struct {
+  uint64_t s[4][SIGMA_RNG_LANES];
+} SigmaRngLanes;
+
+static void sigma_rng_lanes_seed(SigmaRngLanes* r) {
+  for (int lane = 0; lane < SIGMA_RNG_LANES; lane++) {
+    uint64_t seed = sigma_rng_next();
+    for (int i = 0; i < 4; i++) r->s[i][lane] = sigma_splitmix64(&seed);
+  }
+}
+
+static void sigma_rng_lanes_fill(SigmaRngLanes* r, uint64_t* out) {
+  uint64_t* s0 = r->s[0];
+  uint64_t* s1 = r->s[1];
+  uint64_t* s2 = r->s[2];
+  uint64_t* s3 = r->s[3];
+  for (int i = 0; i < SIGMA_RNG_BATCH; i += SIGMA_RNG_LANES) {
+    for (int l = 0; l < SIGMA_RNG_LANES; l++) {
+      out[i + l] = sigma_rotl(s1[l] * 5, 7) * 9;
+      uint64_t t = s1[l] << 17;
+      s2[l] ^= s0[l];
+      s3[l] ^= s1[l];
+      s1[l] ^= s2[l];
+      s0[l] ^= s3[l];
+      s2[l] ^= t;
+      s3[l] = sigma_rotl(s3[l], 45);
+    }
+  }
+}
+
+// n random numbers between lo and hi: ints in [lo, hi] if both bounds are
+// ints, decs in [lo, hi) otherwise.
+SigmaValue sigma_random_array(SigmaValue n, SigmaValue lo, SigmaValue hi) {
+  int64_t count = sigma_int_arg(n);
+  if (count < 0) count = 0;
+  if (count > 0x7fffffff) count = 0x7fffffff;
+  SigmaValue* boxes;
+  SigmaValue arr = sigma_alloc_array((int)count, &boxes);
+
+  SigmaRngLanes lanes;
+  sigma_rng_lanes_seed(&lanes);
+  uint64_t draws[SIGMA_RNG_BATCH];
+  int ints = lo.type == TYPE_INT && hi.type == TYPE_INT;
+  int64_t min = 0;
+  uint64_t span = 0;
+  double base = 0, width = 0;
+  if (ints) {
+    min = lo.as.integer < hi.as.integer ? lo.as.integer : hi.as.integer;
+    span = (uint64_t)(lo.as.integer < hi.as.integer ? hi.as.integer : lo.as.integer) - (uint64_t)min + 1;
+  } else {
+    base = sigma_num(lo);
+    width = sigma_num(hi) - base;
+  }
+  uint64_t threshold = span ? -span % span : 0;
+
+  for (int64_t i = 0; i < count; i += SIGMA_RNG_BATCH) {
+    sigma_rng_lanes_fill(&lanes, draws);
+    int64_t m = count - i < SIGMA_RNG_BATCH ? count - i : SIGMA_RNG_BATCH;
+    SigmaValue* out = boxes + i;
+    if (!ints) {
+      for (int64_t j = 0; j < m; j++) {
+        out[j].type = TYPE_NUMBER;
+        out[j].as.number = base + (double)(draws[j] >> 11) * 0x1.0p-53 * width;
+      }
+    } else if (span == 0) {
+      for (int64_t j = 0; j < m; j++) out[j] = sigma_make_int((int64_t)draws[j]);
+    } else {
+      for (int64_t j = 0; j < m; j++) {
+        __uint128_t p = (__uint128_t)draws[j] * span;
+        while ((uint64_t)p < threshold) p = (__uint128_t)sigma_rng_next() * span;
+        out[j] = sigma_make_int((int64_t)((uint64_t)min + (uint64_t)(p >> 64)));
+      }
+    }
+  }
+  return arr;
+}
+
+// Moves a $fixed array's item pointers and element boxes to the heap,
+// leaving room for `capacity` elements, before its first write.
+__attribute__((noinline, cold)) void sigma_array_unshare(SigmaArray* a, int capacity) {
+  if (capacity < a->size) capacity = a->size;
+  if (capacity == 0) capacity = 4;
+  void** items = malloc(sizeof(void*) * capacity);
+  SigmaValue* boxes = a->size > 0 ? malloc(sizeof(SigmaValue) * a->size) : NULL;
+  for (int i = 0; i < a->size; i++) {
+    boxes[i] = *(SigmaValue*)a->items[i];
+    items[i] = &boxes[i];
+  }
+  a->items = items;
+  a->capacity = capacity;
+  a->flags &= ~SIGMA_STATIC_STORAGE;
+}
+
+static void sigma_array_grow(SigmaArray* a) {
+  int capacity = a->capacity > 0 ? a->capacity * 2 : 4;
+  if (a->flags & SIGMA_STATIC_STORAGE) {
+    sigma_array_unshare(a, capacity);
+    return;
+  }
+  if (a->flags & SIGMA_STACK_STORAGE) {
+    void** items = malloc(sizeof(void*) * capacity);
+    memcpy(items, a->items, sizeof(void*) * a->size);
+    a->items = items;
+    a->flags &= ~SIGMA_STACK_STORAGE;
+  } else {
+    a->items = realloc(a->items, sizeof(void*) * capacity);
+  }
+  a->capacity = capacity;
+}
+
+SigmaValue sigma_array_push(SigmaValue arr, SigmaValue val) {
+  if (arr.type != TYPE_ARRAY) return sigma_make_nil();
+  SigmaArray* a = arr.as.array;
+  if (a->size >= a->capacity || (a->flags & SIGMA_STATIC_STORAGE)) sigma_array_grow(a);
+  SigmaValue* newVal = malloc(sizeof(SigmaValue));
+  *newVal = val;
+  a->items[a->size++] = newVal;
+  return sigma_make_nil();
+}
+
+// An array index as an integer, or -1 if `idx` is not a number.
+static int64_t sigma_index(SigmaValue idx) {
+  if (idx.type == TYPE_INT) return idx.as.integer;
+  if (idx.type == TYPE_NUMBER && idx.as.number >= 0 && idx.as.number < 2147483648.0) return (int64_t)idx.as.number;
+  return -1;
+}
+
+// Raises the error for arr[idx], which is not an element.
+__attribute__((noinline, cold)) static void sigma_index_error(SigmaValue arr, SigmaValue idx) {
+  if (arr.type != TYPE_ARRAY && arr.type != TYPE_TYPED) {
+    sigma_error("Cannot index %s", sigma_a_type(arr));
+  } else if (!sigma_is_number(idx)) {
+    sigma_error("Array index must be a number, not %s", sigma_a_type(idx));
+  } else if (idx.type == TYPE_INT) {
+    sigma_error("Index %" PRId64 " out of bounds for an array of %" PRId64, idx.as.integer, sigma_len(arr));
+  } else {
+    sigma_error("Index %g out of bounds for an array of %" PRId64, idx.as.number, sigma_len(arr));
+  }
+}
+
+// The index of arr[idx] if it is in bounds; otherwise raises and returns -1.
+static inline int64_t sigma_checked_index(SigmaValue arr, SigmaValue idx) {
+  int64_t i = arr.type == TYPE_ARRAY ? sigma_index(idx) : -1;
+  if (__builtin_expect(i < 0 || i >= arr.as.array->size, 0)) {
+    sigma_index_error(arr, idx);
+    return -1;
+  }
+  return i;
+}
+
+// --- string methods ---
+
+// Substring search looks for the first and the last byte of the needle at
+// once, 16 (or, with AVX2, 32) positions at a time, and compares the rest
+// only where both match (Wojciech Muła's "SIMD-friendly algorithms for
+// substring searching"). A needle of one byte is memchr's.
+static const char* sigma_find_scalar(const char* p, size_t i, size_t n, const char* needle, size_t m) {
+  for (; i + m <= n; i++) {
+    if (p[i] == needle[0] && memcmp(p + i + 1, needle + 1, m - 1) == 0) return p + i;
+  }
+  return NULL;
+}
+
+#ifdef __SSE2__
+static const char* sigma_find_sse2(const char* p, size_t n, const char* needle, size_t m) {
+  const __m128i first = _mm_set1_epi8(needle[0]), last = _mm_set1_epi8(needle[m - 1]);
+  size_t i = 0;
+  for (; i + 16 + m - 1 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(p + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(p + i + m - 1));
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+    for (; mask; mask &= mask - 1) {
+      size_t at = i + (size_t)__builtin_ctz(mask);
+      if (memcmp(p + at + 1, needle + 1, m - 2) == 0) return p + at;
+    }
+  }
+  return sigma_find_scalar(p, i, n, needle, m);
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("avx2"))) static const char* sigma_find_avx2(const char* p, size_t n, const char* needle,
+                                                                   size_t m) {
+  const __m256i first = _mm256_set1_epi8(needle[0]), last = _mm256_set1_epi8(needle[m - 1]);
+  size_t i = 0;
+  for (; i + 32 + m - 1 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(p + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(p + i + m - 1));
+    unsigned mask = (unsigned)_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+    for (; mask; mask &= mask - 1) {
+      size_t at = i + (size_t)__builtin_ctz(mask);
+      if (memcmp(p + at + 1, needle + 1, m - 2) == 0) return p + at;
+    }
+  }
+  return sigma_find_scalar(p, i, n, needle, m);
+}
+#endif
+
+// The first occurrence of needle (m bytes) in p (n bytes), or NULL.
+static const char* sigma_find(const char* p, size_t n, const char* needle, size_t m) {
+  if (m == 0) return p;
+  if (m > n) return NULL;
+  if (m == 1) return memchr(p, needle[0], n);
+#if defined(__x86_64__) && defined(__GNUC__)
+  if (__builtin_cpu_supports("avx2")) return sigma_find_avx2(p, n, needle, m);
+#endif
+#ifdef __SSE2__
+  return sigma_find_sse2(p, n, needle, m);
+#else
+  return sigma_find_scalar(p, 0, n, needle, m);
+#endif
+}
+
+// Occurrences of byte c. The compare results (0 or -1 per byte) are
+// subtracted into byte counters, which are summed with psadbw every 255
+// vectors, before they can wrap.
+#ifdef __SSE2__
+static size_t sigma_count_byte_sse2(const char* p, size_t n, char c) {
+  const __m128i needle = _mm_set1_epi8(c), zero = _mm_setzero_si128();
+  __m128i total = zero;
+  size_t i = 0;
+  while (i + 16 <= n) {
+    __m128i counts = zero;
+    for (int k = 0; k < 255 && i + 16 <= n; k++, i += 16) {
+      counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i)), needle));
+    }
+    total = _mm_add_epi64(total, _mm_sad_epu8(counts, zero));
+  }
+  uint64_t sums[2];
+  _mm_storeu_si128((__m128i*)sums, total);
+  size_t count = (size_t)(sums[0] + sums[1]);
+  for (; i < n; i++) count += p[i] == c;
+  return count;
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("avx2"))) static size_t sigma_count_byte_avx2(const char* p, size_t n, char c) {
+  const __m256i needle = _mm256_set1_epi8(c), zero = _mm256_setzero_si256();
+  __m256i total = zero;
+  size_t i = 0;
+  while (i + 32 <= n) {
+    __m256i counts = zero;
+    for (int k = 0; k < 255 && i + 32 <= n; k++, i += 32) {
+      counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i)), needle));
+    }
+    total = _mm256_add_epi64(total, _mm256_sad_epu8(counts, zero));
+  }
+  size_t count = (size_t)_mm256_extract_epi64(total, 0) + (size_t)_mm256_extract_epi64(total, 1) +
+                 (size_t)_mm256_extract_epi64(total, 2) + (size_t)_mm256_extract_epi64(total, 3);
+  for (; i < n; i++) count += p[i] == c;
+  return count;
+}
+#endif
+
+static size_t sigma_count_byte(const char* p, size_t n, char c) {
+#if defined(__x86_64__) && defined(__GNUC__)
+  if (__builtin_cpu_supports("avx2")) return sigma_count_byte_avx2(p, n, c);
+#endif
+#ifdef __SSE2__
+  return sigma_count_byte_sse2(p, n, c);
+#else
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) count += p[i] == c;
+  return count;
+#endif
+}
+
+// Non-overlapping occurrences of needle, which is not empty.
+static size_t sigma_count(const char* p, size_t n, const char* needle, size_t m) {
+  if (m == 1) return sigma_count_byte(p, n, needle[0]);
+  size_t count = 0;
+  for (const char* at; (at = sigma_find(p, n, needle, m)); count++) {
+    n -= (size_t)(at - p) + m;
+    p = at + m;
+  }
+  return count;
+}
+
+// ASCII case mapping: the letters from `lo` ('a' or 'A') are the bytes b
+// with b + (0x80 - lo) below -128 + 26 as signed bytes, and differ from
+// the other case in bit 0x20 alone.
+#ifdef __SSE2__
+static inline __m128i sigma_case_bits(__m128i v, char lo) {
+  __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - lo)));
+  return _mm_and_si128(_mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 26)), _mm_set1_epi8(0x20));
+}
+#endif
+
+static inline int sigma_is_case(char c, char lo) {
+  return (unsigned char)(c - lo) < 26;
+}
+
+// The index of the first letter from `lo` in p, or n if there is none.
+static size_t sigma_case_span(const char* p, size_t n, char lo) {
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 16 <= n; i += 16) {
+    __m128i bits = sigma_case_bits(_mm_loadu_si128((const __m128i*)(p + i)), lo);
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(bits, _mm_setzero_si128()));
+    if (mask != 0xffff) return i + (size_t)__builtin_ctz(~mask);
+  }
+#endif
+  while (i < n && !sigma_is_case(p[i], lo)) i++;
+  return i;
+}
+
+static void sigma_case_map(char* dst, const char* src, size_t n, char lo) {
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(v, sigma_case_bits(v, lo)));
+  }
+#endif
+  for (; i < n; i++) dst[i] = sigma_is_case(src[i], lo) ? src[i] ^ 0x20 : src[i];
+}
+
+static inline int sigma_is_space(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// One bit for each of the n <= 64 bytes at p that is not whitespace.
+static uint64_t sigma_word_mask(const char* p, size_t n) {
+  uint64_t mask = 0;
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+    __m128i control = _mm_sub_epi8(v, _mm_set1_epi8('\t'));      // '\t' to '\r' are 0 to 4
+    __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                 _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8(4)), control));
+    mask |= (uint64_t)(uint16_t)~_mm_movemask_epi8(space) << i;
+  }
+#endif
+  for (; i < n; i++) mask |= (uint64_t)!sigma_is_space(p[i]) << i;
+  return mask;
+}
+
+// Raises the error for s.method(arg): either s is not a string, or arg
+// (when there is one) is not.
+__attribute__((noinline, cold)) static SigmaValue sigma_str_error(const char* method, SigmaValue s, SigmaValue arg) {
+  if (s.type != TYPE_STRING) {
+    sigma_error("Cannot call %s on %s", method, sigma_a_type(s));
+  } else {
+    sigma_error("%s() takes a string, not %s", method, sigma_a_type(arg));
+  }
+  return sigma_make_nil();
+}
+
+// The pieces of a split, each a string with its header, in one block:
+// split makes many small strings, and they go together.
+typedef struct {
+  char* at;
+  SigmaValue* boxes;
+  int n;
+} SigmaPieces;
+
+static SigmaValue sigma_pieces_alloc(SigmaPieces* pieces, size_t count, size_t bytes) {
+  if (count > INT_MAX) {
+    sigma_error("split() would give %zu pieces, more than an array holds", count);
+    return sigma_make_nil();
+  }
+  SigmaValue arr = sigma_alloc_array((int)count, &pieces->boxes);
+  size_t slot = offsetof(SigmaString, chars) + 1 + 7;
+  pieces->at = malloc(count * slot + bytes);
+  pieces->n = 0;
+  return arr;
+}
+
+static void sigma_pieces_add(SigmaPieces* pieces, const char* s, size_t len) {
+  SigmaString* str = (SigmaString*)pieces->at;
+  str->len = len;
+  str->flags = 0;
+  memcpy(str->chars, s, len);
+  str->chars[len] = '\0';
+  pieces->at += (offsetof(SigmaString, chars) + len + 1 + 7) & ~(size_t)7;
+  pieces->boxes[pieces->n++] = sigma_string_finish(str);
+}
+
+SigmaValue sigma_str_split(SigmaValue s, SigmaValue sep) {
+  if (s.type != TYPE_STRING || sep.type != TYPE_STRING) return sigma_str_error("split", s, sep);
+  const char* p = s.as.string;
+  size_t n = sigma_str_len(p), m = sigma_str_len(sep.as.string);
+  if (m == 0) {
+    sigma_error("split() takes a separator that is not empty");
+    return sigma_make_nil();
+  }
+  size_t count = sigma_count(p, n, sep.as.string, m) + 1;
+  SigmaPieces pieces;
+  SigmaValue arr = sigma_pieces_alloc(&pieces, count, n - (count - 1) * m);
+  if (arr.type == TYPE_NIL) return arr;
+  for (size_t k = 1; k < count; k++) {
+    const char* at = sigma_find(p, n, sep.as.string, m);
+    sigma_pieces_add(&pieces, p, (size_t)(at - p));
+    n -= (size_t)(at - p) + m;
+    p = at + m;
+  }
+  sigma_pieces_add(&pieces, p, n);
+  return arr;
+}
+
+// split() without a separator: the runs of characters between runs of
+// whitespace, so no piece is empty. Both passes go 64 bytes at a time, a
+// piece starting at each 0-to-1 step of the word mask and ending at each
+// 1-to-0 one.
+SigmaValue sigma_str_split_space(SigmaValue s) {
+  if (s.type != TYPE_STRING) return sigma_str_error("split", s, s);
+  const char* p = s.as.string;
+  size_t n = sigma_str_len(p), count = 0, bytes = 0;
+  uint64_t carry = 0;
+  for (size_t i = 0; i < n; i += 64) {
+    uint64_t word = sigma_word_mask(p + i, n - i < 64 ? n - i : 64);
+    count += (size_t)__builtin_popcountll(word & ~(word << 1 | carry));
+    bytes += (size_t)__builtin_popcountll(word);
+    carry = word >> 63;
+  }
+  SigmaPieces pieces;
+  SigmaValue arr = sigma_pieces_alloc(&pieces, count, bytes);
+  if (arr.type == TYPE_NIL) return arr;
+  size_t start = 0;
+  carry = 0;
+  for (size_t i = 0; i < n; i += 64) {
+    uint64_t word = sigma_word_mask(p + i, n - i < 64 ? n - i : 64);
+    for (uint64_t steps = word ^ (word << 1 | carry); steps; steps &= steps - 1) {
+      size_t at = i + (size_t)__builtin_ctzll(steps);
+      if (word >> (at - i) & 1) start = at;
+      else sigma_pieces_add(&pieces, p + start, at - start);
+    }
+    carry = word >> 63;
+  }
+  if (carry) sigma_pieces_add(&pieces, p + start, n - start);
+  return arr;
+}
+
+SigmaValue sigma_str_find(SigmaValue s, SigmaValue sub) {
+  if (s.type != TYPE_STRING || sub.type != TYPE_STRING) return sigma_str_error("find", s, sub);
+  const char* p = s.as.string;
+  const char* at = sigma_find(p, sigma_str_len(p), sub.as.string, sigma_str_len(sub.as.string));
+  return sigma_make_int(at ? at - p : -1);
+}
+
+// As in Python, the empty string occurs once before each character and
+// once at the end.
+SigmaValue sigma_str_count(SigmaValue s, SigmaValue sub) {
+  if (s.type != TYPE_STRING || sub.type != TYPE_STRING) return sigma_str_error("count", s, sub);
+  size_t n = sigma_str_len(s.as.string), m = sigma_str_len(sub.as.string);
+  if (m == 0) return sigma_make_int((int64_t)n + 1);
+  return sigma_make_int((int64_t)sigma_count(s.as.string, n, sub.as.string, m));
+}
+
+// Replaces every occurrence of `old`, left to right. With none, the result
+// is s itself.
+SigmaValue sigma_str_replace(SigmaValue s, SigmaValue old, SigmaValue with) {
+  if (s.type != TYPE_STRING || old.type != TYPE_STRING) return sigma_str_error("replace", s, old);
+  if (with.type != TYPE_STRING) return sigma_str_error("replace", s, with);
+  const char* p = s.as.string;
+  size_t n = sigma_str_len(p), m = sigma_str_len(old.as.string), r = sigma_str_len(with.as.string);
+  if (m == 0) {
+    sigma_error("replace() takes a string to replace that is not empty");
+    return sigma_make_nil();
+  }
+  size_t count = sigma_count(p, n, old.as.string, m);
+  if (count == 0) return s;
+  SigmaString* str = sigma_string_alloc(n - count * m + count * r);
+  char* out = str->chars;
+  for (size_t k = 0; k < count; k++) {
+    const char* at = sigma_find(p, n, old.as.string, m);
+    memcpy(out, p, (size_t)(at - p));
+    out += at - p;
+    memcpy(out, with.as.string, r);
+    out += r;
+    n -= (size_t)(at - p) + m;
+    p = at + m;
+  }
+  memcpy(out, p, n);
+  return sigma_string_finish(str);
+}
+
+// Without leading and trailing whitespace; s itself if it has none.
+SigmaValue sigma_str_trim(SigmaValue s) {
+  if (s.type != TYPE_STRING) return sigma_str_error("trim", s, s);
+  const char* p = s.as.string;
+  size_t start = 0, end = sigma_str_len(p);
+  while (start < end && sigma_is_space(p[start])) start++;
+  while (end > start && sigma_is_space(p[end - 1])) end--;
+  if (start == 0 && end == sigma_str_len(p)) return s;
+  return sigma_make_string_n(p + start, end - start);
+}
+
+static SigmaValue sigma_str_case(const char* method, SigmaValue s, char lo) {
+  if (s.type != TYPE_STRING) return sigma_str_error(method, s, s);
+  const char* p = s.as.string;
+  size_t n = sigma_str_len(p), first = sigma_case_span(p, n, lo);
+  if (first == n) return s;
+  SigmaString* str = sigma_string_alloc(n);
+  memcpy(str->chars, p, first);
+  sigma_case_map(str->chars + first, p + first, n - first, lo);
+  return sigma_string_finish(str);
+}
+
+SigmaValue sigma_str_upper(SigmaValue s) {
+  return sigma_str_case("upper", s, 'a');
+}
+
+SigmaValue sigma_str_lower(SigmaValue s) {
+  return sigma_str_case("lower", s, 'A');
+}
+
+// --- typed arrays ---
+
+static const size_t sigma_elem_size[] = {sizeof(double), sizeof(int64_t), sizeof(uint8_t)};
+
+void sigma_typed_index_error(SigmaValue arr, int64_t i) {
+  sigma_index_error(arr, sigma_make_int(i));
+}
+
+void sigma_byte_error(int64_t v) {
+  sigma_error("Cannot store %" PRId64 " in a byte array", v);
+}
+
+__attribute__((noinline, cold)) static void sigma_typed_store_error(const SigmaTypedArray* a, SigmaValue val) {
+  if (sigma_is_number(val)) {
+    sigma_error("Cannot store %s in %s", sigma_to_str(val).as.string, sigma_elem_array[a->kind]);
+  } else {
+    sigma_error("Cannot store %s in %s", sigma_a_type(val), sigma_elem_array[a->kind]);
+  }
+}
+
+static SigmaValue sigma_typed_load(const SigmaTypedArray* a, int64_t i) {
+  switch (a->kind) {
+    case SIGMA_F64: return sigma_make_number(((double*)a->data)[i]);
+    case SIGMA_I64: return sigma_make_int(((int64_t*)a->data)[i]);
+    default: return sigma_make_int(((uint8_t*)a->data)[i]);
+  }
+}
+
+// a[i]: val. An f64 array takes any number; the others take ints, and decs
+// with a whole value.
+static void sigma_typed_store(SigmaTypedArray* a, int64_t i, SigmaValue val) {
+  if (a->kind == SIGMA_F64 && sigma_is_number(val)) {
+    ((double*)a->data)[i] = sigma_num(val);
+    return;
+  }
+  int64_t n;
+  if (val.type == TYPE_INT) {
+    n = val.as.integer;
+  } else if (val.type == TYPE_NUMBER && val.as.number == floor(val.as.number) &&
+             val.as.number >= -9223372036854775808.0 && val.as.number < 9223372036854775808.0) {
+    n = (int64_t)val.as.number;
+  } else {
+    sigma_typed_store_error(a, val);
+    return;
+  }
+  if (a->kind == SIGMA_I64) ((int64_t*)a->data)[i] = n;
+  else if ((uint64_t)n <= 255) ((uint8_t*)a->data)[i] = (uint8_t)n;
+  else sigma_byte_error(n);
+}
+
+static SigmaValue sigma_make_typed(SigmaElemKind kind, const char* name, SigmaValue n) {
+  int64_t size;
+  if (n.type == TYPE_ARRAY || n.type == TYPE_TYPED) {
+    size = sigma_len(n);
+  } else if (sigma_is_number(n) && sigma_num(n) >= 0) {
+    size = sigma_int_arg(n);
+  } else {
+    if (sigma_is_number(n)) sigma_error("%s() takes a length or an array, not %s", name, sigma_to_str(n).as.string);
+    else sigma_error("%s() takes a length or an array, not %s", name, sigma_a_type(n));
+    return sigma_make_nil();
+  }
+  SigmaTypedArray* a = malloc(sizeof(SigmaTypedArray));
+  a->data = calloc(size > 0 ? size : 1, sigma_elem_size[kind]);
+  if (!a->data) {
+    free(a);
+    sigma_error("%s(): cannot allocate %" PRId64 " elements", name, size);
+    return sigma_make_nil();
+  }
+  a->size = size;
+  a->kind = kind;
+  for (int64_t i = 0; i < size && !sigma_failed; i++) {
+    if (n.type == TYPE_ARRAY) sigma_typed_store(a, i, *(SigmaValue*)n.as.array->items[i]);
+    else if (n.type == TYPE_TYPED) sigma_typed_store(a, i, sigma_typed_load(n.as.typed, i));
+  }
+  if (sigma_failed) return sigma_make_nil();
+  SigmaValue v;
+  v.type = TYPE_TYPED;
+  v.as.typed = a;
+  return v;
+}
+
+SigmaValue sigma_make_f64_array(SigmaValue n) {
+  return sigma_make_typed(SIGMA_F64, "f64_array", n);
+}
+
+SigmaValue sigma_make_i64_array(SigmaValue n) {
+  return sigma_make_typed(SIGMA_I64, "i64_array", n);
+}
+
+SigmaValue sigma_make_bytes(SigmaValue n) {
+  return sigma_make_typed(SIGMA_U8, "bytes", n);
+}
+
+// NaNs compare equal to nothing, so they are given a place of their own:
+// after every number.
+static int sigma_f64_order(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  if (isnan(x) || isnan(y)) return isnan(x) - isnan(y);
+  return (x > y) - (x < y);
+}
+
+static int sigma_i64_order(const void* a, const void* b) {
+  int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+  return (x > y) - (x < y);
+}
+
+// Bytes by counting; the others with qsort, reversed for "desc" up to the
+// NaNs, which stay last either way.
+static void sigma_typed_sort(SigmaTypedArray* a, int ascending) {
+  if (a->kind == SIGMA_U8) {
+    int64_t counts[256] = {0};
+    uint8_t* bytes = a->data;
+    for (int64_t i = 0; i < a->size; i++) counts[bytes[i]]++;
+    int64_t at = 0;
+    for (int b = 0; b < 256; b++) {
+      int value = ascending ? b : 255 - b;
+      memset(bytes + at, value, counts[value]);
+      at += counts[value];
+    }
+    return;
+  }
+  qsort(a->data, a->size, sigma_elem_size[a->kind], a->kind == SIGMA_F64 ? sigma_f64_order : sigma_i64_order);
+  if (ascending) return;
+  int64_t n = a->size;
+  if (a->kind == SIGMA_F64) {
+    while (n > 0 && isnan(((double*)a->data)[n - 1])) n--;
+  }
+  int64_t* items = a->data;    // doubles are swapped as their bits
+  for (int64_t i = 0, j = n - 1; i < j; i++, j--) {
+    int64_t t = items[i];
+    items[i] = items[j];
+    items[j] = t;
+  }
+}
+
+// --- element access ---
+
+SigmaValue sigma_array_get(SigmaValue arr, SigmaValue idx) {
+  if (arr.type == TYPE_DICT) return sigma_dict_get(arr, idx);
+  if (arr.type == TYPE_TYPED) {
+    int64_t i = sigma_index(idx);
+    if (__builtin_expect(i < 0 || i >= arr.as.typed->size, 0)) {
+      sigma_index_error(arr, idx);
+      return sigma_make_nil();
+    }
+    return sigma_typed_load(arr.as.typed, i);
+  }
+  int64_t i = sigma_checked_index(arr, idx);
+  if (i < 0) return sigma_make_nil();
+  return *(SigmaValue*)arr.as.array->items[i];
+}
+
+void sigma_array_set(SigmaValue arr, SigmaValue idx, SigmaValue val) {
+  if (arr.type == TYPE_DICT) {
+    sigma_dict_set(arr, idx, val);
+    return;
+  }
+  if (arr.type == TYPE_TYPED) {
+    int64_t i = sigma_index(idx);
+    if (__builtin_expect(i < 0 || i >= arr.as.typed->size, 0)) sigma_index_error(arr, idx);
+    else sigma_typed_store(arr.as.typed, i, val);
+    return;
+  }
+  int64_t i = sigma_checked_index(arr, idx);
+  if (i < 0) return;
+  if (arr.as.array->flags & SIGMA_STATIC_STORAGE) sigma_array_unshare(arr.as.array, arr.as.array->size);
+  *(SigmaValue*)arr.as.array->items[i] = val;
+}
+
+SigmaValue sigma_array_sort(SigmaValue arr, SigmaValue order) {
+  int ascending = 1;
+  if (order.type == TYPE_STRING && strcmp(order.as.string, "desc") == 0) {
+    ascending = 0;
+  }
+  if (arr.type == TYPE_TYPED) sigma_typed_sort(arr.as.typed, ascending);
+  if (arr.type != TYPE_ARRAY) return arr;
+  if (arr.as.array->flags & SIGMA_STATIC_STORAGE) sigma_array_unshare(arr.as.array, arr.as.array->size);
+  for (int i = 0; i < arr.as.array->size - 1; i++) {
+    for (int j = 0; j < arr.as.array->size - i - 1; j++) {
+      SigmaValue* a = (SigmaValue*)arr.as.array->items[j];
+      SigmaValue* b = (SigmaValue*)arr.as.array->items[j + 1];
+      int shouldSwap = 0;
+      if (sigma_is_number(*a) && sigma_is_number(*b)) {
+        int greater = sigma_greater_than(*a, *b).as.boolean;
+        int less = sigma_less_than(*a, *b).as.boolean;
+        shouldSwap = ascending ? greater : less;
+      }
+      if (shouldSwap) {
+        void* temp = arr.as.array->items[j];
+        arr.as.array->items[j] = arr.as.array->items[j + 1];
+        arr.as.array->items[j + 1] = temp;
+      }
+    }
+  }
+  return arr;
+}
+
+SigmaValue sigma_make_object() {
+  SigmaValue v;
+  v.type = TYPE_OBJECT;
+  v.as.object = malloc(sizeof(SigmaObject));
+  v.as.object->keys = malloc(sizeof(char*) * 10);
+  v.as.object->values = malloc(sizeof(void*) * 10);
+  v.as.object->size = 0;
+  v.as.object->capacity = 10;
+  v.as.object->flags = 0;
+  return v;
+}
+
+// Exact-size object literal. Later duplicates of a key overwrite earlier
+// ones, as with sigma_object_set.
+SigmaValue sigma_make_object_of(int n, const char* const* keys, const SigmaValue* vals) {
+  SigmaValue v;
+  v.type = TYPE_OBJECT;
+  v.as.object = malloc(sizeof(SigmaObject));
+  v.as.object->capacity = n > 0 ? n : 4;
+  v.as.object->keys = malloc(sizeof(char*) * v.as.object->capacity);
+  v.as.object->values = malloc(sizeof(void*) * v.as.object->capacity);
+  v.as.object->size = 0;
+  v.as.object->flags = 0;
+  SigmaValue* boxes = n > 0 ? malloc(sizeof(SigmaValue) * n) : NULL;
+  for (int i = 0; i < n; i++) {
+    int j = 0;
+    while (j < v.as.object->size && strcmp(v.as.object->keys[j], keys[i]) != 0) j++;
+    if (j == v.as.object->size) {
+      // Keys are compile-time string literals, so they are shared, not copied.
+      v.as.object->keys[j] = (char*)keys[i];
+      v.as.object->values[j] = &boxes[j];
+      v.as.object->size++;
+    }
+    boxes[j] = vals[i];
+  }
+  return v;
+}
+
+// As sigma_array_unshare. Keys are string literals and stay shared.
+__attribute__((noinline, cold)) void sigma_object_unshare(SigmaObject* o, int capacity) {
+  if (capacity < o->size) capacity = o->size;
+  if (capacity == 0) capacity = 4;
+  char** keys = malloc(sizeof(char*) * capacity);
+  void** values = malloc(sizeof(void*) * capacity);
+  SigmaValue* boxes = o->size > 0 ? malloc(sizeof(SigmaValue) * o->size) : NULL;
+  for (int i = 0; i < o->size; i++) {
+    keys[i] = o->keys[i];
+    boxes[i] = *(SigmaValue*)o->values[i];
+    values[i] = &boxes[i];
+  }
+  o->keys = keys;
+  o->values = values;
+  o->capacity = capacity;
+  o->flags &= ~SIGMA_STATIC_STORAGE;
+}
+
+static void sigma_object_grow(SigmaObject* o) {
+  int capacity = o->capacity > 0 ? o->capacity * 2 : 4;
+  if (o->flags & SIGMA_STATIC_STORAGE) {
+    sigma_object_unshare(o, capacity);
+    return;
+  }
+  if (o->flags & SIGMA_STACK_STORAGE) {
+    char** keys = malloc(sizeof(char*) * capacity);
+    void** values = malloc(sizeof(void*) * capacity);
+    memcpy(keys, o->keys, sizeof(char*) * o->size);
+    memcpy(values, o->values, sizeof(void*) * o->size);
+    o->keys = keys;
+    o->values = values;
+    o->flags &= ~SIGMA_STACK_STORAGE;
+  } else {
+    o->keys = realloc(o->keys, sizeof(char*) * capacity);
+    o->values = realloc(o->values, sizeof(void*) * capacity);
+  }
+  o->capacity = capacity;
+}
+
+void sigma_object_set(SigmaValue obj, const char* key, SigmaValue val) {
+  if (obj.type != TYPE_OBJECT) return;
+  for (int i = 0; i < obj.as.object->size; i++) {
+    if (strcmp(obj.as.object->keys[i], key) == 0) {
+      if (obj.as.object->flags & SIGMA_STATIC_STORAGE) sigma_object_unshare(obj.as.object, obj.as.object->size);
+      *(SigmaValue*)obj.as.object->values[i] = val;
+      return;
+    }
+  }
+  if (obj.as.object->size >= obj.as.object->capacity || (obj.as.object->flags & SIGMA_STATIC_STORAGE)) {
+    sigma_object_grow(obj.as.object);
+  }
+  obj.as.object->keys[obj.as.object->size] = malloc(strlen(key) + 1);
+  strcpy(obj.as.object->keys[obj.as.object->size], key);
+  SigmaValue* newVal = malloc(sizeof(SigmaValue));
+  *newVal = val;
+  obj.as.object->values[obj.as.object->size++] = newVal;
+}
+
+// --- dictionaries ---
+
+// The bitmasks of a group's control bytes that equal a hash's 7 bits, and
+// of its empty slots. Without SSE2, the same a byte at a time.
+#ifdef __SSE2__
+static inline uint32_t sigma_dict_match(const SigmaDictGroup* g, uint8_t h2) {
+  __m128i ctrl = _mm_load_si128((const __m128i*)g->ctrl);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)h2)));
+}
+
+static inline uint32_t sigma_dict_empties(const SigmaDictGroup* g) {
+  return (uint32_t)_mm_movemask_epi8(_mm_load_si128((const __m128i*)g->ctrl));
+}
+#else
+static inline uint32_t sigma_dict_match(const SigmaDictGroup* g, uint8_t h2) {
+  uint32_t m = 0;
+  for (int i = 0; i < SIGMA_DICT_GROUP; i++) m |= (uint32_t)(g->ctrl[i] == h2) << i;
+  return m;
+}
+
+static inline uint32_t sigma_dict_empties(const SigmaDictGroup* g) {
+  uint32_t m = 0;
+  for (int i = 0; i < SIGMA_DICT_GROUP; i++) m |= (uint32_t)(g->ctrl[i] >> 7) << i;
+  return m;
+}
+#endif
+
+// Files a dec key as the int it equals, if it is integral, so that d[2]
+// and d[2.0] are one entry. Returns 0, raising, for a key that is not a
+// string or a number.
+__attribute__((noinline)) static int sigma_dict_key_slow(SigmaValue* key) {
+  if (key->type == TYPE_NUMBER) {
+    double x = key->as.number;
+    if (x == floor(x) && x >= -9223372036854775808.0 && x < 9223372036854775808.0) *key = sigma_make_int((int64_t)x);
+    return 1;
+  }
+  sigma_error("Dictionary keys must be strings or numbers, not %s", sigma_a_type(*key));
+  return 0;
+}
+
+static inline int sigma_dict_key(SigmaValue* key) {
+  if (__builtin_expect(key->type == TYPE_STRING || key->type == TYPE_INT, 1)) return 1;
+  return sigma_dict_key_slow(key);
+}
+
+// The hash of a filed key: a string's own, or a mix of a number's bits.
+static inline uint64_t sigma_dict_hash(SigmaValue key) {
+  if (key.type == TYPE_STRING) return sigma_str_header(key.as.string)->hash;
+  uint64_t salt = key.type == TYPE_INT ? sigma_wyp[0] : sigma_wyp[2];
+  return sigma_wymix((uint64_t)key.as.integer ^ salt, sigma_wyp[1]);
+}
+
+static inline int sigma_dict_key_equals(SigmaValue a, SigmaValue b) {
+  if (a.type != b.type) return 0;
+  if (a.type == TYPE_STRING) return sigma_str_equals(a.as.string, b.as.string);
+  return a.as.integer == b.as.integer;    // ints, and decs bit for bit
+}
+
+// The entry for a filed key, or NULL. Probing visits groups in triangular
+// steps (1, 2, 3, ... groups on), which reach every group of a power-of-two
+// table; the first group with an empty slot ends it.
+static inline SigmaDictEntry* sigma_dict_find(const SigmaDict* d, SigmaValue key, uint64_t hash) {
+  uint8_t h2 = hash & 0x7f;
+  size_t pos = (hash >> 7) & d->mask;
+  for (size_t step = 1;; step++) {
+    const SigmaDictGroup* g = &d->groups[pos];
+    for (uint32_t m = sigma_dict_match(g, h2); m; m &= m - 1) {
+      SigmaDictEntry* e = &d->entries[g->slots[__builtin_ctz(m)]];
+      if (sigma_dict_key_equals(e->key, key)) return e;
+    }
+    if (sigma_dict_empties(g)) return NULL;
+    pos = (pos + step) & d->mask;
+  }
+}
+
+// A dict image (what save writes for a dict, and mmap_dict opens) is this
+// header, the groups of the dict's index as they are in memory, then an
+// entry per key in insertion order, then the strings, each laid out as a
+// SigmaString so that a string value can point into the image. Numbers are
+// in the byte order of the machine that wrote it.
+typedef struct {
+  char magic[8];          // "sigdict" and a version
+  uint64_t order;         // SIGMA_IMAGE_ORDER, as written
+  uint64_t size;          // entries
+  uint64_t groups;
+  uint64_t groups_at;     // offsets from the start
+  uint64_t entries_at;
+  uint64_t bytes;         // of the whole image
+  uint64_t unused;
+} SigmaDictImage;
+
+#define SIGMA_IMAGE_MAGIC "sigdict\1"
+#define SIGMA_IMAGE_ORDER 0x0102030405060708ULL
+
+// The key and value of an entry: their SigmaTypes, and their bits (an int,
+// the bits of a dec, a bool) or, for a string, the offset of its chars.
+typedef struct {
+  uint64_t key, value;
+  uint8_t key_type, value_type;
+  uint8_t unused[6];
+} SigmaDictImageEntry;
+
+static inline const SigmaDictImageEntry* sigma_image_entries(const SigmaDict* d) {
+  return (const SigmaDictImageEntry*)(d->image + ((const SigmaDictImage*)d->image)->entries_at);
+}
+
+static inline SigmaValue sigma_image_value(const char* image, uint8_t type, uint64_t bits) {
+  SigmaValue v;
+  v.type = (SigmaType)type;
+  v.as.integer = 0;
+  if (type == TYPE_STRING) v.as.string = (char*)image + bits;
+  else if (type == TYPE_BOOL) v.as.boolean = (int)bits;
+  else v.as.integer = (int64_t)bits;
+  return v;
+}
+
+// Entry i, from an image too.
+static inline SigmaDictEntry sigma_dict_entry(const SigmaDict* d, int i) {
+  if (!d->image) return d->entries[i];
+  const SigmaDictImageEntry* e = &sigma_image_entries(d)[i];
+  return (SigmaDictEntry){sigma_image_value(d->image, e->key_type, e->key),
+                          sigma_image_value(d->image, e->value_type, e->value)};
+}
+
+// sigma_dict_find for a dict opened from an image: the same probe, over
+// the image's entries.
+__attribute__((noinline)) static const SigmaDictImageEntry* sigma_dict_image_find(const SigmaDict* d, SigmaValue key, uint64_t hash) {
+  const SigmaDictImageEntry* entries = sigma_image_entries(d);
+  uint8_t h2 = hash & 0x7f;
+  size_t pos = (hash >> 7) & d->mask;
+  for (size_t step = 1;; step++) {
+    const SigmaDictGroup* g = &d->groups[pos];
+    for (uint32_t m = sigma_dict_match(g, h2); m; m &= m - 1) {
+      const SigmaDictImageEntry* e = &entries[g->slots[__builtin_ctz(m)]];
+      if (e->key_type != key.type) continue;
+      if (key.type == TYPE_STRING ? sigma_str_equals(d->image + e->key, key.as.string) : e->key == (uint64_t)key.as.integer) {
+        return e;
+      }
+    }
+    if (sigma_dict_empties(g)) return NULL;
+    pos = (pos + step) & d->mask;
+  }
+}
+
+// Points the first empty slot on `hash`'s probe sequence at entry `entry`.
+static void sigma_dict_place(SigmaDict* d, uint64_t hash, uint32_t entry) {
+  size_t pos = (hash >> 7) & d->mask;
+  for (size_t step = 1;; step++) {
+    SigmaDictGroup* g = &d->groups[pos];
+    uint32_t empty = sigma_dict_empties(g);
+    if (empty) {
+      int i = __builtin_ctz(empty);
+      g->ctrl[i] = hash & 0x7f;
+      g->slots[i] = entry;
+      return;
+    }
+    pos = (pos + step) & d->mask;
+  }
+}
+
+// Rebuilds the index with `groups` groups (a power of two). Strings keep
+// their hash, so no key is compared or rehashed but ints.
+static void sigma_dict_reindex(SigmaDict* d, size_t groups) {
+  free(d->groups);
+  d->groups = malloc(groups * sizeof(SigmaDictGroup));
+  d->mask = groups - 1;
+  for (size_t i = 0; i < groups; i++) memset(d->groups[i].ctrl, SIGMA_DICT_EMPTY, SIGMA_DICT_GROUP);
+  for (int i = 0; i < d->size; i++) sigma_dict_place(d, sigma_dict_hash(d->entries[i].key), (uint32_t)i);
+}
+
+// Index groups for `n` entries at a load of at most 7/8.
+static size_t sigma_dict_groups_for(size_t n) {
+  size_t groups = 1;
+  while (groups * (SIGMA_DICT_GROUP - SIGMA_DICT_GROUP / 8) < n) groups *= 2;
+  return groups;
+}
+
+static SigmaValue sigma_dict_alloc(int capacity) {
+  SigmaDict* d = malloc(sizeof(SigmaDict));
+  d->size = 0;
+  d->capacity = capacity > 0 ? capacity : 8;
+  d->entries = malloc(sizeof(SigmaDictEntry) * d->capacity);
+  d->groups = NULL;
+  d->image = NULL;
+  sigma_dict_reindex(d, sigma_dict_groups_for((size_t)d->capacity));
+  SigmaValue v; v.type = TYPE_DICT; v.as.dict = d; return v;
+}
+
+SigmaValue sigma_make_dict(void) {
+  return sigma_dict_alloc(0);
+}
+
+// dict(n): room for n entries before the first resize.
+SigmaValue sigma_make_dict_sized(SigmaValue capacity) {
+  int64_t n = sigma_int_arg(capacity);
+  return sigma_dict_alloc(n < 0 ? 0 : n > (1 << 30) ? (1 << 30) : (int)n);
+}
+
+// The entry for `key`, added with a nil value if it is missing; NULL,
+// raising, if `key` cannot be a key.
+static SigmaDictEntry* sigma_dict_slot(SigmaDict* d, SigmaValue key) {
+  if (__builtin_expect(d->image != NULL, 0)) {
+    sigma_error("Cannot change a dict opened with mmap_dict");
+    return NULL;
+  }
+  if (!sigma_dict_key(&key)) return NULL;
+  uint64_t hash = sigma_dict_hash(key);
+  SigmaDictEntry* e = sigma_dict_find(d, key, hash);
+  if (e) return e;
+  if (d->size == d->capacity) {
+    d->capacity *= 2;
+    d->entries = realloc(d->entries, sizeof(SigmaDictEntry) * d->capacity);
+  }
+  size_t groups = d->mask + 1;
+  if ((size_t)d->size + 1 > groups * (SIGMA_DICT_GROUP - SIGMA_DICT_GROUP / 8)) sigma_dict_reindex(d, groups * 2);
+  e = &d->entries[d->size];
+  e->key = key;
+  e->value = sigma_make_nil();
+  sigma_dict_place(d, hash, (uint32_t)d->size++);
+  return e;
+}
+
+// Raises the error for calling dict method `method` on `v`, which is not a
+// dict.
+__attribute__((noinline, cold)) static SigmaValue sigma_dict_error(const char* method, SigmaValue v) {
+  sigma_error("Cannot call %s on %s", method, sigma_a_type(v));
+  return sigma_make_nil();
+}
+
+SigmaValue sigma_dict_get(SigmaValue dict, SigmaValue key) {
+  if (!sigma_dict_key(&key)) return sigma_make_nil();
+  const SigmaDict* d = dict.as.dict;
+  if (__builtin_expect(d->image != NULL, 0)) {
+    const SigmaDictImageEntry* e = sigma_dict_image_find(d, key, sigma_dict_hash(key));
+    return e ? sigma_image_value(d->image, e->value_type, e->value) : sigma_make_nil();
+  }
+  SigmaDictEntry* e = sigma_dict_find(d, key, sigma_dict_hash(key));
+  return e ? e->value : sigma_make_nil();
+}
+
+void sigma_dict_set(SigmaValue dict, SigmaValue key, SigmaValue val) {
+  SigmaDictEntry* e = sigma_dict_slot(dict.as.dict, key);
+  if (e) e->value = val;
+}
+
+SigmaValue sigma_dict_has(SigmaValue dict, SigmaValue key) {
+  if (dict.type != TYPE_DICT) return sigma_dict_error("has", dict);
+  if (!sigma_dict_key(&key)) return sigma_make_nil();
+  const SigmaDict* d = dict.as.dict;
+  uint64_t hash = sigma_dict_hash(key);
+  return sigma_make_bool(d->image ? sigma_dict_image_find(d, key, hash) != NULL : sigma_dict_find(d, key, hash) != NULL);
+}
+
+// The keys or values, in insertion order, as a new array.
+static SigmaValue sigma_dict_column(SigmaValue dict, int values) {
+  if (dict.type != TYPE_DICT) return sigma_dict_error(values ? "values" : "keys", dict);
+  const SigmaDict* d = dict.as.dict;
+  SigmaValue* boxes;
+  SigmaValue arr = sigma_alloc_array(d->size, &boxes);
+  for (int i = 0; i < d->size; i++) {
+    SigmaDictEntry e = sigma_dict_entry(d, i);
+    boxes[i] = values ? e.value : e.key;
+  }
+  return arr;
+}
+
+SigmaValue sigma_dict_keys(SigmaValue dict) {
+  return sigma_dict_column(dict, 0);
+}
+
+SigmaValue sigma_dict_values(SigmaValue dict) {
+  return sigma_dict_column(dict, 1);
+}
+
+// c[idx]++. A dict is probed once, and a missing key counts as 0.
+SigmaValue sigma_index_increment(SigmaValue c, SigmaValue idx) {
+  SigmaValue one = sigma_make_int(1);
+  if (c.type == TYPE_DICT) {
+    SigmaDictEntry* e = sigma_dict_slot(c.as.dict, idx);
+    if (e) e->value = e->value.type == TYPE_NIL ? one : sigma_add(e->value, one);
+    return sigma_make_nil();
+  }
+  SigmaValue v = sigma_array_get(c, idx);
+  if (!sigma_failed) sigma_array_set(c, idx, sigma_add(v, one));
+  return sigma_make_nil();
+}
+
+// --- mapped files ---
+
+typedef struct {
+  SigmaIoJob job;
+  const char* path;
+  const void* data;
+  size_t len;
+  int error;
+} SigmaWriteJob;
+
+static atomic_int sigma_write_serial;
+
+// Writes the data to a new file beside the path and renames it over the
+// path, so that a process with the old file mapped goes on reading the old
+// file instead of one that changes under it.
+static void sigma_write_file(SigmaIoJob* job) {
+  SigmaWriteJob* w = (SigmaWriteJob*)job;
+  char tmp[PATH_MAX];
+  int n = snprintf(tmp, sizeof(tmp), "%s.%d.%d.tmp", w->path, (int)getpid(), atomic_fetch_add(&sigma_write_serial, 1));
+  if (n < 0 || (size_t)n >= sizeof(tmp)) {
+    w->error = ENAMETOOLONG;
+    return;
+  }
+  FILE* f = fopen(tmp, "wb");
+  if (!f) {
+    w->error = errno;
+    return;
+  }
+  if (fwrite(w->data, 1, w->len, f) != w->len) w->error = errno ? errno : EIO;
+  if (fclose(f) != 0 && !w->error) w->error = errno;
+  if (!w->error && rename(tmp, w->path) != 0) w->error = errno;
+  if (w->error) unlink(tmp);
+}
+
+static size_t sigma_image_string_size(const char* s) {
+  return (offsetof(SigmaString, chars) + sigma_str_len(s) + 1 + 7) & ~(size_t)7;
+}
+
+// Copies string s, header and all, to where its chars go in the image.
+static void sigma_image_put_string(char* image, uint64_t chars_at, const char* s) {
+  const SigmaString* from = sigma_str_header(s);
+  SigmaString* to = (SigmaString*)(image + chars_at - offsetof(SigmaString, chars));
+  to->hash = from->hash;
+  to->len = from->len;
+  to->flags = 0;
+  memcpy(to->chars, from->chars, from->len + 1);
+}
+
+// What an image entry holds for a value that is not a string.
+static uint64_t sigma_image_bits(SigmaValue v) {
+  if (v.type == TYPE_BOOL) return (uint64_t)v.as.boolean;
+  if (v.type == TYPE_NIL) return 0;
+  return (uint64_t)v.as.integer;    // ints, and decs as their bits
+}
+
+// The image of dict d, as one buffer of *bytes bytes; NULL, raising, if a
+// value cannot go in one. The index is copied as it is, so no key is
+// hashed again. Keys are distinct already; each distinct string value is
+// stored once, found through `values`, which maps it to its offset.
+static char* sigma_dict_image(const SigmaDict* d, size_t* bytes) {
+  SigmaDict* values = sigma_dict_alloc(0).as.dict;
+  uint64_t* key_at = malloc(sizeof(uint64_t) * (d->size > 0 ? d->size : 1));
+  size_t groups = d->mask + 1;
+  size_t entries_at = sizeof(SigmaDictImage) + groups * sizeof(SigmaDictGroup);
+  size_t end = entries_at + (size_t)d->size * sizeof(SigmaDictImageEntry);
+  char* image = NULL;
+  for (int i = 0; i < d->size; i++) {
+    SigmaDictEntry e = sigma_dict_entry(d, i);
+    SigmaType t = e.value.type;
+    if (t != TYPE_NIL && t != TYPE_BOOL && t != TYPE_INT && t != TYPE_NUMBER && t != TYPE_STRING) {
+      sigma_error("save(): a saved dict holds strings, numbers, bools and nil, not %s", sigma_a_type(e.value));
+      goto done;
+    }
+    if (e.key.type == TYPE_STRING) {
+      key_at[i] = end + offsetof(SigmaString, chars);
+      end += sigma_image_string_size(e.key.as.string);
+    }
+    if (t == TYPE_STRING) {
+      SigmaDictEntry* slot = sigma_dict_slot(values, e.value);
+      if (slot->value.type != TYPE_NIL) continue;
+      slot->value = sigma_make_int((int64_t)(end + offsetof(SigmaString, chars)));
+      end += sigma_image_string_size(e.value.as.string);
+    }
+  }
+  image = calloc(1, end);
+  SigmaDictImage* h = (SigmaDictImage*)image;
+  memcpy(h->magic, SIGMA_IMAGE_MAGIC, sizeof(h->magic));
+  h->order = SIGMA_IMAGE_ORDER;
+  h->size = (uint64_t)d->size;
+  h->groups = groups;
+  h->groups_at = sizeof(SigmaDictImage);
+  h->entries_at = entries_at;
+  h->bytes = end;
+  memcpy(image + h->groups_at, d->groups, groups * sizeof(SigmaDictGroup));
+  SigmaDictImageEntry* entries = (SigmaDictImageEntry*)(image + entries_at);
+  for (int i = 0; i < d->size; i++) {
+    SigmaDictEntry e = sigma_dict_entry(d, i);
+    uint64_t k = sigma_image_bits(e.key), v = sigma_image_bits(e.value);
+    if (e.key.type == TYPE_STRING) {
+      k = key_at[i];
+      sigma_image_put_string(image, k, e.key.as.string);
+    }
+    if (e.value.type == TYPE_STRING) v = (uint64_t)sigma_dict_find(values, e.value, sigma_dict_hash(e.value))->value.as.integer;
+    entries[i] = (SigmaDictImageEntry){k, v, (uint8_t)e.key.type, (uint8_t)e.value.type, {0}};
+  }
+  for (int i = 0; i < values->size; i++) {
+    sigma_image_put_string(image, (uint64_t)values->entries[i].value.as.integer, values->entries[i].key.as.string);
+  }
+  *bytes = end;
+done:
+  free(key_at);
+  free(values->groups);
+  free(values->entries);
+  free(values);
+  return image;
+}
+
+// v.save(path): a typed array as its raw elements, a dict as an image for
+// mmap_dict. The file is written on an I/O thread when called from a task.
+SigmaValue sigma_save(SigmaValue v, SigmaValue path) {
+  if (v.type != TYPE_TYPED && v.type != TYPE_DICT) return sigma_dict_error("save", v);
+  if (path.type != TYPE_STRING) {
+    sigma_error("save() takes a file name, not %s", sigma_a_type(path));
+    return sigma_make_nil();
+  }
+  SigmaWriteJob write = {{sigma_write_file, NULL, NULL}, path.as.string, NULL, 0, 0};
+  char* image = NULL;
+  if (v.type == TYPE_TYPED) {
+    write.data = v.as.typed->data;
+    write.len = (size_t)v.as.typed->size * sigma_elem_size[v.as.typed->kind];
+  } else {
+    if (!(image = sigma_dict_image(v.as.dict, &write.len))) return sigma_make_nil();
+    write.data = image;
+  }
+  sigma_offload(&write.job);
+  free(image);
+  if (write.error) sigma_error("Cannot write %s: %s", path.as.string, strerror(write.error));
+  return sigma_make_nil();
+}
+
+// Maps all of the file at `path`: NULL with *error set if it cannot, and
+// NULL with *bytes 0 if it is empty (mmap maps nothing of length 0).
+static void* sigma_map_file(const char* path, int writable, int shared, size_t* bytes, int* error) {
+  int fd = open(path, writable && shared ? O_RDWR : O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || S_ISDIR(st.st_mode)) {
+    *error = fd < 0 || !S_ISDIR(st.st_mode) ? errno : EISDIR;
+    if (fd >= 0) close(fd);
+    return NULL;
+  }
+  *bytes = (size_t)st.st_size;
+  void* p = NULL;
+  if (*bytes > 0) {
+    p = mmap(NULL, *bytes, PROT_READ | (writable ? PROT_WRITE : 0), shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      *error = errno;
+      p = NULL;
+    }
+  }
+  close(fd);
+  return p;
+}
+
+// The pages are read in by the kernel as they are first touched, and a
+// mapping that is only read shares them with every other process that
+// maps the file.
+SigmaValue sigma_mmap_array_mode(SigmaValue path, SigmaValue kind, SigmaValue mode) {
+  static const char* const kinds[] = {"f64", "i64", "bytes"};    // by SigmaElemKind
+  if (path.type != TYPE_STRING) {
+    sigma_error("mmap_array() takes a file name, not %s", sigma_a_type(path));
+    return sigma_make_nil();
+  }
+  int k = -1;
+  for (int i = 0; i < 3 && kind.type == TYPE_STRING; i++) {
+    if (strcmp(kind.as.string, kinds[i]) == 0) k = i;
+  }
+  if (k < 0) {
+    sigma_error("mmap_array() maps \"f64\", \"i64\" or \"bytes\", not %s", sigma_to_str(kind).as.string);
+    return sigma_make_nil();
+  }
+  int shared = 0;
+  if (mode.type != TYPE_NIL) {
+    if (mode.type != TYPE_STRING || (strcmp(mode.as.string, "private") != 0 && strcmp(mode.as.string, "shared") != 0)) {
+      sigma_error("mmap_array() takes \"private\" or \"shared\", not %s", sigma_to_str(mode).as.string);
+      return sigma_make_nil();
+    }
+    shared = strcmp(mode.as.string, "shared") == 0;
+  }
+  size_t bytes = 0, size = sigma_elem_size[k];
+  int error = 0;
+  void* data = sigma_map_file(path.as.string, 1, shared, &bytes, &error);
+  if (error) {
+    sigma_error("Cannot map %s: %s", path.as.string, strerror(error));
+    return sigma_make_nil();
+  }
+  if (bytes % size != 0) {
+    munmap(data, bytes);
+    sigma_error("mmap_array(): %s is %zu bytes, not a whole number of %zu-byte elements", path.as.string, bytes, size);
+    return sigma_make_nil();
+  }
+  SigmaTypedArray* a = malloc(sizeof(SigmaTypedArray));
+  a->data = data ? data : calloc(1, size);
+  a->size = (int64_t)(bytes / size);
+  a->kind = (SigmaElemKind)k;
+  SigmaValue v;
+  v.type = TYPE_TYPED;
+  v.as.typed = a;
+  return v;
+}
+
+SigmaValue sigma_mmap_array(SigmaValue path, SigmaValue kind) {
+  return sigma_mmap_array_mode(path, kind, sigma_make_nil());
+}
+
+// Only the header is checked, which keeps opening the same however large
+// the file: the entries and strings are trusted to be as save wrote them.
+SigmaValue sigma_mmap_dict(SigmaValue path) {
+  if (path.type != TYPE_STRING) {
+    sigma_error("mmap_dict() takes a file name, not %s", sigma_a_type(path));
+    return sigma_make_nil();
+  }
+  size_t bytes = 0;
+  int error = 0;
+  const char* image = sigma_map_file(path.as.string, 0, 1, &bytes, &error);
+  if (error) {
+    sigma_error("Cannot map %s: %s", path.as.string, strerror(error));
+    return sigma_make_nil();
+  }
+  const SigmaDictImage* h = (const SigmaDictImage*)image;
+  if (bytes < sizeof(SigmaDictImage) || memcmp(h->magic, SIGMA_IMAGE_MAGIC, sizeof(h->magic)) != 0 ||
+      h->order != SIGMA_IMAGE_ORDER || h->bytes != bytes || h->groups == 0 || (h->groups & (h->groups - 1)) != 0 ||
+      h->groups > bytes / sizeof(SigmaDictGroup) || h->groups_at != sizeof(SigmaDictImage) ||
+      h->entries_at != h->groups_at + h->groups * sizeof(SigmaDictGroup) || h->size > h->groups * SIGMA_DICT_GROUP ||
+      h->size > INT_MAX || h->entries_at > bytes || (bytes - h->entries_at) / sizeof(SigmaDictImageEntry) < h->size) {
+    if (image) munmap((void*)image, bytes);
+    sigma_error("mmap_dict(): %s is not a dict written by save", path.as.string);
+    return sigma_make_nil();
+  }
+  SigmaDict* d = malloc(sizeof(SigmaDict));
+  d->groups = (SigmaDictGroup*)(image + h->groups_at);
+  d->entries = NULL;
+  d->mask = h->groups - 1;
+  d->size = (int)h->size;
+  d->capacity = 0;
+  d->image = image;
+  SigmaValue v;
+  v.type = TYPE_DICT;
+  v.as.dict = d;
+  return v;
+}
+
+// --- iteration ---
+
+SigmaValue sigma_iter_check(SigmaValue c) {
+  if (c.type != TYPE_ARRAY && c.type != TYPE_TYPED && c.type != TYPE_DICT && c.type != TYPE_STRING) {
+    sigma_error("Cannot iterate over %s", sigma_a_type(c));
+  }
+  return sigma_make_nil();
+}
+
+// Iterating a string gives its characters as one-byte strings, made once.
+// (Not thread-local: a 4 KB table would not fit the static TLS that a
+// library loaded by libsigma gets.)
+static SigmaValue sigma_chars[256];
+static pthread_once_t sigma_chars_once = PTHREAD_ONCE_INIT;
+
+static void sigma_make_chars(void) {
+  for (int i = 0; i < 256; i++) {
+    char c = (char)i;
+    sigma_chars[i] = sigma_make_string_n(&c, 1);
+  }
+}
+
+SigmaValue sigma_iter_at_slow(SigmaValue c, int64_t i) {
+  switch (c.type) {
+    case TYPE_TYPED:
+      return sigma_typed_load(c.as.typed, i);
+    case TYPE_DICT:
+      return sigma_dict_entry(c.as.dict, (int)i).key;
+    case TYPE_STRING: {
+      pthread_once(&sigma_chars_once, sigma_make_chars);
+      return sigma_chars[(uint8_t)c.as.string[i]];
+    }
+    default:
+      return sigma_make_nil();
+  }
+}
+
+typedef struct {
+  SigmaIoJob job;
+  const char* path;
+  char* text;
+  size_t len;
+  int error;
+} SigmaFileJob;
+
+static void sigma_read_file(SigmaIoJob* job) {
+  SigmaFileJob* read = (SigmaFileJob*)job;
+  FILE* f = fopen(read->path, "rb");
+  if (!f) {
+    read->error = errno;
+    return;
+  }
+  size_t len = 0, capacity = 1 << 16;
+  char* text = malloc(capacity);
+  for (size_t n; (n = fread(text + len, 1, capacity - len, f)) > 0;) {
+    len += n;
+    if (len == capacity) text = realloc(text, capacity *= 2);
+  }
+  fclose(f);
+  read->text = text;
+  read->len = len;
+}
+
+// The whole file in one read, then one string per line, without its "\n"
+// or "\r\n". A last line without a newline still counts.
+SigmaValue sigma_read_lines(SigmaValue path) {
+  if (path.type != TYPE_STRING) {
+    sigma_error("lines() takes a file name, not %s", sigma_a_type(path));
+    return sigma_make_nil();
+  }
+  SigmaFileJob read = {{sigma_read_file, NULL, NULL}, path.as.string, NULL, 0, 0};
+  sigma_offload(&read.job);
+  if (read.error) {
+    sigma_error("Cannot read %s: %s", path.as.string, strerror(read.error));
+    return sigma_make_nil();
+  }
+  char* text = read.text;
+  size_t len = read.len;
+  int count = 0;
+  for (const char* p = text; (p = memchr(p, '\n', text + len - p)); p++) count++;
+  if (len > 0 && text[len - 1] != '\n') count++;
+  SigmaValue* boxes;
+  SigmaValue lines = sigma_alloc_array(count, &boxes);
+  const char* start = text;
+  for (int i = 0; i < count; i++) {
+    const char* end = memchr(start, '\n', text + len - start);
+    if (!end) end = text + len;
+    size_t n = end - start;
+    if (n > 0 && start[n - 1] == '\r') n--;
+    boxes[i] = sigma_make_string_n(start, n);
+    start = end + 1;
+  }
+  free(text);
+  return lines;
+}
+
+SigmaValue sigma_concat(SigmaValue a, SigmaValue b) {
+  // Either side is a string: stringify the other side and join them.
+  char a_buf[64], b_buf[64];
+  char* a_str = a_buf;
+  char* b_str = b_buf;
+  if (a.type == TYPE_STRING) {
+    a_str = a.as.string;
+  } else if (a.type == TYPE_NUMBER) {
+    sprintf(a_buf, "%g", a.as.number);
+  } else if (a.type == TYPE_INT) {
+    sprintf(a_buf, "%" PRId64, a.as.integer);
+  } else if (a.type == TYPE_BOOL) {
+    strcpy(a_buf, a.as.boolean ? "true" : "false");
+  } else {
+    strcpy(a_buf, "nil");
+  }
+  if (b.type == TYPE_STRING) {
+    b_str = b.as.string;
+  } else if (b.type == TYPE_NUMBER) {
+    sprintf(b_buf, "%g", b.as.number);
+  } else if (b.type == TYPE_INT) {
+    sprintf(b_buf, "%" PRId64, b.as.integer);
+  } else if (b.type == TYPE_BOOL) {
+    strcpy(b_buf, b.as.boolean ? "true" : "false");
+  } else {
+    strcpy(b_buf, "nil");
+  }
+  size_t a_len = a.type == TYPE_STRING ? sigma_str_len(a_str) : strlen(a_str);
+  size_t b_len = b.type == TYPE_STRING ? sigma_str_len(b_str) : strlen(b_str);
+  SigmaString* result = sigma_string_alloc(a_len + b_len);
+  memcpy(result->chars, a_str, a_len);
+  memcpy(result->chars + a_len, b_str, b_len);
+  return sigma_string_finish(result);
+}
+
+// Ints and decs compare by value: 2 == 2.0.
+SigmaValue sigma_equals(SigmaValue a, SigmaValue b) {
+  if (a.type == TYPE_INT && b.type == TYPE_INT) return sigma_make_bool(a.as.integer == b.as.integer);
+  if (sigma_is_number(a) && sigma_is_number(b)) return sigma_make_bool(sigma_num(a) == sigma_num(b));
+  if (a.type != b.type) return sigma_make_bool(0);
+  if (a.type == TYPE_STRING) return sigma_make_bool(sigma_str_equals(a.as.string, b.as.string));
+  if (a.type == TYPE_BOOL) return sigma_make_bool(a.as.boolean == b.as.boolean);
+  return sigma_make_bool(0);
+}
+
+// Also compares the types: 2 === 2.0 is false.
+SigmaValue sigma_strict_equals(SigmaValue a, SigmaValue b) {
+  if (a.type != b.type) return sigma_make_bool(0);
+  if (a.type == TYPE_NUMBER) return sigma_make_bool(a.as.number == b.as.number);
+  if (a.type == TYPE_INT) return sigma_make_bool(a.as.integer == b.as.integer);
+  if (a.type == TYPE_STRING) return sigma_make_bool(sigma_str_equals(a.as.string, b.as.string));
+  if (a.type == TYPE_BOOL) return sigma_make_bool(a.as.boolean == b.as.boolean);
+  return sigma_make_bool(0);
+}
+
+static void sigma_table_print(const SigmaTable* t);    // with the tables, below
+
+// An element of a printed array or dict; only numbers and strings show.
+static void sigma_print_elem(SigmaValue elem) {
+  if (elem.type == TYPE_NUMBER) printf("%g", elem.as.number);
+  else if (elem.type == TYPE_INT) printf("%" PRId64, elem.as.integer);
+  else if (elem.type == TYPE_STRING) printf("\"%s\"", elem.as.string);
+}
+
+// One line per call, even when tasks print at once.
+void sigma_print(SigmaValue v) {
+  flockfile(stdout);
+  switch (v.type) {
+    case TYPE_NIL: printf("nil\n"); break;
+    case TYPE_NUMBER: {
+      double num = v.as.number;
+      if (num == floor(num)) {
+        printf("%g\n", num);
+      } else {
+        printf("%.2f\n", num);
+      }
+      break;
+    }
+    case TYPE_INT: printf("%" PRId64 "\n", v.as.integer); break;
+    case TYPE_STRING: printf("%s\n", v.as.string); break;
+    case TYPE_BOOL: printf("%s\n", v.as.boolean ? "true" : "false"); break;
+    case TYPE_ARRAY: {
+      printf("[");
+      for (int i = 0; i < v.as.array->size; i++) {
+        sigma_print_elem(*(SigmaValue*)v.as.array->items[i]);
+        if (i < v.as.array->size - 1) printf(", ");
+      }
+      printf("]\n");
+      break;
+    }
+    case TYPE_TYPED: {
+      printf("[");
+      for (int64_t i = 0; i < v.as.typed->size; i++) {
+        sigma_print_elem(sigma_typed_load(v.as.typed, i));
+        if (i < v.as.typed->size - 1) printf(", ");
+      }
+      printf("]\n");
+      break;
+    }
+    case TYPE_OBJECT: printf("<object>\n"); break;
+    case TYPE_CHAN: printf("<chan>\n"); break;
+    case TYPE_TABLE: sigma_table_print(v.as.table); break;
+    case TYPE_DICT: {
+      printf("{");
+      for (int i = 0; i < v.as.dict->size; i++) {
+        SigmaDictEntry e = sigma_dict_entry(v.as.dict, i);
+        sigma_print_elem(e.key);
+        printf(": ");
+        sigma_print_elem(e.value);
+        if (i < v.as.dict->size - 1) printf(", ");
+      }
+      printf("}\n");
+      break;
+    }
+    default: printf("<unknown>\n"); break;
+  }
+  funlockfile(stdout);
+}
+
+// --- JSON ---
+
+// json_parse works in two stages, after simdjson (Langdale and Lemire,
+// "Parsing Gigabytes of JSON per Second"). The first reads the text 64
+// bytes at a time and records the offset of every structural character
+// ({}[]:,), every unescaped quote and the first character of every number
+// or literal, using bit masks instead of a branch per byte. The second
+// walks that index and builds the values. A container is built when it
+// closes, from the items it left on a scratch stack, so every array and
+// object is allocated once at its exact size.
+enum {
+  SIGMA_JSON_QUOTE = 1,
+  SIGMA_JSON_BACKSLASH = 2,
+  SIGMA_JSON_STRUCTURAL = 4,
+  SIGMA_JSON_SPACE = 8
+};
+
+static const uint8_t sigma_json_class[256] = {
+  ['"'] = SIGMA_JSON_QUOTE, ['\\'] = SIGMA_JSON_BACKSLASH,
+  ['{'] = SIGMA_JSON_STRUCTURAL, ['}'] = SIGMA_JSON_STRUCTURAL, ['['] = SIGMA_JSON_STRUCTURAL,
+  [']'] = SIGMA_JSON_STRUCTURAL, [':'] = SIGMA_JSON_STRUCTURAL, [','] = SIGMA_JSON_STRUCTURAL,
+  [' '] = SIGMA_JSON_SPACE, ['\t'] = SIGMA_JSON_SPACE, ['\n'] = SIGMA_JSON_SPACE, ['\r'] = SIGMA_JSON_SPACE
+};
+
+// One bit per byte of a 64-byte block, for each class of character.
+typedef struct {
+  uint64_t quote, backslash, structural, space;
+} SigmaJsonMasks;
+
+#ifndef __SSE2__
+static void sigma_json_classify_table(const uint8_t* p, SigmaJsonMasks* m) {
+  uint64_t quote = 0, backslash = 0, structural = 0, space = 0;
+  for (int i = 0; i < 64; i++) {
+    uint64_t c = sigma_json_class[p[i]];
+    quote |= (c & 1) << i;
+    backslash |= ((c >> 1) & 1) << i;
+    structural |= ((c >> 2) & 1) << i;
+    space |= ((c >> 3) & 1) << i;
+  }
+  m->quote = quote;
+  m->backslash = backslash;
+  m->structural = structural;
+  m->space = space;
+}
+#endif
+
+#ifdef __SSE2__
+// '{' | 0x20 is '{' and '[' | 0x20 is '{', and likewise for '}' and ']',
+// so six structural characters take four comparisons.
+static void sigma_json_classify_sse2(const uint8_t* p, SigmaJsonMasks* m) {
+  m->quote = m->backslash = m->structural = m->space = 0;
+  for (int i = 0; i < 4; i++) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(p + 16 * i));
+    __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+#define SIGMA_EQ(x, c) _mm_cmpeq_epi8(x, _mm_set1_epi8(c))
+    uint64_t quote = (uint16_t)_mm_movemask_epi8(SIGMA_EQ(v, '"'));
+    uint64_t backslash = (uint16_t)_mm_movemask_epi8(SIGMA_EQ(v, '\\'));
+    uint64_t structural = (uint16_t)_mm_movemask_epi8(
+        _mm_or_si128(_mm_or_si128(SIGMA_EQ(folded, '{'), SIGMA_EQ(folded, '}')),
+                     _mm_or_si128(SIGMA_EQ(v, ':'), SIGMA_EQ(v, ','))));
+    uint64_t space = (uint16_t)_mm_movemask_epi8(
+        _mm_or_si128(_mm_or_si128(SIGMA_EQ(v, ' '), SIGMA_EQ(v, '\t')),
+                     _mm_or_si128(SIGMA_EQ(v, '\n'), SIGMA_EQ(v, '\r'))));
+#undef SIGMA_EQ
+    m->quote |= quote << (16 * i);
+    m->backslash |= backslash << (16 * i);
+    m->structural |= structural << (16 * i);
+    m->space |= space << (16 * i);
+  }
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// The same with 32-byte vectors, for machines that have AVX2; the rest of
+// the runtime does not assume it.
+__attribute__((target("avx2"))) static void sigma_json_classify_avx2(const uint8_t* p, SigmaJsonMasks* m) {
+  m->quote = m->backslash = m->structural = m->space = 0;
+  for (int i = 0; i < 2; i++) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(p + 32 * i));
+    __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+#define SIGMA_EQ(x, c) _mm256_cmpeq_epi8(x, _mm256_set1_epi8(c))
+    uint64_t quote = (uint32_t)_mm256_movemask_epi8(SIGMA_EQ(v, '"'));
+    uint64_t backslash = (uint32_t)_mm256_movemask_epi8(SIGMA_EQ(v, '\\'));
+    uint64_t structural = (uint32_t)_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_or_si256(SIGMA_EQ(folded, '{'), SIGMA_EQ(folded, '}')),
+                        _mm256_or_si256(SIGMA_EQ(v, ':'), SIGMA_EQ(v, ','))));
+    uint64_t space = (uint32_t)_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_or_si256(SIGMA_EQ(v, ' '), SIGMA_EQ(v, '\t')),
+                        _mm256_or_si256(SIGMA_EQ(v, '\n'), SIGMA_EQ(v, '\r'))));
+#undef SIGMA_EQ
+    m->quote |= quote << (32 * i);
+    m->backslash |= backslash << (32 * i);
+    m->structural |= structural << (32 * i);
+    m->space |= space << (32 * i);
+  }
+}
+#endif
+
+typedef void (*SigmaJsonClassifier)(const uint8_t*, SigmaJsonMasks*);
+
+static SigmaJsonClassifier sigma_json_classifier(void) {
+#if defined(__x86_64__) && defined(__GNUC__)
+  if (__builtin_cpu_supports("avx2")) return sigma_json_classify_avx2;
+#endif
+#ifdef __SSE2__
+  return sigma_json_classify_sse2;
+#else
+  return sigma_json_classify_table;
+#endif
+}
+
+// The characters escaped by a backslash: those that end a run of
+// backslashes of odd length (simdjson's find_odd_backslash_sequences).
+// `carry` says whether the previous block ended inside such a run.
+static uint64_t sigma_json_escaped(uint64_t backslash, uint64_t* carry) {
+  const uint64_t even = 0x5555555555555555ULL, odd = ~even;
+  uint64_t starts = backslash & ~(backslash << 1);
+  uint64_t even_start_mask = even ^ *carry;
+  uint64_t even_starts = starts & even_start_mask;
+  uint64_t odd_starts = starts & ~even_start_mask;
+  uint64_t even_carries = backslash + even_starts;
+  uint64_t odd_carries;
+  int overflow = __builtin_add_overflow(backslash, odd_starts, &odd_carries);
+  odd_carries |= *carry;
+  *carry = overflow;
+  uint64_t even_carry_ends = even_carries & ~backslash;
+  uint64_t odd_carry_ends = odd_carries & ~backslash;
+  return (even_carry_ends & odd) | (odd_carry_ends & even);
+}
+
+// Bit i set where an odd number of bits at or below i are set in x: the
+// inside of the strings, given their quotes.
+static inline uint64_t sigma_json_prefix_xor(uint64_t x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+typedef struct {
+  uint32_t* at;
+  size_t size, capacity;
+} SigmaJsonIndex;
+
+// Stage one. Fails only on an unterminated string.
+static int sigma_json_index(const char* text, size_t len, SigmaJsonIndex* index) {
+  SigmaJsonClassifier classify = sigma_json_classifier();
+  index->capacity = len / 4 + 64;
+  index->at = malloc(sizeof(uint32_t) * index->capacity);
+  index->size = 0;
+  uint64_t escape_carry = 0, in_string = 0, prev_separator = 1;
+  for (size_t base = 0; base < len; base += 64) {
+    SigmaJsonMasks m;
+    if (len - base >= 64) {
+      classify((const uint8_t*)text + base, &m);
+    } else {
+      uint8_t block[64];
+      memset(block, ' ', sizeof(block));
+      memcpy(block, text + base, len - base);
+      classify(block, &m);
+    }
+    uint64_t quote = m.quote & ~sigma_json_escaped(m.backslash, &escape_carry);
+    // Set from each opening quote up to, but not including, its closing one.
+    uint64_t inside = sigma_json_prefix_xor(quote) ^ in_string;
+    in_string = (uint64_t)((int64_t)inside >> 63);
+    uint64_t structural = m.structural & ~inside;
+    uint64_t space = m.space & ~inside;
+    // A number or literal starts with a character that is none of these,
+    // right after one that is a separator.
+    uint64_t separator = structural | space | quote;
+    uint64_t scalar = ~(inside | separator) & ((separator << 1) | prev_separator);
+    prev_separator = separator >> 63;
+    uint64_t bits = structural | quote | scalar;
+    size_t n = __builtin_popcountll(bits);
+    if (index->size + n > index->capacity) {
+      index->capacity = index->capacity * 2 + n;
+      index->at = realloc(index->at, sizeof(uint32_t) * index->capacity);
+    }
+    uint32_t* out = index->at + index->size;
+    for (; bits; bits &= bits - 1) *out++ = (uint32_t)(base + __builtin_ctzll(bits));
+    index->size += n;
+  }
+  return in_string == 0;
+}
+
+// Distinct keys of one document, each made into a string once: objects
+// that repeat their keys (as the records of an array do) share them. While
+// an object is being built, `stamp` and `slot` say whether it already has
+// the key, and where.
+typedef struct {
+  char* chars;
+  uint64_t hash;
+  size_t len;
+  uint32_t stamp, slot;
+} SigmaJsonKey;
+
+typedef struct {
+  SigmaValue value;
+  uint32_t key;
+} SigmaJsonItem;
+
+typedef struct {
+  const char* text;
+  size_t len;
+  SigmaJsonIndex index;
+  SigmaJsonItem* items;     // the scratch stack
+  size_t item_count, item_capacity;
+  SigmaJsonKey* keys;
+  uint32_t key_count, key_capacity;
+  uint32_t* key_table;      // open addressing over `keys`, at most half full
+  size_t key_mask;
+  uint32_t stamp;
+  char* buf;                // for unescaping
+  size_t buf_capacity;
+} SigmaJsonParser;
+
+__attribute__((noinline, cold)) static int sigma_json_error(size_t at, const char* what) {
+  sigma_error("Invalid JSON at byte %zu: %s", at, what);
+  return 0;
+}
+
+// The first character in [p, end) that is a backslash, a control
+// character or (if `quote`) a quote, or end: in a string being parsed, the
+// characters that are not copied as they are, and in one being written,
+// those that are escaped.
+static const char* sigma_json_special(const char* p, const char* end, int quote) {
+#ifdef __SSE2__
+  __m128i q = _mm_set1_epi8(quote ? '"' : '\\');
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\')), _mm_cmpeq_epi8(v, q)),
+                               _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v));
+    int mask = _mm_movemask_epi8(hit);
+    if (mask) return p + __builtin_ctz(mask);
+  }
+#endif
+  for (; p < end; p++) {
+    if (*p == '\\' || (uint8_t)*p < 0x20 || (quote && *p == '"')) return p;
+  }
+  return end;
+}
+
+static int sigma_json_hex(const char* p) {
+  int v = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = p[i];
+    v <<= 4;
+    if (c >= '0' && c <= '9') v |= c - '0';
+    else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') v |= (c | 0x20) - 'a' + 10;
+    else return -1;
+  }
+  return v;
+}
+
+// Copies the string body [p, end) into `out`, which has room for end - p
+// bytes (an escape never takes more bytes than it stands for), resolving
+// escapes. Returns the length, or -1 after raising an error.
+static ptrdiff_t sigma_json_unescape(SigmaJsonParser* ps, const char* p, const char* end, char* out) {
+  char* o = out;
+  while (p < end) {
+    const char* special = sigma_json_special(p, end, 0);
+    memcpy(o, p, special - p);
+    o += special - p;
+    p = special;
+    if (p == end) break;
+    if (*p != '\\') {
+      sigma_json_error(p - ps->text, "control character in string");
+      return -1;
+    }
+    char c = p[1];
+    p += 2;
+    switch (c) {
+      case '"': case '\\': case '/': *o++ = c; break;
+      case 'b': *o++ = '\b'; break;
+      case 'f': *o++ = '\f'; break;
+      case 'n': *o++ = '\n'; break;
+      case 'r': *o++ = '\r'; break;
+      case 't': *o++ = '\t'; break;
+      case 'u': {
+        int cp = end - p >= 4 ? sigma_json_hex(p) : -1;
+        if (cp < 0) {
+          sigma_json_error(p - 2 - ps->text, "bad \\u escape");
+          return -1;
+        }
+        p += 4;
+        if (cp >= 0xd800 && cp < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+          int low = sigma_json_hex(p + 2);
+          if (low >= 0xdc00 && low < 0xe000) {
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            p += 6;
+          }
+        }
+        if (cp >= 0xd800 && cp < 0xe000) cp = 0xfffd;     // an unpaired surrogate
+        if (cp < 0x80) {
+          *o++ = (char)cp;
+        } else if (cp < 0x800) {
+          *o++ = (char)(0xc0 | (cp >> 6));
+          *o++ = (char)(0x80 | (cp & 0x3f));
+        } else if (cp < 0x10000) {
+          *o++ = (char)(0xe0 | (cp >> 12));
+          *o++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+          *o++ = (char)(0x80 | (cp & 0x3f));
+        } else {
+          *o++ = (char)(0xf0 | (cp >> 18));
+          *o++ = (char)(0x80 | ((cp >> 12) & 0x3f));
+          *o++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+          *o++ = (char)(0x80 | (cp & 0x3f));
+        }
+        break;
+      }
+      default:
+        sigma_json_error(p - 2 - ps->text, "bad escape in string");
+        return -1;
+    }
+  }
+  return o - out;
+}
+
+// The string whose quotes are at offsets `open` and `close`.
+static int sigma_json_string(SigmaJsonParser* ps, uint32_t open, uint32_t close, SigmaValue* out) {
+  const char* p = ps->text + open + 1;
+  const char* end = ps->text + close;
+  SigmaString* str = sigma_string_alloc(end - p);
+  ptrdiff_t len = sigma_json_unescape(ps, p, end, str->chars);
+  if (len < 0) {
+    free(str);
+    return 0;
+  }
+  str->len = len;
+  str->chars[len] = '\0';
+  *out = sigma_string_finish(str);
+  return 1;
+}
+
+// The key whose quotes are at `open` and `close`, as an index into ps->keys.
+static int sigma_json_key(SigmaJsonParser* ps, uint32_t open, uint32_t close, uint32_t* out) {
+  const char* p = ps->text + open + 1;
+  const char* end = ps->text + close;
+  size_t len = end - p;
+  if (sigma_json_special(p, end, 0) != end) {
+    if (ps->buf_capacity < len) {
+      free(ps->buf);
+      ps->buf_capacity = len * 2;
+      ps->buf = malloc(ps->buf_capacity);
+    }
+    ptrdiff_t n = sigma_json_unescape(ps, p, end, ps->buf);
+    if (n < 0) return 0;
+    // Object keys are C strings.
+    if (memchr(ps->buf, '\0', n)) return sigma_json_error(open, "\\u0000 in a key");
+    p = ps->buf;
+    len = n;
+  }
+  uint64_t hash = sigma_hash_bytes(p, len);
+  size_t i = hash & ps->key_mask;
+  for (;; i = (i + 1) & ps->key_mask) {
+    uint32_t k = ps->key_table[i];
+    if (k == UINT32_MAX) break;
+    SigmaJsonKey* key = &ps->keys[k];
+    if (key->hash == hash && key->len == len && memcmp(key->chars, p, len) == 0) {
+      *out = k;
+      return 1;
+    }
+  }
+  if (ps->key_count == ps->key_capacity) {
+    ps->key_capacity *= 2;
+    ps->keys = realloc(ps->keys, sizeof(SigmaJsonKey) * ps->key_capacity);
+  }
+  SigmaString* str = sigma_string_alloc(len);
+  memcpy(str->chars, p, len);
+  str->hash = hash;
+  SigmaJsonKey* key = &ps->keys[ps->key_count];
+  key->chars = str->chars;
+  key->hash = hash;
+  key->len = len;
+  key->stamp = 0;
+  ps->key_table[i] = *out = ps->key_count++;
+  if (ps->key_count * 2 > ps->key_mask) {
+    ps->key_mask = ps->key_mask * 2 + 1;
+    free(ps->key_table);
+    ps->key_table = malloc(sizeof(uint32_t) * (ps->key_mask + 1));
+    memset(ps->key_table, 0xff, sizeof(uint32_t) * (ps->key_mask + 1));
+    for (uint32_t k = 0; k < ps->key_count; k++) {
+      size_t j = ps->keys[k].hash & ps->key_mask;
+      while (ps->key_table[j] != UINT32_MAX) j = (j + 1) & ps->key_mask;
+      ps->key_table[j] = k;
+    }
+  }
+  return 1;
+}
+
+static const double sigma_pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// m * 10^e as a correctly rounded double, for |e| <= 22, without strtod.
+// Below 2^53, m and 10^e are exact doubles and one multiplication or
+// division rounds correctly (Clinger's fast path). Up to 2^64, the same in
+// x87 extended precision rounds correctly to 64 bits; rounding that on to
+// 53 bits can only go wrong when it landed exactly halfway between two
+// doubles, which the low 11 bits tell. Zero in that case, or when long
+// double is no wider than double.
+static inline int sigma_decimal_to_double(uint64_t m, int e, double* out) {
+  if (m <= (1ULL << 53)) {
+    *out = e < 0 ? (double)m / sigma_pow10[-e] : (double)m * sigma_pow10[e];
+    return 1;
+  }
+#if LDBL_MANT_DIG == 64
+  long double x = e < 0 ? (long double)m / sigma_pow10[-e] : (long double)m * sigma_pow10[e];
+  uint64_t significand;
+  memcpy(&significand, &x, 8);
+  if ((significand & 0x7ff) == 0x400) return 0;
+  *out = (double)x;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+// The number at p, in JSON's syntax: an int if it is a whole number that
+// fits in 64 bits (down to -2^63, whose magnitude is one more than
+// INT64_MAX), a dec otherwise. Decs with at most 19 digits and an
+// exponent of at most 22 are converted directly, the rest go through
+// strtod. Returns the end of the number, or NULL with *bad where a digit
+// was expected.
+static inline const char* sigma_scan_number(const char* p, SigmaValue* out, const char** bad) {
+  const char* start = p;
+  int negative = *p == '-';
+  p += negative;
+  if (*p < '0' || *p > '9') {
+    *bad = p;
+    return NULL;
+  }
+  uint64_t mantissa = 0;
+  int digits = 0, exponent = 0, is_dec = 0;
+  double d;
+  if (*p == '0') {
+    p++;
+  } else {
+    for (; *p >= '0' && *p <= '9'; p++, digits++) {
+      if (digits < 19) mantissa = mantissa * 10 + (*p - '0');
+      else exponent++;
+    }
+  }
+  if (*p == '.') {
+    is_dec = 1;
+    p++;
+    if (*p < '0' || *p > '9') {
+      *bad = p;
+      return NULL;
+    }
+    for (; *p >= '0' && *p <= '9'; p++) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        exponent--;
+        if (mantissa) digits++;
+      } else {
+        digits++;     // too many for the fast path
+      }
+    }
+  }
+  if ((*p | 0x20) == 'e') {
+    is_dec = 1;
+    p++;
+    int sign = 1, e = 0;
+    if (*p == '+' || *p == '-') sign = *p++ == '-' ? -1 : 1;
+    if (*p < '0' || *p > '9') {
+      *bad = p;
+      return NULL;
+    }
+    for (; *p >= '0' && *p <= '9'; p++) {
+      if (e < 100000) e = e * 10 + (*p - '0');
+    }
+    exponent += sign * e;
+  }
+  if (!is_dec && exponent == 0 && mantissa <= (uint64_t)INT64_MAX + negative) {
+    *out = sigma_make_int(negative ? -(int64_t)(mantissa - 1) - 1 : (int64_t)mantissa);
+  } else if (digits <= 19 && exponent >= -22 && exponent <= 22 && sigma_decimal_to_double(mantissa, exponent, &d)) {
+    *out = sigma_make_number(negative ? -d : d);
+  } else {
+    *out = sigma_make_number(strtod(start, NULL));
+  }
+  return p;
+}
+
+// A number, true, false or null starting at `at`; `limit` is the offset of
+// the next index entry.
+static int sigma_json_scalar(SigmaJsonParser* ps, uint32_t at, uint32_t limit, SigmaValue* out) {
+  const char* p = ps->text + at;
+  switch (*p) {
+    case 't':
+      if (strncmp(p, "true", 4) != 0) return sigma_json_error(at, "unexpected character");
+      *out = sigma_make_bool(1);
+      p += 4;
+      break;
+    case 'f':
+      if (strncmp(p, "false", 5) != 0) return sigma_json_error(at, "unexpected character");
+      *out = sigma_make_bool(0);
+      p += 5;
+      break;
+    case 'n':
+      if (strncmp(p, "null", 4) != 0) return sigma_json_error(at, "unexpected character");
+      *out = sigma_make_nil();
+      p += 4;
+      break;
+    default: {
+      const char* bad;
+      const char* digit = p + (*p == '-');
+      if (*digit < '0' || *digit > '9') return sigma_json_error(at, "unexpected character");
+      if (!(p = sigma_scan_number(p, out, &bad))) return sigma_json_error(bad - ps->text, "digit expected");
+      break;
+    }
+  }
+  // Only spaces may follow, up to the next index entry.
+  for (const char* end = ps->text + limit; p < end; p++) {
+    if (!(sigma_json_class[(uint8_t)*p] & SIGMA_JSON_SPACE)) return sigma_json_error(p - ps->text, "unexpected character");
+  }
+  return 1;
+}
+
+static void sigma_json_push(SigmaJsonParser* ps, SigmaValue value, uint32_t key) {
+  if (ps->item_count == ps->item_capacity) {
+    ps->item_capacity *= 2;
+    ps->items = realloc(ps->items, sizeof(SigmaJsonItem) * ps->item_capacity);
+  }
+  ps->items[ps->item_count].value = value;
+  ps->items[ps->item_count].key = key;
+  ps->item_count++;
+}
+
+// The items from `base` up, as an array or object. The header and the
+// element boxes are one allocation (nothing frees or moves either), and
+// a key that appears twice keeps its first place and its last value.
+static SigmaValue sigma_json_close(SigmaJsonParser* ps, size_t base, int object) {
+  SigmaJsonItem* items = ps->items + base;
+  int n = (int)(ps->item_count - base);
+  ps->item_count = base;
+  SigmaValue v;
+  if (!object) {
+    SigmaArray* a = malloc(sizeof(SigmaArray) + sizeof(SigmaValue) * n);
+    SigmaValue* boxes = (SigmaValue*)(a + 1);
+    a->capacity = n > 0 ? n : 4;
+    a->items = malloc(sizeof(void*) * a->capacity);
+    a->size = n;
+    a->flags = 0;
+    for (int i = 0; i < n; i++) {
+      boxes[i] = items[i].value;
+      a->items[i] = &boxes[i];
+    }
+    v.type = TYPE_ARRAY;
+    v.as.array = a;
+    return v;
+  }
+  SigmaObject* o = malloc(sizeof(SigmaObject) + sizeof(SigmaValue) * n);
+  SigmaValue* boxes = (SigmaValue*)(o + 1);
+  o->capacity = n > 0 ? n : 4;
+  o->keys = malloc(sizeof(char*) * o->capacity);
+  o->values = malloc(sizeof(void*) * o->capacity);
+  o->size = 0;
+  o->flags = 0;
+  uint32_t stamp = ++ps->stamp;
+  for (int i = 0; i < n; i++) {
+    SigmaJsonKey* key = &ps->keys[items[i].key];
+    if (key->stamp == stamp) {
+      boxes[key->slot] = items[i].value;
+      continue;
+    }
+    key->stamp = stamp;
+    key->slot = o->size;
+    boxes[o->size] = items[i].value;
+    o->keys[o->size] = key->chars;
+    o->values[o->size] = &boxes[o->size];
+    o->size++;
+  }
+  v.type = TYPE_OBJECT;
+  v.as.object = o;
+  return v;
+}
+
+typedef struct {
+  size_t base;      // of its items on the scratch stack
+  uint32_t key;     // of the value being parsed, in an object
+  int object;
+} SigmaJsonFrame;
+
+// The offset of index entry i, or the end of the text.
+static inline uint32_t sigma_json_at(const SigmaJsonParser* ps, size_t i) {
+  return i < ps->index.size ? ps->index.at[i] : (uint32_t)ps->len;
+}
+
+// `"key":` at entry *i, in an object.
+static int sigma_json_member(SigmaJsonParser* ps, size_t* i, SigmaJsonFrame* f) {
+  const char* text = ps->text;
+  if (*i >= ps->index.size || text[ps->index.at[*i]] != '"') return sigma_json_error(sigma_json_at(ps, *i), "key expected");
+  if (!sigma_json_key(ps, ps->index.at[*i], ps->index.at[*i + 1], &f->key)) return 0;
+  *i += 2;
+  if (*i >= ps->index.size || text[ps->index.at[*i]] != ':') return sigma_json_error(sigma_json_at(ps, *i), "':' expected");
+  (*i)++;
+  return 1;
+}
+
+// Stage two: the value the index describes, or 0 after raising an error.
+// Each turn of the loop parses one value starting at entry i, then closes
+// the containers it completes.
+static int sigma_json_build(SigmaJsonParser* ps, SigmaValue* result) {
+  const char* text = ps->text;
+  const uint32_t* at = ps->index.at;
+  size_t n = ps->index.size, i = 0;
+  size_t depth = 0, frame_capacity = 16;
+  SigmaJsonFrame* frames = malloc(sizeof(SigmaJsonFrame) * frame_capacity);
+  int ok = 0;
+  while (1) {
+    SigmaValue value;
+    char c = i < n ? text[at[i]] : '\0';
+    if (c == '[' || c == '{') {
+      if (depth == frame_capacity) frames = realloc(frames, sizeof(SigmaJsonFrame) * (frame_capacity *= 2));
+      SigmaJsonFrame* f = &frames[depth++];
+      f->base = ps->item_count;
+      f->object = c == '{';
+      i++;
+      if (i < n && text[at[i]] == (f->object ? '}' : ']')) {
+        i++;
+        value = sigma_json_close(ps, f->base, f->object);
+        depth--;
+      } else {
+        if (f->object && !sigma_json_member(ps, &i, f)) break;
+        continue;
+      }
+    } else if (c == '"') {
+      if (!sigma_json_string(ps, at[i], at[i + 1], &value)) break;
+      i += 2;
+    } else if (c == '\0' || c == ']' || c == '}' || c == ':' || c == ',') {
+      sigma_json_error(sigma_json_at(ps, i), "value expected");
+      break;
+    } else {
+      if (!sigma_json_scalar(ps, at[i], sigma_json_at(ps, i + 1), &value)) break;
+      i++;
+    }
+
+    // The value is the result, or the next item of the innermost container,
+    // which may end here.
+    int more = 0;
+    while (depth > 0) {
+      SigmaJsonFrame* f = &frames[depth - 1];
+      sigma_json_push(ps, value, f->key);
+      c = i < n ? text[at[i]] : '\0';
+      if (c == ',') {
+        i++;
+        more = !f->object || sigma_json_member(ps, &i, f) ? 1 : -1;
+        break;
+      }
+      if (c != (f->object ? '}' : ']')) {
+        sigma_json_error(sigma_json_at(ps, i), f->object ? "',' or '}' expected" : "',' or ']' expected");
+        more = -1;
+        break;
+      }
+      i++;
+      value = sigma_json_close(ps, f->base, f->object);
+      depth--;
+    }
+    if (more < 0) break;
+    if (more) continue;
+    if (i < n) {
+      sigma_json_error(at[i], "unexpected data after the value");
+      break;
+    }
+    *result = value;
+    ok = 1;
+    break;
+  }
+  free(frames);
+  return ok;
+}
+
+SigmaValue sigma_json_parse(SigmaValue text) {
+  if (text.type != TYPE_STRING) {
+    sigma_error("json_parse() takes a string, not %s", sigma_a_type(text));
+    return sigma_make_nil();
+  }
+  size_t len = sigma_str_len(text.as.string);
+  if (len >= UINT32_MAX) {
+    sigma_error("json_parse() takes at most 4 GB");
+    return sigma_make_nil();
+  }
+  SigmaJsonParser ps;
+  memset(&ps, 0, sizeof(ps));
+  ps.text = text.as.string;
+  ps.len = len;
+  SigmaValue result = sigma_make_nil();
+  if (!sigma_json_index(ps.text, len, &ps.index)) {
+    sigma_json_error(len, "unterminated string");
+  } else {
+    ps.item_capacity = 64;
+    ps.items = malloc(sizeof(SigmaJsonItem) * ps.item_capacity);
+    ps.key_capacity = 16;
+    ps.keys = malloc(sizeof(SigmaJsonKey) * ps.key_capacity);
+    ps.key_mask = 63;
+    ps.key_table = malloc(sizeof(uint32_t) * (ps.key_mask + 1));
+    memset(ps.key_table, 0xff, sizeof(uint32_t) * (ps.key_mask + 1));
+    if (!sigma_json_build(&ps, &result)) result = sigma_make_nil();
+  }
+  free(ps.index.at);
+  free(ps.items);
+  free(ps.keys);
+  free(ps.key_table);
+  free(ps.buf);
+  return result;
+}
+
+// json_stringify writes into one buffer that grows by doubling. The
+// buffer is allocated as a string from the start, so that the result is
+// the buffer itself.
+typedef struct {
+  SigmaString* str;
+  size_t len, capacity;
+} SigmaJsonWriter;
+
+static inline char* sigma_json_reserve(SigmaJsonWriter* w, size_t n) {
+  if (__builtin_expect(w->len + n > w->capacity, 0)) {
+    while (w->len + n > w->capacity) w->capacity *= 2;
+    w->str = realloc(w->str, sizeof(SigmaString) + w->capacity + 1);
+  }
+  return w->str->chars + w->len;
+}
+
+static inline void sigma_json_append(SigmaJsonWriter* w, const char* s, size_t n) {
+  memcpy(sigma_json_reserve(w, n), s, n);
+  w->len += n;
+}
+
+static const char sigma_digit_pairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+// The digits of n, two at a time from the right; returns their count.
+static int sigma_format_u64(uint64_t n, char* out) {
+  char buf[20];
+  char* p = buf + 20;
+  while (n >= 100) {
+    p -= 2;
+    memcpy(p, sigma_digit_pairs + 2 * (n % 100), 2);
+    n /= 100;
+  }
+  if (n >= 10) {
+    p -= 2;
+    memcpy(p, sigma_digit_pairs + 2 * n, 2);
+  } else {
+    *--p = (char)('0' + n);
+  }
+  int len = (int)(buf + 20 - p);
+  memcpy(out, p, len);
+  return len;
+}
+
+static int sigma_format_i64(int64_t n, char* out) {
+  if (n < 0) {
+    *out = '-';
+    return 1 + sigma_format_u64(-(uint64_t)n, out + 1);
+  }
+  return sigma_format_u64((uint64_t)n, out);
+}
+
+// The shortest decimal that reads back as the same double, always with a
+// '.' or an exponent so that it reads back as a dec rather than an int.
+// For x between 1e-5 and 1e15, m / 10^d with m the nearest integer to
+// x * 10^d reads back as x exactly when sigma_decimal_to_double (which
+// rounds as strtod does) returns x. If some d works, every larger one does
+// too, so a binary search finds the smallest d, which gives the shortest
+// text. Other values, and the rare ones where that cannot decide, go
+// through printf with the fewest digits, from 1 up, that read back.
+// Infinities and NaN are not JSON; they become null.
+static int sigma_dec_digits(double a, int d, uint64_t* m) {
+  *m = (uint64_t)((long double)a * sigma_pow10[d] + 0.5L);
+  double back = 0;
+  return sigma_decimal_to_double(*m, -d, &back) && back == a;
+}
+
+static int sigma_format_dec(double x, char* out) {
+  if (!isfinite(x)) {
+    memcpy(out, "null", 4);
+    return 4;
+  }
+  char* o = out;
+  if (signbit(x)) *o++ = '-';
+  double a = fabs(x);
+  if (a < 1e15 && (a == 0 || a >= 1e-5)) {
+    int d = 0, high = 0;
+    uint64_t m, high_m;
+    while (high < 22 && (long double)a * sigma_pow10[high + 1] < 1e17L) high++;
+    if (sigma_dec_digits(a, high, &high_m)) {
+      while (d < high) {
+        int mid = (d + high) / 2;
+        if (sigma_dec_digits(a, mid, &m)) high = mid, high_m = m;
+        else d = mid + 1;
+      }
+      m = high_m;
+      char digits[20];
+      int n = sigma_format_u64(m, digits);
+      if (d == 0) {
+        memcpy(o, digits, n);
+        memcpy(o + n, ".0", 2);
+        return (int)(o - out) + n + 2;
+      }
+      if (n <= d) {
+        memcpy(o, "0.", 2);
+        o += 2;
+        memset(o, '0', d - n);
+        o += d - n;
+        memcpy(o, digits, n);
+        return (int)(o - out) + n;
+      }
+      memcpy(o, digits, n - d);
+      o += n - d;
+      *o++ = '.';
+      memcpy(o, digits + n - d, d);
+      return (int)(o - out) + d;
+    }
+  }
+  int n = 0;
+  for (int precision = 1; precision <= 17; precision++) {
+    n = snprintf(out, 32, "%.*g", precision, x);
+    if (strtod(out, NULL) == x) break;
+  }
+  if (!memchr(out, '.', n) && !memchr(out, 'e', n)) {
+    memcpy(out + n, ".0", 2);
+    n += 2;
+  }
+  return n;
+}
+
+static const char sigma_json_hex_digits[] = "0123456789abcdef";
+
+// s in quotes, with ", \ and control characters escaped.
+static void sigma_json_write_string(SigmaJsonWriter* w, const char* s, size_t len) {
+  char* o = sigma_json_reserve(w, len + 2);
+  *o = '"';
+  w->len++;
+  const char* end = s + len;
+  while (s < end) {
+    const char* special = sigma_json_special(s, end, 1);
+    sigma_json_append(w, s, special - s);
+    s = special;
+    if (s == end) break;
+    char c = *s++;
+    char esc[6] = {'\\', c, 0, 0, 0, 0};
+    int n = 2;
+    switch (c) {
+      case '"': case '\\': break;
+      case '\b': esc[1] = 'b'; break;
+      case '\f': esc[1] = 'f'; break;
+      case '\n': esc[1] = 'n'; break;
+      case '\r': esc[1] = 'r'; break;
+      case '\t': esc[1] = 't'; break;
+      default:
+        memcpy(esc + 1, "u00", 3);
+        esc[4] = sigma_json_hex_digits[(uint8_t)c >> 4];
+        esc[5] = sigma_json_hex_digits[c & 15];
+        n = 6;
+    }
+    sigma_json_append(w, esc, n);
+  }
+  *sigma_json_reserve(w, 1) = '"';
+  w->len++;
+}
+
+// Deep enough for any real document; a value that contains itself would
+// otherwise recurse until the stack ran out.
+#define SIGMA_JSON_MAX_DEPTH 1000
+
+static int sigma_json_write(SigmaJsonWriter* w, SigmaValue v, int depth) {
+  char buf[32];
+  if (depth > SIGMA_JSON_MAX_DEPTH) {
+    sigma_error("Cannot convert to JSON: nested more than %d deep (does it contain itself?)", SIGMA_JSON_MAX_DEPTH);
+    return 0;
+  }
+  switch (v.type) {
+    case TYPE_NIL:
+      sigma_json_append(w, "null", 4);
+      return 1;
+    case TYPE_BOOL:
+      if (v.as.boolean) sigma_json_append(w, "true", 4);
+      else sigma_json_append(w, "false", 5);
+      return 1;
+    case TYPE_INT:
+      w->len += sigma_format_i64(v.as.integer, sigma_json_reserve(w, 20));
+      return 1;
+    case TYPE_NUMBER:
+      w->len += sigma_format_dec(v.as.number, sigma_json_reserve(w, 32));
+      return 1;
+    case TYPE_STRING:
+      sigma_json_write_string(w, v.as.string, sigma_str_len(v.as.string));
+      return 1;
+    case TYPE_ARRAY:
+      sigma_json_append(w, "[", 1);
+      for (int i = 0; i < v.as.array->size; i++) {
+        if (i > 0) sigma_json_append(w, ",", 1);
+        if (!sigma_json_write(w, *(SigmaValue*)v.as.array->items[i], depth + 1)) return 0;
+      }
+      sigma_json_append(w, "]", 1);
+      return 1;
+    case TYPE_TYPED:
+      sigma_json_append(w, "[", 1);
+      for (int64_t i = 0; i < v.as.typed->size; i++) {
+        if (i > 0) sigma_json_append(w, ",", 1);
+        sigma_json_write(w, sigma_typed_load(v.as.typed, i), depth + 1);
+      }
+      sigma_json_append(w, "]", 1);
+      return 1;
+    case TYPE_OBJECT:
+      sigma_json_append(w, "{", 1);
+      for (int i = 0; i < v.as.object->size; i++) {
+        if (i > 0) sigma_json_append(w, ",", 1);
+        const char* key = v.as.object->keys[i];
+        sigma_json_write_string(w, key, strlen(key));
+        sigma_json_append(w, ":", 1);
+        if (!sigma_json_write(w, *(SigmaValue*)v.as.object->values[i], depth + 1)) return 0;
+      }
+      sigma_json_append(w, "}", 1);
+      return 1;
+    case TYPE_DICT:
+      // JSON keys are strings: a number key is written as its digits.
+      sigma_json_append(w, "{", 1);
+      for (int i = 0; i < v.as.dict->size; i++) {
+        if (i > 0) sigma_json_append(w, ",", 1);
+        SigmaDictEntry e = sigma_dict_entry(v.as.dict, i);
+        SigmaValue key = e.key;
+        if (key.type == TYPE_STRING) {
+          sigma_json_write_string(w, key.as.string, sigma_str_len(key.as.string));
+        } else {
+          int n = key.type == TYPE_INT ? sigma_format_i64(key.as.integer, buf) : sigma_format_dec(key.as.number, buf);
+          sigma_json_write_string(w, buf, n);
+        }
+        sigma_json_append(w, ":", 1);
+        if (!sigma_json_write(w, e.value, depth + 1)) return 0;
+      }
+      sigma_json_append(w, "}", 1);
+      return 1;
+    default:
+      sigma_error("Cannot convert %s to JSON", sigma_a_type(v));
+      return 0;
+  }
+}
+
+SigmaValue sigma_json_stringify(SigmaValue v) {
+  SigmaJsonWriter w = {NULL, 0, 64};
+  w.str = malloc(sizeof(SigmaString) + w.capacity + 1);
+  if (!sigma_json_write(&w, v, 0)) {
+    free(w.str);
+    return sigma_make_nil();
+  }
+  w.str = realloc(w.str, sizeof(SigmaString) + w.len + 1);
+  w.str->len = w.len;
+  w.str->flags = 0;
+  w.str->chars[w.len] = '\0';
+  return sigma_string_finish(w.str);
+}
+
+// --- tables ---
+
+static const size_t sigma_column_size[] = {sizeof(int64_t), sizeof(double), sizeof(uint32_t)};
+
+// A string column's distinct strings, numbered in order of first
+// appearance, with an open-addressing index over their hashes that is at
+// most half full.
+struct SigmaStringPool {
+  char** strings;       // by code
+  uint32_t* slots;      // code + 1, or 0 for an empty slot
+  uint32_t size, capacity, mask;
+};
+
+static SigmaStringPool* sigma_pool_new(void) {
+  SigmaStringPool* p = malloc(sizeof(SigmaStringPool));
+  p->size = 0;
+  p->capacity = 16;
+  p->strings = malloc(sizeof(char*) * p->capacity);
+  p->mask = 2 * p->capacity - 1;
+  p->slots = calloc(p->mask + 1, sizeof(uint32_t));
+  return p;
+}
+
+static void sigma_pool_grow(SigmaStringPool* p) {
+  p->capacity *= 2;
+  p->strings = realloc(p->strings, sizeof(char*) * p->capacity);
+  p->mask = 2 * p->capacity - 1;
+  free(p->slots);
+  p->slots = calloc(p->mask + 1, sizeof(uint32_t));
+  for (uint32_t c = 0; c < p->size; c++) {
+    size_t i = sigma_str_header(p->strings[c])->hash & p->mask;
+    while (p->slots[i]) i = (i + 1) & p->mask;
+    p->slots[i] = c + 1;
+  }
+}
+
+// The code of the `len` bytes at s, whose hash is `hash`; a string not in
+// the pool yet is made and added.
+static uint32_t sigma_pool_code(SigmaStringPool* p, const char* s, size_t len, uint64_t hash) {
+  if (p->size == p->capacity) sigma_pool_grow(p);
+  size_t i = hash & p->mask;
+  for (uint32_t c; (c = p->slots[i]); i = (i + 1) & p->mask) {
+    const SigmaString* str = sigma_str_header(p->strings[c - 1]);
+    if (str->hash == hash && str->len == len && memcmp(str->chars, s, len) == 0) return c - 1;
+  }
+  SigmaString* str = sigma_string_alloc(len);
+  memcpy(str->chars, s, len);
+  str->hash = hash;
+  p->strings[p->size] = str->chars;
+  p->slots[i] = ++p->size;
+  return p->size - 1;
+}
+
+static uint32_t sigma_pool_text(SigmaStringPool* p, const char* s, size_t len) {
+  return sigma_pool_code(p, s, len, sigma_hash_bytes(s, len));
+}
+
+static SigmaTable* sigma_table_alloc(int ncols, int64_t rows) {
+  SigmaTable* t = malloc(sizeof(SigmaTable));
+  t->columns = malloc(sizeof(SigmaColumn) * (ncols > 0 ? ncols : 1));
+  t->ncols = ncols;
+  t->rows = rows;
+  t->groups = NULL;
+  return t;
+}
+
+static SigmaValue sigma_table_value(SigmaTable* t) {
+  SigmaValue v; v.type = TYPE_TABLE; v.as.table = t; return v;
+}
+
+// A copy of t's header that shares its columns.
+static SigmaTable* sigma_table_share(const SigmaTable* t) {
+  SigmaTable* s = sigma_table_alloc(t->ncols, t->rows);
+  memcpy(s->columns, t->columns, sizeof(SigmaColumn) * t->ncols);
+  return s;
+}
+
+// The table a method was called on, or NULL after raising. Of the methods,
+// only sum, count and mean take what group_by returns.
+static SigmaTable* sigma_table_of(SigmaValue t, const char* method, int grouped) {
+  if (t.type != TYPE_TABLE) {
+    sigma_error("Cannot call %s on %s", method, sigma_a_type(t));
+    return NULL;
+  }
+  if (t.as.table->groups && !grouped) {
+    sigma_error("Cannot call %s on what group_by returns; aggregate it with sum, count or mean first", method);
+    return NULL;
+  }
+  return t.as.table;
+}
+
+// The position of the column called `name`, or -1 after raising.
+static int sigma_table_find(const SigmaTable* t, SigmaValue name, const char* method) {
+  if (name.type != TYPE_STRING) {
+    sigma_error("%s() takes a column name, not %s", method, sigma_a_type(name));
+    return -1;
+  }
+  for (int i = 0; i < t->ncols; i++) {
+    if (sigma_str_equals(t->columns[i].name, name.as.string)) return i;
+  }
+  sigma_error("%s(): the table has no column %s", method, name.as.string);
+  return -1;
+}
+
+// The positions of the columns named by `names`, a column name or an array
+// of them, in a new buffer at *out. Returns how many, or -1 after raising.
+static int sigma_table_find_all(const SigmaTable* t, SigmaValue names, const char* method, int** out) {
+  if (names.type != TYPE_ARRAY) {
+    *out = malloc(sizeof(int));
+    **out = sigma_table_find(t, names, method);
+    if (**out >= 0) return 1;
+    free(*out);
+    return -1;
+  }
+  int n = names.as.array->size;
+  *out = malloc(sizeof(int) * (n > 0 ? n : 1));
+  for (int i = 0; i < n; i++) {
+    if (((*out)[i] = sigma_table_find(t, *(SigmaValue*)names.as.array->items[i], method)) < 0) {
+      free(*out);
+      return -1;
+    }
+  }
+  return n;
+}
+
+// The rows `at` of column c, in order, as a new column sharing c's name
+// and pool.
+static SigmaColumn sigma_column_gather(const SigmaColumn* c, const int64_t* at, int64_t n) {
+  SigmaColumn out = *c;
+  out.data = malloc(sigma_column_size[c->kind] * (n > 0 ? n : 1));
+  if (c->kind == SIGMA_COL_STR) {
+    const uint32_t* in = c->data;
+    uint32_t* o = out.data;
+    for (int64_t i = 0; i < n; i++) o[i] = in[at[i]];
+  } else {
+    const uint64_t* in = c->data;     // doubles are moved as their bits
+    uint64_t* o = out.data;
+    for (int64_t i = 0; i < n; i++) o[i] = in[at[i]];
+  }
+  return out;
+}
+
+static SigmaTable* sigma_table_gather(const SigmaTable* t, const int64_t* at, int64_t n) {
+  SigmaTable* s = sigma_table_alloc(t->ncols, n);
+  for (int c = 0; c < t->ncols; c++) s->columns[c] = sigma_column_gather(&t->columns[c], at, n);
+  return s;
+}
+
+// --- tables: read_csv ---
+
+// A column while read_csv reads it. The first field that is not empty
+// decides what it holds; when a later field does not fit, ints become decs
+// and numbers become strings, written back in their shortest form (1.50
+// comes back as "1.5"). Empty fields are nan in number columns.
+#define SIGMA_COL_PENDING (-1)
+
+typedef struct {
+  int kind;             // a SigmaColumnKind, or SIGMA_COL_PENDING while every field has been empty
+  void* data;
+  int64_t capacity;
+  SigmaStringPool* pool;
+} SigmaColumnBuilder;
+
+static void sigma_builder_reserve(SigmaColumnBuilder* b, int64_t rows) {
+  if (rows < b->capacity) return;
+  b->capacity = b->capacity ? b->capacity * 2 : 4096;
+  b->data = realloc(b->data, sigma_column_size[b->kind] * b->capacity);
+}
+
+// Settles a pending column on `kind`, its first `rows` fields empty.
+static void sigma_builder_settle(SigmaColumnBuilder* b, SigmaColumnKind kind, int64_t rows) {
+  b->kind = kind;
+  b->capacity = rows;
+  sigma_builder_reserve(b, rows);
+  if (kind == SIGMA_COL_STR) {
+    b->pool = sigma_pool_new();
+    uint32_t empty = sigma_pool_text(b->pool, "", 0);
+    for (int64_t i = 0; i < rows; i++) ((uint32_t*)b->data)[i] = empty;
+  } else {
+    for (int64_t i = 0; i < rows; i++) ((double*)b->data)[i] = NAN;
+  }
+}
+
+static void sigma_builder_to_f64(SigmaColumnBuilder* b, int64_t rows) {
+  int64_t* ints = b->data;
+  double* decs = b->data;
+  for (int64_t i = 0; i < rows; i++) decs[i] = (double)ints[i];
+  b->kind = SIGMA_COL_F64;
+}
+
+static void sigma_builder_to_str(SigmaColumnBuilder* b, int64_t rows) {
+  SigmaStringPool* pool = sigma_pool_new();
+  uint32_t* codes = malloc(sizeof(uint32_t) * b->capacity);
+  char text[40];
+  for (int64_t i = 0; i < rows; i++) {
+    int n;
+    if (b->kind == SIGMA_COL_I64) {
+      n = sigma_format_i64(((int64_t*)b->data)[i], text);
+    } else {
+      double x = ((double*)b->data)[i];
+      if (x != x) {
+        n = 0;
+      } else if (isinf(x)) {
+        n = x > 0 ? 3 : 4;
+        memcpy(text, x > 0 ? "inf" : "-inf", n);
+      } else {
+        n = sigma_format_dec(x, text);
+        if (n > 2 && memcmp(text + n - 2, ".0", 2) == 0) n -= 2;
+      }
+    }
+    codes[i] = sigma_pool_text(pool, text, n);
+  }
+  free(b->data);
+  b->data = codes;
+  b->pool = pool;
+  b->kind = SIGMA_COL_STR;
+}
+
+// Field `row` of the column: the `len` bytes at s, which are followed by a
+// byte that cannot continue a number.
+static void sigma_builder_add(SigmaColumnBuilder* b, int64_t row, const char* s, size_t len) {
+  SigmaValue v = sigma_make_nil();
+  const char* bad;
+  int number = 0;
+  if (b->kind != SIGMA_COL_STR && len > 0) {
+    const char* end = sigma_scan_number(s, &v, &bad);
+    number = end == s + len;
+  }
+  if (b->kind == SIGMA_COL_PENDING) {
+    if (len == 0) return;
+    sigma_builder_settle(b, !number ? SIGMA_COL_STR : v.type == TYPE_INT && row == 0 ? SIGMA_COL_I64 : SIGMA_COL_F64, row);
+  }
+  sigma_builder_reserve(b, row);
+  if (b->kind != SIGMA_COL_STR && len > 0 && !number) sigma_builder_to_str(b, row);
+  switch (b->kind) {
+    case SIGMA_COL_I64:
+      if (number && v.type == TYPE_INT) {
+        ((int64_t*)b->data)[row] = v.as.integer;
+        return;
+      }
+      sigma_builder_to_f64(b, row);
+      // fall through
+    case SIGMA_COL_F64:
+      ((double*)b->data)[row] = len == 0 ? NAN : sigma_num(v);
+      return;
+    default:
+      ((uint32_t*)b->data)[row] = sigma_pool_text(b->pool, s, len);
+  }
+}
+
+typedef struct {
+  const char* s;
+  size_t len;
+  int escaped;          // holds doubled quotes
+} SigmaCsvField;
+
+typedef struct {
+  SigmaCsvField* fields;
+  int count, capacity;
+} SigmaCsvRecord;
+
+static void sigma_csv_field(SigmaCsvRecord* r, const char* s, size_t len, int escaped) {
+  if (r->count == r->capacity) {
+    r->capacity *= 2;
+    r->fields = realloc(r->fields, sizeof(SigmaCsvField) * r->capacity);
+  }
+  r->fields[r->count++] = (SigmaCsvField){s, len, escaped};
+}
+
+// Splits the record at p into fields (RFC 4180: fields in double quotes may
+// hold commas, newlines and doubled quotes; a record may end in "\r\n").
+// Returns the start of the next record, or NULL if the record may go on
+// past `end` and more has to be read first.
+static const char* sigma_csv_record(const char* p, const char* end, int at_eof, SigmaCsvRecord* r) {
+  r->count = 0;
+  for (;;) {
+    if (p < end && *p == '"') {
+      const char* start = ++p;
+      int escaped = 0;
+      for (;;) {
+        const char* q = memchr(p, '"', end - p);
+        if (!q || (q + 1 == end && !at_eof)) return NULL;
+        if (q + 1 < end && q[1] == '"') {
+          escaped = 1;
+          p = q + 2;
+          continue;
+        }
+        sigma_csv_field(r, start, q - start, escaped);
+        p = q + 1;
+        break;
+      }
+      while (p < end && *p != ',' && *p != '\n') p++;    // anything after the closing quote
+    } else {
+      const char* start = p;
+      while (p < end && *p != ',' && *p != '\n') p++;
+      sigma_csv_field(r, start, p - start, 0);
+    }
+    if (p < end && *p == ',') {
+      p++;
+      continue;
+    }
+    if (p == end && !at_eof) return NULL;
+    SigmaCsvField* last = &r->fields[r->count - 1];
+    if (last->len > 0 && last->s + last->len == p && p[-1] == '\r') last->len--;
+    return p < end ? p + 1 : p;
+  }
+}
+
+// Undoes the doubled quotes of a complete record's fields, in place.
+static void sigma_csv_unescape(SigmaCsvRecord* r) {
+  for (int i = 0; i < r->count; i++) {
+    SigmaCsvField* f = &r->fields[i];
+    if (!f->escaped) continue;
+    char* o = (char*)f->s;
+    for (size_t j = 0; j < f->len; j++) {
+      *o++ = f->s[j];
+      if (f->s[j] == '"') j++;
+    }
+    f->len = o - f->s;
+    *o = ',';       // ends the field for sigma_scan_number
+  }
+}
+
+#define SIGMA_CSV_CHUNK (1 << 20)
+
+typedef struct {
+  SigmaIoJob job;
+  const char* path;
+  FILE* f;
+  char* buf;
+  size_t want, got;
+  int error;
+} SigmaCsvRead;
+
+// Opens the file on the first call, then reads the next chunk.
+static void sigma_csv_read(SigmaIoJob* job) {
+  SigmaCsvRead* r = (SigmaCsvRead*)job;
+  if (!r->f && !(r->f = fopen(r->path, "rb"))) {
+    r->error = errno;
+    return;
+  }
+  r->got = fread(r->buf, 1, r->want, r->f);
+  if (r->got < r->want && ferror(r->f)) r->error = errno ? errno : EIO;
+}
+
+// The file is read a megabyte at a time (on an I/O thread, from a task),
+// and every complete record in the buffer goes straight into the columns;
+// only a record cut off at the end of a chunk is kept for the next.
+SigmaValue sigma_read_csv(SigmaValue path) {
+  if (path.type != TYPE_STRING) {
+    sigma_error("read_csv() takes a file name, not %s", sigma_a_type(path));
+    return sigma_make_nil();
+  }
+  SigmaCsvRead read = {{sigma_csv_read, NULL, NULL}, path.as.string, NULL, NULL, 0, 0, 0};
+  size_t capacity = SIGMA_CSV_CHUNK, start = 0, len = 0;
+  char* buf = malloc(capacity + 1);
+  SigmaCsvRecord record = {malloc(sizeof(SigmaCsvField) * 16), 0, 16};
+  SigmaTable* t = NULL;
+  SigmaColumnBuilder* columns = NULL;
+  int at_eof = 0, failed = 0;
+  while (!failed) {
+    if (start > 0) {
+      memmove(buf, buf + start, len - start);
+      len -= start;
+      start = 0;
+    }
+    if (len == capacity) buf = realloc(buf, (capacity *= 2) + 1);
+    read.buf = buf + len;
+    read.want = capacity - len;
+    sigma_offload(&read.job);
+    if (read.error) {
+      sigma_error("Cannot read %s: %s", path.as.string, strerror(read.error));
+      failed = 1;
+      break;
+    }
+    len += read.got;
+    at_eof = read.got < read.want;
+    buf[len] = '\0';
+    while (start < len) {
+      const char* next = sigma_csv_record(buf + start, buf + len, at_eof, &record);
+      if (!next) {
+        if (at_eof) {
+          sigma_error("read_csv(): %s ends inside a quoted field", path.as.string);
+          failed = 1;
+        }
+        break;
+      }
+      start = next - buf;
+      if (record.count == 1 && record.fields[0].len == 0) continue;    // a blank line
+      sigma_csv_unescape(&record);
+      if (!t) {
+        t = sigma_table_alloc(record.count, 0);
+        columns = calloc(record.count > 0 ? (size_t)record.count : 1, sizeof(SigmaColumnBuilder));
+        for (int c = 0; c < record.count; c++) {
+          t->columns[c].name = sigma_make_string_n(record.fields[c].s, record.fields[c].len).as.string;
+          columns[c].kind = SIGMA_COL_PENDING;
+        }
+        continue;
+      }
+      if (record.count != t->ncols) {
+        sigma_error("read_csv(): row %" PRId64 " of %s has %d fields, not %d", t->rows + 1, path.as.string,
+                    record.count, t->ncols);
+        failed = 1;
+        break;
+      }
+      for (int c = 0; c < t->ncols; c++) sigma_builder_add(&columns[c], t->rows, record.fields[c].s, record.fields[c].len);
+      t->rows++;
+    }
+    if (at_eof) break;
+  }
+  if (read.f) fclose(read.f);
+  free(buf);
+  free(record.fields);
+  if (!failed && !t) {
+    sigma_error("read_csv(): %s is empty", path.as.string);
+    failed = 1;
+  }
+  if (failed) {
+    if (t) {
+      for (int c = 0; c < t->ncols; c++) free(columns[c].data);
+      free(columns);
+    }
+    return sigma_make_nil();
+  }
+  for (int c = 0; c < t->ncols; c++) {
+    SigmaColumnBuilder* b = &columns[c];
+    if (b->kind == SIGMA_COL_PENDING) sigma_builder_settle(b, SIGMA_COL_STR, t->rows);
+    t->columns[c].kind = b->kind;
+    t->columns[c].data = realloc(b->data, sigma_column_size[b->kind] * (t->rows > 0 ? t->rows : 1));
+    t->columns[c].pool = b->pool;
+  }
+  free(columns);
+  return sigma_table_value(t);
+}
+
+// table({name:: [values], ...}): arrays of ints become int columns, of
+// numbers dec columns, of strings string columns; nil is nan or "".
+SigmaValue sigma_make_table(SigmaValue columns) {
+  if (columns.type != TYPE_OBJECT) {
+    sigma_error("table() takes an object of columns, not %s", sigma_a_type(columns));
+    return sigma_make_nil();
+  }
+  const SigmaObject* o = columns.as.object;
+  int64_t rows = 0;
+  for (int c = 0; c < o->size; c++) {
+    SigmaValue v = *(SigmaValue*)o->values[c];
+    if (v.type != TYPE_ARRAY && v.type != TYPE_TYPED) {
+      sigma_error("table(): column %s is %s, not an array", o->keys[c], sigma_a_type(v));
+      return sigma_make_nil();
+    }
+    if (c > 0 && sigma_len(v) != rows) {
+      sigma_error("table(): column %s has %" PRId64 " values, not %" PRId64, o->keys[c], sigma_len(v), rows);
+      return sigma_make_nil();
+    }
+    rows = sigma_len(v);
+  }
+  SigmaTable* t = sigma_table_alloc(o->size, rows);
+  for (int c = 0; c < o->size; c++) {
+    SigmaValue v = *(SigmaValue*)o->values[c];
+    SigmaColumn* col = &t->columns[c];
+    col->name = sigma_make_string(o->keys[c]).as.string;
+    col->pool = NULL;
+    if (v.type == TYPE_TYPED) {
+      col->kind = v.as.typed->kind == SIGMA_F64 ? SIGMA_COL_F64 : SIGMA_COL_I64;
+      col->data = malloc(sizeof(int64_t) * (rows > 0 ? rows : 1));
+      for (int64_t i = 0; i < rows; i++) {
+        SigmaValue x = sigma_typed_load(v.as.typed, i);
+        if (col->kind == SIGMA_COL_F64) ((double*)col->data)[i] = x.as.number;
+        else ((int64_t*)col->data)[i] = x.as.integer;
+      }
+      continue;
+    }
+    int ints = 1, numbers = 1, strings = 1;
+    for (int64_t i = 0; i < rows; i++) {
+      SigmaValue x = *(SigmaValue*)v.as.array->items[i];
+      ints &= x.type == TYPE_INT;
+      numbers &= sigma_is_number(x) || x.type == TYPE_NIL;
+      strings &= x.type == TYPE_STRING || x.type == TYPE_NIL;
+      if (!numbers && !strings) {
+        free(t->columns);
+        free(t);
+        sigma_error("table(): column %s holds %s", o->keys[c],
+                    x.type == TYPE_STRING || sigma_is_number(x) ? "both numbers and strings" : "values that are neither");
+        return sigma_make_nil();
+      }
+    }
+    col->kind = ints ? SIGMA_COL_I64 : numbers ? SIGMA_COL_F64 : SIGMA_COL_STR;
+    col->data = malloc(sigma_column_size[col->kind] * (rows > 0 ? rows : 1));
+    if (col->kind == SIGMA_COL_STR) col->pool = sigma_pool_new();
+    for (int64_t i = 0; i < rows; i++) {
+      SigmaValue x = *(SigmaValue*)v.as.array->items[i];
+      if (col->kind == SIGMA_COL_I64) {
+        ((int64_t*)col->data)[i] = x.as.integer;
+      } else if (col->kind == SIGMA_COL_F64) {
+        ((double*)col->data)[i] = x.type == TYPE_NIL ? NAN : sigma_num(x);
+      } else if (x.type == TYPE_NIL) {
+        ((uint32_t*)col->data)[i] = sigma_pool_text(col->pool, "", 0);
+      } else {
+        const SigmaString* s = sigma_str_header(x.as.string);
+        ((uint32_t*)col->data)[i] = sigma_pool_code(col->pool, s->chars, s->len, s->hash);
+      }
+    }
+  }
+  return sigma_table_value(t);
+}
+
+// --- tables: filter, select, sort_by ---
+
+enum { SIGMA_CMP_EQ, SIGMA_CMP_NE, SIGMA_CMP_LT, SIGMA_CMP_LE, SIGMA_CMP_GT, SIGMA_CMP_GE };
+
+static int sigma_cmp_op(SigmaValue op) {
+  static const char* const ops[] = {"==", "!=", "<", "<=", ">", ">="};
+  if (op.type == TYPE_STRING) {
+    for (int i = 0; i < 6; i++) {
+      if (strcmp(op.as.string, ops[i]) == 0) return i;
+    }
+  }
+  return -1;
+}
+
+// Appends every row i for which `test` holds to sel, without a branch: the
+// row is always written, and n only moves past it if it passed.
+#define SIGMA_SELECT(test)                  \
+  for (int64_t i = 0; i < rows; i++) {      \
+    sel[n] = i;                             \
+    n += (test);                            \
+  }
+
+#define SIGMA_SELECT_CMP(x, v)                            \
+  switch (op) {                                           \
+    case SIGMA_CMP_EQ: SIGMA_SELECT(x == v); break;       \
+    case SIGMA_CMP_NE: SIGMA_SELECT(x != v); break;       \
+    case SIGMA_CMP_LT: SIGMA_SELECT(x < v); break;        \
+    case SIGMA_CMP_LE: SIGMA_SELECT(x <= v); break;       \
+    case SIGMA_CMP_GT: SIGMA_SELECT(x > v); break;        \
+    default: SIGMA_SELECT(x >= v); break;                 \
+  }
+
+static int64_t sigma_select_i64(const int64_t* x, int64_t rows, int op, int64_t v, int64_t* sel) {
+  int64_t n = 0;
+  SIGMA_SELECT_CMP(x[i], v)
+  return n;
+}
+
+static int64_t sigma_select_f64(const double* x, int64_t rows, int op, double v, int64_t* sel) {
+  int64_t n = 0;
+  SIGMA_SELECT_CMP(x[i], v)
+  return n;
+}
+
+static int64_t sigma_select_i64_f64(const int64_t* x, int64_t rows, int op, double v, int64_t* sel) {
+  int64_t n = 0;
+  SIGMA_SELECT_CMP((double)x[i], v)
+  return n;
+}
+
+// A string column is compared through its pool: each distinct string is
+// compared with the value once, and the rows only look their code up.
+static int64_t sigma_select_codes(const uint32_t* x, int64_t rows, const uint8_t* keep, int64_t* sel) {
+  int64_t n = 0;
+  SIGMA_SELECT(keep[x[i]])
+  return n;
+}
+
+static int sigma_compare_strings(const SigmaString* a, const SigmaString* b) {
+  int c = memcmp(a->chars, b->chars, a->len < b->len ? a->len : b->len);
+  return c ? c : (a->len > b->len) - (a->len < b->len);
+}
+
+SigmaValue sigma_table_filter(SigmaValue tv, SigmaValue column, SigmaValue op, SigmaValue value) {
+  SigmaTable* t = sigma_table_of(tv, "filter", 0);
+  if (!t) return sigma_make_nil();
+  int c = sigma_table_find(t, column, "filter");
+  if (c < 0) return sigma_make_nil();
+  int cmp = sigma_cmp_op(op);
+  if (cmp < 0) {
+    sigma_error("filter() compares with ==, !=, <, <=, > or >=, not %s", sigma_to_str(op).as.string);
+    return sigma_make_nil();
+  }
+  const SigmaColumn* col = &t->columns[c];
+  if ((col->kind == SIGMA_COL_STR) != (value.type == TYPE_STRING) || (col->kind != SIGMA_COL_STR && !sigma_is_number(value))) {
+    sigma_error("filter(): cannot compare the %s column %s with %s", col->kind == SIGMA_COL_STR ? "string" : "number",
+                col->name, sigma_a_type(value));
+    return sigma_make_nil();
+  }
+  int64_t rows = t->rows, n;
+  int64_t* sel = malloc(sizeof(int64_t) * (rows + 1));
+  if (col->kind == SIGMA_COL_I64 && value.type == TYPE_INT) {
+    n = sigma_select_i64(col->data, rows, cmp, value.as.integer, sel);
+  } else if (col->kind == SIGMA_COL_I64) {
+    n = sigma_select_i64_f64(col->data, rows, cmp, value.as.number, sel);
+  } else if (col->kind == SIGMA_COL_F64) {
+    n = sigma_select_f64(col->data, rows, cmp, sigma_num(value), sel);
+  } else {
+    const SigmaStringPool* pool = col->pool;
+    const SigmaString* v = sigma_str_header(value.as.string);
+    uint8_t* keep = malloc(pool->size + 1);
+    for (uint32_t code = 0; code < pool->size; code++) {
+      int d = sigma_compare_strings(sigma_str_header(pool->strings[code]), v);
+      int results[] = {d == 0, d != 0, d < 0, d <= 0, d > 0, d >= 0};
+      keep[code] = (uint8_t)results[cmp];
+    }
+    n = sigma_select_codes(col->data, rows, keep, sel);
+    free(keep);
+  }
+  SigmaTable* out = n == rows ? sigma_table_share(t) : sigma_table_gather(t, sel, n);
+  free(sel);
+  return sigma_table_value(out);
+}
+
+// The columns named, sharing their data.
+SigmaValue sigma_table_select(SigmaValue tv, SigmaValue columns) {
+  SigmaTable* t = sigma_table_of(tv, "select", 0);
+  if (!t) return sigma_make_nil();
+  int* at;
+  int n = sigma_table_find_all(t, columns, "select", &at);
+  if (n < 0) return sigma_make_nil();
+  SigmaTable* out = sigma_table_alloc(n, t->rows);
+  for (int i = 0; i < n; i++) out->columns[i] = t->columns[at[i]];
+  free(at);
+  return sigma_table_value(out);
+}
+
+// The order of n uint64 keys, stably: a least-significant-digit radix sort
+// a byte at a time, which skips the bytes that every key has in common
+// (all but the low two or three, for most columns). The keys are used up.
+static int64_t* sigma_radix_order(uint64_t* keys, int64_t n) {
+  int64_t* order = malloc(sizeof(int64_t) * (n > 0 ? n : 1));
+  int64_t* order2 = malloc(sizeof(int64_t) * (n > 0 ? n : 1));
+  uint64_t* scratch = malloc(sizeof(uint64_t) * (n > 0 ? n : 1));
+  uint64_t* keys2 = scratch;
+  int64_t (*counts)[256] = calloc(8, sizeof(*counts));
+  for (int64_t i = 0; i < n; i++) {
+    uint64_t k = keys[i];
+    for (int b = 0; b < 8; b++) counts[b][(k >> (8 * b)) & 255]++;
+    order[i] = i;
+  }
+  for (int b = 0; b < 8 && n > 0; b++) {
+    int shift = 8 * b;
+    if (counts[b][(keys[0] >> shift) & 255] == n) continue;
+    int64_t at = 0;
+    for (int d = 0; d < 256; d++) {
+      int64_t count = counts[b][d];
+      counts[b][d] = at;
+      at += count;
+    }
+    for (int64_t i = 0; i < n; i++) {
+      uint64_t k = keys[i];
+      int64_t to = counts[b][(k >> shift) & 255]++;
+      keys2[to] = k;
+      order2[to] = order[i];
+    }
+    uint64_t* k = keys;
+    keys = keys2;
+    keys2 = k;
+    int64_t* o = order;
+    order = order2;
+    order2 = o;
+  }
+  free(order2);
+  free(scratch);
+  free(counts);
+  return order;
+}
+
+typedef struct {
+  const SigmaString* str;
+  uint32_t code;
+} SigmaPoolEntry;
+
+static int sigma_pool_entry_order(const void* a, const void* b) {
+  return sigma_compare_strings(((const SigmaPoolEntry*)a)->str, ((const SigmaPoolEntry*)b)->str);
+}
+
+// Each pool string's place in sorted order, by code: the pool is sorted
+// once and the rows are then ordered by those ranks.
+static uint32_t* sigma_pool_ranks(const SigmaStringPool* pool) {
+  SigmaPoolEntry* entries = malloc(sizeof(SigmaPoolEntry) * (pool->size + 1));
+  for (uint32_t c = 0; c < pool->size; c++) entries[c] = (SigmaPoolEntry){sigma_str_header(pool->strings[c]), c};
+  qsort(entries, pool->size, sizeof(SigmaPoolEntry), sigma_pool_entry_order);
+  uint32_t* ranks = malloc(sizeof(uint32_t) * (pool->size + 1));
+  for (uint32_t r = 0; r < pool->size; r++) ranks[entries[r].code] = r;
+  free(entries);
+  return ranks;
+}
+
+// Rows in order of one column, keeping the order of equal rows. Each value
+// is mapped to a uint64 key that orders the same way (decs by their bits,
+// with nan last either way), and every column is then gathered in that
+// order.
+SigmaValue sigma_table_sort_by_order(SigmaValue tv, SigmaValue column, SigmaValue order) {
+  SigmaTable* t = sigma_table_of(tv, "sort_by", 0);
+  if (!t) return sigma_make_nil();
+  int c = sigma_table_find(t, column, "sort_by");
+  if (c < 0) return sigma_make_nil();
+  int descending = 0;
+  if (order.type != TYPE_NIL) {
+    if (order.type != TYPE_STRING || (strcmp(order.as.string, "asc") != 0 && strcmp(order.as.string, "desc") != 0)) {
+      sigma_error("sort_by() takes \"asc\" or \"desc\", not %s", sigma_to_str(order).as.string);
+      return sigma_make_nil();
+    }
+    descending = strcmp(order.as.string, "desc") == 0;
+  }
+  const SigmaColumn* col = &t->columns[c];
+  int64_t rows = t->rows;
+  uint64_t flip = descending ? UINT64_MAX : 0;
+  uint64_t* keys = malloc(sizeof(uint64_t) * (rows > 0 ? rows : 1));
+  if (col->kind == SIGMA_COL_I64) {
+    const int64_t* x = col->data;
+    for (int64_t i = 0; i < rows; i++) keys[i] = ((uint64_t)x[i] ^ (1ULL << 63)) ^ flip;
+  } else if (col->kind == SIGMA_COL_F64) {
+    const uint64_t* x = col->data;
+    for (int64_t i = 0; i < rows; i++) {
+      uint64_t bits = x[i];
+      uint64_t key = bits >> 63 ? ~bits : bits | (1ULL << 63);
+      keys[i] = (bits << 1) > (0x7ffULL << 53) ? UINT64_MAX : key ^ flip;
+    }
+  } else {
+    uint32_t* ranks = sigma_pool_ranks(col->pool);
+    const uint32_t* x = col->data;
+    for (int64_t i = 0; i < rows; i++) keys[i] = ranks[x[i]] ^ flip;
+    free(ranks);
+  }
+  int64_t* at = sigma_radix_order(keys, rows);
+  free(keys);
+  SigmaTable* out = sigma_table_gather(t, at, rows);
+  free(at);
+  return sigma_table_value(out);
+}
+
+SigmaValue sigma_table_sort_by(SigmaValue t, SigmaValue column) {
+  return sigma_table_sort_by_order(t, column, sigma_make_nil());
+}
+
+// --- tables: group_by and aggregates ---
+
+// What group_by returns: the table's columns, with each row's group.
+// Groups are numbered in order of first appearance.
+struct SigmaGroups {
+  uint32_t* ids;        // each row's group
+  int64_t* first;       // each group's first row
+  int64_t count;
+  int* keys;            // the key columns
+  int nkeys;
+};
+
+// Numbers the distinct keys[i] in order of first appearance, into ids[i],
+// with an open-addressing table; returns how many there are.
+static int64_t sigma_dense_ids(const uint64_t* keys, int64_t n, uint32_t* ids) {
+  int bits = 10;
+  size_t mask = ((size_t)1 << bits) - 1;
+  uint64_t* slot_keys = malloc(sizeof(uint64_t) * (mask + 1));
+  uint32_t* slot_ids = calloc(mask + 1, sizeof(uint32_t));     // id + 1, or 0 when empty
+  int64_t count = 0;
+  for (int64_t i = 0; i < n; i++) {
+    uint64_t k = keys[i];
+    size_t s = (k * 0x9e3779b97f4a7c15ULL) >> (64 - bits);
+    while (slot_ids[s] && slot_keys[s] != k) s = (s + 1) & mask;
+    if (slot_ids[s]) {
+      ids[i] = slot_ids[s] - 1;
+      continue;
+    }
+    slot_keys[s] = k;
+    slot_ids[s] = (uint32_t)++count;
+    ids[i] = (uint32_t)(count - 1);
+    if ((size_t)count * 2 > mask) {
+      bits++;
+      size_t old_mask = mask;
+      uint64_t* old_keys = slot_keys;
+      uint32_t* old_ids = slot_ids;
+      mask = ((size_t)1 << bits) - 1;
+      slot_keys = malloc(sizeof(uint64_t) * (mask + 1));
+      slot_ids = calloc(mask + 1, sizeof(uint32_t));
+      for (size_t j = 0; j <= old_mask; j++) {
+        if (!old_ids[j]) continue;
+        size_t t = (old_keys[j] * 0x9e3779b97f4a7c15ULL) >> (64 - bits);
+        while (slot_ids[t]) t = (t + 1) & mask;
+        slot_keys[t] = old_keys[j];
+        slot_ids[t] = old_ids[j];
+      }
+      free(old_keys);
+      free(old_ids);
+    }
+  }
+  free(slot_keys);
+  free(slot_ids);
+  return count;
+}
+
+// The group of each row by one column alone. A string column already
+// numbers its values, so its codes only need renumbering; numbers are
+// hashed, decs by their bits once -0 and nan are made one value each.
+static int64_t sigma_column_ids(const SigmaColumn* col, int64_t rows, uint32_t* ids) {
+  if (col->kind == SIGMA_COL_STR) {
+    const uint32_t* x = col->data;
+    uint32_t* renumber = malloc(sizeof(uint32_t) * (col->pool->size + 1));
+    memset(renumber, 0xff, sizeof(uint32_t) * (col->pool->size + 1));
+    uint32_t count = 0;
+    for (int64_t i = 0; i < rows; i++) {
+      uint32_t code = x[i];
+      if (renumber[code] == UINT32_MAX) renumber[code] = count++;
+      ids[i] = renumber[code];
+    }
+    free(renumber);
+    return count;
+  }
+  uint64_t* keys = malloc(sizeof(uint64_t) * (rows > 0 ? rows : 1));
+  memcpy(keys, col->data, sizeof(uint64_t) * rows);
+  if (col->kind == SIGMA_COL_F64) {
+    for (int64_t i = 0; i < rows; i++) {
+      double x = ((const double*)col->data)[i];
+      if (x == 0) keys[i] = 0;
+      else if (x != x) keys[i] = 0x7ff8000000000000ULL;
+    }
+  }
+  int64_t count = sigma_dense_ids(keys, rows, ids);
+  free(keys);
+  return count;
+}
+
+// With several keys, the groups of the keys so far and of the next key are
+// numbered again as pairs.
+SigmaValue sigma_table_group_by(SigmaValue tv, SigmaValue keys) {
+  SigmaTable* t = sigma_table_of(tv, "group_by", 0);
+  if (!t) return sigma_make_nil();
+  int* at;
+  int nkeys = sigma_table_find_all(t, keys, "group_by", &at);
+  if (nkeys < 0) return sigma_make_nil();
+  if (nkeys == 0 || t->rows > UINT32_MAX) {
+    free(at);
+    if (nkeys == 0) sigma_error("group_by() needs at least one column");
+    else sigma_error("group_by(): tables of more than %" PRIu32 " rows are not supported", UINT32_MAX);
+    return sigma_make_nil();
+  }
+  int64_t rows = t->rows;
+  uint32_t* ids = malloc(sizeof(uint32_t) * (rows > 0 ? rows : 1));
+  int64_t count = sigma_column_ids(&t->columns[at[0]], rows, ids);
+  if (nkeys > 1) {
+    uint32_t* next = malloc(sizeof(uint32_t) * (rows > 0 ? rows : 1));
+    uint64_t* pairs = malloc(sizeof(uint64_t) * (rows > 0 ? rows : 1));
+    for (int k = 1; k < nkeys; k++) {
+      int64_t n = sigma_column_ids(&t->columns[at[k]], rows, next);
+      for (int64_t i = 0; i < rows; i++) pairs[i] = (uint64_t)ids[i] * (uint64_t)n + next[i];
+      count = sigma_dense_ids(pairs, rows, ids);
+    }
+    free(next);
+    free(pairs);
+  }
+  SigmaGroups* g = malloc(sizeof(SigmaGroups));
+  g->ids = ids;
+  g->count = count;
+  g->first = malloc(sizeof(int64_t) * (count > 0 ? count : 1));
+  for (int64_t i = 0, next = 0; i < rows && next < count; i++) {
+    if (ids[i] == next) g->first[next++] = i;
+  }
+  g->keys = at;
+  g->nkeys = nkeys;
+  SigmaTable* out = sigma_table_share(t);
+  out->groups = g;
+  return sigma_table_value(out);
+}
+
+// The result of an aggregate of a group_by: the key columns, one row per
+// group, then the aggregate in a new column `name` of `kind`.
+static SigmaTable* sigma_group_table(const SigmaTable* t, const char* name, SigmaColumnKind kind, void* data) {
+  const SigmaGroups* g = t->groups;
+  SigmaTable* out = sigma_table_alloc(g->nkeys + 1, g->count);
+  for (int k = 0; k < g->nkeys; k++) out->columns[k] = sigma_column_gather(&t->columns[g->keys[k]], g->first, g->count);
+  out->columns[g->nkeys] = (SigmaColumn){(char*)name, kind, data, NULL};
+  return out;
+}
+
+// The number column an aggregate reads, or NULL after raising.
+static const SigmaColumn* sigma_number_column(const SigmaTable* t, SigmaValue name, const char* method) {
+  int c = sigma_table_find(t, name, method);
+  if (c < 0) return NULL;
+  if (t->columns[c].kind == SIGMA_COL_STR) {
+    sigma_error("%s(): column %s holds strings, not numbers", method, t->columns[c].name);
+    return NULL;
+  }
+  return &t->columns[c];
+}
+
+// Sums of an int column into sums[group] (group 0 for all rows when ids is
+// NULL). False if one of them does not fit in 64 bits.
+static int sigma_sum_i64(const int64_t* x, int64_t rows, const uint32_t* ids, int64_t* sums) {
+  int overflow = 0;
+  if (!ids) {
+    int64_t s = 0;
+    for (int64_t i = 0; i < rows; i++) overflow |= __builtin_add_overflow(s, x[i], &s);
+    sums[0] = s;
+  } else {
+    for (int64_t i = 0; i < rows; i++) overflow |= __builtin_add_overflow(sums[ids[i]], x[i], &sums[ids[i]]);
+  }
+  return !overflow;
+}
+
+// Sums of a column as decs, skipping nan, and how many values each has
+// when counts is not NULL.
+static void sigma_sum_f64(const SigmaColumn* col, int64_t rows, const uint32_t* ids, double* sums, int64_t* counts) {
+  if (col->kind == SIGMA_COL_I64) {
+    const int64_t* x = col->data;
+    if (!ids) {
+      double s = 0;
+      for (int64_t i = 0; i < rows; i++) s += (double)x[i];
+      sums[0] = s;
+      if (counts) counts[0] = rows;
+      return;
+    }
+    for (int64_t i = 0; i < rows; i++) sums[ids[i]] += (double)x[i];
+    if (counts) {
+      for (int64_t i = 0; i < rows; i++) counts[ids[i]]++;
+    }
+    return;
+  }
+  const double* x = col->data;
+  if (!ids) {
+    double s = 0;
+    int64_t n = 0;
+    for (int64_t i = 0; i < rows; i++) {
+      int present = x[i] == x[i];
+      s += present ? x[i] : 0;
+      n += present;
+    }
+    sums[0] = s;
+    if (counts) counts[0] = n;
+    return;
+  }
+  for (int64_t i = 0; i < rows; i++) {
+    int present = x[i] == x[i];
+    sums[ids[i]] += present ? x[i] : 0;
+    if (counts) counts[ids[i]] += present;
+  }
+}
+
+// An int column sums to an int unless that overflows, as + does.
+SigmaValue sigma_table_sum(SigmaValue tv, SigmaValue column) {
+  SigmaTable* t = sigma_table_of(tv, "sum", 1);
+  if (!t) return sigma_make_nil();
+  const SigmaColumn* col = sigma_number_column(t, column, "sum");
+  if (!col) return sigma_make_nil();
+  const SigmaGroups* g = t->groups;
+  int64_t n = g ? g->count : 1;
+  void* sums = calloc(n > 0 ? n : 1, sizeof(int64_t));
+  SigmaColumnKind kind = SIGMA_COL_F64;
+  if (col->kind == SIGMA_COL_I64 && sigma_sum_i64(col->data, t->rows, g ? g->ids : NULL, sums)) {
+    kind = SIGMA_COL_I64;
+  } else {
+    memset(sums, 0, sizeof(double) * n);
+    sigma_sum_f64(col, t->rows, g ? g->ids : NULL, sums, NULL);
+  }
+  if (g) return sigma_table_value(sigma_group_table(t, col->name, kind, sums));
+  SigmaValue v = kind == SIGMA_COL_I64 ? sigma_make_int(*(int64_t*)sums) : sigma_make_number(*(double*)sums);
+  free(sums);
+  return v;
+}
+
+// Of the values that are not nan; nan for none.
+SigmaValue sigma_table_mean(SigmaValue tv, SigmaValue column) {
+  SigmaTable* t = sigma_table_of(tv, "mean", 1);
+  if (!t) return sigma_make_nil();
+  const SigmaColumn* col = sigma_number_column(t, column, "mean");
+  if (!col) return sigma_make_nil();
+  const SigmaGroups* g = t->groups;
+  int64_t n = g ? g->count : 1;
+  double* sums = calloc(n > 0 ? n : 1, sizeof(double));
+  int64_t* counts = calloc(n > 0 ? n : 1, sizeof(int64_t));
+  sigma_sum_f64(col, t->rows, g ? g->ids : NULL, sums, counts);
+  for (int64_t i = 0; i < n; i++) sums[i] = counts[i] ? sums[i] / (double)counts[i] : NAN;
+  free(counts);
+  if (g) return sigma_table_value(sigma_group_table(t, col->name, SIGMA_COL_F64, sums));
+  SigmaValue v = sigma_make_number(sums[0]);
+  free(sums);
+  return v;
+}
+
+// Rows, or rows per group in a column called "count".
+SigmaValue sigma_table_count(SigmaValue tv) {
+  SigmaTable* t = sigma_table_of(tv, "count", 1);
+  if (!t) return sigma_make_nil();
+  const SigmaGroups* g = t->groups;
+  if (!g) return sigma_make_int(t->rows);
+  int64_t* counts = calloc(g->count > 0 ? g->count : 1, sizeof(int64_t));
+  for (int64_t i = 0; i < t->rows; i++) counts[g->ids[i]]++;
+  return sigma_table_value(sigma_group_table(t, sigma_make_string("count").as.string, SIGMA_COL_I64, counts));
+}
+
+// A column as a new i64 or f64 array, or an array of strings.
+SigmaValue sigma_table_column(SigmaValue tv, SigmaValue name) {
+  SigmaTable* t = sigma_table_of(tv, "column", 0);
+  if (!t) return sigma_make_nil();
+  int c = sigma_table_find(t, name, "column");
+  if (c < 0) return sigma_make_nil();
+  const SigmaColumn* col = &t->columns[c];
+  int64_t rows = t->rows;
+  if (col->kind != SIGMA_COL_STR) {
+    SigmaTypedArray* a = malloc(sizeof(SigmaTypedArray));
+    a->data = malloc(sizeof(int64_t) * (rows > 0 ? rows : 1));
+    memcpy(a->data, col->data, sizeof(int64_t) * rows);
+    a->size = rows;
+    a->kind = col->kind == SIGMA_COL_F64 ? SIGMA_F64 : SIGMA_I64;
+    SigmaValue v; v.type = TYPE_TYPED; v.as.typed = a; return v;
+  }
+  if (rows > INT32_MAX) {
+    sigma_error("column(): %s has too many rows for an array of strings", col->name);
+    return sigma_make_nil();
+  }
+  SigmaValue* boxes;
+  SigmaValue arr = sigma_alloc_array((int)rows, &boxes);
+  const uint32_t* codes = col->data;
+  for (int64_t i = 0; i < rows; i++) {
+    boxes[i].type = TYPE_STRING;
+    boxes[i].as.string = col->pool->strings[codes[i]];
+  }
+  return arr;
+}
+
+SigmaValue sigma_table_columns(SigmaValue tv) {
+  SigmaTable* t = sigma_table_of(tv, "columns", 1);
+  if (!t) return sigma_make_nil();
+  SigmaValue* boxes;
+  SigmaValue arr = sigma_alloc_array(t->ncols, &boxes);
+  for (int c = 0; c < t->ncols; c++) {
+    boxes[c].type = TYPE_STRING;
+    boxes[c].as.string = t->columns[c].name;
+  }
+  return arr;
+}
+
+// --- tables: printing ---
+
+#define SIGMA_TABLE_PRINT_ROWS 10
+
+// A cell as text: decs with two decimals, like yap, and nan (a missing
+// value) as nothing.
+static const char* sigma_table_cell(const SigmaColumn* c, int64_t row, char* buf) {
+  switch (c->kind) {
+    case SIGMA_COL_I64:
+      buf[sigma_format_i64(((const int64_t*)c->data)[row], buf)] = '\0';
+      return buf;
+    case SIGMA_COL_F64: {
+      double x = ((const double*)c->data)[row];
+      if (x != x) buf[0] = '\0';
+      else snprintf(buf, 64, "%.2f", x);
+      return buf;
+    }
+    default:
+      return c->pool->strings[((const uint32_t*)c->data)[row]];
+  }
+}
+
+static void sigma_table_print_cell(const char* text, int width, int left, int last) {
+  if (left && last) printf("%s", text);       // no trailing spaces
+  else printf(left ? "%-*s" : "%*s", width, text);
+  printf(last ? "\n" : "  ");
+}
+
+// The first rows, in aligned columns under their names: numbers to the
+// right, strings to the left.
+static void sigma_table_print(const SigmaTable* t) {
+  if (t->groups) {
+    printf("<table grouped by");
+    for (int k = 0; k < t->groups->nkeys; k++) printf("%s %s", k ? "," : "", t->columns[t->groups->keys[k]].name);
+    printf(": %" PRId64 " groups>\n", t->groups->count);
+    return;
+  }
+  int64_t shown = t->rows < SIGMA_TABLE_PRINT_ROWS ? t->rows : SIGMA_TABLE_PRINT_ROWS;
+  int* widths = malloc(sizeof(int) * (t->ncols > 0 ? t->ncols : 1));
+  char buf[64];
+  for (int c = 0; c < t->ncols; c++) {
+    widths[c] = (int)sigma_str_len(t->columns[c].name);
+    for (int64_t r = 0; r < shown; r++) {
+      int w = (int)strlen(sigma_table_cell(&t->columns[c], r, buf));
+      if (w > widths[c]) widths[c] = w;
+    }
+  }
+  for (int c = 0; c < t->ncols; c++) {
+    sigma_table_print_cell(t->columns[c].name, widths[c], t->columns[c].kind == SIGMA_COL_STR, c + 1 == t->ncols);
+  }
+  for (int64_t r = 0; r < shown; r++) {
+    for (int c = 0; c < t->ncols; c++) {
+      sigma_table_print_cell(sigma_table_cell(&t->columns[c], r, buf), widths[c], t->columns[c].kind == SIGMA_COL_STR,
+                             c + 1 == t->ncols);
+    }
+  }
+  if (t->rows > shown) printf("... %" PRId64 " more rows\n", t->rows - shown);
+  free(widths);
+}
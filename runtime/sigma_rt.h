@@ -0,0 +1,726 @@
+// Sigma runtime: value representation and the functions generated code calls.
+//
+// sig embeds this header and sigma_rt.c into its own binary, writes them next
+// to the generated C, and compiles sigma_rt.c once into a cached object that
+// every program links against. Small, hot helpers are defined static inline
+// here so they still inline into each module's translation unit.
+#ifndef SIGMA_RT_H
+#define SIGMA_RT_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// sig watch compiles generated code at -O0, where each unit would get its
+// own copy of every helper below that it calls. With SIGMA_OUTLINE they are
+// only declared, and one unit defining SIGMA_OUTLINE_DEFINITIONS holds them.
+#if defined(SIGMA_OUTLINE_DEFINITIONS)
+#define SIGMA_INLINE
+#elif defined(SIGMA_OUTLINE)
+#define SIGMA_INLINE extern inline __attribute__((gnu_inline))
+#else
+#define SIGMA_INLINE static inline
+#endif
+
+// Numbers are either exact 64-bit integers (TYPE_INT, Sigma's "int") or
+// doubles (TYPE_NUMBER, "dec"). Integer arithmetic stays exact and is
+// promoted to a double only when the result does not fit in 64 bits.
+typedef enum {
+  TYPE_NIL,
+  TYPE_NUMBER,
+  TYPE_INT,
+  TYPE_STRING,
+  TYPE_BOOL,
+  TYPE_ARRAY,
+  TYPE_OBJECT,
+  TYPE_DICT,
+  TYPE_TYPED,
+  TYPE_CHAN,
+  TYPE_TABLE
+} SigmaType;
+
+// Set on arrays and objects whose buffers live in a C stack frame (literals
+// that escape analysis proved never outlive it). They are copied to the heap
+// before they are ever grown.
+#define SIGMA_STACK_STORAGE 1
+// Set on arrays and objects the compiler built from a top-level $fixed
+// literal: the header is static data, and its buffers and element boxes are
+// read-only. The first write copies them to the heap (sigma_array_unshare).
+#define SIGMA_STATIC_STORAGE 2
+
+typedef struct {
+  void** items;
+  int size;
+  int capacity;
+  int flags;
+} SigmaArray;
+
+typedef struct {
+  char** keys;
+  void** values;
+  int size;
+  int capacity;
+  int flags;
+} SigmaObject;
+
+typedef struct SigmaDict SigmaDict;
+typedef struct SigmaChan SigmaChan;
+typedef struct SigmaTable SigmaTable;
+
+// Typed arrays (f64_array(n), i64_array(n), bytes(n)) hold numbers of one
+// kind as a flat C array: 8 bytes an element, or 1 for bytes, where an
+// array element is a pointer to a 16-byte box. Their length is fixed when
+// they are made.
+typedef enum { SIGMA_F64, SIGMA_I64, SIGMA_U8 } SigmaElemKind;
+
+typedef struct {
+  void* data;
+  int64_t size;
+  SigmaElemKind kind;
+} SigmaTypedArray;
+
+// Strings are immutable. A string value points at its NUL-terminated
+// characters, which are preceded by this header: the length and hash are
+// computed once, when the string is made. Interned strings are unique per
+// content, so two of them are equal exactly when their pointers are.
+#define SIGMA_INTERNED 1
+
+typedef struct {
+  uint64_t hash;
+  size_t len;
+  int flags;
+  char chars[];
+} SigmaString;
+
+// A string and its header as static data, laid out as a SigmaString, for
+// $fixed literals. `hash` must be what sigma_hash_bytes gives for `text`.
+#define SIGMA_STATIC_STRING(name, hash_, len_, text) \
+  static const struct { uint64_t hash; size_t len; int flags; char chars[(len_) + 1]; } name = {hash_, len_, 0, text}
+
+typedef struct SigmaValue {
+  SigmaType type;
+  union {
+    double number;
+    int64_t integer;
+    char* string;
+    int boolean;
+    SigmaArray* array;
+    SigmaObject* object;
+    SigmaDict* dict;
+    SigmaTypedArray* typed;
+    SigmaChan* chan;
+    SigmaTable* table;
+  } as;
+} SigmaValue;
+
+// libsigma hands values to and from compiled libraries as they are, so this
+// layout and the SigmaType numbering are mirrored by sigma_value in sigma.h
+// and must not change.
+_Static_assert(sizeof(SigmaValue) == 16 && offsetof(SigmaValue, as) == 8, "SigmaValue is part of the libsigma ABI");
+
+// Dictionaries (dict()) are Swiss tables keyed by strings and numbers.
+// `entries` holds the keys and values in insertion order, which is the
+// order they are iterated in. The index is a power of two of groups of 16
+// slots, each slot an entry number with a control byte: the low 7 bits of
+// its key's hash, or SIGMA_DICT_EMPTY. A lookup compares a group's 16
+// control bytes at once and only looks at the entries whose 7 bits match;
+// the control bytes sit next to the group's entry numbers, so that a probe
+// touches one place in the index.
+#define SIGMA_DICT_EMPTY 0x80
+#define SIGMA_DICT_GROUP 16
+
+typedef struct {
+  SigmaValue key;
+  SigmaValue value;
+} SigmaDictEntry;
+
+typedef struct {
+  uint8_t ctrl[SIGMA_DICT_GROUP];
+  uint32_t slots[SIGMA_DICT_GROUP];
+} SigmaDictGroup;
+
+// A dict opened with mmap_dict reads a file written by save instead: its
+// groups are the file's, laid out as above, `entries` is NULL and `image`
+// is the start of the file. Such a dict cannot be changed.
+struct SigmaDict {
+  SigmaDictGroup* groups;
+  SigmaDictEntry* entries;
+  size_t mask;      // groups - 1
+  int size;
+  int capacity;     // of entries
+  const char* image;
+};
+
+// Tables (read_csv(path), table(columns)) store their rows column by
+// column: a column is a flat C array of int64_t or double, or of uint32_t
+// codes into a pool of the column's distinct strings. Tables are never
+// changed once made, so the tables derived from one (by filter, select,
+// sort_by, group_by) share whatever columns and pools they can with it.
+typedef enum { SIGMA_COL_I64, SIGMA_COL_F64, SIGMA_COL_STR } SigmaColumnKind;
+
+typedef struct SigmaStringPool SigmaStringPool;
+typedef struct SigmaGroups SigmaGroups;
+
+typedef struct {
+  char* name;
+  SigmaColumnKind kind;
+  void* data;
+  SigmaStringPool* pool;  // SIGMA_COL_STR
+} SigmaColumn;
+
+struct SigmaTable {
+  SigmaColumn* columns;
+  int ncols;
+  int64_t rows;
+  SigmaGroups* groups;    // set on what group_by returns
+};
+
+// Values
+SigmaValue sigma_make_string(const char* s);
+SigmaValue sigma_make_string_n(const char* s, size_t len);
+SigmaValue sigma_intern(const char* s);
+SigmaValue sigma_make_literal(const char* literal);
+void sigma_print(SigmaValue v);
+SigmaValue sigma_input(const char* prompt);
+
+// Builtins
+SigmaValue sigma_type_of(SigmaValue v);
+SigmaValue sigma_to_int(SigmaValue v);
+SigmaValue sigma_to_dec(SigmaValue v);
+SigmaValue sigma_to_str(SigmaValue v);
+SigmaValue sigma_random(SigmaValue digits);
+SigmaValue sigma_seed(SigmaValue n);
+SigmaValue sigma_random_array(SigmaValue n, SigmaValue lo, SigmaValue hi);
+
+// String methods. find gives the index of the first occurrence or -1, and
+// count the number of occurrences that do not overlap. split() without a
+// separator splits at runs of whitespace. upper and lower change ASCII
+// letters only. A result equal to the string may be the string itself.
+SigmaValue sigma_str_split(SigmaValue s, SigmaValue sep);
+SigmaValue sigma_str_split_space(SigmaValue s);
+SigmaValue sigma_str_find(SigmaValue s, SigmaValue sub);
+SigmaValue sigma_str_count(SigmaValue s, SigmaValue sub);
+SigmaValue sigma_str_replace(SigmaValue s, SigmaValue old, SigmaValue with);
+SigmaValue sigma_str_trim(SigmaValue s);
+SigmaValue sigma_str_upper(SigmaValue s);
+SigmaValue sigma_str_lower(SigmaValue s);
+
+// Arrays
+SigmaValue sigma_make_array();
+SigmaValue sigma_make_array_of(int n, const SigmaValue* vals);
+SigmaValue sigma_array_push(SigmaValue arr, SigmaValue val);
+SigmaValue sigma_array_get(SigmaValue arr, SigmaValue idx);
+void sigma_array_set(SigmaValue arr, SigmaValue idx, SigmaValue val);
+SigmaValue sigma_array_sort(SigmaValue arr, SigmaValue order);
+
+// Objects
+SigmaValue sigma_make_object();
+SigmaValue sigma_make_object_of(int n, const char* const* keys, const SigmaValue* vals);
+void sigma_object_set(SigmaValue obj, const char* key, SigmaValue val);
+
+// Dictionaries. Indexing a dict with a missing key gives nil.
+SigmaValue sigma_make_dict(void);
+SigmaValue sigma_make_dict_sized(SigmaValue capacity);
+SigmaValue sigma_dict_get(SigmaValue dict, SigmaValue key);
+void sigma_dict_set(SigmaValue dict, SigmaValue key, SigmaValue val);
+SigmaValue sigma_dict_has(SigmaValue dict, SigmaValue key);
+SigmaValue sigma_dict_keys(SigmaValue dict);
+SigmaValue sigma_dict_values(SigmaValue dict);
+SigmaValue sigma_index_increment(SigmaValue c, SigmaValue idx);     // c[idx]++
+
+// Typed arrays, made from a length (every element 0) or from an array to
+// convert. sigma_array_get, sigma_array_set and sigma_array_sort take them
+// too.
+SigmaValue sigma_make_f64_array(SigmaValue n);
+SigmaValue sigma_make_i64_array(SigmaValue n);
+SigmaValue sigma_make_bytes(SigmaValue n);
+// mmap_array(path, kind): a file of raw f64s, i64s or bytes as a typed
+// array, mapped copy-on-write; with "shared", stores go to the file.
+// mmap_dict(path): a dict saved with save(path), opened as it lies on disk.
+SigmaValue sigma_mmap_array(SigmaValue path, SigmaValue kind);
+SigmaValue sigma_mmap_array_mode(SigmaValue path, SigmaValue kind, SigmaValue mode);
+SigmaValue sigma_mmap_dict(SigmaValue path);
+SigmaValue sigma_save(SigmaValue v, SigmaValue path);   // v.save(path), for typed arrays and dicts
+void sigma_typed_index_error(SigmaValue arr, int64_t i) __attribute__((cold));
+void sigma_byte_error(int64_t v) __attribute__((cold));
+
+// $for x $in c: raises unless c is an array, typed array, dict or string.
+// Items are then read by position with sigma_iter_at.
+SigmaValue sigma_iter_check(SigmaValue c);
+SigmaValue sigma_iter_at_slow(SigmaValue c, int64_t i);
+SigmaValue sigma_read_lines(SigmaValue path);       // lines(path)
+
+// JSON. json_parse gives objects, arrays, strings, bools and nil, ints for
+// whole numbers that fit in 64 bits and decs for other numbers; a key that
+// appears twice in an object keeps its last value. json_stringify writes
+// compact JSON, decs always with a '.' or an exponent, dicts as objects.
+SigmaValue sigma_json_parse(SigmaValue text);
+SigmaValue sigma_json_stringify(SigmaValue v);
+
+// Tables. A CSV file is read a chunk at a time; its first line names the
+// columns, and a column holds ints, decs or strings depending on what its
+// fields turn out to be. filter(column, op, value) keeps the rows where the
+// comparison holds, for op one of == != < <= > >=. group_by(keys) takes a
+// column name or an array of them, and sum, count and mean then give one
+// row per group (in order of first appearance); on a table they give a
+// number.
+SigmaValue sigma_read_csv(SigmaValue path);         // read_csv(path)
+SigmaValue sigma_make_table(SigmaValue columns);    // table({name:: [values], ...})
+SigmaValue sigma_table_filter(SigmaValue t, SigmaValue column, SigmaValue op, SigmaValue value);
+SigmaValue sigma_table_select(SigmaValue t, SigmaValue columns);
+SigmaValue sigma_table_sort_by(SigmaValue t, SigmaValue column);
+SigmaValue sigma_table_sort_by_order(SigmaValue t, SigmaValue column, SigmaValue order);
+SigmaValue sigma_table_group_by(SigmaValue t, SigmaValue keys);
+SigmaValue sigma_table_sum(SigmaValue t, SigmaValue column);
+SigmaValue sigma_table_mean(SigmaValue t, SigmaValue column);
+SigmaValue sigma_table_count(SigmaValue t);
+SigmaValue sigma_table_column(SigmaValue t, SigmaValue name);
+SigmaValue sigma_table_columns(SigmaValue t);
+
+// Tasks and channels. $spawn f.run(args) runs the generic C function of f
+// as a task: a coroutine on a small stack of its own, scheduled over a pool
+// of worker threads. chan(n) is a channel with room for n values, chan()
+// one that hands each value straight from sender to receiver. send blocks
+// while the channel is full, recv while it is empty; both only suspend the
+// calling task, so the worker runs others meanwhile. recv on a closed,
+// empty channel gives nil. A task that fails reports its error and exits
+// the program, as main does.
+#define SIGMA_SPAWN_MAX 8
+void sigma_spawn(void* fn, int argc, const SigmaValue* args);
+SigmaValue sigma_make_chan(void);                   // chan()
+SigmaValue sigma_make_chan_sized(SigmaValue capacity);
+SigmaValue sigma_chan_send(SigmaValue chan, SigmaValue v);
+SigmaValue sigma_chan_recv(SigmaValue chan);
+SigmaValue sigma_chan_close(SigmaValue chan);
+// Whether $spawn has started the workers, which then live as long as the
+// process (libsigma does not unload such a library).
+int sigma_tasks_started(void);
+
+// Operators
+SigmaValue sigma_concat(SigmaValue a, SigmaValue b);
+SigmaValue sigma_equals(SigmaValue a, SigmaValue b);
+SigmaValue sigma_strict_equals(SigmaValue a, SigmaValue b);
+
+// Errors. A runtime function that fails stores an error object ({message,
+// line, file}) in this thread's error slot, sets sigma_failed and returns
+// nil. Generated code tests the flag after every call that can fail: inside
+// $try it jumps to the catch block; elsewhere the function returns and its
+// caller tests the flag in turn, up to main, which reports the error and
+// exits. Entering a $try costs nothing, and code that does not fail pays
+// one predicted branch per fallible call.
+//
+// The flag uses the initial-exec TLS model so that the test stays a single
+// %fs-relative load in libraries built with sig --shared too.
+extern _Thread_local int sigma_failed __attribute__((tls_model("initial-exec")));
+
+void sigma_error(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+SigmaValue sigma_error_raise(SigmaValue error);     // error(x)
+void sigma_error_locate(const char* file, int line);
+SigmaValue sigma_error_catch(void);
+void sigma_error_uncaught(void) __attribute__((noreturn));
+int sigma_error_report(char* buf, size_t size);
+
+// True if an error is pending. The first test after a failure records
+// where it happened.
+SIGMA_INLINE int sigma_check(const char* file, int line) {
+  if (__builtin_expect(sigma_failed, 0)) {
+    sigma_error_locate(file, line);
+    return 1;
+  }
+  return 0;
+}
+
+SIGMA_INLINE SigmaValue sigma_make_nil() {
+  SigmaValue v; v.type = TYPE_NIL; return v;
+}
+
+SIGMA_INLINE SigmaValue sigma_make_number(double n) {
+  SigmaValue v; v.type = TYPE_NUMBER; v.as.number = n; return v;
+}
+
+SIGMA_INLINE SigmaValue sigma_make_int(int64_t n) {
+  SigmaValue v; v.type = TYPE_INT; v.as.integer = n; return v;
+}
+
+SIGMA_INLINE SigmaValue sigma_make_bool(int b) {
+  SigmaValue v; v.type = TYPE_BOOL; v.as.boolean = b; return v;
+}
+
+SIGMA_INLINE int sigma_is_number(SigmaValue v) {
+  return v.type == TYPE_INT || v.type == TYPE_NUMBER;
+}
+
+// A number's value as a double; anything that is not a number counts as 0.
+SIGMA_INLINE double sigma_num(SigmaValue v) {
+  if (v.type == TYPE_INT) return (double)v.as.integer;
+  if (v.type == TYPE_NUMBER) return v.as.number;
+  return 0;
+}
+
+// $match on ints: whether v is a number with an integer value, which it
+// stores in *out.
+SIGMA_INLINE int sigma_match_int(SigmaValue v, int64_t* out) {
+  if (v.type == TYPE_INT) {
+    *out = v.as.integer;
+    return 1;
+  }
+  if (v.type != TYPE_NUMBER || !(v.as.number >= -0x1p63 && v.as.number < 0x1p63)) return 0;
+  *out = (int64_t)v.as.number;
+  return (double)*out == v.as.number;
+}
+
+SIGMA_INLINE SigmaString* sigma_str_header(const char* s) {
+  return (SigmaString*)(s - offsetof(SigmaString, chars));
+}
+
+SIGMA_INLINE size_t sigma_str_len(const char* s) {
+  return sigma_str_header(s)->len;
+}
+
+int sigma_str_equals_slow(const SigmaString* a, const SigmaString* b);
+
+// Pointers first, then length and hash; the characters are only compared
+// when those match and at most one side is interned.
+SIGMA_INLINE int sigma_str_equals(const char* a, const char* b) {
+  if (a == b) return 1;
+  const SigmaString* x = sigma_str_header(a);
+  const SigmaString* y = sigma_str_header(b);
+  if (x->hash != y->hash || x->len != y->len) return 0;
+  return sigma_str_equals_slow(x, y);
+}
+
+SIGMA_INLINE int sigma_is_truthy(SigmaValue v) {
+  switch (v.type) {
+    case TYPE_NIL: return 0;
+    case TYPE_BOOL: return v.as.boolean;
+    case TYPE_NUMBER: return v.as.number != 0;
+    case TYPE_INT: return v.as.integer != 0;
+    case TYPE_STRING: return sigma_str_len(v.as.string) > 0;
+    default: return 1;
+  }
+}
+
+// Random numbers: xoshiro256** (Blackman and Vigna), one state per thread.
+// A thread's state is seeded from the clock on its first draw, or from
+// seed(n), which makes the draws that follow on that thread reproducible.
+extern _Thread_local uint64_t sigma_rng[4];
+extern _Thread_local int sigma_rng_seeded;
+void sigma_rng_seed(uint64_t seed);
+void sigma_rng_seed_from_clock(void);
+
+SIGMA_INLINE uint64_t sigma_rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+SIGMA_INLINE uint64_t sigma_rng_next(void) {
+  if (__builtin_expect(!sigma_rng_seeded, 0)) sigma_rng_seed_from_clock();
+  uint64_t* s = sigma_rng;
+  uint64_t result = sigma_rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = sigma_rotl(s[3], 45);
+  return result;
+}
+
+// Uniform in [0, n) for n > 0, without modulo bias and almost always
+// without a division (Lemire, "Fast Random Integer Generation in an
+// Interval"): the high half of draw * n, redrawn in the rare case that the
+// low half falls in the biased sliver.
+SIGMA_INLINE uint64_t sigma_rng_below(uint64_t n) {
+  __uint128_t m = (__uint128_t)sigma_rng_next() * n;
+  if ((uint64_t)m < n) {
+    uint64_t threshold = -n % n;
+    while ((uint64_t)m < threshold) m = (__uint128_t)sigma_rng_next() * n;
+  }
+  return (uint64_t)(m >> 64);
+}
+
+// Uniform in [lo, hi], either way round.
+SIGMA_INLINE int64_t sigma_rng_range(int64_t lo, int64_t hi) {
+  if (lo > hi) {
+    int64_t t = lo;
+    lo = hi;
+    hi = t;
+  }
+  uint64_t span = (uint64_t)hi - (uint64_t)lo + 1;
+  if (span == 0) return (int64_t)sigma_rng_next();    // the whole int64 range
+  return (int64_t)((uint64_t)lo + sigma_rng_below(span));
+}
+
+// Uniform in [0, 1) with all 53 bits of the mantissa random.
+SIGMA_INLINE double sigma_rng_dec(void) {
+  return (double)(sigma_rng_next() >> 11) * 0x1.0p-53;
+}
+
+// Integer arguments of the random builtins: decs are truncated.
+SIGMA_INLINE int64_t sigma_int_arg(SigmaValue v) {
+  if (v.type == TYPE_INT) return v.as.integer;
+  double x = sigma_num(v);
+  if (x != x) return 0;
+  if (x <= -9223372036854775808.0) return INT64_MIN;
+  if (x >= 9223372036854775808.0) return INT64_MAX;
+  return (int64_t)x;
+}
+
+SIGMA_INLINE SigmaValue sigma_random_range(SigmaValue min, SigmaValue max) {
+  return sigma_make_int(sigma_rng_range(sigma_int_arg(min), sigma_int_arg(max)));
+}
+
+SIGMA_INLINE SigmaValue sigma_random_dec(void) {
+  return sigma_make_number(sigma_rng_dec());
+}
+
+// Integer operators, called directly when both operands are known to be
+// integers but the result might not fit.
+SIGMA_INLINE SigmaValue sigma_int_add(int64_t a, int64_t b) {
+  int64_t r;
+  if (__builtin_add_overflow(a, b, &r)) return sigma_make_number((double)a + (double)b);
+  return sigma_make_int(r);
+}
+
+SIGMA_INLINE SigmaValue sigma_int_subtract(int64_t a, int64_t b) {
+  int64_t r;
+  if (__builtin_sub_overflow(a, b, &r)) return sigma_make_number((double)a - (double)b);
+  return sigma_make_int(r);
+}
+
+SIGMA_INLINE SigmaValue sigma_int_multiply(int64_t a, int64_t b) {
+  int64_t r;
+  if (__builtin_mul_overflow(a, b, &r)) return sigma_make_number((double)a * (double)b);
+  return sigma_make_int(r);
+}
+
+// Exact quotients stay integers: 6 / 3 is 2, 7 / 2 is 3.5, and so is
+// anything divided by zero (inf or nan, as for decs).
+SIGMA_INLINE SigmaValue sigma_int_divide(int64_t a, int64_t b) {
+  if (b != 0 && !(a == INT64_MIN && b == -1) && a % b == 0) return sigma_make_int(a / b);
+  return sigma_make_number((double)a / (double)b);
+}
+
+// Truncating, like fmod: the result has the sign of `a`. x % 0 is nan.
+SIGMA_INLINE SigmaValue sigma_int_modulo(int64_t a, int64_t b) {
+  if (b == 0) return sigma_make_number(NAN);
+  if (b == -1) return sigma_make_int(0);
+  return sigma_make_int(a % b);
+}
+
+// Addition of two values known to be numbers (no string concatenation).
+SIGMA_INLINE SigmaValue sigma_num_add(SigmaValue a, SigmaValue b) {
+  if (a.type == TYPE_INT && b.type == TYPE_INT) return sigma_int_add(a.as.integer, b.as.integer);
+  return sigma_make_number(sigma_num(a) + sigma_num(b));
+}
+
+SIGMA_INLINE SigmaValue sigma_add(SigmaValue a, SigmaValue b) {
+  if (a.type == TYPE_STRING || b.type == TYPE_STRING) return sigma_concat(a, b);
+  return sigma_num_add(a, b);
+}
+
+SIGMA_INLINE SigmaValue sigma_subtract(SigmaValue a, SigmaValue b) {
+  if (a.type == TYPE_INT && b.type == TYPE_INT) return sigma_int_subtract(a.as.integer, b.as.integer);
+  return sigma_make_number(sigma_num(a) - sigma_num(b));
+}
+
+SIGMA_INLINE SigmaValue sigma_multiply(SigmaValue a, SigmaValue b) {
+  if (a.type == TYPE_INT && b.type == TYPE_INT) return sigma_int_multiply(a.as.integer, b.as.integer);
+  return sigma_make_number(sigma_num(a) * sigma_num(b));
+}
+
+SIGMA_INLINE SigmaValue sigma_divide(SigmaValue a, SigmaValue b) {
+  if (a.type == TYPE_INT && b.type == TYPE_INT) return sigma_int_divide(a.as.integer, b.as.integer);
+  return sigma_make_number(sigma_num(a) / sigma_num(b));
+}
+
+SIGMA_INLINE SigmaValue sigma_modulo(SigmaValue a, SigmaValue b) {
+  if (a.type == TYPE_INT && b.type == TYPE_INT) return sigma_int_modulo(a.as.integer, b.as.integer);
+  return sigma_make_number(fmod(sigma_num(a), sigma_num(b)));
+}
+
+SIGMA_INLINE SigmaValue sigma_not_equals(SigmaValue a, SigmaValue b) {
+  return sigma_make_bool(!sigma_is_truthy(sigma_equals(a, b)));
+}
+
+SIGMA_INLINE SigmaValue sigma_less_than(SigmaValue a, SigmaValue b) {
+  if (a.type == TYPE_INT && b.type == TYPE_INT) return sigma_make_bool(a.as.integer < b.as.integer);
+  return sigma_make_bool(sigma_num(a) < sigma_num(b));
+}
+
+SIGMA_INLINE SigmaValue sigma_greater_than(SigmaValue a, SigmaValue b) {
+  if (a.type == TYPE_INT && b.type == TYPE_INT) return sigma_make_bool(a.as.integer > b.as.integer);
+  return sigma_make_bool(sigma_num(a) > sigma_num(b));
+}
+
+SIGMA_INLINE SigmaValue sigma_less_equal(SigmaValue a, SigmaValue b) {
+  if (a.type == TYPE_INT && b.type == TYPE_INT) return sigma_make_bool(a.as.integer <= b.as.integer);
+  return sigma_make_bool(sigma_num(a) <= sigma_num(b));
+}
+
+SIGMA_INLINE SigmaValue sigma_greater_equal(SigmaValue a, SigmaValue b) {
+  if (a.type == TYPE_INT && b.type == TYPE_INT) return sigma_make_bool(a.as.integer >= b.as.integer);
+  return sigma_make_bool(sigma_num(a) >= sigma_num(b));
+}
+
+SIGMA_INLINE SigmaValue sigma_logical_and(SigmaValue a, SigmaValue b) {
+  return sigma_make_bool(sigma_is_truthy(a) && sigma_is_truthy(b));
+}
+
+SIGMA_INLINE SigmaValue sigma_logical_or(SigmaValue a, SigmaValue b) {
+  return sigma_make_bool(sigma_is_truthy(a) || sigma_is_truthy(b));
+}
+
+// Literal arrays/objects that do not escape: CodeGen declares the header and
+// buffers as locals and these wire them together, with no allocation.
+SIGMA_INLINE SigmaValue sigma_stack_array(SigmaArray* hdr, void** items, SigmaValue* vals, int n) {
+  for (int i = 0; i < n; i++) items[i] = &vals[i];
+  hdr->items = items;
+  hdr->size = n;
+  hdr->capacity = n;
+  hdr->flags = SIGMA_STACK_STORAGE;
+  SigmaValue v; v.type = TYPE_ARRAY; v.as.array = hdr; return v;
+}
+
+SIGMA_INLINE SigmaValue sigma_stack_object(SigmaObject* hdr, char** keys, void** slots, SigmaValue* vals, int n) {
+  for (int i = 0; i < n; i++) slots[i] = &vals[i];
+  hdr->keys = keys;
+  hdr->values = slots;
+  hdr->size = n;
+  hdr->capacity = n;
+  hdr->flags = SIGMA_STACK_STORAGE;
+  SigmaValue v; v.type = TYPE_OBJECT; v.as.object = hdr; return v;
+}
+
+// $fixed literals: CodeGen emits the header, buffers and strings as static
+// data and these only make a value of them.
+SIGMA_INLINE SigmaValue sigma_static_array(SigmaArray* hdr) {
+  SigmaValue v; v.type = TYPE_ARRAY; v.as.array = hdr; return v;
+}
+
+SIGMA_INLINE SigmaValue sigma_static_object(SigmaObject* hdr) {
+  SigmaValue v; v.type = TYPE_OBJECT; v.as.object = hdr; return v;
+}
+
+void sigma_array_unshare(SigmaArray* a, int capacity);
+void sigma_object_unshare(SigmaObject* o, int capacity);
+
+// Elements of an array or typed array, bytes of a string, entries of a
+// dict, rows of a table; 0 for anything else.
+SIGMA_INLINE int64_t sigma_len(SigmaValue v) {
+  if (v.type == TYPE_ARRAY) return v.as.array->size;
+  if (v.type == TYPE_STRING) return (int64_t)sigma_str_len(v.as.string);
+  if (v.type == TYPE_DICT) return v.as.dict->size;
+  if (v.type == TYPE_TYPED) return v.as.typed->size;
+  if (v.type == TYPE_TABLE) return v.as.table->rows;
+  return 0;
+}
+
+// Unchecked element access, for indices the compiler has proven to be in
+// bounds of a value it knows to be an array.
+SIGMA_INLINE SigmaValue sigma_array_at(SigmaValue arr, int64_t i) {
+  return *(SigmaValue*)arr.as.array->items[i];
+}
+
+SIGMA_INLINE void sigma_array_put(SigmaValue arr, int64_t i, SigmaValue v) {
+  SigmaArray* a = arr.as.array;
+  if (__builtin_expect(a->flags & SIGMA_STATIC_STORAGE, 0)) sigma_array_unshare(a, a->size);
+  *(SigmaValue*)a->items[i] = v;
+}
+
+// Item i of a collection sigma_iter_check accepted, for 0 <= i <
+// sigma_len(c): an element, a dict's i-th key or a one-character string.
+SIGMA_INLINE SigmaValue sigma_iter_at(SigmaValue c, int64_t i) {
+  if (c.type == TYPE_ARRAY) return sigma_array_at(c, i);
+  return sigma_iter_at_slow(c, i);
+}
+
+// Elements of a value the compiler knows to be a typed array of the kind
+// in the name. The data pointers are for indices it has proven in bounds;
+// _get and _set check the index, and byte stores check the value.
+SIGMA_INLINE double* sigma_f64_data(SigmaValue arr) {
+  return (double*)arr.as.typed->data;
+}
+
+SIGMA_INLINE int64_t* sigma_i64_data(SigmaValue arr) {
+  return (int64_t*)arr.as.typed->data;
+}
+
+SIGMA_INLINE uint8_t* sigma_u8_data(SigmaValue arr) {
+  return (uint8_t*)arr.as.typed->data;
+}
+
+SIGMA_INLINE int sigma_typed_in_bounds(SigmaValue arr, int64_t i) {
+  if (__builtin_expect((uint64_t)i < (uint64_t)arr.as.typed->size, 1)) return 1;
+  sigma_typed_index_error(arr, i);
+  return 0;
+}
+
+SIGMA_INLINE double sigma_f64_get(SigmaValue arr, int64_t i) {
+  return sigma_typed_in_bounds(arr, i) ? sigma_f64_data(arr)[i] : 0;
+}
+
+SIGMA_INLINE int64_t sigma_i64_get(SigmaValue arr, int64_t i) {
+  return sigma_typed_in_bounds(arr, i) ? sigma_i64_data(arr)[i] : 0;
+}
+
+SIGMA_INLINE int64_t sigma_u8_get(SigmaValue arr, int64_t i) {
+  return sigma_typed_in_bounds(arr, i) ? sigma_u8_data(arr)[i] : 0;
+}
+
+SIGMA_INLINE void sigma_f64_set(SigmaValue arr, int64_t i, double v) {
+  if (sigma_typed_in_bounds(arr, i)) sigma_f64_data(arr)[i] = v;
+}
+
+SIGMA_INLINE void sigma_i64_set(SigmaValue arr, int64_t i, int64_t v) {
+  if (sigma_typed_in_bounds(arr, i)) sigma_i64_data(arr)[i] = v;
+}
+
+SIGMA_INLINE void sigma_u8_put(SigmaValue arr, int64_t i, int64_t v) {
+  if (__builtin_expect((uint64_t)v > 255, 0)) sigma_byte_error(v);
+  else sigma_u8_data(arr)[i] = (uint8_t)v;
+}
+
+SIGMA_INLINE void sigma_u8_set(SigmaValue arr, int64_t i, int64_t v) {
+  if (sigma_typed_in_bounds(arr, i)) sigma_u8_put(arr, i, v);
+}
+
+SIGMA_INLINE SigmaValue sigma_object_get(SigmaValue obj, const char* key) {
+  if (obj.type != TYPE_OBJECT) return sigma_make_nil();
+  for (int i = 0; i < obj.as.object->size; i++) {
+    if (strcmp(obj.as.object->keys[i], key) == 0) {
+      return *(SigmaValue*)obj.as.object->values[i];
+    }
+  }
+  return sigma_make_nil();
+}
+
+// A function of a library built with sig --shared, listed in the library's
+// sigma_exports table, which ends with a NULL name.
+typedef struct {
+  const char* name;
+  void* fn;
+  int arity;
+} SigmaExport;
+
+// Allocation profiling (sig --mem-stats, which defines SIGMA_MEM_STATS as 1
+// for a table and 2 for JSON). Generated code calls sigma_mem_at before the
+// instructions of each Sigma line, and every runtime allocation is charged
+// to the line set last. The report goes to stderr at exit, or to the file
+// named by $SIGMA_MEM_STATS_FILE.
+#ifdef SIGMA_MEM_STATS
+extern _Thread_local const char* sigma_mem_file;
+extern _Thread_local int sigma_mem_line;
+
+SIGMA_INLINE void sigma_mem_at(const char* file, int line) {
+  sigma_mem_file = file;
+  sigma_mem_line = line;
+}
+#endif
+
+#endif